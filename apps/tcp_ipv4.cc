@@ -11,6 +11,7 @@
 #include <span>
 #include <string>
 #include <tuple>
+#include <utility>
 
 using namespace std;
 
@@ -30,8 +31,9 @@ void show_usage( const char* argv0, const char* msg )
        << "   -a <addr>       Set source address (client mode only)           " << LOCAL_ADDRESS_DFLT << "\n"
        << "   -s <port>       Set source port (client mode only)              (random)\n\n"
 
-       << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::MAX_PAYLOAD_SIZE
-       << "\n\n"
+       << "   -w <winsz>      Use a receive window of <winsz> bytes           " << TCPConfig::DEFAULT_CAPACITY
+       << "\n"
+       << "                   (up to " << TCPConfig::MAX_WINDOW << ", using window scaling above 65535)\n\n"
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
@@ -89,6 +91,12 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     } else if ( strncmp( "-w", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -w requires one argument." );
       c_fsm.recv_capacity = strtol( args[curr + 1], nullptr, 0 );
+      if ( c_fsm.recv_capacity == 0 or c_fsm.recv_capacity > TCPConfig::MAX_WINDOW ) {
+        const string err
+          = "ERROR: -w requires a window between 1 and " + to_string( TCPConfig::MAX_WINDOW ) + " bytes.";
+        show_usage( args.front(), err.c_str() );
+        exit( 1 );
+      }
       curr += 2;
 
     } else if ( strncmp( "-t", args[curr], 3 ) == 0 ) {
@@ -158,8 +166,10 @@ int main( int argc, char** argv )
     }
 
     auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
-    LossyTCPOverIPv4MinnowSocket tcp_socket( LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>(
-      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
+    TunFD tun { tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name };
+    c_fsm.mtu = tun.mtu(); // the MSS we advertise is what the device can carry
+    LossyTCPOverIPv4MinnowSocket tcp_socket(
+      LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>( TCPOverIPv4OverTunFdAdapter( std::move( tun ) ) ) );
 
     if ( listen ) {
       tcp_socket.listen_and_accept( c_fsm, c_filt );
@@ -23,6 +23,8 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_backends)
+ttest(spsc_byte_ring)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -31,6 +33,8 @@ ttest(reassembler_dup)
 ttest(reassembler_holes)
 ttest(reassembler_overlapping)
 ttest(reassembler_win)
+ttest(reassembler_engines)
+ttest(reassembler_ranges)
 
 ttest(wrapping_integers_cmp)
 ttest(wrapping_integers_wrap)
@@ -45,6 +49,8 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_sack)
+ttest(recv_timestamps)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,6 +59,24 @@ ttest(send_window)
 ttest(send_ack)
 ttest(send_close)
 ttest(send_extra)
+ttest(send_sack)
+ttest(send_congestion_control)
+ttest(send_rtt_estimation)
+ttest(send_timestamps)
+ttest(peer_window_scaling)
+ttest(peer_timestamps)
+ttest(peer_plpmtud)
+ttest(peer_delayed_ack)
+ttest(peer_ack_clock)
+ttest(send_fast_retransmit)
+ttest(send_rack_tlp)
+ttest(send_pacing)
+ttest(send_nagle)
+ttest(send_retransmit_buffer)
+ttest(tcp_stack)
+ttest(sharded_tcp_stack)
+ttest(eventloop)
+ttest(io_uring)
 
 ttest(net_interface)
 
@@ -66,12 +90,14 @@ add_custom_target (check1 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --s
 
 add_custom_target (check2 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R '^byte_stream_|^reassembler_|^wrapping|^recv')
 
-add_custom_target (check3 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R '^byte_stream_|^reassembler_|^wrapping|^recv|^send')
+add_custom_target (check3 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R '^byte_stream_|^reassembler_|^wrapping|^recv|^send|^peer')
 
 add_custom_target (check5 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R '^net_interface')
 
 add_custom_target (check6 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R '^net_interface|^router')
 
+add_custom_target (check_stack COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R '^tcp_stack|^sharded_tcp_stack|^eventloop|^io_uring|^spsc_byte_ring')
+
 ###
 
 add_custom_target (speed COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --timeout 12 -R '_speed_test')
@@ -90,3 +116,20 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(byte_stream_syscall_speed_test)
+stest(payload_copy_speed_test)
+stest(sack_loss_speed_test)
+stest(congestion_control_speed_test)
+stest(plpmtud_speed_test)
+stest(delayed_ack_speed_test)
+stest(fast_retransmit_speed_test)
+stest(rack_tlp_speed_test)
+stest(pacing_speed_test)
+stest(nagle_speed_test)
+stest(retransmit_buffer_speed_test)
+stest(tcp_stack_speed_test)
+stest(tcp_listen_speed_test)
+stest(sharded_tcp_stack_speed_test)
+stest(eventloop_speed_test)
+stest(io_uring_speed_test)
+stest(tcp_minnow_socket_speed_test)
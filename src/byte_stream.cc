@@ -1,17 +1,34 @@
 #include "byte_stream.hh"
 
+#include <stdexcept>
+
 using namespace std;
 
-ByteStream::ByteStream( uint64_t capacity )
+ByteStream::ByteStream( uint64_t capacity, Backend backend )
   : capacity_( capacity )
   , error_( false )
   , is_close( false )
   , num_bytes_pushed( 0 )
   , num_bytes_popped( 0 )
   , num_bytes_buffered( 0 )
+  , backend_( backend )
+  , ring_( backend == Backend::Deque ? 0 : capacity, backend == Backend::MirroredRing )
   , bytes_queue()
 {}
 
+string_view ByteStream::backend_name( Backend backend )
+{
+  switch ( backend ) {
+    case Backend::MirroredRing:
+      return "mirrored ring";
+    case Backend::Ring:
+      return "ring";
+    case Backend::Deque:
+      return "deque";
+  }
+  throw runtime_error( "unknown ByteStream backend" );
+}
+
 bool Writer::is_closed() const
 {
   return is_close;
@@ -23,16 +40,79 @@ void Writer::push( string data )
     return;
 
   uint64_t num = min( available_capacity(), data.size() );
-  if ( available_capacity() < data.size() ) {
-    data = data.substr( 0, available_capacity() );
+  if ( backend_ != Backend::Deque ) {
+    ring_.push( data );
+  } else {
+    if ( available_capacity() < data.size() ) {
+      data.resize( available_capacity() );
+    }
+    bytes_queue.emplace_back( std::move( data ) );
   }
   num_bytes_buffered += num;
   num_bytes_pushed += num;
-  bytes_queue.push_back( std::move( data ) );
 
   return;
 }
 
+void Writer::push( Cord data )
+{
+  if ( is_close || available_capacity() == 0 || data.empty() )
+    return;
+
+  if ( available_capacity() < data.size() ) {
+    data.remove_suffix( data.size() - available_capacity() );
+  }
+  const uint64_t num = data.size();
+  for ( const auto& slice : data.slices() ) {
+    if ( backend_ != Backend::Deque ) {
+      ring_.push( slice );
+    } else {
+      bytes_queue.push_back( slice );
+    }
+  }
+  num_bytes_buffered += num;
+  num_bytes_pushed += num;
+}
+
+span<char> Writer::reserve( uint64_t len )
+{
+  if ( is_close ) {
+    return {};
+  }
+  len = min( len, available_capacity() );
+  if ( backend_ != Backend::Deque ) {
+    const auto region = ring_.reserve( len );
+    reserved_len_ = region.size();
+    return region;
+  }
+  reserved_.resize( len );
+  reserved_len_ = len;
+  return reserved_;
+}
+
+void Writer::commit( uint64_t len )
+{
+  if ( len == 0 ) {
+    return;
+  }
+  if ( len > available_capacity() ) {
+    throw runtime_error( "Writer::commit: committing more than the available capacity" );
+  }
+  if ( len > reserved_len_ ) {
+    throw runtime_error( "Writer::commit: committing more than was reserved" );
+  }
+  reserved_len_ = 0;
+  if ( backend_ != Backend::Deque ) {
+    ring_.commit( len );
+  } else {
+    reserved_.resize( len );
+    bytes_queue.emplace_back( std::move( reserved_ ) );
+    reserved_.clear();
+  }
+  num_bytes_buffered += len;
+  num_bytes_pushed += len;
+}
+
 void Writer::close()
 {
   is_close = true;
@@ -60,16 +140,62 @@ uint64_t Reader::bytes_popped() const
 
 string_view Reader::peek() const
 {
-  string_view sw( bytes_queue.front() );
-  return sw;
+  if ( backend_ != Backend::Deque ) {
+    return ring_.peek();
+  }
+  if ( bytes_queue.empty() ) {
+    return {};
+  }
+  return bytes_queue.front().view();
+}
+
+vector<string_view> Reader::peek_iov( uint64_t max_len ) const
+{
+  max_len = min( max_len, num_bytes_buffered );
+  if ( backend_ != Backend::Deque ) {
+    return ring_.peek_iov( max_len );
+  }
+
+  vector<string_view> segments;
+  for ( auto it = bytes_queue.begin(); max_len > 0 and it != bytes_queue.end(); ++it ) {
+    const string_view segment = it->view().substr( 0, max_len );
+    segments.push_back( segment );
+    max_len -= segment.size();
+  }
+  return segments;
+}
+
+Cord Reader::peek_cord( uint64_t max_len ) const
+{
+  max_len = min( max_len, num_bytes_buffered );
+  Cord ret;
+  if ( backend_ != Backend::Deque ) {
+    for ( const auto segment : ring_.peek_iov( max_len ) ) {
+      ret.append( Slice::copy_of( segment ) );
+    }
+    return ret;
+  }
+
+  for ( auto it = bytes_queue.begin(); max_len > 0 and it != bytes_queue.end(); ++it ) {
+    Slice segment = it->substr( 0, max_len );
+    max_len -= segment.size();
+    ret.append( std::move( segment ) );
+  }
+  return ret;
 }
 
 void Reader::pop( uint64_t len )
 {
   uint64_t n = min( len, num_bytes_buffered );
+  if ( backend_ != Backend::Deque ) {
+    ring_.pop( n );
+    num_bytes_buffered -= n;
+    num_bytes_popped += n;
+    return;
+  }
   while ( n > 0 ) {
     if ( n < bytes_queue.front().size() ) {
-      bytes_queue.front().erase( 0, n );
+      bytes_queue.front().remove_prefix( n );
       num_bytes_buffered -= n;
       num_bytes_popped += n;
       n = 0;
@@ -1,9 +1,14 @@
 #pragma once
 
+#include "cord.hh"
+#include "ring_buffer.hh"
+
 #include <cstdint>
 #include <queue>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 class Reader;
 class Writer;
@@ -11,7 +16,21 @@ class Writer;
 class ByteStream
 {
 public:
-  explicit ByteStream( uint64_t capacity );
+  // How the ByteStream stores buffered bytes. MirroredRing is the default: peek() sees every buffered byte
+  // and a write() costs no allocation. Its storage is reused once bytes are popped, so peek_cord() must copy
+  // them out (once: the TCPSender keeps that copy for retransmission, and it is written to the fd in place).
+  // Deque shares the writer's strings all the way to the fd, with no copy, but allocates a Slice per write
+  // and peek() returns one write at a time. Zero copy is opt-in: a TCPPeer uses Deque only with
+  // TCPConfig::zero_copy.
+  enum class Backend : uint8_t
+  {
+    MirroredRing, // circular buffer double-mapped through memfd: peek() returns every buffered byte
+    Ring,         // plain circular buffer: peek() returns the buffered bytes up to the wrap point
+    Deque,        // queue of refcounted Slices: peek() returns the front Slice, and Cords pass through uncopied
+  };
+  static std::string_view backend_name( Backend backend ); // "mirrored ring", "ring" or "deque"
+
+  explicit ByteStream( uint64_t capacity, Backend backend = Backend::MirroredRing );
 
   // Helper functions (provided) to access the ByteStream's Reader and Writer interfaces
   Reader& reader();
@@ -21,6 +40,7 @@ public:
 
   void set_error() { error_ = true; };       // Signal that the stream suffered an error.
   bool has_error() const { return error_; }; // Has the stream had an error?
+  uint64_t capacity() const { return capacity_; } // How many bytes can the stream buffer at most?
 
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
@@ -30,15 +50,27 @@ protected:
   uint64_t num_bytes_pushed;
   uint64_t num_bytes_popped;
   uint64_t num_bytes_buffered;
-  std::deque<std::string> bytes_queue;
+  Backend backend_;
+  RingBuffer ring_;                    // storage for the ring backends
+  std::deque<Slice> bytes_queue;       // storage for the deque backend
+  std::string reserved_ {};            // region handed out by Writer::reserve() (deque backend only)
+  uint64_t reserved_len_ {};           // length of the region handed out by the last Writer::reserve()
 };
 
 class Writer : public ByteStream
 {
 public:
   void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
+  void push( Cord data );        // Same, but the deque backend keeps the Cord's Slices without copying them
   void close();                  // Signal that the stream has reached its ending. Nothing more will be written.
 
+  // Zero-copy alternative to push(): reserve() returns a writable region of at most `len` bytes inside the
+  // stream's own storage (possibly shorter, e.g. if the storage wraps around), and commit() makes the
+  // first `len` bytes written there available to the Reader. Each reserve() must be followed by one commit(),
+  // of no more than the region's length.
+  std::span<char> reserve( uint64_t len );
+  void commit( uint64_t len );
+
   bool is_closed() const;              // Has the stream been closed?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
   uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
@@ -50,6 +82,13 @@ public:
   std::string_view peek() const; // Peek at the next bytes in the buffer
   void pop( uint64_t len );      // Remove `len` bytes from the buffer
 
+  // Peek at every buffered segment (up to `max_len` bytes in total), e.g. to drain the stream with one writev
+  std::vector<std::string_view> peek_iov( uint64_t max_len = UINT64_MAX ) const;
+
+  // Peek at up to `max_len` bytes as a Cord. The deque backend shares its Slices (no copy);
+  // the ring backends copy the bytes out.
+  Cord peek_cord( uint64_t max_len ) const;
+
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
   uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
   uint64_t bytes_popped() const;   // Total number of bytes cumulatively popped from stream
@@ -60,3 +99,18 @@ public:
  * from a ByteStream Reader into a string;
  */
 void read( Reader& reader, uint64_t len, std::string& out );
+void read( Reader& reader, uint64_t len, Cord& out );
+
+class FileDescriptor;
+
+/*
+ * read_into: read from `fd` straight into the Writer's storage (as much as its available capacity
+ * allows), without an intermediate string; returns the number of bytes read
+ */
+size_t read_into( FileDescriptor& fd, Writer& writer );
+
+/*
+ * write_from: drain as much of the Reader as `fd` accepts with a single writev, popping exactly
+ * what was written; returns the number of bytes written
+ */
+size_t write_from( FileDescriptor& fd, Reader& reader );
@@ -1,5 +1,7 @@
 #include "byte_stream.hh"
+#include "file_descriptor.hh"
 
+#include <climits>
 #include <cstdint>
 #include <stdexcept>
 
@@ -24,6 +26,47 @@ void read( Reader& reader, uint64_t len, std::string& out )
   }
 }
 
+/*
+ * read: Like the above, but into a Cord (which, for the deque backend, shares the stream's Slices
+ * instead of copying them).
+ */
+void read( Reader& reader, uint64_t len, Cord& out )
+{
+  out = reader.peek_cord( len );
+  reader.pop( out.size() );
+}
+
+/*
+ * read_into: read from the fd straight into the Writer's storage,
+ * without an intermediate string.
+ */
+size_t read_into( FileDescriptor& fd, Writer& writer )
+{
+  const auto region = writer.reserve( writer.available_capacity() );
+  const size_t bytes_read = fd.read( region );
+  writer.commit( bytes_read );
+  return bytes_read;
+}
+
+/*
+ * write_from: write every buffered segment of the Reader with one writev,
+ * then pop what the fd accepted.
+ */
+size_t write_from( FileDescriptor& fd, Reader& reader )
+{
+  if ( not reader.bytes_buffered() ) {
+    return 0;
+  }
+
+  auto segments = reader.peek_iov();
+  if ( segments.size() > IOV_MAX ) {
+    segments.resize( IOV_MAX );
+  }
+  const size_t bytes_written = fd.write( segments );
+  reader.pop( bytes_written );
+  return bytes_written;
+}
+
 Reader& ByteStream::reader()
 {
   static_assert( sizeof( Reader ) == sizeof( ByteStream ),
@@ -0,0 +1,118 @@
+#include "congestion_control.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+unique_ptr<CongestionController> make_congestion_controller( CongestionControl algorithm, uint64_t mss )
+{
+  switch ( algorithm ) {
+    case CongestionControl::None:
+      return {};
+    case CongestionControl::NewReno:
+      return make_unique<NewReno>( mss );
+    case CongestionControl::CUBIC:
+      return make_unique<CUBIC>( mss );
+  }
+  throw runtime_error( "unknown congestion control algorithm" );
+}
+
+namespace {
+// RFC 6928 initial window
+uint64_t initial_window( uint64_t mss )
+{
+  return min( 10 * mss, max( 2 * mss, uint64_t { 14600 } ) );
+}
+} // namespace
+
+NewReno::NewReno( uint64_t mss ) : mss_( mss ), cwnd_( initial_window( mss ) ), ssthresh_( UINT64_MAX ) {}
+
+void NewReno::on_ack( uint64_t bytes_acked, uint64_t /* now_ms */ )
+{
+  if ( cwnd_ < ssthresh_ ) {
+    cwnd_ += min( bytes_acked, 2 * mss_ ); // slow start, crediting both segments of a delayed ACK (RFC 3465)
+    return;
+  }
+
+  // congestion avoidance: one MSS per window of acknowledged bytes
+  bytes_acked_ += bytes_acked;
+  if ( bytes_acked_ >= cwnd_ ) {
+    bytes_acked_ -= cwnd_;
+    cwnd_ += mss_;
+  }
+}
+
+void NewReno::on_congestion_event( uint64_t bytes_in_flight, uint64_t /* now_ms */ )
+{
+  ssthresh_ = max( bytes_in_flight / 2, 2 * mss_ );
+  cwnd_ = ssthresh_;
+  bytes_acked_ = 0;
+}
+
+void NewReno::on_timeout( uint64_t bytes_in_flight, uint64_t /* now_ms */ )
+{
+  ssthresh_ = max( bytes_in_flight / 2, 2 * mss_ );
+  cwnd_ = mss_;
+  bytes_acked_ = 0;
+}
+
+CUBIC::CUBIC( uint64_t mss )
+  : mss_( static_cast<double>( mss ) )
+  , cwnd_( static_cast<double>( initial_window( mss ) ) )
+  , ssthresh_( static_cast<double>( UINT64_MAX ) )
+{}
+
+void CUBIC::on_ack( uint64_t bytes_acked, uint64_t now_ms )
+{
+  const double acked = static_cast<double>( bytes_acked );
+  if ( cwnd_ < ssthresh_ ) {
+    cwnd_ += min( acked, 2 * mss_ ); // slow start (RFC 3465)
+    return;
+  }
+
+  if ( not epoch_start_.has_value() ) {
+    epoch_start_ = now_ms;
+    if ( cwnd_ < w_max_ ) {
+      k_ = cbrt( ( w_max_ - cwnd_ ) / mss_ / C );
+    } else {
+      k_ = 0;
+      w_max_ = cwnd_;
+    }
+    w_est_ = cwnd_;
+  }
+
+  const double t = static_cast<double>( now_ms - *epoch_start_ ) / 1000;
+  const double w_cubic = C * pow( t - k_, 3 ) * mss_ + w_max_;
+  w_est_ += mss_ * ( 3 * ( 1 - beta ) / ( 1 + beta ) ) * acked / cwnd_;
+
+  if ( w_cubic < w_est_ ) {
+    cwnd_ = w_est_; // Reno-friendly region
+  } else {
+    const double target = min( w_cubic, 1.5 * cwnd_ );
+    if ( target > cwnd_ ) {
+      cwnd_ += ( target - cwnd_ ) * acked / cwnd_;
+    }
+  }
+}
+
+void CUBIC::reduce()
+{
+  epoch_start_.reset();
+  // fast convergence: release bandwidth sooner when the plateau keeps dropping
+  w_max_ = cwnd_ < w_max_ ? cwnd_ * ( 1 + beta ) / 2 : cwnd_;
+  ssthresh_ = max( cwnd_ * beta, 2 * mss_ );
+}
+
+void CUBIC::on_congestion_event( uint64_t /* bytes_in_flight */, uint64_t /* now_ms */ )
+{
+  reduce();
+  cwnd_ = ssthresh_;
+}
+
+void CUBIC::on_timeout( uint64_t /* bytes_in_flight */, uint64_t /* now_ms */ )
+{
+  reduce();
+  cwnd_ = mss_;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "tcp_config.hh"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+// A congestion control algorithm: told about the TCPSender's ACKs, losses and timeouts, it decides
+// how many bytes (the congestion window) may be in flight.
+class CongestionController
+{
+public:
+  // `bytes_acked` newly acknowledged bytes arrived (not called during fast recovery)
+  virtual void on_ack( uint64_t bytes_acked, uint64_t now_ms ) = 0;
+
+  // a loss was detected from SACK or duplicate-ACK information: fast recovery begins
+  virtual void on_congestion_event( uint64_t bytes_in_flight, uint64_t now_ms ) = 0;
+
+  // the retransmission timer expired
+  virtual void on_timeout( uint64_t bytes_in_flight, uint64_t now_ms ) = 0;
+
+  // the sender's segments changed size (from the peer's MSS, or path MTU discovery)
+  virtual void set_mss( uint64_t mss ) = 0;
+
+  virtual uint64_t cwnd() const = 0;
+  virtual bool in_slow_start() const = 0;
+  virtual std::string_view name() const = 0;
+
+  virtual ~CongestionController() = default;
+};
+
+// Returns nothing for CongestionControl::None
+std::unique_ptr<CongestionController> make_congestion_controller( CongestionControl algorithm, uint64_t mss );
+
+// RFC 5681 slow start and congestion avoidance, halving the window once per loss event (RFC 6582)
+class NewReno : public CongestionController
+{
+public:
+  explicit NewReno( uint64_t mss );
+
+  void on_ack( uint64_t bytes_acked, uint64_t now_ms ) override;
+  void on_congestion_event( uint64_t bytes_in_flight, uint64_t now_ms ) override;
+  void on_timeout( uint64_t bytes_in_flight, uint64_t now_ms ) override;
+  void set_mss( uint64_t mss ) override { mss_ = mss; }
+
+  uint64_t cwnd() const override { return cwnd_; }
+  bool in_slow_start() const override { return cwnd_ < ssthresh_; }
+  std::string_view name() const override { return "NewReno"; }
+
+private:
+  uint64_t mss_;
+  uint64_t cwnd_;
+  uint64_t ssthresh_;
+  uint64_t bytes_acked_ {}; // acknowledged since the window last grew in congestion avoidance
+};
+
+// RFC 9438: after a loss the window grows along a cubic curve of the time since the loss, plateauing
+// around the window where the loss happened, and never slower than Reno would.
+class CUBIC : public CongestionController
+{
+public:
+  explicit CUBIC( uint64_t mss );
+
+  void on_ack( uint64_t bytes_acked, uint64_t now_ms ) override;
+  void on_congestion_event( uint64_t bytes_in_flight, uint64_t now_ms ) override;
+  void on_timeout( uint64_t bytes_in_flight, uint64_t now_ms ) override;
+  void set_mss( uint64_t mss ) override { mss_ = static_cast<double>( mss ); }
+
+  uint64_t cwnd() const override { return static_cast<uint64_t>( cwnd_ ); }
+  bool in_slow_start() const override { return cwnd_ < ssthresh_; }
+  std::string_view name() const override { return "CUBIC"; }
+
+private:
+  static constexpr double C = 0.4;
+  static constexpr double beta = 0.7;
+
+  double mss_;
+  double cwnd_;
+  double ssthresh_;
+  double w_max_ {};                        // window before the last reduction
+  double w_est_ {};                        // what Reno's window would be (the "Reno-friendly" estimate)
+  double k_ {};                            // seconds from the start of the epoch until the curve reaches w_max_
+  std::optional<uint64_t> epoch_start_ {}; // when congestion avoidance began since the last reduction
+
+  void reduce();
+};
@@ -1,81 +1,263 @@
 #include "reassembler.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 using namespace std;
 
-void Reassembler::insert( uint64_t first_index, string data, bool is_last_substring )
+namespace {
+constexpr size_t max_recent_inserts = 8; // more than the number of SACK blocks that fit in a TCP header
+} // namespace
+
+template<class Store>
+void BasicReassembler<Store>::insert( uint64_t first_index, Cord data, bool is_last_substring )
 {
-  uint64_t capacity = output_.writer().available_capacity();
+  const uint64_t capacity = output_.writer().available_capacity();
   if ( output_.writer().is_closed() || capacity == 0 || first_index >= expect_idx + capacity )
     return;
-  if ( first_index + data.length() <= expect_idx && !is_last_substring )
+  if ( first_index + data.size() <= expect_idx && !is_last_substring )
     return;
 
   if ( is_last_substring )
-    last_idx = first_index + data.length();
-  if ( first_index + data.length() >= expect_idx + capacity ) {
-    data.resize( expect_idx + capacity - first_index );
-    is_last_substring = false;
+    last_idx = first_index + data.size();
+
+  // trim to the window [expect_idx, expect_idx + capacity)
+  if ( first_index + data.size() > expect_idx + capacity )
+    data.remove_suffix( first_index + data.size() - ( expect_idx + capacity ) );
+  if ( first_index < expect_idx ) {
+    data.remove_prefix( min( expect_idx - first_index, data.size() ) );
+    first_index = expect_idx;
+  }
+
+  if ( !data.empty() ) {
+    store_.insert( first_index, std::move( data ) );
+    recent_inserts_.push_front( first_index );
+    if ( recent_inserts_.size() > max_recent_inserts )
+      recent_inserts_.pop_back();
+  }
+
+  expect_idx += store_.pop_ready( expect_idx, output_.writer() );
+
+  if ( last_idx.has_value() && expect_idx == last_idx.value() ) {
+    output_.writer().close();
   }
-  uint64_t idx = 0, pos = cache.size();
-  bool found_pos = false;
-  for ( auto iter = cache.begin(); iter != cache.end(); ) {
-    auto& [cur_first_idx, cur_data] = *iter;
-    if ( first_index > cur_first_idx + cur_data.length() ) { // totally after
-      idx++;
-      iter++;
-      continue;
+}
+
+template<class Store>
+vector<IndexRange> BasicReassembler<Store>::held_ranges( size_t max_count ) const
+{
+  vector<IndexRange> ret;
+  const auto add = [&]( const IndexRange& range ) {
+    if ( ret.size() < max_count && find( ret.begin(), ret.end(), range ) == ret.end() )
+      ret.push_back( range );
+  };
+
+  for ( const uint64_t index : recent_inserts_ ) {
+    if ( const auto range = store_.range_containing( expect_idx, index ) )
+      add( *range );
+  }
+  for ( const auto& range : store_.ranges( expect_idx, max_count + ret.size() ) ) {
+    add( range );
+  }
+  return ret;
+}
+
+template class BasicReassembler<IntervalMapStore>;
+template class BasicReassembler<BitmapStore>;
+
+void IntervalMapStore::insert( uint64_t first_index, Cord data )
+{
+  uint64_t last_index = first_index + data.size();
+  auto next = intervals_.upper_bound( first_index );
+
+  // merge with the interval before, if it overlaps or touches
+  if ( next != intervals_.begin() ) {
+    auto prev = std::prev( next );
+    const uint64_t prev_end = prev->first + prev->second.size();
+    if ( prev_end >= last_index )
+      return; // already have all of it
+    if ( prev_end >= first_index ) {
+      data.remove_prefix( prev_end - first_index );
+      num_bytes_pending_ -= prev->second.size();
+      Cord merged = std::move( prev->second );
+      merged.append( std::move( data ) );
+      data = std::move( merged );
+      first_index = prev->first;
+      intervals_.erase( prev );
     }
-    if ( first_index + data.length() < cur_first_idx ) { // totally before
-      if ( !found_pos )
-        pos = idx;
-      break;
-    } else {
-      if ( !found_pos ) {
-        pos = idx;
-        found_pos = true;
-      }
-      if ( first_index < cur_first_idx ) {
-        if ( first_index + data.length() <= cur_first_idx + cur_data.length() ) {
-          data.resize( cur_first_idx - first_index );
-          data += cur_data;
-        }
-        num_bytes_pending -= cur_data.length();
-      } else {
-        if ( first_index + data.length() >= cur_first_idx + cur_data.length() ) {
-          num_bytes_pending -= cur_data.length();
-          cur_data.resize( first_index - cur_first_idx );
-          data = cur_data + data;
-        } else {
-          num_bytes_pending -= cur_data.length();
-          data = cur_data;
-        }
-        first_index = cur_first_idx;
-      }
-      iter = cache.erase( iter );
+  }
+
+  // absorb the intervals after, while they overlap or touch
+  while ( next != intervals_.end() && next->first <= last_index ) {
+    const uint64_t next_end = next->first + next->second.size();
+    if ( next_end > last_index ) {
+      next->second.remove_prefix( last_index - next->first );
+      data.append( std::move( next->second ) );
+      last_index = next_end;
     }
-    idx++;
+    num_bytes_pending_ -= next_end - next->first;
+    next = intervals_.erase( next );
   }
-  auto iter = cache.begin();
-  advance( iter, pos );
-  num_bytes_pending += data.length();
-  cache.insert( iter, make_pair( first_index, std::move( data ) ) );
-
-  if ( expect_idx >= cache.front().first ) {
-    cache.front().second.erase( 0, expect_idx - cache.front().first );
-    num_bytes_pending -= expect_idx - cache.front().first;
-    expect_idx += cache.front().second.length();
-    num_bytes_pending -= cache.front().second.length();
-    output_.writer().push( std::move( cache.front().second ) );
-    cache.pop_front();
+
+  num_bytes_pending_ += data.size();
+  intervals_.emplace_hint( next, first_index, std::move( data ) );
+}
+
+uint64_t IntervalMapStore::pop_ready( uint64_t next_index, Writer& output )
+{
+  if ( intervals_.empty() || intervals_.begin()->first != next_index )
+    return 0;
+  Cord ready = std::move( intervals_.begin()->second );
+  intervals_.erase( intervals_.begin() );
+  const uint64_t len = ready.size();
+  num_bytes_pending_ -= len;
+  output.push( std::move( ready ) );
+  return len;
+}
+
+optional<IndexRange> IntervalMapStore::range_containing( uint64_t /* next_index */, uint64_t index ) const
+{
+  auto it = intervals_.upper_bound( index );
+  if ( it == intervals_.begin() )
+    return {};
+  --it;
+  if ( index >= it->first + it->second.size() )
+    return {};
+  return IndexRange { it->first, it->first + it->second.size() };
+}
+
+vector<IndexRange> IntervalMapStore::ranges( uint64_t /* next_index */, size_t max_count ) const
+{
+  vector<IndexRange> ret;
+  for ( auto it = intervals_.begin(); it != intervals_.end() && ret.size() < max_count; ++it ) {
+    ret.emplace_back( it->first, it->first + it->second.size() );
   }
+  return ret;
+}
 
-  if ( expect_idx == last_idx && cache.empty() ) {
-    output_.writer().close();
+BitmapStore::BitmapStore( uint64_t capacity ) : buffer_( capacity ), present_( ( capacity + 63 ) / 64 ) {}
+
+void BitmapStore::insert( uint64_t first_index, const Cord& data )
+{
+  uint64_t pos = first_index % buffer_.size();
+  for ( const auto& slice : data.slices() ) {
+    string_view bytes = slice.view();
+    CopyCounter::add( bytes.size() );
+    while ( !bytes.empty() ) {
+      const uint64_t len = min( bytes.size(), buffer_.size() - pos );
+      memcpy( buffer_.data() + pos, bytes.data(), len );
+      num_bytes_pending_ += set_present( pos, pos + len );
+      bytes.remove_prefix( len );
+      pos = ( pos + len ) % buffer_.size();
+    }
+  }
+}
+
+uint64_t BitmapStore::pop_ready( uint64_t next_index, Writer& output )
+{
+  if ( buffer_.empty() )
+    return 0;
+  const uint64_t pos = next_index % buffer_.size();
+  const uint64_t len = run_length( pos, buffer_.size(), true );
+  if ( len == 0 )
+    return 0;
+  const uint64_t before_wrap = min( len, buffer_.size() - pos );
+  const uint64_t after_wrap = len - before_wrap;
+
+  // copy each run (the ring may wrap) into as many regions of the output as it takes
+  for ( auto [from, count] : { pair { pos, before_wrap }, pair { uint64_t {}, after_wrap } } ) {
+    while ( count > 0 ) {
+      const auto region = output.reserve( count );
+      if ( region.empty() )
+        throw runtime_error( "BitmapStore: the output has no room for bytes inside its window" );
+      memcpy( region.data(), buffer_.data() + from, region.size() );
+      output.commit( region.size() );
+      from += region.size();
+      count -= region.size();
+    }
   }
+  CopyCounter::add( len );
+  clear_present( pos, pos + before_wrap );
+  clear_present( 0, after_wrap );
+  num_bytes_pending_ -= len;
+  return len;
 }
 
-uint64_t Reassembler::bytes_pending() const
+namespace {
+// the bits of word `w` that lie in [begin, end)
+uint64_t word_mask( uint64_t w, uint64_t begin, uint64_t end )
 {
-  return num_bytes_pending;
+  const uint64_t lo = max( begin, w * 64 ) - w * 64;
+  const uint64_t hi = min( end, w * 64 + 64 ) - w * 64;
+  return ( hi == 64 ? ~uint64_t {} : ( uint64_t { 1 } << hi ) - 1 ) & ~( ( uint64_t { 1 } << lo ) - 1 );
+}
+} // namespace
+
+uint64_t BitmapStore::set_present( uint64_t begin, uint64_t end )
+{
+  uint64_t newly_set = 0;
+  for ( uint64_t w = begin / 64; w * 64 < end; ++w ) {
+    const uint64_t mask = word_mask( w, begin, end );
+    newly_set += popcount( mask & ~present_[w] );
+    present_[w] |= mask;
+  }
+  return newly_set;
+}
+
+void BitmapStore::clear_present( uint64_t begin, uint64_t end )
+{
+  for ( uint64_t w = begin / 64; w * 64 < end; ++w ) {
+    present_[w] &= ~word_mask( w, begin, end );
+  }
+}
+
+uint64_t BitmapStore::count_run( uint64_t begin, uint64_t end, bool present ) const
+{
+  uint64_t i = begin;
+  while ( i < end ) {
+    const uint64_t shift = i % 64;
+    const uint64_t word = present ? present_[i / 64] : ~present_[i / 64];
+    const uint64_t ones = countr_one( word >> shift ); // at most 64 - shift
+    i += ones;
+    if ( shift + ones < 64 )
+      break;
+  }
+  return min( i, end ) - begin;
+}
+
+uint64_t BitmapStore::run_length( uint64_t pos, uint64_t limit, bool present ) const
+{
+  const uint64_t before_wrap = count_run( pos, min<uint64_t>( buffer_.size(), pos + limit ), present );
+  if ( pos + before_wrap < buffer_.size() || before_wrap == limit )
+    return before_wrap;
+  return before_wrap + count_run( 0, min( pos, limit - before_wrap ), present );
+}
+
+optional<IndexRange> BitmapStore::range_containing( uint64_t next_index, uint64_t index ) const
+{
+  for ( const auto& range : ranges( next_index, buffer_.size() ) ) {
+    if ( index < range.first )
+      break;
+    if ( index < range.second )
+      return range;
+  }
+  return {};
+}
+
+vector<IndexRange> BitmapStore::ranges( uint64_t next_index, size_t max_count ) const
+{
+  vector<IndexRange> ret;
+  uint64_t offset = 0; // from next_index
+  while ( offset < buffer_.size() && ret.size() < max_count ) {
+    offset += run_length( ( next_index + offset ) % buffer_.size(), buffer_.size() - offset, false );
+    if ( offset == buffer_.size() )
+      break;
+    const uint64_t len = run_length( ( next_index + offset ) % buffer_.size(), buffer_.size() - offset, true );
+    ret.emplace_back( next_index + offset, next_index + offset + len );
+    offset += len;
+  }
+  return ret;
 }
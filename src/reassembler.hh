@@ -1,20 +1,83 @@
 #pragma once
 
 #include "byte_stream.hh"
-#include <list>
+#include <deque>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
 
-class Reassembler
+// A range [first, last) of stream indices
+using IndexRange = std::pair<uint64_t, uint64_t>;
+
+// Storage engines for bytes that arrive before the bytes preceding them. The Reassembler trims every
+// substring to its window before handing it over, so an engine only sees bytes in
+// [next index, next index + stream capacity) and never anything it has already given back.
+
+// Pending substrings kept as Cords in an ordered map keyed by first index, so merging never copies bytes.
+// The intervals are disjoint and never adjacent (touching neighbors are merged), so an insert only has to
+// look at its neighbors in the map: O(log n + number of intervals it overlaps).
+class IntervalMapStore
+{
+public:
+  explicit IntervalMapStore( uint64_t /* capacity */ ) {}
+
+  void insert( uint64_t first_index, Cord data );
+  // remove the bytes starting at `next_index`, if any, and write them to `output`; returns how many
+  uint64_t pop_ready( uint64_t next_index, Writer& output );
+  uint64_t bytes_pending() const { return num_bytes_pending_; }
+
+  // The held range that includes `index`, if any, and the first `max_count` held ranges in stream order
+  std::optional<IndexRange> range_containing( uint64_t next_index, uint64_t index ) const;
+  std::vector<IndexRange> ranges( uint64_t next_index, size_t max_count ) const;
+
+private:
+  std::map<uint64_t, Cord> intervals_ {};
+  uint64_t num_bytes_pending_ {};
+};
+
+// A preallocated ring of `capacity` bytes plus a bitmap of which of them are present. Byte i of the stream
+// lives at position i % capacity. An insert is a memcpy plus setting a range of bits, and delivery scans
+// for the first missing byte a 64-bit word at a time (countr_one), so memory is constant per connection,
+// there are no per-segment allocations, and the cost doesn't depend on how fragmented the stream is.
+// The bytes are copied in, and out straight into the output's storage (Writer::reserve), both counted by
+// CopyCounter.
+class BitmapStore
+{
+public:
+  explicit BitmapStore( uint64_t capacity );
+
+  void insert( uint64_t first_index, const Cord& data );
+  uint64_t pop_ready( uint64_t next_index, Writer& output );
+  uint64_t bytes_pending() const { return num_bytes_pending_; }
+
+  std::optional<IndexRange> range_containing( uint64_t next_index, uint64_t index ) const;
+  std::vector<IndexRange> ranges( uint64_t next_index, size_t max_count ) const;
+
+private:
+  std::vector<char> buffer_;
+  std::vector<uint64_t> present_; // bit (i % 64) of word (i / 64) is set if buffer_[i] holds a pending byte
+  uint64_t num_bytes_pending_ {};
+
+  uint64_t set_present( uint64_t begin, uint64_t end ); // returns how many of the bits were newly set
+  void clear_present( uint64_t begin, uint64_t end );
+  uint64_t count_run( uint64_t begin, uint64_t end, bool present ) const; // length of the run of equal bits
+  uint64_t run_length( uint64_t pos, uint64_t limit, bool present ) const; // same, wrapping around the ring
+};
+
+template<class Store>
+class BasicReassembler
 {
 public:
   // Construct Reassembler to write into given ByteStream.
-  explicit Reassembler( ByteStream&& output )
-    : output_( std::move( output ) ), expect_idx( 0 ), num_bytes_pending( 0 ), last_idx( 0 ), cache()
+  explicit BasicReassembler( ByteStream&& output )
+    : output_( std::move( output ) ), expect_idx( 0 ), last_idx(), store_( output_.capacity() )
   {}
 
   /*
    * Insert a new substring to be reassembled into a ByteStream.
    *   `first_index`: the index of the first byte of the substring
-   *   `data`: the substring itself
+   *   `data`: the substring itself (a std::string converts to a Cord without copying)
    *   `is_last_substring`: this substring represents the end of the stream
    *   `output`: a mutable reference to the Writer
    *
@@ -31,10 +94,15 @@ public:
    *
    * The Reassembler should close the stream after writing the last byte.
    */
-  void insert( uint64_t first_index, std::string data, bool is_last_substring );
+  void insert( uint64_t first_index, Cord data, bool is_last_substring );
 
   // How many bytes are stored in the Reassembler itself?
-  uint64_t bytes_pending() const;
+  uint64_t bytes_pending() const { return store_.bytes_pending(); }
+
+  // Up to `max_count` of the ranges of bytes stored in the Reassembler (received but not yet written),
+  // in absolute stream indices. As RFC 2018 asks of SACK blocks, the range holding the most recently
+  // inserted bytes comes first, then the ranges holding earlier insertions, then the rest in stream order.
+  std::vector<IndexRange> held_ranges( size_t max_count ) const;
 
   // Access output stream reader
   Reader& reader() { return output_.reader(); }
@@ -46,7 +114,10 @@ public:
 private:
   ByteStream output_; // the Reassembler writes to this ByteStream
   uint64_t expect_idx;
-  uint64_t num_bytes_pending;
-  uint64_t last_idx;
-  std::list<std::pair<uint64_t, std::string>> cache;
+  std::optional<uint64_t> last_idx; // index just past the last byte, once the last substring has been seen
+  Store store_;                     // bytes waiting for the ones before them
+  std::deque<uint64_t> recent_inserts_ {}; // first index stored by each recent insert, newest first
 };
+
+using Reassembler = BasicReassembler<IntervalMapStore>;
+using BitmapReassembler = BasicReassembler<BitmapStore>;
@@ -0,0 +1,51 @@
+#include "retransmit_buffer.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+void RetransmitBuffer::append( const Cord& data )
+{
+  for ( const auto& slice : data.slices() ) {
+    if ( pieces_.empty() || !pieces_.back().slice.extend( slice ) )
+      pieces_.push_back( { first_index_ + size_, slice } );
+    size_ += slice.size();
+  }
+}
+
+Cord RetransmitBuffer::cut( uint64_t index, uint64_t len ) const
+{
+  if ( index < first_index_ || index + len > first_index_ + size_ )
+    throw out_of_range( "RetransmitBuffer::cut: bytes not held" );
+
+  Cord ret;
+  if ( len == 0 )
+    return ret;
+  // the last piece starting at or before `index`
+  auto it = upper_bound(
+    pieces_.begin(), pieces_.end(), index, []( uint64_t i, const Piece& piece ) { return i < piece.index; } );
+  for ( --it; len > 0; ++it ) {
+    const uint64_t offset = index - it->index;
+    Slice part = it->slice.substr( offset, len );
+    index += part.size();
+    len -= part.size();
+    ret.append( std::move( part ) );
+  }
+  return ret;
+}
+
+void RetransmitBuffer::release( uint64_t index )
+{
+  index = std::min( index, first_index_ + size_ );
+  while ( first_index_ < index ) {
+    Piece& front = pieces_.front();
+    const uint64_t n = std::min( index - first_index_, front.slice.size() );
+    front.slice.remove_prefix( n );
+    front.index += n;
+    first_index_ += n;
+    size_ -= n;
+    if ( front.slice.empty() )
+      pieces_.pop_front();
+  }
+}
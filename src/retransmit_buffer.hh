@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cord.hh"
+
+#include <cstdint>
+#include <deque>
+
+// The bytes a TCPSender has sent and not yet had acknowledged, each held once, indexed by their position in
+// the stream. The buffer shares the Slices it is given, merging neighbours that came from the same storage,
+// so keeping a window of data costs a few words per write rather than a copy of every segment. A segment
+// to (re)transmit is cut from it at whatever offset and length the sender wants.
+class RetransmitBuffer
+{
+public:
+  // Add bytes just past the end (no copy)
+  void append( const Cord& data );
+
+  // `len` bytes starting at stream index `index`, sharing the buffer's storage
+  Cord cut( uint64_t index, uint64_t len ) const;
+
+  // Discard the bytes before stream index `index` (all of them, if it is past the end)
+  void release( uint64_t index );
+
+  uint64_t first_index() const { return first_index_; } // stream index of the oldest byte held
+  uint64_t size() const { return size_; }               // bytes held
+  uint64_t pieces() const { return pieces_.size(); }    // separate runs of storage they are kept in
+
+private:
+  struct Piece
+  {
+    uint64_t index; // stream index of the first byte
+    Slice slice;
+  };
+  std::deque<Piece> pieces_ {};
+  uint64_t first_index_ {};
+  uint64_t size_ {};
+};
@@ -0,0 +1,196 @@
+#include "sharded_tcp_stack.hh"
+
+#include "eventloop.hh"
+#include "ipv4_header.hh"
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+// The connection a datagram belongs to (as seen by its receiver), from the fixed parts of its IPv4 and TCP
+// headers, without parsing the rest
+optional<FourTuple> peek_tuple( const vector<string>& datagram )
+{
+  const auto number = [&]( size_t offset, size_t len ) -> optional<uint32_t> {
+    uint32_t ret = 0;
+    auto buffer = datagram.begin();
+    for ( ; len > 0; len-- ) {
+      while ( buffer != datagram.end() && offset >= buffer->size() ) {
+        offset -= buffer->size();
+        ++buffer;
+      }
+      if ( buffer == datagram.end() )
+        return nullopt;
+      ret = ret << 8U | static_cast<uint8_t>( ( *buffer )[offset++] );
+    }
+    return ret;
+  };
+
+  const auto version_ihl = number( 0, 1 );
+  const auto proto = number( 9, 1 );
+  if ( !version_ihl || !proto || *proto != IPv4Header::PROTO_TCP )
+    return nullopt;
+  const size_t tcp_offset = ( *version_ihl & 0xfU ) * 4;
+  const auto src = number( 12, 4 );
+  const auto dst = number( 16, 4 );
+  const auto src_port = number( tcp_offset, 2 );
+  const auto dst_port = number( tcp_offset + 2, 2 );
+  if ( !src || !dst || !src_port || !dst_port )
+    return nullopt;
+  return FourTuple { *dst, *src, static_cast<uint16_t>( *dst_port ), static_cast<uint16_t>( *src_port ) };
+}
+
+// Copy the next `len` bytes out of a ring, which holds at least that many
+void take( SPSCByteRing& ring, size_t len, string& out )
+{
+  out.clear();
+  while ( out.size() < len ) {
+    const string_view piece = ring.peek().substr( 0, len - out.size() );
+    out.append( piece );
+    ring.pop( piece.size() );
+  }
+}
+} // namespace
+
+ShardedTCPStack::ShardedTCPStack( vector<FileDescriptor>&& queues, const Setup& setup, DatagramIO io )
+{
+  for ( auto& fd : queues ) {
+    shards_.push_back( make_unique<Shard>( std::move( fd ), io ) );
+  }
+  for ( auto& to : shards_ ) {
+    to->inbound.resize( shards_.size() );
+    for ( size_t from = 0; from < shards_.size(); from++ ) {
+      if ( shards_[from] != to ) {
+        // (a shard never waits for room in a ring -- it drops what doesn't fit, as a full queue would)
+        to->inbound[from] = make_unique<SPSCByteRing>( RING_CAPACITY, to->wakeup, shards_[from]->wakeup );
+      }
+    }
+  }
+  for ( size_t i = 0; i < shards_.size(); i++ ) {
+    shards_[i]->thread = thread( [this, i, setup] { run( i, setup ); } );
+  }
+}
+
+void ShardedTCPStack::stop()
+{
+  stop_ = true;
+  for ( auto& shard : shards_ ) {
+    shard->wakeup.notify();
+  }
+  for ( auto& shard : shards_ ) {
+    if ( shard->thread.joinable() ) {
+      shard->thread.join();
+    }
+  }
+}
+
+void ShardedTCPStack::post( size_t shard, Task task )
+{
+  Shard& target = *shards_.at( shard );
+  {
+    const lock_guard lock { target.tasks_mutex };
+    target.tasks.push_back( std::move( task ) );
+  }
+  target.has_tasks = true;
+  target.wakeup.notify();
+}
+
+void ShardedTCPStack::connect( const TCPConfig& config, const Address& local, const Address& remote )
+{
+  const FourTuple tuple { local.ipv4_numeric(), remote.ipv4_numeric(), local.port(), remote.port() };
+  post( shard_of( tuple ), [config, local, remote]( TCPStack& stack ) { stack.connect( config, local, remote ); } );
+}
+
+void ShardedTCPStack::run( const size_t index, const Setup& setup )
+{
+  try {
+    Shard& shard = *shards_[index];
+    shard.stack.set_filter( [this, index]( const vector<string>& dgram ) { return forward( index, dgram ); } );
+    setup( shard.stack, index );
+
+    EventLoop loop;
+    loop.add_rule( "datagrams", shard.stack.watch_fd(), Direction::In, [&] { shard.stack.receive(); } );
+    loop.add_rule( "wakeup", shard.wakeup, Direction::In, [&] { shard.wakeup.clear(); } );
+
+    auto last_tick = steady_clock::now();
+    while ( !stop_ ) {
+      drain( shard );
+
+      // sleep until a datagram, a ring or a task needs this thread, or it's time to tick
+      bool idle = true;
+      for ( auto& ring : shard.inbound ) {
+        if ( ring && !ring->request_data_wakeup() )
+          idle = false;
+      }
+      loop.wait_next_event( idle && !shard.has_tasks ? static_cast<int>( TICK_MS ) : 0 );
+
+      const auto now = steady_clock::now();
+      const auto ms = duration_cast<milliseconds>( now - last_tick ).count();
+      if ( ms > 0 ) {
+        shard.stack.tick( ms );
+        last_tick += milliseconds { ms };
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception in TCP shard " << index << ": " << e.what() << "\n";
+    throw;
+  }
+}
+
+bool ShardedTCPStack::forward( const size_t from, const vector<string>& datagram )
+{
+  const auto tuple = peek_tuple( datagram );
+  if ( !tuple.has_value() )
+    return false; // (the stack will count it as invalid)
+  const size_t owner = shard_of( *tuple );
+  if ( owner == from )
+    return false;
+
+  // one push per datagram, length first, so the owner never sees part of one
+  Shard& source = *shards_[from];
+  size_t len = 0;
+  for ( const auto& buffer : datagram ) {
+    len += buffer.size();
+  }
+  source.record.assign( { static_cast<char>( len >> 8U ), static_cast<char>( len & 0xffU ) } );
+  for ( const auto& buffer : datagram ) {
+    source.record.append( buffer );
+  }
+  SPSCByteRing& ring = *shards_[owner]->inbound[from];
+  if ( ring.available_capacity() < source.record.size() ) {
+    source.forward_drops++;
+  } else {
+    ring.push( source.record );
+    source.forwarded++;
+  }
+  return true;
+}
+
+void ShardedTCPStack::drain( Shard& shard )
+{
+  if ( shard.has_tasks.exchange( false ) ) {
+    vector<Task> tasks;
+    {
+      const lock_guard lock { shard.tasks_mutex };
+      swap( tasks, shard.tasks );
+    }
+    for ( const auto& task : tasks ) {
+      task( shard.stack );
+    }
+  }
+
+  for ( auto& ring : shard.inbound ) {
+    while ( ring && ring->size() >= 2 ) {
+      take( *ring, 2, shard.record );
+      const size_t len = static_cast<size_t>( static_cast<uint8_t>( shard.record[0] ) ) << 8U
+                         | static_cast<uint8_t>( shard.record[1] );
+      take( *ring, len, shard.delivery.front() );
+      shard.stack.deliver( shard.delivery );
+    }
+  }
+}
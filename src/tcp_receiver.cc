@@ -1,4 +1,5 @@
 #include "tcp_receiver.hh"
+#include "tcp_config.hh"
 #include <algorithm>
 #include <iostream>
 
@@ -11,25 +12,41 @@ void TCPReceiver::receive( TCPSenderMessage message )
   if ( ( !message.SYN && !ISN.has_value() ) || ( ISN.has_value() && ISN == message.seqno ) ) {
     return;
   }
+  // PAWS (RFC 7323 section 5): a timestamp older than one already seen means an old duplicate, perhaps
+  // from before the sequence numbers wrapped, which unwrap() would place in the wrong spot
+  if ( !message.RST && message.TSval.has_value() && TS_recent_.has_value()
+       && static_cast<int32_t>( *message.TSval - *TS_recent_ ) < 0 ) {
+    return;
+  }
   if ( !ISN.has_value() ) {
     ISN = message.seqno;
   }
   uint64_t checkpoint = reassembler_.writer().bytes_pushed() + 1;
   uint64_t abs_seqno = message.seqno.unwrap( *ISN, checkpoint );
+
+  // echo the timestamp of the segment that filled the next hole, not of ones that arrived early
+  // (RFC 7323 section 4.3: SEG.SEQ <= Last.ACK.sent)
+  if ( message.TSval.has_value() && abs_seqno <= checkpoint + reassembler_.writer().is_closed() ) {
+    TS_recent_ = message.TSval;
+  }
   uint64_t first_index = abs_seqno == 0 ? abs_seqno : abs_seqno - 1;
-  reassembler_.insert( first_index, message.payload, message.FIN );
+  reassembler_.insert( first_index, std::move( message.payload ), message.FIN );
 }
 
 TCPReceiverMessage TCPReceiver::send() const
 {
   TCPReceiverMessage msg {};
-  msg.window_size = min( (uint64_t)UINT16_MAX, reassembler_.writer().available_capacity() );
+  msg.window_size = min( (uint64_t)max_window_, reassembler_.writer().available_capacity() );
 
   uint64_t abs_seqno = reassembler_.writer().bytes_pushed() + ISN.has_value() + reassembler_.writer().is_closed();
   if ( ISN.has_value() ) {
     msg.ackno = Wrap32::wrap( abs_seqno, *ISN );
+    for ( const auto& [first, last] : reassembler_.held_ranges( TCPConfig::MAX_SACK_BLOCKS ) ) {
+      msg.sack_blocks.emplace_back( Wrap32::wrap( first + 1, *ISN ), Wrap32::wrap( last + 1, *ISN ) );
+    }
   }
   msg.RST = reassembler_.writer().has_error();
+  msg.TSecr = TS_recent_;
 
   return msg;
 }
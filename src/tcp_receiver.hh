@@ -4,11 +4,15 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <cstdint>
+
 class TCPReceiver
 {
 public:
-  // Construct with given Reassembler
-  explicit TCPReceiver( Reassembler&& reassembler ) : reassembler_( std::move( reassembler ) ) {}
+  // Construct with given Reassembler, advertising a window of at most `max_window` bytes
+  explicit TCPReceiver( Reassembler&& reassembler, uint32_t max_window = UINT16_MAX )
+    : reassembler_( std::move( reassembler ) ), max_window_( max_window )
+  {}
 
   /*
    * The TCPReceiver receives TCPSenderMessages, inserting their payload into the Reassembler
@@ -27,5 +31,7 @@ public:
 
 private:
   Reassembler reassembler_;
+  uint32_t max_window_;
   std::optional<Wrap32> ISN {};
+  std::optional<uint32_t> TS_recent_ {}; // RFC 7323: the timestamp to echo, and the oldest one still accepted
 };
@@ -2,6 +2,9 @@
 #include "iostream"
 #include "tcp_config.hh"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace std;
 
 uint64_t TCPSender::sequence_numbers_in_flight() const
@@ -14,27 +17,92 @@ uint64_t TCPSender::consecutive_retransmissions() const
   return num_retrans;
 }
 
+optional<uint64_t> TCPSender::congestion_window() const
+{
+  if ( !congestion_ )
+    return {};
+  return congestion_->cwnd();
+}
+
+void RetransmissionTimer::on_new_ack( optional<uint64_t> rtt_sample_ms )
+{
+  if ( !adaptive.has_value() ) {
+    RTO = initial_RTO;
+    return;
+  }
+  if ( !rtt_sample_ms.has_value() )
+    return;
+
+  // RFC 6298 section 2, with alpha = 1/8, beta = 1/4, K = 4 and a clock granularity of 1 ms
+  const auto sample = static_cast<double>( *rtt_sample_ms );
+  if ( !SRTT.has_value() ) {
+    SRTT = sample;
+    RTTVAR = sample / 2;
+  } else {
+    RTTVAR = 0.75 * *RTTVAR + 0.25 * std::abs( *SRTT - sample );
+    SRTT = 0.875 * *SRTT + 0.125 * sample;
+  }
+  const auto rto = static_cast<uint64_t>( std::ceil( *SRTT + std::max( 1.0, 4 * *RTTVAR ) ) );
+  RTO = std::clamp( rto, adaptive->min_RTO, adaptive->max_RTO );
+}
+
+void TCPSender::resend_lost( const TransmitFunction& transmit )
+{
+  const uint64_t cwnd = congestion_ ? congestion_->cwnd() : UINT64_MAX;
+
+  // (a fast retransmit goes out at once, whatever the congestion window or pacing rate)
+  const auto may_send = [&] { return retransmit_now_ || ( pipe() < cwnd && released() ); };
+  for ( size_t i = 0; lost_unsent_bytes && i < msg_queue.size() && may_send(); ++i ) {
+    if ( msg_queue[i].lost && !msg_queue[i].sacked && !msg_queue[i].retransmitted ) {
+      split_segment( i );
+      OutstandingSegment& seg = msg_queue[i];
+      seg.xmit_ms = now_ms_;
+      const TCPSenderMessage msg = make_segment( seg );
+      transmit( msg );
+      pace( msg );
+      seg.retransmitted = seg.ever_resent = true;
+      lost_unsent_bytes -= seg.sequence_length();
+      retransmit_now_ = false;
+    }
+  }
+}
+
 void TCPSender::push( const TransmitFunction& transmit )
 {
+  // resend what SACK information shows was lost before sending anything new
+  resend_lost( transmit );
+
   if ( FIN_sent )
     return;
+  // a tail loss probe may send one segment of new data beyond the congestion window
+  uint64_t cwnd = congestion_ ? congestion_->cwnd() : UINT64_MAX;
+  if ( tlp_new_data_ )
+    cwnd = std::max( cwnd, pipe() + mss_ );
   const size_t wnd_size = window_size == 0 ? 1 : window_size;
-  while ( wnd_size > num_flight ) {
+  const uint64_t before = nxt_seqno;
+  while ( wnd_size > num_flight && cwnd > pipe() && released() ) {
+    // don't split a segment just to fit the congestion window (unless the window is smaller than one segment)
+    const uint64_t cwnd_room = cwnd - pipe();
+    if ( cwnd_room < mss_ && reader().bytes_buffered() > cwnd_room && pipe() > 0 )
+      break;
+
     TCPSenderMessage msg = make_empty_message();
     if ( !SYN_sent ) {
       msg.SYN = true;
       SYN_sent = true;
     }
-    while ( reader().bytes_buffered() > 0 && msg.sequence_length() < wnd_size - num_flight
-            && msg.payload.size() < TCPConfig::MAX_PAYLOAD_SIZE ) {
-      string_view bytes_view = reader().peek();
-      const uint64_t available_size = std::min( TCPConfig::MAX_PAYLOAD_SIZE - msg.payload.size(),
-                                                wnd_size - ( num_flight + msg.sequence_length() ) );
-      if ( bytes_view.size() > available_size )
-        bytes_view = bytes_view.substr( 0, available_size );
-      msg.payload.append( bytes_view );
-      input_.reader().pop( bytes_view.size() );
-    }
+    const uint64_t room = std::min( wnd_size - ( num_flight + msg.sequence_length() ), cwnd_room );
+    // send a probe if one is due, and enough data follows it that its loss would show up in SACK blocks
+    // (if the windows are big enough for the probe but it doesn't fit yet, wait for ACKs to make room)
+    const auto probe = probe_size();
+    const bool probe_ready = probe.has_value() && std::min<uint64_t>( wnd_size, cwnd ) >= *probe + mss_
+                             && reader().bytes_buffered() >= *probe + TCPConfig::DUP_THRESH * mss_;
+    if ( probe_ready && room < *probe )
+      break;
+    if ( !msg.SYN && hold_small_segment() )
+      break;
+    const bool is_probe = probe_ready;
+    read( input_.reader(), std::min( is_probe ? *probe : mss_, room ), msg.payload );
 
     if ( !FIN_sent && reader().is_finished() && msg.sequence_length() < wnd_size - num_flight ) {
       msg.FIN = true;
@@ -44,27 +112,167 @@ void TCPSender::push( const TransmitFunction& transmit )
     if ( msg.sequence_length() == 0 )
       break;
 
+    const uint64_t seqno = nxt_seqno;
     nxt_seqno += msg.sequence_length();
     num_flight += msg.sequence_length();
     transmit( msg );
-    msg_queue.emplace( std::move( msg ) );
+    pace( msg );
+    retx_.append( msg.payload );
+    OutstandingSegment seg { seqno, msg.payload.size(), now_ms_, now_ms_ };
+    seg.SYN = msg.SYN;
+    seg.FIN = msg.FIN;
+    seg.probe = is_probe;
+    probe_outstanding_ |= is_probe;
+    msg_queue.push_back( seg );
 
     if ( !timer.is_active() )
       timer.start();
   }
+  // RFC 8985 section 7.2: the PTO restarts whenever new data goes out
+  if ( nxt_seqno != before )
+    arm_pto();
+}
+
+// A FIN goes at once: no more bytes are coming to fill the segment
+bool TCPSender::hold_small_segment() const
+{
+  if ( reader().bytes_buffered() >= mss_ || writer().is_closed() )
+    return false;
+  return corked_ || ( nagle_ && num_flight > 0 );
+}
+
+optional<double> TCPSender::pacing_rate() const
+{
+  if ( !pacing_ )
+    return {};
+  if ( fixed_pacing_rate_.has_value() )
+    return fixed_pacing_rate_;
+  if ( !congestion_ || !timer.srtt().has_value() )
+    return {};
+  const unsigned gain = congestion_->in_slow_start() ? TCPConfig::PACING_SS_GAIN : TCPConfig::PACING_CA_GAIN;
+  return gain / 100.0 * static_cast<double>( congestion_->cwnd() ) / std::max( *timer.srtt(), 1.0 );
+}
+
+// Time passes in whole milliseconds, so a segment whose release time falls within this one may go now.
+// A tail loss probe isn't held back, since the PTO already waited longer than pacing would have.
+bool TCPSender::released() const
+{
+  return tlp_new_data_ || !pacing_rate().has_value() || next_release_ms_ < static_cast<double>( now_ms_ + 1 );
+}
+
+// The next release time is counted from now if the sender fell behind, so an idle period earns no burst
+void TCPSender::pace( const TCPSenderMessage& msg )
+{
+  const auto rate = pacing_rate();
+  if ( rate.has_value() ) {
+    next_release_ms_ = std::max( next_release_ms_, static_cast<double>( now_ms_ ) )
+                       + static_cast<double>( msg.sequence_length() ) / *rate;
+  }
+}
+
+bool TCPSender::ready_to_send() const
+{
+  const uint64_t cwnd = congestion_ ? congestion_->cwnd() : UINT64_MAX;
+  const bool new_data
+    = !FIN_sent && window_size > num_flight && ( reader().bytes_buffered() || reader().is_finished() );
+  return ( lost_unsent_bytes > 0 || new_data ) && pipe() < cwnd;
+}
+
+optional<uint64_t> TCPSender::next_deadline() const
+{
+  optional<uint64_t> deadline;
+  const auto consider = [&deadline]( uint64_t ms ) { deadline = std::min( deadline.value_or( ms ), ms ); };
+  if ( timer.is_active() )
+    consider( timer.time_left() );
+  for ( const auto& at : { reorder_deadline_, pto_deadline_ } ) {
+    if ( at.has_value() )
+      consider( *at - std::min( *at, now_ms_ ) );
+  }
+  if ( !released() && ready_to_send() )
+    consider( static_cast<uint64_t>( next_release_ms_ ) - now_ms_ );
+  return deadline;
 }
 
 TCPSenderMessage TCPSender::make_empty_message() const
 {
-  return TCPSenderMessage { Wrap32::wrap( nxt_seqno, isn_ ), false, {}, false, input_.has_error() };
+  return TCPSenderMessage { Wrap32::wrap( nxt_seqno, isn_ ), false, {}, false, input_.has_error(), timestamp() };
+}
+
+TCPSenderMessage TCPSender::make_segment( const OutstandingSegment& seg ) const
+{
+  return TCPSenderMessage { Wrap32::wrap( seg.seqno, isn_ ),
+                            seg.SYN,
+                            retx_.cut( seg.stream_index(), seg.length ),
+                            seg.FIN,
+                            input_.has_error(),
+                            timestamp() };
+}
+
+void TCPSender::set_max_payload_size( uint64_t max_payload_size )
+{
+  probe_high_ = max_payload_size;
+  mss_ = plpmtud_ ? std::min( mss_, max_payload_size ) : max_payload_size;
+  if ( congestion_ )
+    congestion_->set_mss( mss_ );
 }
 
-void TCPSender::receive( const TCPReceiverMessage& msg )
+optional<uint64_t> TCPSender::probe_size() const
+{
+  if ( !plpmtud_ || probe_outstanding_ || ack_seqno == 0 || probe_high_ < mss_ + TCPConfig::PMTU_SEARCH_DONE )
+    return {};
+  return ( mss_ + probe_high_ + 1 ) / 2;
+}
+
+void TCPSender::probe_result( OutstandingSegment& probe, bool delivered )
+{
+  if ( delivered ) {
+    mss_ = std::max( mss_, probe.length );
+    if ( congestion_ )
+      congestion_->set_mss( mss_ );
+    probes_lost_ = 0;
+  } else if ( ++probes_lost_ == TCPConfig::MAX_PROBES ) {
+    probe_high_ = probe.length - 1;
+    probes_lost_ = 0;
+  }
+  probe.probe = probe_outstanding_ = false;
+}
+
+// A segment to be resent that no longer fits (a probe that was too big, or one sent before the MSS shrank)
+// is replaced by segments of mss_ bytes, each in the same state. Only the bookkeeping changes: the payload
+// stays where it is in retx_.
+void TCPSender::split_segment( size_t index )
+{
+  const OutstandingSegment whole = msg_queue[index];
+  if ( whole.length <= mss_ )
+    return;
+  msg_queue[index].length = mss_;
+  msg_queue[index].FIN = false;
+  uint64_t seqno = whole.seqno + msg_queue[index].sequence_length();
+  for ( uint64_t offset = mss_; offset < whole.length; offset += mss_ ) {
+    OutstandingSegment piece = whole;
+    piece.seqno = seqno;
+    piece.length = std::min( mss_, whole.length - offset );
+    piece.SYN = false;
+    piece.FIN = whole.FIN && offset + piece.length == whole.length;
+    seqno += piece.sequence_length();
+    msg_queue.insert( msg_queue.begin() + static_cast<ptrdiff_t>( index + offset / mss_ ), piece );
+  }
+}
+
+optional<uint32_t> TCPSender::timestamp() const
+{
+  if ( !timestamps_ )
+    return {};
+  return static_cast<uint32_t>( now_ms_ );
+}
+
+void TCPSender::receive( const TCPReceiverMessage& msg, bool carries_data )
 {
   if ( msg.RST ) {
     input_.set_error();
     return;
   }
+  const uint32_t previous_window = window_size;
   window_size = msg.window_size;
   if ( !msg.ackno.has_value() )
     return;
@@ -73,33 +281,323 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
   if ( expect_seqno > nxt_seqno )
     return;
   bool ack_flag = false;
+  uint64_t bytes_acked = 0;
+  optional<uint64_t> rtt_sample;
+  const auto rack_before = rack_;
   while ( !msg_queue.empty() ) {
-    TCPSenderMessage curmsg = msg_queue.front();
-    if ( expect_seqno <= ack_seqno || expect_seqno < ack_seqno + curmsg.sequence_length() )
+    const OutstandingSegment& cur = msg_queue.front();
+    const uint64_t len = cur.sequence_length();
+    if ( expect_seqno <= ack_seqno || expect_seqno < ack_seqno + len )
       break;
 
     ack_flag = true;
-    num_flight -= curmsg.sequence_length();
-    ack_seqno += curmsg.sequence_length();
-    msg_queue.pop();
+    num_flight -= len;
+    ack_seqno += len;
+    bytes_acked += cur.length; // the window grows with data, not with the SYN or FIN
+    // Karn's algorithm: an ACK for a retransmitted segment could be for either copy, so it gives no sample
+    rtt_sample = cur.ever_resent ? nullopt : optional { now_ms_ - cur.sent_at_ms };
+    if ( rack_tlp_ )
+      rack_update( cur, msg.TSecr );
+    if ( cur.probe )
+      probe_result( msg_queue.front(), true );
+    if ( cur.sacked )
+      sacked_bytes -= len;
+    else if ( cur.lost && !cur.retransmitted )
+      lost_unsent_bytes -= len;
+    msg_queue.pop_front();
+  }
+  if ( ack_flag )
+    retx_.release( ack_seqno - 1 );
+  // RFC 7323 section 4.1: the echoed timestamp identifies the transmission being acknowledged, even a
+  // retransmission, so every ACK of new data gives a sample
+  if ( ack_flag && timestamps_ && msg.TSecr.has_value() )
+    rtt_sample = static_cast<uint32_t>( now_ms_ ) - *msg.TSecr;
+
+  bool new_loss = !msg.sack_blocks.empty() && update_scoreboard( msg.sack_blocks );
+  if ( rack_tlp_ && rack_ != rack_before )
+    new_loss |= rack_detect_loss();
+
+  if ( fast_retransmit_ && msg.sack_blocks.empty() && !msg_queue.empty() ) {
+    if ( ack_flag ) {
+      dup_acks_ = 0;
+      dupack_bytes_ -= std::min( dupack_bytes_, bytes_acked );
+      // a partial ACK: the segment after the one resent was lost too
+      if ( recovery_point_.has_value() && ack_seqno < recovery_point_.value() )
+        mark_front_lost();
+    } else if ( !carries_data && expect_seqno == ack_seqno && msg.window_size == previous_window ) {
+      if ( ++dup_acks_ == TCPConfig::DUP_THRESH && ack_seqno >= recover_ ) {
+        new_loss = mark_front_lost();
+        recover_ = nxt_seqno;
+        dupack_bytes_ = TCPConfig::DUP_THRESH * mss_;
+      } else if ( dup_acks_ > TCPConfig::DUP_THRESH ) {
+        dupack_bytes_ += mss_;
+      }
+    }
+  }
+
+  if ( recovery_point_.has_value() && ack_seqno >= recovery_point_.value() ) {
+    recovery_point_.reset();
+    dupack_bytes_ = 0;
+  }
+
+  // Without DSACK there is no telling whether a resent probe repaired a loss or duplicated a segment
+  // that had arrived, so a loss is assumed (RFC 8985 section 7.4.2)
+  bool probe_loss = false;
+  if ( tlp_high_seq_.has_value() && ack_seqno >= *tlp_high_seq_ ) {
+    probe_loss = tlp_retransmitted_ && !new_loss && !recovery_point_.has_value();
+    if ( probe_loss && congestion_ )
+      congestion_->on_congestion_event( tlp_flight_, now_ms_ );
+    tlp_high_seq_.reset();
+  }
+
+  if ( new_loss ) {
+    enter_recovery();
+  } else if ( congestion_ && bytes_acked && !recovery_point_.has_value() && !probe_loss ) {
+    congestion_->on_ack( bytes_acked, now_ms_ );
   }
 
   if ( ack_flag ) {
     num_retrans = 0;
-    timer = RetransmissionTimer( initial_RTO_ms_ );
+    timer.on_new_ack( rtt_sample );
+    timer.stop();
     if ( !msg_queue.empty() )
       timer.start();
+    arm_pto();
+  }
+}
+
+void TCPSender::enter_recovery()
+{
+  pto_deadline_.reset();
+  if ( recovery_point_.has_value() )
+    return;
+  if ( congestion_ )
+    congestion_->on_congestion_event( num_flight, now_ms_ );
+  recovery_point_ = nxt_seqno;
+  retransmit_now_ = lost_unsent_bytes > 0; // the first retransmission doesn't wait for the pipe to drain
+}
+
+void TCPSender::rack_update( const OutstandingSegment& seg, optional<uint32_t> TSecr )
+{
+  const uint64_t rtt = now_ms_ - seg.xmit_ms;
+  if ( seg.ever_resent ) {
+    // the ACK may be for an earlier copy: only believe it is for the last one if the echoed timestamp
+    // says so, or (without timestamps) if the round trip is not implausibly short
+    const bool earlier_copy = TSecr.has_value()
+                                ? static_cast<int32_t>( *TSecr - static_cast<uint32_t>( seg.xmit_ms ) ) < 0
+                                : min_rtt_.has_value() && rtt < *min_rtt_;
+    if ( earlier_copy )
+      return;
+  } else {
+    min_rtt_ = std::min( min_rtt_.value_or( rtt ), rtt );
+  }
+
+  const uint64_t end_seq = seg.seqno + seg.sequence_length();
+  if ( !rack_.has_value() || seg.xmit_ms > rack_->xmit_ms
+       || ( seg.xmit_ms == rack_->xmit_ms && end_seq > rack_->end_seq ) )
+    rack_ = RackState { seg.xmit_ms, end_seq, rtt };
+}
+
+bool TCPSender::rack_detect_loss()
+{
+  reorder_deadline_.reset();
+  if ( !rack_.has_value() )
+    return false;
+
+  const uint64_t reorder_window = min_rtt_.value_or( 0 ) / 4;
+  bool new_loss = false;
+  for ( auto& seg : msg_queue ) {
+    const uint64_t len = seg.sequence_length();
+    if ( seg.sacked || ( seg.lost && !seg.retransmitted ) )
+      continue;
+    // only a segment sent before the one delivered can be lost (this includes a lost retransmission)
+    if ( seg.xmit_ms > rack_->xmit_ms || ( seg.xmit_ms == rack_->xmit_ms && seg.seqno + len >= rack_->end_seq ) )
+      continue;
+    const uint64_t lost_at = seg.xmit_ms + rack_->rtt + reorder_window;
+    if ( now_ms_ < lost_at ) {
+      reorder_deadline_ = std::min( reorder_deadline_.value_or( lost_at ), lost_at );
+      continue;
+    }
+    seg.lost = true;
+    seg.retransmitted = false;
+    lost_unsent_bytes += len;
+    if ( seg.probe )
+      probe_result( seg, false );
+    else
+      new_loss = true;
+  }
+  return new_loss;
+}
+
+// RFC 8985 section 7.2: the PTO is two round trips, plus time for a delayed ACK if only one segment is out.
+// There is no probe in recovery (other losses are being repaired) or while a probe is outstanding, and no
+// probe if the RTO would come first.
+void TCPSender::arm_pto()
+{
+  pto_deadline_.reset();
+  if ( !rack_tlp_ || msg_queue.empty() || recovery_point_.has_value() || tlp_high_seq_.has_value()
+       || !timer.srtt().has_value() )
+    return;
+  auto pto = static_cast<uint64_t>( std::ceil( 2 * *timer.srtt() ) );
+  if ( msg_queue.size() == 1 )
+    pto += tlp_ack_delay_;
+  if ( pto < timer.time_left() )
+    pto_deadline_ = now_ms_ + pto;
+}
+
+void TCPSender::send_tail_loss_probe( const TransmitFunction& transmit )
+{
+  // new data if the receiver's window has room for it; otherwise the last segment again
+  const uint64_t before = nxt_seqno;
+  if ( reader().bytes_buffered() ) {
+    tlp_new_data_ = true;
+    push( transmit );
+    tlp_new_data_ = false;
+  }
+  tlp_retransmitted_ = nxt_seqno == before;
+  if ( tlp_retransmitted_ ) {
+    const auto last_unsacked = [this] {
+      return find_if( msg_queue.rbegin(), msg_queue.rend(), []( const auto& seg ) { return !seg.sacked; } );
+    };
+    if ( last_unsacked() == msg_queue.rend() )
+      return;
+    // (only the last mss_ bytes of it, if it no longer fits)
+    split_segment( static_cast<size_t>( msg_queue.rend() - last_unsacked() ) - 1 );
+    OutstandingSegment& last = *last_unsacked();
+    last.xmit_ms = now_ms_;
+    last.ever_resent = true;
+    transmit( make_segment( last ) );
+  }
+  tlp_high_seq_ = nxt_seqno;
+  tlp_flight_ = num_flight;
+  pto_deadline_.reset();
+  timer.reset(); // the RTO now runs from the probe
+}
+
+bool TCPSender::mark_front_lost()
+{
+  OutstandingSegment& front = msg_queue.front();
+  if ( front.sacked || ( front.lost && !front.retransmitted ) )
+    return false;
+  front.lost = true;
+  front.retransmitted = false;
+  lost_unsent_bytes += front.sequence_length();
+  retransmit_now_ = true;
+  if ( !front.probe )
+    return true;
+  probe_result( front, false );
+  return false;
+}
+
+bool TCPSender::update_scoreboard( const vector<pair<Wrap32, Wrap32>>& sack_blocks )
+{
+  bool newly_sacked = false;
+  for ( const auto& [left, right] : sack_blocks ) {
+    const uint64_t first = left.unwrap( isn_, nxt_seqno );
+    const uint64_t last = right.unwrap( isn_, nxt_seqno );
+    if ( last <= ack_seqno || last > nxt_seqno || first >= last )
+      continue; // stale or bogus
+
+    auto it = lower_bound( msg_queue.begin(), msg_queue.end(), first, []( const auto& seg, uint64_t seqno ) {
+      return seg.seqno < seqno;
+    } );
+    // the receiver holds an early FIN without SACKing it, so a segment's payload is what has to be covered
+    const auto covered = [last]( const OutstandingSegment& seg ) {
+      const bool uncovered_fin = seg.FIN && seg.length > 0;
+      return seg.seqno + seg.sequence_length() - uncovered_fin <= last;
+    };
+    for ( ; it != msg_queue.end() && covered( *it ); ++it ) {
+      if ( !it->sacked ) {
+        if ( rack_tlp_ )
+          rack_update( *it, {} );
+        if ( it->probe )
+          probe_result( *it, true );
+        it->sacked = newly_sacked = true;
+        sacked_bytes += it->sequence_length();
+        if ( it->lost && !it->retransmitted )
+          lost_unsent_bytes -= it->sequence_length();
+      }
+    }
+  }
+  if ( !newly_sacked )
+    return false;
+
+  // RFC 6675 IsLost(): a hole with DUP_THRESH SACKed segments above it. Everything below a segment already
+  // marked lost has at least as many SACKed segments above it, so the walk can stop there.
+  unsigned sacked_above = 0;
+  bool new_loss = false;
+  for ( auto it = msg_queue.rbegin(); it != msg_queue.rend(); ++it ) {
+    if ( it->sacked ) {
+      sacked_above++;
+    } else if ( sacked_above >= TCPConfig::DUP_THRESH ) {
+      if ( it->lost )
+        break;
+      it->lost = true;
+      lost_unsent_bytes += it->sequence_length();
+      if ( it->probe )
+        probe_result( *it, false ); // most likely too big for the path, which is no sign of congestion
+      else
+        new_loss = true;
+    }
   }
+  return new_loss;
 }
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
-  if ( timer.tick( ms_since_last_tick ).is_expired() ) {
-    transmit( msg_queue.front() );
-    if ( window_size != 0 ) {
-      num_retrans++;
-      timer.exponential_backoff();
+  now_ms_ += ms_since_last_tick;
+  if ( !timer.tick( ms_since_last_tick ).is_expired() ) {
+    // RACK: segments that were waiting out the reordering window may now be lost
+    if ( reorder_deadline_.has_value() && now_ms_ >= *reorder_deadline_ ) {
+      if ( rack_detect_loss() )
+        enter_recovery();
+      resend_lost( transmit );
     }
-    timer.reset();
+    if ( pto_deadline_.has_value() && now_ms_ >= *pto_deadline_ )
+      send_tail_loss_probe( transmit );
+    // release what pacing held back
+    if ( pacing_ && ready_to_send() )
+      push( transmit );
+    return;
+  }
+
+  // a probe that timed out is taken to be too big for the path, not a sign of congestion
+  const bool probe_lost = msg_queue.front().probe;
+  if ( probe_lost )
+    probe_result( msg_queue.front(), false );
+  split_segment( 0 );
+
+  // resend the oldest segment, and let push() resend the other lost segments again too, since their
+  // retransmissions may have been lost as well
+  OutstandingSegment& oldest = msg_queue.front();
+  oldest.xmit_ms = now_ms_;
+  transmit( make_segment( oldest ) );
+  oldest.ever_resent = true;
+  for ( auto& seg : msg_queue ) {
+    if ( seg.lost && !seg.sacked && seg.retransmitted ) {
+      seg.retransmitted = false;
+      lost_unsent_bytes += seg.sequence_length();
+    }
+  }
+  if ( oldest.lost && !oldest.sacked ) {
+    oldest.retransmitted = true;
+    lost_unsent_bytes -= oldest.sequence_length();
+  }
+
+  if ( !probe_lost ) {
+    if ( congestion_ )
+      congestion_->on_timeout( num_flight, now_ms_ );
+    recovery_point_.reset();
+  }
+  dup_acks_ = 0;
+  dupack_bytes_ = 0;
+  recover_ = nxt_seqno;
+  pto_deadline_.reset();
+  tlp_high_seq_.reset();
+
+  if ( window_size != 0 ) {
+    num_retrans++;
+    timer.exponential_backoff();
   }
+  timer.reset();
 }
@@ -1,20 +1,30 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "congestion_control.hh"
+#include "retransmit_buffer.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
 #include <memory>
 #include <optional>
-#include <queue>
 
 class RetransmissionTimer
 {
 public:
-  RetransmissionTimer( uint64_t initial_RTO_ms ) : RTO( initial_RTO_ms ) {}
+  // A timer whose RTO is `initial_RTO_ms` whenever new data is acknowledged
+  RetransmissionTimer( uint64_t initial_RTO_ms ) : RTO( initial_RTO_ms ), initial_RTO( initial_RTO_ms ) {}
+
+  // A timer whose RTO follows the measured round-trip times (RFC 6298), clamped to [min_RTO_ms, max_RTO_ms]
+  RetransmissionTimer( uint64_t initial_RTO_ms, uint64_t min_RTO_ms, uint64_t max_RTO_ms )
+    : RTO( initial_RTO_ms ), initial_RTO( initial_RTO_ms ), adaptive( { min_RTO_ms, max_RTO_ms } )
+  {}
+
   bool is_expired() const { return status_active && consumed_time >= RTO; }
   bool is_active() const { return status_active; }
   void start()
@@ -27,18 +37,37 @@ public:
     status_active = false;
     reset();
   }
-  void exponential_backoff() { RTO <<= 1; }
+  void exponential_backoff() { RTO = adaptive.has_value() ? std::min( RTO << 1, adaptive->max_RTO ) : RTO << 1; }
   void reset() { consumed_time = 0; }
+  uint64_t time_left() const { return RTO - std::min( RTO, consumed_time ); }
   RetransmissionTimer& tick( uint64_t ms_since_last_tick )
   {
     consumed_time += status_active ? ms_since_last_tick : 0;
     return *this;
   }
 
+  // New data was acknowledged, giving a round-trip sample unless the segment was retransmitted.
+  // (Karn's algorithm: the RTO stays backed off until there is a sample.)
+  void on_new_ack( std::optional<uint64_t> rtt_sample_ms );
+
+  uint64_t rto() const { return RTO; }
+  std::optional<double> srtt() const { return SRTT; }
+  std::optional<double> rttvar() const { return RTTVAR; }
+
 private:
   uint64_t RTO;
+  uint64_t initial_RTO;
   uint64_t consumed_time {};
   bool status_active {};
+
+  struct Bounds
+  {
+    uint64_t min_RTO;
+    uint64_t max_RTO;
+  };
+  std::optional<Bounds> adaptive {}; // set if the RTO follows the measured round-trip times
+  std::optional<double> SRTT {};
+  std::optional<double> RTTVAR {};
 };
 
 class TCPSender
@@ -46,14 +75,40 @@ class TCPSender
 public:
   /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
   TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
-    : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ), timer( initial_RTO_ms )
+    : input_( std::move( input ) ), isn_( isn ), timer( initial_RTO_ms )
   {}
 
+  /* Construct TCP sender with the ISN, Retransmission Timeout policy and congestion control given by `config` */
+  TCPSender( ByteStream&& input, const TCPConfig& config )
+    : TCPSender( std::move( input ), config.isn, config.rt_timeout )
+  {
+    if ( config.adaptive_rto )
+      timer = RetransmissionTimer( config.rt_timeout, config.rto_min, config.rto_max );
+    timestamps_ = config.timestamps;
+    plpmtud_ = config.plpmtud;
+    fast_retransmit_ = config.fast_retransmit;
+    rack_tlp_ = config.rack_tlp;
+    tlp_ack_delay_ = config.ack_delay;
+    pacing_ = config.pacing;
+    nagle_ = !config.nodelay;
+    if ( config.pacing_rate > 0 )
+      fixed_pacing_rate_ = static_cast<double>( config.pacing_rate ) / 1000;
+    congestion_ = make_congestion_controller( config.congestion_control, TCPConfig::MAX_PAYLOAD_SIZE );
+  }
+
+  /*
+   * Set the largest payload a segment may carry, from the peer's MSS and our MTU. Without PLPMTUD, every
+   * segment may be that big; with it, segments start at TCPConfig::MAX_PAYLOAD_SIZE (or smaller) and probes
+   * find how much of the rest the path can carry.
+   */
+  void set_max_payload_size( uint64_t max_payload_size );
+
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
 
-  /* Receive and process a TCPReceiverMessage from the peer's receiver */
-  void receive( const TCPReceiverMessage& msg );
+  /* Receive and process a TCPReceiverMessage from the peer's receiver (`carries_data` if it came with data,
+   * in which case it is not a duplicate ACK even if its ackno is) */
+  void receive( const TCPReceiverMessage& msg, bool carries_data = false );
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
   using TransmitFunction = std::function<void( const TCPSenderMessage& )>;
@@ -61,12 +116,22 @@ public:
   /* Push bytes from the outbound stream */
   void push( const TransmitFunction& transmit );
 
+  /* While corked, push() sends only full-sized segments (and a FIN), so small writes can gather */
+  void set_corked( bool corked ) { corked_ = corked; }
+
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called */
   void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
 
+  /* Milliseconds until tick() next has something to do (a paced segment to release, or a timer), if ever */
+  std::optional<uint64_t> next_deadline() const;
+
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // How many consecutive *re*transmissions have happened?
+  std::optional<uint64_t> congestion_window() const; // The congestion controller's cwnd (if there is one)
+  const RetransmissionTimer& retransmission_timer() const { return timer; } // RTO, and SRTT/RTTVAR estimates
+  uint64_t max_payload_size() const { return mss_; } // Payload of a full-sized segment
+  std::optional<double> pacing_rate() const;         // Bytes per millisecond, if segments are paced
   Writer& writer() { return input_.writer(); }
   const Writer& writer() const { return input_.writer(); }
 
@@ -77,14 +142,126 @@ private:
   // Variables initialized in constructor
   ByteStream input_;
   Wrap32 isn_;
-  uint64_t initial_RTO_ms_;
 
   RetransmissionTimer timer;
-  uint16_t window_size { 1 };
+  uint32_t window_size { 1 };
   uint64_t nxt_seqno {};
   uint64_t ack_seqno {};
 
-  std::queue<TCPSenderMessage> msg_queue {};
+  // The payload of every outstanding segment, kept once. A segment is (re)built from it when it is sent.
+  RetransmitBuffer retx_ {};
+
+  // SACK scoreboard (RFC 6675): every outstanding segment, with what the peer's SACK blocks say about it
+  struct OutstandingSegment
+  {
+    uint64_t seqno;         // absolute sequence number of the first byte (the SYN, if it has one)
+    uint64_t length;        // payload bytes, which are in retx_
+    uint64_t sent_at_ms;    // when it was first sent
+    uint64_t xmit_ms;       // when it was last sent
+    bool ever_resent {};    // retransmitted at least once (without timestamps, its ACK gives no round-trip sample)
+    bool sacked {};         // the peer holds it, so it is never retransmitted
+    bool lost {};           // DUP_THRESH segments above it were SACKed, so it can be resent without an RTO
+    bool retransmitted {};  // resent since it was marked lost
+    bool probe {};          // a PLPMTUD probe, bigger than mss_
+    bool SYN {};
+    bool FIN {};
+
+    uint64_t sequence_length() const { return SYN + length + FIN; }
+    uint64_t stream_index() const { return seqno + SYN - 1; } // of the first payload byte
+  };
+  TCPSenderMessage make_segment( const OutstandingSegment& seg ) const;
+  void split_segment( size_t index ); // cut a segment bigger than mss_ into pieces of mss_ bytes
+  std::deque<OutstandingSegment> msg_queue {};
+  uint64_t sacked_bytes {};      // sequence numbers in segments the peer has SACKed
+  uint64_t lost_unsent_bytes {}; // sequence numbers in segments marked lost and not yet retransmitted
+
+  // returns true if it marked any segment lost
+  bool update_scoreboard( const std::vector<std::pair<Wrap32, Wrap32>>& sack_blocks );
+
+  // resend segments marked lost, as far as the congestion window allows
+  void resend_lost( const TransmitFunction& transmit );
+
+  // RFC 6675 "pipe": sequence numbers the sender believes are still in the network
+  uint64_t pipe() const
+  {
+    const uint64_t in_network = num_flight - sacked_bytes - lost_unsent_bytes;
+    return in_network - std::min( in_network, dupack_bytes_ );
+  }
+
+  // Fast retransmit for a peer that doesn't send SACK blocks (RFC 5681 and RFC 6582 NewReno): DUP_THRESH
+  // duplicate ACKs mark the oldest segment lost, each further one means a segment has left the network, and
+  // in recovery an ACK that doesn't reach the recovery point marks the next hole lost.
+  bool fast_retransmit_ {};
+  unsigned dup_acks_ {};
+  uint64_t dupack_bytes_ {};       // segments the duplicate ACKs say have arrived (above the hole)
+  uint64_t recover_ {};            // no new fast retransmit until the ACK passes this (RFC 6582 "recover")
+  bool retransmit_now_ {};         // resend the oldest lost segment whatever the congestion window says
+  bool mark_front_lost(); // returns false if the segment was a PLPMTUD probe
+
+  std::unique_ptr<CongestionController> congestion_ {};
+  std::optional<uint64_t> recovery_point_ {}; // in fast recovery until this sequence number is acknowledged
+  void enter_recovery();                      // a loss was detected: reduce the window, once per round trip
+  uint64_t now_ms_ {};                        // sum of the tick() intervals
+
+  // RFC 7323 timestamps: every segment carries the time it was sent, and the receiver echoes it back
+  bool timestamps_ {};
+  std::optional<uint32_t> timestamp() const;
+
+  // Packetization-layer path MTU discovery (RFC 4821): segments carry mss_ bytes, and now and then one is
+  // sent as a probe halfway to probe_high_. If the probe gets through, mss_ grows to its size. A lost probe
+  // is not taken as congestion; it is resent in mss_ pieces, and after MAX_PROBES losses probe_high_ shrinks.
+  bool plpmtud_ {};
+  uint64_t mss_ { TCPConfig::MAX_PAYLOAD_SIZE };
+  uint64_t probe_high_ { TCPConfig::MAX_PAYLOAD_SIZE }; // the largest payload the path might carry
+  bool probe_outstanding_ {};
+  unsigned probes_lost_ {}; // probes of the current size that were lost
+  std::optional<uint64_t> probe_size() const; // size of the next probe, if one is due
+  void probe_result( OutstandingSegment& probe, bool delivered );
+
+  // RACK-TLP (RFC 8985): a segment is lost once a segment sent after it has been delivered and a reordering
+  // window (a quarter of the minimum RTT) has passed since. When no ACK has come for about two round trips, a
+  // tail loss probe sends new data or resends the last segment, so a loss at the end of a burst is found by
+  // RACK instead of waiting for the RTO.
+  struct RackState
+  {
+    uint64_t xmit_ms; // when the most recently sent segment known to be delivered was sent
+    uint64_t end_seq; // the sequence number just past it
+    uint64_t rtt;     // its round trip
+    bool operator==( const RackState& ) const = default;
+  };
+  bool rack_tlp_ {};
+  uint64_t tlp_ack_delay_ {}; // the peer is taken to delay ACKs no longer than this side does
+  std::optional<RackState> rack_ {};
+  std::optional<uint64_t> min_rtt_ {};
+  std::optional<uint64_t> reorder_deadline_ {}; // when segments not yet old enough to call lost will be
+  std::optional<uint64_t> pto_deadline_ {};     // when to send a tail loss probe
+  std::optional<uint64_t> tlp_high_seq_ {};     // a probe is outstanding until this is acknowledged
+  uint64_t tlp_flight_ {};                      // sequence numbers in flight when the probe was sent
+  bool tlp_retransmitted_ {};                   // the probe resent a segment rather than sending new data
+  bool tlp_new_data_ {};                        // push() may exceed the congestion window by one segment
+  void rack_update( const OutstandingSegment& seg, std::optional<uint32_t> TSecr );
+  bool rack_detect_loss(); // returns true if it marked any segment lost
+  void arm_pto();
+  void send_tail_loss_probe( const TransmitFunction& transmit );
+
+  // Pacing: each segment gets a release time, one segment's worth of the pacing rate after the one before,
+  // so a window goes out spread over the round trip rather than in a burst. tick() releases segments that
+  // push() held back. The rate is fixed by the config, or follows cwnd/SRTT (with a gain, so that the
+  // window can still grow).
+  bool pacing_ {};
+  std::optional<double> fixed_pacing_rate_ {}; // bytes per millisecond
+  double next_release_ms_ {};                  // when the next segment may go out
+  bool released() const;
+  void pace( const TCPSenderMessage& msg );
+  bool ready_to_send() const; // would push() send something if pacing allowed?
+
+  // Nagle's algorithm (RFC 9293 section 3.7.4): while data is unacknowledged, a segment smaller than the MSS
+  // waits for more bytes or for the ACK, so an application writing in small pieces doesn't send a segment
+  // per write. Corking holds small segments whether or not anything is in flight.
+  bool nagle_ {};
+  bool corked_ {};
+  bool hold_small_segment() const;
+
   uint64_t num_flight {};
   uint64_t num_retrans {};
 
@@ -0,0 +1,319 @@
+#include "tcp_stack.hh"
+
+#include "ipv4_datagram.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+TCPStack::TCPStack( FileDescriptor&& datagram_fd, DatagramIO io ) : fd_( std::move( datagram_fd ) )
+{
+  if ( io == DatagramIO::IOUring && IOUringFD::available() )
+    ring_.emplace( fd_.duplicate() );
+  else
+    fd_.set_blocking( false );
+  random_device rd;
+  for ( auto& word : cookie_secret_ )
+    word = uint64_t { rd() } << 32 | rd();
+}
+
+TCPStack::Connection& TCPStack::connect( const TCPConfig& config, const Address& local, const Address& remote )
+{
+  const FourTuple tuple { local.ipv4_numeric(), remote.ipv4_numeric(), local.port(), remote.port() };
+  auto [it, inserted] = connections_.try_emplace( tuple, tuple, config );
+  if ( !inserted )
+    throw runtime_error( "TCPStack::connect: a connection with that 4-tuple already exists" );
+  push( it->second );
+  return it->second;
+}
+
+void TCPStack::listen( const TCPConfig& config, const Address& local, size_t backlog, bool syn_cookies )
+{
+  listeners_.insert_or_assign( local.port(), Listener { local.ipv4_numeric(), config, backlog, syn_cookies } );
+}
+
+TCPStack::Connection* TCPStack::accept( uint16_t port )
+{
+  const auto it = listeners_.find( port );
+  if ( it == listeners_.end() || it->second.accept_queue.empty() )
+    return nullptr;
+  Connection* connection = find( it->second.accept_queue.front() );
+  it->second.accept_queue.pop_front();
+  connection->stage = Connection::Stage::Accepted;
+  return connection;
+}
+
+size_t TCPStack::receive()
+{
+  batching_++;
+  size_t count = 0;
+  while ( true ) {
+    read_buffers_.resize( 2 );
+    read_buffers_.front().resize( IPv4Header::LENGTH );
+    if ( ring_ )
+      ring_->read( read_buffers_ );
+    else
+      fd_.read( read_buffers_ );
+    if ( read_buffers_.empty() || ( read_buffers_.front().empty() && read_buffers_.back().empty() ) )
+      break; // nothing waiting (or EOF)
+    ++count;
+    if ( filter_ && filter_( read_buffers_ ) )
+      continue;
+    dispatch( read_buffers_ );
+  }
+  notify_acceptable();
+  end_batch();
+  return count;
+}
+
+void TCPStack::deliver( const vector<string>& datagram )
+{
+  batching_++;
+  dispatch( datagram );
+  notify_acceptable();
+  end_batch();
+}
+
+void TCPStack::end_batch()
+{
+  // (the datagrams sent by a call that others are under way for go with theirs)
+  if ( --batching_ == 0 && ring_ )
+    ring_->submit();
+}
+
+void TCPStack::dispatch( const vector<string>& datagram )
+{
+  stats_.datagrams_received++;
+  InternetDatagram ip_dgram;
+  if ( !parse( ip_dgram, datagram ) ) {
+    stats_.invalid++;
+    return;
+  }
+  auto segment = TCPOverIPv4Adapter::parse_tcp_in_ip( ip_dgram );
+  if ( !segment.has_value() ) {
+    stats_.invalid++;
+    return;
+  }
+  auto& [tuple, msg] = *segment;
+
+  Connection* connection = find( tuple );
+  if ( !connection ) {
+    // a SYN (not a SYN-ACK) to a listening port opens a connection, if the backlog has room
+    Listener* listener = find_listener( tuple );
+    const bool syn = msg.sender.SYN && !msg.receiver.ackno.has_value() && !msg.sender.RST;
+    const bool ack = !msg.sender.SYN && msg.receiver.ackno.has_value() && !msg.sender.RST;
+    if ( listener && syn && listener->half_open < listener->backlog ) {
+      connection = &connections_.try_emplace( tuple, tuple, listener->config ).first->second;
+      connection->stage = Connection::Stage::HalfOpen;
+      listener->half_open++;
+      stats_.passive_opens++;
+    } else if ( listener && syn && listener->syn_cookies ) {
+      send_cookie( tuple, msg, *listener );
+      return;
+    } else if ( listener && ack && listener->syn_cookies ) {
+      connection = open_from_cookie( tuple, msg, *listener );
+      if ( !connection )
+        return;
+    } else {
+      ( listener && syn ? stats_.syn_drops : stats_.unmatched )++;
+      return;
+    }
+  }
+
+  connection->peer.receive( std::move( msg ), transmit( *connection ) );
+  if ( connection->stage == Connection::Stage::Accepted ) {
+    if ( handler_ )
+      handler_( *connection );
+  } else if ( Listener* listener = find_listener( tuple ) ) {
+    listener_holds( *connection, *listener );
+  }
+}
+
+void TCPStack::push( Connection& connection )
+{
+  batching_++;
+  connection.peer.push( transmit( connection ) );
+  end_batch();
+}
+
+void TCPStack::tick( uint64_t ms_since_last_tick )
+{
+  batching_++;
+  now_ms_ += ms_since_last_tick;
+  for ( auto it = connections_.begin(); it != connections_.end(); ) {
+    Connection& connection = it->second;
+    TCPPeer& peer = connection.peer;
+    if ( peer.active() )
+      peer.tick( ms_since_last_tick, transmit( connection ) );
+
+    // a connection that finished its handshake while the accept queue was full may have room now
+    const bool half_open = connection.stage == Connection::Stage::HalfOpen;
+    Listener* listener = half_open ? find_listener( connection.tuple ) : nullptr;
+    if ( listener && listener->accept_queue.size() < listener->backlog )
+      listener_holds( connection, *listener );
+
+    const bool given_up = half_open && peer.sender().consecutive_retransmissions() > MAX_SYNACK_RETX;
+    const bool read_to_end = peer.inbound_reader().is_finished() || peer.inbound_reader().has_error();
+    if ( given_up || ( !peer.active() && read_to_end ) ) {
+      listener_drops( connection );
+      it = connections_.erase( it );
+    } else {
+      ++it;
+    }
+  }
+  notify_acceptable();
+  end_batch();
+}
+
+TCPStack::Connection* TCPStack::find( const FourTuple& tuple )
+{
+  const auto it = connections_.find( tuple );
+  return it == connections_.end() ? nullptr : &it->second;
+}
+
+TCPStack::Listener* TCPStack::find_listener( const FourTuple& tuple )
+{
+  const auto it = listeners_.find( tuple.local_port );
+  if ( it == listeners_.end() || ( it->second.address != 0 && it->second.address != tuple.local_address ) )
+    return nullptr;
+  return &it->second;
+}
+
+void TCPStack::listener_holds( Connection& connection, Listener& listener )
+{
+  const TCPPeer& peer = connection.peer;
+  const bool established = peer.has_ackno() && peer.sender().sequence_numbers_in_flight() == 0;
+  if ( connection.stage != Connection::Stage::HalfOpen || !established )
+    return;
+  if ( listener.accept_queue.size() >= listener.backlog ) {
+    stats_.accept_drops++;
+    return;
+  }
+  listener.half_open--;
+  listener.accept_queue.push_back( connection.tuple );
+  connection.stage = Connection::Stage::AcceptQueue;
+  if ( accept_handler_ )
+    acceptable_.push_back( connection.tuple.local_port );
+}
+
+void TCPStack::notify_acceptable()
+{
+  // (taken first, in case the handler calls receive() or tick() itself)
+  for ( const uint16_t port : exchange( acceptable_, {} ) )
+    accept_handler_( port );
+}
+
+void TCPStack::listener_drops( const Connection& connection )
+{
+  Listener* listener = find_listener( connection.tuple );
+  if ( !listener )
+    return;
+  if ( connection.stage == Connection::Stage::HalfOpen ) {
+    listener->half_open--;
+  } else if ( connection.stage == Connection::Stage::AcceptQueue ) {
+    auto& queue = listener->accept_queue;
+    queue.erase( std::find( queue.begin(), queue.end(), connection.tuple ) );
+  }
+}
+
+uint32_t TCPStack::cookie_hash( const FourTuple& tuple, Wrap32 peer_isn, uint64_t period ) const
+{
+  const auto mix = []( uint64_t x ) { // the splitmix64 finalizer
+    x = ( x ^ ( x >> 30U ) ) * 0xbf58476d1ce4e5b9;
+    x = ( x ^ ( x >> 27U ) ) * 0x94d049bb133111eb;
+    return x ^ ( x >> 31U );
+  };
+  uint64_t h = mix( cookie_secret_[0] ^ ( uint64_t { tuple.local_address } << 32U | tuple.remote_address ) );
+  h = mix( h ^ ( uint64_t { tuple.local_port } << 48U | uint64_t { tuple.remote_port } << 32U
+                 | peer_isn.unwrap( Wrap32 { 0 }, 0 ) ) );
+  h = mix( h ^ cookie_secret_[1] ^ period );
+  return h & 0xffffffU;
+}
+
+Wrap32 TCPStack::make_cookie( const FourTuple& tuple, Wrap32 peer_isn, uint16_t mss ) const
+{
+  const uint64_t period = now_ms_ / COOKIE_PERIOD_MS;
+  uint32_t mss_index = 0;
+  while ( mss_index + 1 < COOKIE_MSS.size() && COOKIE_MSS.at( mss_index + 1 ) <= mss )
+    mss_index++;
+  return Wrap32 { static_cast<uint32_t>( period % 32 ) << 27U | mss_index << 24U
+                  | cookie_hash( tuple, peer_isn, period ) };
+}
+
+optional<uint16_t> TCPStack::check_cookie( const FourTuple& tuple, Wrap32 peer_isn, Wrap32 cookie ) const
+{
+  const uint32_t raw = static_cast<uint32_t>( cookie.unwrap( Wrap32 { 0 }, 0 ) );
+  const uint64_t now = now_ms_ / COOKIE_PERIOD_MS;
+  for ( const uint64_t period : { now, now - 1 } ) {
+    if ( period > now || period % 32 != raw >> 27U )
+      continue; // (no period before the first)
+    if ( cookie_hash( tuple, peer_isn, period ) == ( raw & 0xffffffU ) )
+      return COOKIE_MSS.at( ( raw >> 24U ) & 7U );
+  }
+  return nullopt;
+}
+
+TCPConfig TCPStack::cookie_config( const TCPConfig& config, Wrap32 cookie )
+{
+  TCPConfig ret = config;
+  ret.isn = cookie;
+  ret.window_scaling = false;
+  ret.timestamps = false;
+  ret.sack = false;
+  return ret;
+}
+
+void TCPStack::send_cookie( const FourTuple& tuple, const TCPMessage& syn, const Listener& listener )
+{
+  // a TCPPeer that lives just long enough to answer the SYN, as the connection made later will have
+  const Wrap32 cookie = make_cookie( tuple, syn.sender.seqno, syn.mss.value_or( TCPConfig::DEFAULT_MSS ) );
+  TCPPeer peer { cookie_config( listener.config, cookie ) };
+  peer.receive( TCPMessage { syn }, [&]( const TCPMessage& msg ) { send( tuple, msg ); } );
+  stats_.cookies_sent++;
+}
+
+TCPStack::Connection* TCPStack::open_from_cookie( const FourTuple& tuple,
+                                                  const TCPMessage& ack,
+                                                  Listener& listener )
+{
+  const Wrap32 cookie = *ack.receiver.ackno + UINT32_MAX; // (minus one)
+  const Wrap32 peer_isn = ack.sender.seqno + UINT32_MAX;
+  const auto mss = check_cookie( tuple, peer_isn, cookie );
+  if ( !mss.has_value() ) {
+    stats_.bad_cookies++;
+    return nullptr;
+  }
+  if ( listener.accept_queue.size() >= listener.backlog ) {
+    stats_.accept_drops++;
+    return nullptr;
+  }
+
+  Connection& connection
+    = connections_.try_emplace( tuple, tuple, cookie_config( listener.config, cookie ) ).first->second;
+  connection.stage = Connection::Stage::HalfOpen;
+  listener.half_open++;
+  stats_.passive_opens++;
+
+  // bring it to where it was when the cookie went out: the SYN received and the SYN-ACK sent
+  TCPMessage syn;
+  syn.sender.seqno = peer_isn;
+  syn.sender.SYN = true;
+  syn.receiver.window_size = ack.receiver.window_size;
+  syn.mss = *mss;
+  connection.peer.receive( std::move( syn ), []( const TCPMessage& ) {} );
+  return &connection;
+}
+
+void TCPStack::send( const FourTuple& tuple, const TCPMessage& msg )
+{
+  const auto datagram = TCPOverIPv4Adapter::serialize_tcp_in_ip( msg, tuple, headers_ );
+  if ( ( ring_ ? ring_->write( datagram ) : fd_.write( datagram ) ) == 0 )
+    stats_.send_drops++;
+  else
+    stats_.datagrams_sent++;
+}
@@ -0,0 +1,270 @@
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+#include "file_descriptor.hh"
+
+#include <array>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+struct ReadInto : public Action<ByteStream>
+{
+  FileDescriptor& fd_;
+
+  explicit ReadInto( FileDescriptor& fd ) : fd_( fd ) {}
+  std::string description() const override { return "read_into from fd"; }
+  void execute( ByteStream& bs ) const override { read_into( fd_, bs.writer() ); }
+};
+
+struct CommitPastReserve : public Expectation<ByteStream>
+{
+  uint64_t len_;
+  uint64_t region_size_;
+
+  CommitPastReserve( uint64_t len, uint64_t region_size ) : len_( len ), region_size_( region_size ) {}
+  std::string description() const override
+  {
+    return "reserve( " + std::to_string( len_ ) + " ) gives " + std::to_string( region_size_ )
+           + " bytes, and committing more throws";
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    const auto region = bs.writer().reserve( len_ );
+    if ( region.size() != region_size_ ) {
+      throw ExpectationViolation { "reserve() gave " + std::to_string( region.size() ) + " bytes" };
+    }
+    try {
+      bs.writer().commit( region.size() + 1 );
+    } catch ( const std::runtime_error& ) {
+      return;
+    }
+    throw ExpectationViolation { "commit() accepted more than reserve() gave" };
+  }
+};
+
+struct PeekIov : public Expectation<ByteStream>
+{
+  uint64_t max_len_;
+  std::vector<std::string> segments_;
+
+  PeekIov( uint64_t max_len, std::vector<std::string> segments )
+    : max_len_( max_len ), segments_( move( segments ) )
+  {}
+  std::string description() const override
+  {
+    std::string ret = "peek_iov( " + std::to_string( max_len_ ) + " ) gives {";
+    for ( const auto& x : segments_ ) {
+      ret += " \"" + Printer::prettify( x ) + "\"";
+    }
+    return ret + " }";
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    const auto got = bs.reader().peek_iov( max_len_ );
+    if ( not std::equal( got.begin(), got.end(), segments_.begin(), segments_.end() ) ) {
+      throw ExpectationViolation { "peek_iov() returned " + std::to_string( got.size() )
+                                   + " segments that don't match the expected ones" };
+    }
+  }
+};
+
+struct PushCord : public Action<ByteStream>
+{
+  std::vector<std::string> slices_;
+
+  explicit PushCord( std::vector<std::string> slices ) : slices_( move( slices ) ) {}
+  std::string description() const override
+  {
+    return "push a Cord of " + std::to_string( slices_.size() ) + " slices to the stream";
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    Cord data;
+    for ( const auto& x : slices_ ) {
+      data.append( Slice { x } );
+    }
+    bs.writer().push( std::move( data ) );
+  }
+};
+
+struct PeekCord : public Expectation<ByteStream>
+{
+  uint64_t max_len_;
+  std::string output_;
+
+  PeekCord( uint64_t max_len, std::string output ) : max_len_( max_len ), output_( move( output ) ) {}
+  std::string description() const override
+  {
+    return "peek_cord( " + std::to_string( max_len_ ) + " ) gives \"" + Printer::prettify( output_ ) + "\"";
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    const Cord got = bs.reader().peek_cord( max_len_ );
+    if ( not( got == output_ ) ) {
+      throw ExpectationViolation { "Expected \"" + Printer::prettify( output_ )
+                                   + "\" from peek_cord(), but found \""
+                                   + Printer::prettify( static_cast<std::string>( got ) ) + "\"" };
+    }
+  }
+};
+
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "deque peeks one write at a time", 15, ByteStream::Backend::Deque };
+
+      test.execute( Push { "cat" } );
+      test.execute( Push { "tac" } );
+      test.execute( PeekOnce { "cat" } );
+      test.execute( PeekIov { UINT64_MAX, { "cat", "tac" } } );
+      test.execute( PeekIov { 4, { "cat", "t" } } );
+      test.execute( Pop { 2 } );
+      test.execute( PeekOnce { "t" } );
+      test.execute( Peek { "ttac" } );
+      test.execute( BytesBuffered { 4 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "ring peeks across writes", 15, ByteStream::Backend::Ring };
+
+      test.execute( Push { "cat" } );
+      test.execute( Push { "tac" } );
+      test.execute( PeekOnce { "cattac" } );
+      test.execute( Pop { 2 } );
+      test.execute( PeekOnce { "ttac" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "ring peek stops at the wrap point", 8, ByteStream::Backend::Ring };
+
+      test.execute( Push { "abcdef" } );
+      test.execute( Pop { 4 } );
+      test.execute( Push { "ghijklmn" } );
+      test.execute( BytesBuffered { 8 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( PeekOnce { "efgh" } );
+      test.execute( PeekIov { UINT64_MAX, { "efgh", "ijkl" } } );
+      test.execute( PeekIov { 3, { "efg" } } );
+      test.execute( Peek { "efghijkl" } );
+      test.execute( Pop { 4 } );
+      test.execute( PeekOnce { "ijkl" } );
+      test.execute( Pop { 4 } );
+      test.execute( BufferEmpty { true } );
+      test.execute( Push { "op" } );
+      test.execute( PeekOnce { "op" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "ring commit can't pass the wrap point", 8, ByteStream::Backend::Ring };
+
+      test.execute( Push { "abcdef" } );
+      test.execute( Pop { 4 } );
+      test.execute( AvailableCapacity { 6 } );
+      test.execute( CommitPastReserve { 6, 2 } );
+      test.execute( BytesPushed { 6 } );
+      test.execute( Peek { "ef" } );
+    }
+
+    {
+      const string first( 3000, 'x' );
+      const string second( 3000, 'y' );
+      ByteStreamTestHarness test { "mirrored ring peeks every byte", 4096, ByteStream::Backend::MirroredRing };
+
+      test.execute( Push { first } );
+      test.execute( Pop { 2000 } );
+      test.execute( Push { second } );
+      test.execute( BytesBuffered { 4000 } );
+      test.execute( AvailableCapacity { 96 } );
+      test.execute( PeekOnce { first.substr( 2000 ) + second } );
+      test.execute( PeekIov { UINT64_MAX, { first.substr( 2000 ) + second } } );
+      test.execute( Pop { 3999 } );
+      test.execute( PeekOnce { "y" } );
+      test.execute( Close {} );
+      test.execute( Pop { 1 } );
+      test.execute( IsFinished { true } );
+    }
+
+    {
+      ByteStreamTestHarness test {
+        "mirrored ring with capacity below a page", 3, ByteStream::Backend::MirroredRing };
+
+      test.execute( Push { "cat" } );
+      test.execute( Pop { 2 } );
+      test.execute( Push { "dog" } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( PeekOnce { "tdo" } );
+      test.execute( BytesPushed { 5 } );
+    }
+
+    for ( const auto backend :
+          { ByteStream::Backend::MirroredRing, ByteStream::Backend::Ring, ByteStream::Backend::Deque } ) {
+      ByteStreamTestHarness test { "reserve and commit", 8, backend };
+
+      test.execute( ReserveAndCommit { "abcdef" } );
+      test.execute( BytesPushed { 6 } );
+      test.execute( Pop { 4 } );
+      test.execute( ReserveAndCommit { "ghijklmn" } );
+      test.execute( BytesPushed { 12 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( ReserveAndCommit { "o" } );
+      test.execute( BytesPushed { 12 } );
+      test.execute( Peek { "efghijkl" } );
+      test.execute( Close {} );
+      test.execute( ReserveAndCommit { "p" } );
+      test.execute( ReadAll { "efghijkl" } );
+      test.execute( IsFinished { true } );
+    }
+
+    for ( const auto backend :
+          { ByteStream::Backend::MirroredRing, ByteStream::Backend::Ring, ByteStream::Backend::Deque } ) {
+      ByteStreamTestHarness test { "push and peek Cords", 8, backend };
+
+      test.execute( PushCord { { "ab", "cde", "f" } } );
+      test.execute( BytesPushed { 6 } );
+      test.execute( PeekCord { 4, "abcd" } );
+      test.execute( Pop { 3 } );
+      test.execute( PushCord { { "ghi", "jklmn" } } );
+      test.execute( BytesPushed { 11 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( PeekCord { UINT64_MAX, "defghijk" } );
+      test.execute( Peek { "defghijk" } );
+      test.execute( Pop { 8 } );
+      test.execute( PeekCord { UINT64_MAX, "" } );
+    }
+
+    for ( const auto backend :
+          { ByteStream::Backend::MirroredRing, ByteStream::Backend::Ring, ByteStream::Backend::Deque } ) {
+      ByteStreamTestHarness test { "read_into from a pipe", 5, backend };
+
+      array<int, 2> fds {};
+      CheckSystemCall( "pipe", ::pipe( fds.data() ) );
+      FileDescriptor read_end { fds[0] };
+      FileDescriptor write_end { fds[1] };
+      write_end.write( "hello, world" );
+
+      test.execute( ReadInto { read_end } );
+      test.execute( BytesPushed { 5 } );
+      test.execute( Pop { 3 } );
+      test.execute( ReadInto { read_end } );
+      test.execute( Peek { "lo, w" } );
+      test.execute( Pop { 5 } );
+      write_end.close();
+      test.execute( ReadInto { read_end } );
+      test.execute( ReadInto { read_end } );
+      test.execute( Peek { "orld" } );
+      if ( not read_end.eof() ) {
+        throw runtime_error( "read_into did not reach EOF" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -11,7 +11,8 @@
 using namespace std;
 using namespace std::chrono;
 
-void speed_test( const size_t input_len,   // NOLINT(bugprone-easily-swappable-parameters)
+void speed_test( const ByteStream::Backend backend,
+                 const size_t input_len,   // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t capacity,    // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t write_size,  // NOLINT(bugprone-easily-swappable-parameters)
@@ -34,7 +35,7 @@ void speed_test( const size_t input_len,   // NOLINT(bugprone-easily-swappable-p
     split_data.emplace( data.substr( i, write_size ) );
   }
 
-  ByteStream bs { capacity };
+  ByteStream bs { capacity, backend };
   string output_data;
   output_data.reserve( data.size() );
 
@@ -75,11 +76,12 @@ void speed_test( const size_t input_len,   // NOLINT(bugprone-easily-swappable-p
   fstream debug_output;
   debug_output.open( "/dev/tty" );
 
-  cout << "ByteStream with capacity=" << capacity << ", write_size=" << write_size << ", read_size=" << read_size
-       << " reached " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
+  cout << "ByteStream (" << ByteStream::backend_name( backend ) << ") with capacity=" << capacity
+       << ", write_size=" << write_size << ", read_size=" << read_size << " reached " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s.\n";
 
-  debug_output << "             ByteStream throughput: " << fixed << setprecision( 2 ) << gigabits_per_second
-               << " Gbit/s\n";
+  debug_output << "             ByteStream (" << setw( 13 ) << ByteStream::backend_name( backend )
+               << ") throughput: " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s\n";
 
   if ( gigabits_per_second < 0.1 ) {
     throw runtime_error( "ByteStream did not meet minimum speed of 0.1 Gbit/s." );
@@ -88,7 +90,12 @@ void speed_test( const size_t input_len,   // NOLINT(bugprone-easily-swappable-p
 
 void program_body()
 {
-  speed_test( 1e7, 32768, 789, 1500, 128 );
+  for ( const auto backend :
+        { ByteStream::Backend::MirroredRing, ByteStream::Backend::Ring, ByteStream::Backend::Deque } ) {
+    speed_test( backend, 1e7, 32768, 789, 1500, 128 );      // small reads
+    speed_test( backend, 1e7, 32768, 789, 64, 64 );         // small writes and reads
+    speed_test( backend, 1e7, 1048576, 789, 65536, 65536 ); // large writes and reads
+  }
 }
 
 int main()
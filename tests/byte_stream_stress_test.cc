@@ -5,7 +5,8 @@
 
 using namespace std;
 
-void stress_test( const size_t input_len,    // NOLINT(bugprone-easily-swappable-parameters)
+void stress_test( const ByteStream::Backend backend,
+                  const size_t input_len,    // NOLINT(bugprone-easily-swappable-parameters)
                   const size_t capacity,     // NOLINT(bugprone-easily-swappable-parameters)
                   const size_t random_seed ) // NOLINT(bugprone-easily-swappable-parameters)
 {
@@ -21,7 +22,8 @@ void stress_test( const size_t input_len,    // NOLINT(bugprone-easily-swappable
   }();
 
   ByteStreamTestHarness bs { "stress test input=" + to_string( input_len ) + ", capacity=" + to_string( capacity ),
-                             capacity };
+                             capacity,
+                             backend };
 
   size_t expected_bytes_pushed {};
   size_t expected_bytes_popped {};
@@ -72,10 +74,13 @@ void stress_test( const size_t input_len,    // NOLINT(bugprone-easily-swappable
 
 void program_body()
 {
-  stress_test( 19, 3, 10110 );
-  stress_test( 18, 17, 12345 );
-  stress_test( 1111, 17, 98765 );
-  stress_test( 4097, 4096, 11101 );
+  for ( const auto backend :
+        { ByteStream::Backend::MirroredRing, ByteStream::Backend::Ring, ByteStream::Backend::Deque } ) {
+    stress_test( backend, 19, 3, 10110 );
+    stress_test( backend, 18, 17, 12345 );
+    stress_test( backend, 1111, 17, 98765 );
+    stress_test( backend, 4097, 4096, 11101 );
+  }
 }
 
 int main()
@@ -0,0 +1,138 @@
+#include "byte_stream.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sys/socket.h>
+
+using namespace std;
+using namespace std::chrono;
+
+struct DrainResult
+{
+  double syscalls_per_megabyte;
+  double gigabits_per_second;
+};
+
+DrainResult drain_test( const ByteStream::Backend backend,
+                        const bool use_write_from,
+                        const size_t input_len,  // NOLINT(bugprone-easily-swappable-parameters)
+                        const size_t capacity,   // NOLINT(bugprone-easily-swappable-parameters)
+                        const size_t write_size, // NOLINT(bugprone-easily-swappable-parameters)
+                        const size_t random_seed )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM, 0, fds.data() ) );
+  FileDescriptor sender { fds[0] };
+  FileDescriptor receiver { fds[1] };
+  sender.set_blocking( false );
+  receiver.set_blocking( false );
+
+  ByteStream bs { capacity, backend };
+  size_t bytes_written_to_stream = 0;
+  string output_data;
+  output_data.reserve( data.size() );
+  string read_buffer;
+
+  const auto start_time = steady_clock::now();
+  while ( output_data.size() < data.size() ) {
+    // the application writes in small pieces
+    while ( bytes_written_to_stream < data.size() and bs.writer().available_capacity() >= write_size ) {
+      bs.writer().push( data.substr( bytes_written_to_stream, write_size ) );
+      bytes_written_to_stream += write_size;
+    }
+
+    // one "writable" event: drain the stream into the socket
+    if ( bs.reader().bytes_buffered() ) {
+      if ( use_write_from ) {
+        write_from( sender, bs.reader() );
+      } else {
+        bs.reader().pop( sender.write( bs.reader().peek() ) );
+      }
+    }
+
+    // the peer reads everything that arrived
+    while ( true ) {
+      read_buffer.resize( 1048576 );
+      receiver.read( read_buffer );
+      if ( read_buffer.empty() ) {
+        break;
+      }
+      output_data += read_buffer;
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return { static_cast<double>( sender.write_count() ) / ( static_cast<double>( input_len ) / 1e6 ),
+           8 * static_cast<double>( input_len ) / test_duration.count() / 1e9 };
+}
+
+void speed_test( const ByteStream::Backend backend,
+                 const size_t write_size ) // NOLINT(bugprone-easily-swappable-parameters)
+{
+  constexpr size_t input_len = 2e6;
+  constexpr size_t capacity = 65536;
+  const auto backend_name = ByteStream::backend_name( backend );
+
+  const auto peek_write = drain_test( backend, false, input_len, capacity, write_size, 1370 );
+  const auto write_from = drain_test( backend, true, input_len, capacity, write_size, 1370 );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  for ( const auto& [name, result] : { pair { "peek+write", peek_write }, pair { "write_from", write_from } } ) {
+    cout << "ByteStream (" << backend_name << ") with write_size=" << write_size << " drained by " << name
+         << " used " << fixed << setprecision( 1 ) << result.syscalls_per_megabyte << " syscalls/MB at "
+         << setprecision( 2 ) << result.gigabits_per_second << " Gbit/s.\n";
+    debug_output << "             " << setw( 13 ) << backend_name << " " << name << " (write_size=" << setw( 4 )
+                 << write_size << "): " << fixed << setprecision( 1 ) << setw( 8 )
+                 << result.syscalls_per_megabyte << " syscalls/MB\n";
+  }
+
+  if ( write_from.syscalls_per_megabyte > peek_write.syscalls_per_megabyte ) {
+    throw runtime_error( "write_from() used more syscalls than peek() and write()." );
+  }
+}
+
+void program_body()
+{
+  for ( const size_t write_size : { 64, 1500 } ) {
+    speed_test( ByteStream::Backend::Deque, write_size );
+    speed_test( ByteStream::Backend::Ring, write_size );
+    speed_test( ByteStream::Backend::MirroredRing, write_size );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -3,6 +3,7 @@
 #include "byte_stream.hh"
 #include "common.hh"
 
+#include <algorithm>
 #include <concepts>
 #include <optional>
 #include <utility>
@@ -16,8 +17,13 @@ static_assert( sizeof( Writer ) == sizeof( ByteStream ),
 class ByteStreamTestHarness : public TestHarness<ByteStream>
 {
 public:
-  ByteStreamTestHarness( std::string test_name, uint64_t capacity )
-    : TestHarness( move( test_name ), "capacity=" + std::to_string( capacity ), ByteStream { capacity } )
+  ByteStreamTestHarness( std::string test_name,
+                         uint64_t capacity,
+                         ByteStream::Backend backend = ByteStream::Backend::MirroredRing )
+    : TestHarness( move( test_name ),
+                   "capacity=" + std::to_string( capacity ) + ", backend="
+                     + std::string { ByteStream::backend_name( backend ) },
+                   ByteStream { capacity, backend } )
   {}
 
   size_t peek_size() { return object().reader().peek().size(); }
@@ -34,6 +40,30 @@ struct Push : public Action<ByteStream>
   void execute( ByteStream& bs ) const override { bs.writer().push( data_ ); }
 };
 
+struct ReserveAndCommit : public Action<ByteStream>
+{
+  std::string data_;
+
+  explicit ReserveAndCommit( std::string data ) : data_( move( data ) ) {}
+  std::string description() const override
+  {
+    return "reserve/commit \"" + Printer::prettify( data_ ) + "\" into the stream";
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    std::string_view remaining = data_;
+    while ( not remaining.empty() ) {
+      const auto region = bs.writer().reserve( remaining.size() );
+      if ( region.empty() ) {
+        break;
+      }
+      std::copy( remaining.begin(), remaining.begin() + region.size(), region.begin() );
+      bs.writer().commit( region.size() );
+      remaining.remove_prefix( region.size() );
+    }
+  }
+};
+
 struct Close : public Action<ByteStream>
 {
   std::string description() const override { return "close"; }
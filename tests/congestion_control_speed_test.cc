@@ -0,0 +1,143 @@
+#include "byte_stream.hh"
+#include "lossy_link.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+struct TransferResult
+{
+  double simulated_megabits_per_second; // goodput over the simulated link
+  double queue_drop_fraction;           // segments dropped by the bottleneck queue, over segments sent
+  double retransmitted_fraction;        // payload bytes sent more than once, over bytes delivered
+};
+
+// Send `input_len` bytes from a TCPSender to a TCPReceiver through a bottleneck with a drop-tail queue.
+TransferResult transfer( const CongestionControl algorithm,
+                         const size_t input_len,     // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint64_t delay_ms,    // NOLINT(bugprone-easily-swappable-parameters)
+                         const double bytes_per_ms,  // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint64_t queue_limit, // NOLINT(bugprone-easily-swappable-parameters)
+                         const size_t random_seed )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPConfig config;
+  config.isn = Wrap32 { 0 };
+  config.rt_timeout = 4 * delay_ms + 2 * queue_limit / static_cast<uint64_t>( bytes_per_ms );
+  config.congestion_control = algorithm;
+
+  TCPSender sender { ByteStream { TCPConfig::DEFAULT_CAPACITY }, config };
+  TCPReceiver receiver { Reassembler { ByteStream { TCPConfig::DEFAULT_CAPACITY } } };
+  LossyLink<TCPSenderMessage> data_link { delay_ms, 0, random_seed };
+  LossyLink<TCPReceiverMessage> ack_link { delay_ms, 0, random_seed + 1 };
+  data_link.set_bottleneck( bytes_per_ms, queue_limit );
+
+  uint64_t now = 0;
+  uint64_t payload_bytes_sent = 0;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    payload_bytes_sent += msg.payload.size();
+    data_link.send( msg, now, msg.sequence_length() + 40 );
+  };
+
+  size_t bytes_written = 0;
+  string chunk;
+  string output_data;
+  output_data.reserve( data.size() );
+
+  while ( not receiver.reader().is_finished() ) {
+    const size_t len = min( data.size() - bytes_written, sender.writer().available_capacity() );
+    sender.writer().push( data.substr( bytes_written, len ) );
+    bytes_written += len;
+    if ( bytes_written == data.size() ) {
+      sender.writer().close();
+    }
+    sender.push( transmit );
+
+    // the application reads as soon as bytes arrive, so the window advertised is never held back
+    data_link.deliver( now, [&]( TCPSenderMessage msg ) {
+      receiver.receive( move( msg ) );
+      read( receiver.reader(), receiver.reader().bytes_buffered(), chunk );
+      output_data += chunk;
+      ack_link.send( receiver.send(), now );
+    } );
+    ack_link.deliver( now, [&]( const TCPReceiverMessage& ack ) {
+      sender.receive( ack );
+      sender.push( transmit );
+    } );
+
+    sender.tick( 1, transmit );
+    ++now;
+  }
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  return { 8 * static_cast<double>( input_len ) / ( static_cast<double>( now ) / 1000 ) / 1e6,
+           static_cast<double>( data_link.queue_drops() ) / static_cast<double>( data_link.sent() ),
+           static_cast<double>( payload_bytes_sent ) / static_cast<double>( input_len ) - 1 };
+}
+
+void speed_test( const CongestionControl algorithm, const string& algorithm_name )
+{
+  constexpr size_t input_len = 4e6;
+  constexpr uint64_t delay_ms = 20;
+  constexpr double bytes_per_ms = 625; // 5 Mbit/s: the bandwidth-delay product is 25 kB
+  constexpr uint64_t queue_limit = 15000;
+
+  const auto result = transfer( algorithm, input_len, delay_ms, bytes_per_ms, queue_limit, 1370 );
+
+  cout << "TCPSender (" << algorithm_name << ") -> TCPReceiver through a 5 Mbit/s, " << 2 * delay_ms
+       << " ms RTT bottleneck: " << fixed << setprecision( 2 ) << result.simulated_megabits_per_second
+       << " Mbit/s, " << result.queue_drop_fraction * 100 << "% of segments dropped at the queue, "
+       << result.retransmitted_fraction * 100 << "% of bytes resent.\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "             " << setw( 8 ) << algorithm_name << ": " << fixed << setprecision( 2 )
+               << result.simulated_megabits_per_second << " Mbit/s, " << result.queue_drop_fraction * 100
+               << "% queue drops\n";
+
+  if ( algorithm != CongestionControl::None and result.queue_drop_fraction > 0.05 ) {
+    throw runtime_error( algorithm_name + " overran the bottleneck queue" );
+  }
+}
+
+void program_body()
+{
+  speed_test( CongestionControl::None, "none" );
+  speed_test( CongestionControl::NewReno, "NewReno" );
+  speed_test( CongestionControl::CUBIC, "CUBIC" );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
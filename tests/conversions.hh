@@ -5,6 +5,7 @@
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 // https://stackoverflow.com/questions/33399594/making-a-user-defined-class-stdto-stringable
 
@@ -31,6 +32,22 @@ std::string to_string( const std::optional<T>& v )
 
   return "None";
 }
+
+template<typename T, typename U>
+std::string to_string( const std::pair<T, U>& range )
+{
+  return "[" + to_string( range.first ) + ", " + to_string( range.second ) + ")";
+}
+
+template<typename T>
+std::string to_string( const std::vector<T>& v )
+{
+  std::string ret = "{";
+  for ( const auto& x : v ) {
+    ret += ( ret.size() > 1 ? " " : "" ) + to_string( x );
+  }
+  return ret + "}";
+}
 } // namespace minnow_conversions
 
 template<typename T>
@@ -0,0 +1,138 @@
+#include "lossy_link.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+struct TransferResult
+{
+  double simulated_megabits_per_second;  // goodput over the simulated link
+  double acks_per_data_segment;          // pure ACKs sent by the receiver, over data segments it received
+  double receiver_segments_per_megabyte; // segments the receiver sent, per megabyte delivered
+};
+
+// Send `input_len` bytes from one TCPPeer to another over a 100 Mbit/s, 20 ms RTT path
+TransferResult transfer( const TCPConfig& receiver_config, const size_t input_len )
+{
+  constexpr uint64_t delay_ms = 10;
+  constexpr double bytes_per_ms = 12500;
+  constexpr uint64_t queue_limit = 250'000;
+  constexpr uint64_t header_len = TCPConfig::HEADERS_LEN + TCPConfig::TIMESTAMPS_LEN;
+
+  const string data = [&input_len] {
+    default_random_engine rd { 1370 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPConfig sender_config;
+  sender_config.send_capacity = 1 << 20;
+  sender_config.recv_capacity = 1 << 20;
+  TCPPeer sender { sender_config };
+  TCPPeer receiver { receiver_config };
+
+  LossyLink<TCPMessage> data_link { delay_ms, 0, 1 };
+  LossyLink<TCPMessage> ack_link { delay_ms, 0, 2 };
+  data_link.set_bottleneck( bytes_per_ms, queue_limit );
+
+  uint64_t now = 0;
+  const auto send_data = [&]( const TCPMessage& msg ) {
+    data_link.send( msg, now, msg.sender.payload.size() + header_len );
+  };
+  const auto send_ack = [&]( const TCPMessage& msg ) { ack_link.send( msg, now ); };
+
+  size_t bytes_written = 0;
+  uint64_t data_segments_received = 0;
+  string output_data;
+  output_data.reserve( data.size() );
+
+  while ( not receiver.inbound_reader().is_finished() ) {
+    Writer& writer = sender.outbound_writer();
+    const size_t len = min( data.size() - bytes_written, writer.available_capacity() );
+    writer.push( data.substr( bytes_written, len ) );
+    bytes_written += len;
+    if ( bytes_written == data.size() and not writer.is_closed() ) {
+      writer.close();
+    }
+    sender.push( send_data );
+
+    data_link.deliver( now, [&]( TCPMessage msg ) {
+      data_segments_received += not msg.sender.payload.empty();
+      receiver.receive( std::move( msg ), send_ack );
+      Reader& reader = receiver.inbound_reader();
+      while ( reader.bytes_buffered() ) {
+        output_data += reader.peek();
+        reader.pop( reader.peek().size() );
+      }
+    } );
+    ack_link.deliver( now, [&]( TCPMessage msg ) { sender.receive( std::move( msg ), send_data ); } );
+
+    sender.tick( 1, send_data );
+    receiver.tick( 1, send_ack );
+    ++now;
+  }
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const double megabytes = static_cast<double>( input_len ) / 1e6;
+  return { 8 * megabytes / ( static_cast<double>( now ) / 1000 ),
+           static_cast<double>( receiver.stats().pure_acks_sent ) / static_cast<double>( data_segments_received ),
+           static_cast<double>( receiver.stats().segments_sent ) / megabytes };
+}
+
+void speed_test( const TCPConfig& receiver_config, const string& name )
+{
+  constexpr size_t input_len = 20e6;
+
+  const auto result = transfer( receiver_config, input_len );
+
+  cout << "TCPPeer to TCPPeer (" << name << "): " << fixed << setprecision( 2 )
+       << result.simulated_megabits_per_second << " Mbit/s, " << result.acks_per_data_segment
+       << " ACKs per data segment, " << setprecision( 0 ) << result.receiver_segments_per_megabyte
+       << " receiver segments/MB.\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "      " << setw( 20 ) << name << ": " << fixed << setprecision( 2 ) << setw( 6 )
+               << result.simulated_megabits_per_second << " Mbit/s, " << result.acks_per_data_segment
+               << " ACKs/segment, " << setprecision( 0 ) << setw( 4 ) << result.receiver_segments_per_megabyte
+               << " receiver segments/MB\n";
+}
+
+void program_body()
+{
+  TCPConfig config;
+  config.send_capacity = 1 << 20;
+  config.recv_capacity = 1 << 20;
+
+  config.delayed_ack = false;
+  speed_test( config, "ACK every segment" );
+  config.delayed_ack = true;
+  speed_test( config, "delayed ACKs" );
+  config.stretch_ack = 8;
+  speed_test( config, "stretch ACKs" );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,302 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+string name( const EventLoop::Backend backend )
+{
+  return backend == EventLoop::Backend::Epoll ? "epoll: " : "poll: ";
+}
+
+pair<FileDescriptor, FileDescriptor> make_pair_of_sockets()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+// Three fds are readable at once: epoll serves them all in one wakeup, poll one at a time
+void dispatch_test( const EventLoop::Backend backend )
+{
+  EventLoop loop { backend };
+  const size_t category = loop.add_category( "read" );
+  vector<pair<FileDescriptor, FileDescriptor>> pairs;
+  size_t served = 0;
+  for ( int i = 0; i < 3; i++ ) {
+    pairs.push_back( make_pair_of_sockets() );
+  }
+  for ( auto& [reader, writer] : pairs ) {
+    loop.add_rule( category, reader, Direction::In, [&served, &reader] {
+      string buffer;
+      reader.read( buffer );
+      served++;
+    } );
+    writer.write( "x" );
+  }
+
+  // ready fds are served
+  test_should_be( loop.wait_next_event( 0 ) == EventLoop::Result::Success, true );
+  // as many as it can
+  test_should_be( served == ( backend == EventLoop::Backend::Epoll ? 3 : 1 ), true );
+  while ( served < 3 ) {
+    loop.wait_next_event( 0 );
+  }
+  // then nothing is ready
+  test_should_be( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, true );
+}
+
+// A rule is only served while it is interested, however its interest comes and goes
+void interest_test( const EventLoop::Backend backend )
+{
+  EventLoop loop { backend };
+  auto [reader, writer] = make_pair_of_sockets();
+  bool interested = true;
+  size_t served = 0;
+  loop.add_rule(
+    "read",
+    reader,
+    Direction::In,
+    [&] {
+      string buffer;
+      reader.read( buffer );
+      served++;
+    },
+    [&] { return interested; } );
+  loop.add_rule( "keep the loop alive", writer, Direction::Out, [] {}, [] { return false; } );
+
+  writer.write( "x" );
+  loop.wait_next_event( 0 );
+  // an interested rule is served
+  test_should_be( served == 1, true );
+
+  interested = false;
+  writer.write( "x" );
+  // nothing is interested
+  test_should_be( loop.wait_next_event( 0 ) == EventLoop::Result::Exit, true );
+  // and nothing is served
+  test_should_be( served == 1, true );
+
+  interested = true;
+  // until it is interested again
+  test_should_be( loop.wait_next_event( 0 ) == EventLoop::Result::Success and served == 2, true );
+
+  // losing interest between events, with another rule still interested
+  auto [other_reader, other_writer] = make_pair_of_sockets();
+  loop.add_rule( "other read", other_reader, Direction::In, [&] {
+    string buffer;
+    other_reader.read( buffer );
+  } );
+  interested = false;
+  writer.write( "x" );
+  // an unwanted event doesn't count as one
+  test_should_be( loop.wait_next_event( 10 ) == EventLoop::Result::Timeout and served == 2, true );
+  interested = true;
+  // and the event is still there when it is wanted
+  test_should_be( loop.wait_next_event( 10 ) == EventLoop::Result::Success and served == 3, true );
+}
+
+// A rule that neither reads nor loses interest would spin forever
+void busy_wait_test( const EventLoop::Backend backend )
+{
+  EventLoop loop { backend };
+  auto [reader, writer] = make_pair_of_sockets();
+  loop.add_rule( "lazy", reader, Direction::In, [] {} );
+  writer.write( "x" );
+
+  bool threw = false;
+  try {
+    loop.wait_next_event( 0 );
+  } catch ( const runtime_error& e ) {
+    threw = string { e.what() }.find( "busy wait" ) != string::npos;
+  }
+  // busy wait is detected
+  test_should_be( threw, true );
+}
+
+// Rules on a socket whose peer is gone are cancelled
+void hangup_test( const EventLoop::Backend backend )
+{
+  EventLoop loop { backend };
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds.data() ) );
+  FileDescriptor ours { fds[0] };
+  size_t cancelled = 0;
+  loop.add_rule(
+    "write", ours, Direction::Out, [] {}, [] { return true; }, [&] { cancelled++; } );
+  {
+    const FileDescriptor theirs { fds[1] };
+  }
+  loop.wait_next_event( 0 );
+  // a writer whose peer hung up is cancelled
+  test_should_be( cancelled == 1, true );
+  // and removed
+  test_should_be( loop.wait_next_event( 0 ) == EventLoop::Result::Exit, true );
+}
+
+// A hangup on an fd whose rule isn't interested wakes no one, and the wait still ends at its timeout
+void uninterested_hangup_test( const EventLoop::Backend backend )
+{
+  EventLoop loop { backend };
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds.data() ) );
+  FileDescriptor ours { fds[0] };
+  bool interested = false;
+  size_t cancelled = 0;
+  loop.add_rule(
+    "read",
+    ours,
+    Direction::In,
+    [&] {
+      string buffer;
+      ours.read( buffer );
+    },
+    [&] { return interested; },
+    [&] { cancelled++; } );
+  auto [idle_reader, idle_writer] = make_pair_of_sockets();
+  loop.add_rule( "keep the loop alive", idle_reader, Direction::In, [] {} );
+  {
+    const FileDescriptor theirs { fds[1] };
+  }
+
+  for ( int i = 0; i < 3; i++ ) {
+    const auto start = chrono::steady_clock::now();
+    loop.wait_next_event( 20 );
+    // the wait returns, however long the hangup has gone unwanted
+    test_should_be( chrono::steady_clock::now() - start < chrono::seconds { 1 }, true );
+  }
+  // an uninterested rule keeps its place
+  test_should_be( cancelled == 0, true );
+
+  interested = true;
+  for ( int i = 0; i < 3 and cancelled == 0; i++ ) {
+    loop.wait_next_event( 0 );
+  }
+  // and hears about the hangup once it is interested
+  test_should_be( cancelled == 1, true );
+}
+
+// A rule that loses interest while an earlier rule is served, in the same wakeup, isn't served
+void interest_lost_in_wakeup_test( const EventLoop::Backend backend )
+{
+  EventLoop loop { backend };
+  vector<pair<FileDescriptor, FileDescriptor>> pairs;
+  bool done = false;
+  size_t served = 0;
+  for ( int i = 0; i < 2; i++ ) {
+    pairs.push_back( make_pair_of_sockets() );
+  }
+  for ( auto& [reader, writer] : pairs ) {
+    loop.add_rule(
+      "read",
+      reader,
+      Direction::In,
+      [&served, &done, &reader] {
+        string buffer;
+        reader.read( buffer );
+        served++;
+        done = true;
+      },
+      [&done] { return not done; } );
+    writer.write( "x" );
+  }
+
+  loop.wait_next_event( 0 );
+  // the second rule isn't served once the first has run
+  test_should_be( served == 1, true );
+}
+
+// epoll can't watch a regular file, which poll(2) calls always readable
+void regular_file_test( const EventLoop::Backend backend )
+{
+  EventLoop loop { backend };
+  FileDescriptor file { CheckSystemCall( "fileno", fileno( tmpfile() ) ) };
+  file.write( "contents" );
+  size_t served = 0;
+  loop.add_rule( "file", file, Direction::In, [&] {
+    string buffer;
+    file.read( buffer );
+    served++;
+  } );
+  while ( loop.wait_next_event( 0 ) == EventLoop::Result::Success ) {}
+  // a regular file is read to the end
+  test_should_be( served >= 1 and file.eof(), true );
+}
+
+volatile sig_atomic_t alarms = 0;
+
+// A signal that arrives during the wait (as io_uring task work can, or a timer) doesn't end it early
+void signal_test( const EventLoop::Backend backend )
+{
+  struct sigaction action {};
+  action.sa_handler = []( int ) { alarms = alarms + 1; };
+  CheckSystemCall( "sigaction", ::sigaction( SIGALRM, &action, nullptr ) );
+
+  EventLoop loop { backend };
+  auto [reader, writer] = make_pair_of_sockets();
+  loop.add_rule( "read", reader, Direction::In, [&] {
+    string buffer;
+    reader.read( buffer );
+  } );
+
+  alarms = 0;
+  const itimerval timer { { 0, 10'000 }, { 0, 10'000 } }; // every 10 ms
+  CheckSystemCall( "setitimer", ::setitimer( ITIMER_REAL, &timer, nullptr ) );
+  const auto start = chrono::steady_clock::now();
+  const auto result = loop.wait_next_event( 100 );
+  const auto elapsed = chrono::steady_clock::now() - start;
+  const itimerval stop {};
+  CheckSystemCall( "setitimer", ::setitimer( ITIMER_REAL, &stop, nullptr ) );
+
+  // the wait was interrupted
+  test_should_be( alarms > 0, true );
+  // an interrupted wait times out
+  test_should_be( result == EventLoop::Result::Timeout, true );
+  // after the whole timeout
+  test_should_be( elapsed >= chrono::milliseconds { 100 }, true );
+
+  CheckSystemCall( "setitimer", ::setitimer( ITIMER_REAL, &timer, nullptr ) );
+  writer.write( "x" );
+  // and ready fds are served
+  test_should_be( loop.wait_next_event( 100 ) == EventLoop::Result::Success, true );
+  CheckSystemCall( "setitimer", ::setitimer( ITIMER_REAL, &stop, nullptr ) );
+}
+} // namespace
+
+int main()
+{
+  try {
+    for ( const auto backend : { EventLoop::Backend::Poll, EventLoop::Backend::Epoll } ) {
+      try {
+        dispatch_test( backend );
+        interest_test( backend );
+        busy_wait_test( backend );
+        hangup_test( backend );
+        uninterested_hangup_test( backend );
+        interest_lost_in_wakeup_test( backend );
+        regular_file_test( backend );
+        signal_test( backend );
+      } catch ( const exception& e ) {
+        throw runtime_error( name( backend ) + e.what() );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
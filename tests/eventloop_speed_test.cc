@@ -0,0 +1,96 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t READY = 8;      // fds that become readable at once
+constexpr size_t ROUNDS = 5'000; // rounds of READY events each
+
+// `fds` idle datagram sockets watched by one EventLoop, READY of which become readable each round. Returns the
+// time to serve one event, including the writes that cause it.
+double ns_per_event( const EventLoop::Backend backend, const size_t fds )
+{
+  vector<FileDescriptor> readers;
+  vector<FileDescriptor> writers;
+  for ( size_t i = 0; i < fds; i++ ) {
+    array<int, 2> pair {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, pair.data() ) );
+    readers.emplace_back( pair[0] );
+    writers.emplace_back( pair[1] );
+  }
+
+  EventLoop loop { backend };
+  const size_t category = loop.add_category( "read" ); // (one category: there can only be 64)
+  size_t served = 0;
+  string buffer;
+  for ( auto& reader : readers ) {
+    loop.add_rule( category, reader, Direction::In, [&] {
+      reader.read( buffer );
+      served++;
+    } );
+  }
+
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < ROUNDS; round++ ) {
+    // spread each round's events over the whole set
+    for ( size_t i = 0; i < READY; i++ ) {
+      writers[( round * READY + i ) * 7919 % fds].write( "x" );
+    }
+    const size_t goal = served + READY;
+    while ( served < goal ) {
+      if ( loop.wait_next_event( -1 ) != EventLoop::Result::Success ) {
+        throw runtime_error( "EventLoop stopped before serving every event" );
+      }
+    }
+  }
+  const auto elapsed = steady_clock::now() - start_time;
+
+  return static_cast<double>( duration_cast<nanoseconds>( elapsed ).count() ) / static_cast<double>( served );
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  for ( const size_t fds : { 10, 100, 500 } ) {
+    const double poll_ns = ns_per_event( EventLoop::Backend::Poll, fds );
+    const double epoll_ns = ns_per_event( EventLoop::Backend::Epoll, fds );
+
+    cout << "EventLoop with " << fds << " fds (" << READY << " ready at once): poll " << fixed << setprecision( 0 )
+         << poll_ns << " ns/event, epoll " << epoll_ns << " ns/event (" << setprecision( 2 ) << poll_ns / epoll_ns
+         << "x).\n";
+
+    debug_output << "      " << setw( 4 ) << fds << " fds: poll " << fixed << setprecision( 0 ) << setw( 6 )
+                 << poll_ns << " ns/event, epoll " << setw( 6 ) << epoll_ns << " ns/event\n";
+
+    // poll(2) scans every fd for each event it serves, so with many idle fds epoll has to win
+    if ( fds >= 100 and epoll_ns > poll_ns ) {
+      throw runtime_error( "epoll backend is slower than poll with many fds" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
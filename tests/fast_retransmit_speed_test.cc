@@ -0,0 +1,156 @@
+#include "byte_stream.hh"
+#include "lossy_link.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+enum class Recovery : uint8_t
+{
+  TimeoutOnly,    // every loss waits for the retransmission timer
+  FastRetransmit, // duplicate ACKs and NewReno partial ACKs
+  SACK,           // the SACK scoreboard, for comparison
+};
+
+struct TransferResult
+{
+  double simulated_seconds;      // time to complete the transfer
+  double retransmitted_fraction; // payload bytes sent more than once, over bytes delivered
+  uint64_t timeouts;             // retransmission timer expirations
+};
+
+// Send `data` from a TCPSender to a TCPReceiver over a 100 Mbit/s, 20 ms RTT path that drops segments (in
+// both directions) at `loss_rate`
+TransferResult transfer( const Recovery recovery, const string& data, const double loss_rate )
+{
+  constexpr uint64_t delay_ms = 10;
+  constexpr double bytes_per_ms = 12500;
+  constexpr uint64_t queue_limit = 250'000;
+
+  TCPConfig config;
+  config.isn = Wrap32 { 0 };
+  config.fast_retransmit = recovery != Recovery::TimeoutOnly;
+
+  TCPSender sender { ByteStream { 1 << 20 }, config };
+  TCPReceiver receiver { Reassembler { ByteStream { 1 << 20 } }, TCPConfig::MAX_WINDOW };
+  LossyLink<TCPSenderMessage> data_link { delay_ms, loss_rate, 1370 };
+  LossyLink<TCPReceiverMessage> ack_link { delay_ms, loss_rate, 1371 };
+  data_link.set_bottleneck( bytes_per_ms, queue_limit );
+
+  uint64_t now = 0;
+  uint64_t payload_bytes_sent = 0;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    payload_bytes_sent += msg.payload.size();
+    data_link.send( msg, now, msg.sequence_length() + TCPConfig::HEADERS_LEN + TCPConfig::TIMESTAMPS_LEN );
+  };
+  uint64_t timeouts = 0;
+  const auto retransmit = [&]( const TCPSenderMessage& msg ) {
+    timeouts++;
+    transmit( msg );
+  };
+
+  size_t bytes_written = 0;
+  uint64_t bytes_read = 0;
+  bool intact = true;
+
+  while ( not receiver.reader().is_finished() ) {
+    const size_t len = min( data.size() - bytes_written, sender.writer().available_capacity() );
+    sender.writer().push( data.substr( bytes_written, len ) );
+    bytes_written += len;
+    if ( bytes_written == data.size() ) {
+      sender.writer().close();
+    }
+    sender.push( transmit );
+
+    data_link.deliver( now, [&]( TCPSenderMessage msg ) {
+      receiver.receive( std::move( msg ) );
+      Reader& reader = receiver.reader();
+      while ( reader.bytes_buffered() ) {
+        const string_view chunk = reader.peek();
+        intact &= chunk == string_view { data }.substr( bytes_read, chunk.size() );
+        bytes_read += chunk.size();
+        reader.pop( chunk.size() );
+      }
+      TCPReceiverMessage ack = receiver.send();
+      if ( recovery != Recovery::SACK ) {
+        ack.sack_blocks.clear();
+      }
+      ack_link.send( ack, now );
+    } );
+    ack_link.deliver( now, [&]( const TCPReceiverMessage& ack ) {
+      sender.receive( ack );
+      sender.push( transmit );
+    } );
+
+    sender.tick( 1, retransmit );
+    ++now;
+  }
+
+  if ( not intact or bytes_read != data.size() ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  return { static_cast<double>( now ) / 1000,
+           static_cast<double>( payload_bytes_sent ) / static_cast<double>( data.size() ) - 1,
+           timeouts };
+}
+
+void program_body()
+{
+  constexpr size_t input_len = 100e6;
+  constexpr double loss_rate = 0.01;
+
+  const string data = [] {
+    default_random_engine rd { 1370 };
+    uniform_int_distribution<char> ud;
+    string ret( input_len, 0 );
+    for ( auto& c : ret ) {
+      c = ud( rd );
+    }
+    return ret;
+  }();
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  double timeout_only_seconds = 0;
+  for ( const auto& [recovery, name] : { pair { Recovery::TimeoutOnly, "timeouts only" },
+                                         pair { Recovery::FastRetransmit, "fast retransmit + NewReno" },
+                                         pair { Recovery::SACK, "SACK" } } ) {
+    const auto result = transfer( recovery, data, loss_rate );
+
+    cout << "100 MB over a 100 Mbit/s, 20 ms RTT link with 1% loss, " << name << ": " << fixed
+         << setprecision( 1 ) << result.simulated_seconds << " s (" << setprecision( 2 )
+         << 8 * input_len / result.simulated_seconds / 1e6 << " Mbit/s), " << result.retransmitted_fraction * 100
+         << "% resent, " << result.timeouts << " timeouts.\n";
+
+    debug_output << "      " << setw( 26 ) << name << ": " << fixed << setprecision( 1 ) << setw( 6 )
+                 << result.simulated_seconds << " s, " << setw( 4 ) << result.timeouts << " timeouts\n";
+
+    if ( recovery == Recovery::TimeoutOnly ) {
+      timeout_only_seconds = result.simulated_seconds;
+    } else if ( result.simulated_seconds > timeout_only_seconds ) {
+      throw runtime_error( "fast recovery made a lossy transfer slower" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,319 @@
+#include "address.hh"
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+#include "test_should_be.hh"
+#include "tuntap_adapter.hh"
+
+#include <array>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+pair<FileDescriptor, FileDescriptor> make_pair_of_sockets()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+// Wait (a while) for the ring to have completions
+void wait_for( const FileDescriptor& ring )
+{
+  pollfd pfd { ring.fd_num(), POLLIN, 0 };
+  CheckSystemCall( "poll", ::poll( &pfd, 1, 1000 ) );
+}
+
+// Datagrams come out of the ring as they went into the socket, split as FileDescriptor::read() splits them
+void read_test()
+{
+  auto [ours, theirs] = make_pair_of_sockets();
+  IOUringFD ring { std::move( ours ), 4 };
+  for ( int i = 0; i < 10; i++ ) {
+    theirs.write( "datagram " + to_string( i ) );
+  }
+
+  vector<string> read;
+  vector<string> buffers;
+  while ( read.size() < 10 ) {
+    wait_for( ring.watch_fd() );
+    while ( true ) {
+      buffers.assign( { string( 4, '\0' ), string {} } );
+      ring.read( buffers );
+      if ( buffers.empty() ) {
+        break;
+      }
+      // the first buffer gets as much as it holds
+      test_should_be( buffers.size() == 2 and buffers[0] == "data", true );
+      read.push_back( buffers[0] + buffers[1] );
+    }
+  }
+  for ( int i = 0; i < 10; i++ ) {
+    // datagrams are read in order (more than the depth)
+    test_should_be( read.at( i ) == "datagram " + to_string( i ), true );
+  }
+}
+
+// Writes are queued until submitted, and then arrive in order
+void write_test()
+{
+  auto [ours, theirs] = make_pair_of_sockets();
+  theirs.set_blocking( false );
+  IOUringFD ring { std::move( ours ), 4 };
+
+  for ( int i = 0; i < 3; i++ ) {
+    // a write is queued
+    test_should_be( ring.write( "datagram " + to_string( i ) ) == 10, true );
+  }
+  string buffer;
+  theirs.read( buffer );
+  // and not sent before it is submitted
+  test_should_be( buffer.empty(), true );
+
+  ring.submit();
+  for ( int i = 0; i < 3; i++ ) {
+    buffer.clear();
+    theirs.read( buffer );
+    // then it is sent
+    test_should_be( buffer == "datagram " + to_string( i ), true );
+  }
+  // without errors
+  test_should_be( ring.write_errors() == 0, true );
+}
+
+// A peer that never reads: its socket fills, the writes wait in flight, and then there's no more room
+void full_test()
+{
+  auto [ours, theirs] = make_pair_of_sockets();
+  theirs.set_blocking( false );
+  size_t written = 0;
+  {
+    IOUringFD ring { std::move( ours ), 4 };
+    while ( written < 1000 and ring.write( to_string( written ) ) > 0 ) {
+      ring.submit();
+      written++;
+    }
+    // writes are dropped once every buffer is in flight
+    test_should_be( written < 1000, true );
+  } // (and the writes still in flight are cancelled)
+
+  string buffer;
+  size_t received = 0;
+  while ( ( theirs.read( buffer ), not buffer.empty() ) ) {
+    // what was sent arrived in order
+    test_should_be( buffer == to_string( received ), true );
+    received++;
+    buffer.clear();
+  }
+  // and some of it arrived
+  test_should_be( received > 0 and received <= written, true );
+}
+
+// An EventLoop rule on the ring serves the datagrams that have arrived
+void eventloop_test( const EventLoop::Backend backend )
+{
+  auto [ours, theirs] = make_pair_of_sockets();
+  IOUringFD ring { std::move( ours ) };
+  EventLoop loop { backend };
+  vector<string> buffers;
+  size_t received = 0;
+  loop.add_rule( "datagrams", ring.watch_fd(), Direction::In, [&] {
+    while ( ( buffers.assign( 1, {} ), ring.read( buffers ), not buffers.empty() ) ) {
+      received++;
+    }
+  } );
+
+  for ( int i = 0; i < 100; i++ ) {
+    theirs.write( "x" );
+  }
+  for ( int i = 0; i < 100 and received < 100; i++ ) {
+    loop.wait_next_event( 10 );
+  }
+  // every datagram is served
+  test_should_be( received == 100, true );
+  // and then nothing is ready
+  test_should_be( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, true );
+}
+
+// A long run of datagrams, arriving while the EventLoop waits and echoed through the ring: the completions,
+// which arrive as task work, don't interrupt the wait (or if they do, it waits again)
+void busy_eventloop_test( const EventLoop::Backend backend )
+{
+  constexpr size_t datagrams = 20000;
+  auto [ours, theirs] = make_pair_of_sockets();
+  IOUringFD ring { std::move( ours ) };
+  EventLoop loop { backend };
+  vector<string> buffers;
+  size_t received = 0;
+  loop.add_rule( "echo", ring.watch_fd(), Direction::In, [&] {
+    while ( ( buffers.assign( 1, {} ), ring.read( buffers ), not buffers.empty() ) ) {
+      received++;
+      ring.write( buffers );
+    }
+    ring.submit();
+  } );
+
+  theirs.set_blocking( false );
+  thread writer { [&theirs] {
+    string echo;
+    for ( size_t i = 0; i < datagrams; i++ ) {
+      while ( theirs.write( to_string( i ) ) == 0 ) {
+        this_thread::sleep_for( chrono::microseconds { 100 } );
+      }
+      theirs.read( echo ); // (drain the echoes, or the ring's writes would wait in flight for room)
+      if ( i % 1000 == 0 ) {
+        this_thread::sleep_for( chrono::milliseconds { 5 } );
+      }
+    }
+  } };
+
+  const auto deadline = chrono::steady_clock::now() + chrono::seconds { 10 };
+  try {
+    while ( received < datagrams and chrono::steady_clock::now() < deadline ) {
+      loop.wait_next_event( 100 );
+    }
+  } catch ( ... ) {
+    writer.join();
+    throw;
+  }
+  writer.join();
+  // every datagram is served, however long the loop runs
+  test_should_be( received == datagrams, true );
+}
+
+// A TCPOverIPv4OverTunFdAdapter reads every segment that has arrived (skipping those for other connections),
+// so that with a ring, none is left waiting once the ring's fd is no longer readable
+void adapter_test( const DatagramIO io )
+{
+  auto [ours, theirs] = make_pair_of_sockets();
+  TCPOverIPv4OverTunFdAdapter receiver { std::move( ours ), io };
+  TCPOverIPv4OverTunFdAdapter sender { std::move( theirs ) };
+  receiver.config_mut().source = Address { "10.0.0.2", 80 };
+  receiver.config_mut().destination = Address { "10.0.0.1", 1000 };
+  sender.config_mut().source = Address { "10.0.0.1", 1000 };
+
+  for ( uint32_t i = 0; i < 10; i++ ) {
+    sender.config_mut().destination = Address { "10.0.0.2", static_cast<uint16_t>( i == 5 ? 81 : 80 ) };
+    TCPMessage msg;
+    msg.sender.seqno = Wrap32 { i };
+    msg.sender.payload = "segment " + to_string( i );
+    sender.write( msg );
+  }
+
+  EventLoop loop;
+  vector<uint64_t> seqnos;
+  loop.add_rule( "segments", receiver.watch_fd(), Direction::In, [&] {
+    while ( auto msg = receiver.read() ) {
+      seqnos.push_back( msg->sender.seqno.unwrap( Wrap32 { 0 }, 0 ) );
+    }
+  } );
+  for ( int i = 0; i < 10 and seqnos.size() < 9; i++ ) {
+    loop.wait_next_event( 10 );
+  }
+
+  // every segment for it is read
+  test_should_be( seqnos == ( vector<uint64_t> { 0, 1, 2, 3, 4, 6, 7, 8, 9 } ), true );
+  // and then nothing is ready
+  test_should_be( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, true );
+}
+
+// Two stacks, one reading and writing through a ring and one with system calls, can talk
+void tcp_stack_test()
+{
+  auto [client_fd, server_fd] = make_pair_of_sockets();
+  TCPStack client { std::move( client_fd ), DatagramIO::IOUring };
+  TCPStack server { std::move( server_fd ), DatagramIO::Syscalls };
+  // each does as it's asked
+  test_should_be( client.io() == DatagramIO::IOUring and server.io() == DatagramIO::Syscalls, true );
+
+  TCPConfig config;
+  config.rt_timeout = 10;
+  server.listen( config, Address { "10.0.0.2", 80 } );
+  const auto echo = [&]( TCPStack::Connection& connection ) {
+    Reader& inbound = connection.peer.inbound_reader();
+    while ( inbound.bytes_buffered() ) {
+      connection.peer.outbound_writer().push( string { inbound.peek() } );
+      inbound.pop( inbound.peek().size() );
+    }
+    if ( inbound.is_finished() ) {
+      connection.peer.outbound_writer().close();
+    }
+    server.push( connection );
+  };
+  server.set_handler( echo );
+  server.set_accept_handler( [&]( uint16_t port ) {
+    while ( TCPStack::Connection* connection = server.accept( port ) ) {
+      echo( *connection );
+    }
+  } );
+
+  map<uint16_t, string> echoed;
+  client.set_handler( [&]( TCPStack::Connection& connection ) {
+    Reader& inbound = connection.peer.inbound_reader();
+    while ( inbound.bytes_buffered() ) {
+      echoed[connection.tuple.local_port] += inbound.peek();
+      inbound.pop( inbound.peek().size() );
+    }
+  } );
+  for ( uint16_t port = 1000; port < 1010; port++ ) {
+    TCPStack::Connection& connection
+      = client.connect( config, Address { "10.0.0.1", port }, Address { "10.0.0.2", 80 } );
+    connection.peer.outbound_writer().push( "hello from " + to_string( port ) );
+    connection.peer.outbound_writer().close();
+    client.push( connection );
+  }
+
+  EventLoop loop;
+  loop.add_rule( "client", client.watch_fd(), Direction::In, [&] { client.receive(); } );
+  loop.add_rule( "server", server.watch_fd(), Direction::In, [&] { server.receive(); } );
+  for ( int ms = 0; ms < 1000 and ( client.size() > 0 or server.size() > 0 ); ms++ ) {
+    loop.wait_next_event( 1 );
+    client.tick( 1 );
+    server.tick( 1 );
+  }
+
+  for ( uint16_t port = 1000; port < 1010; port++ ) {
+    // each connection gets its own bytes back
+    test_should_be( echoed[port] == "hello from " + to_string( port ), true );
+  }
+  // and every connection finishes
+  test_should_be( client.size() == 0 and server.size() == 0, true );
+}
+} // namespace
+
+int main()
+{
+  try {
+    if ( not IOUringFD::available() ) {
+      cout << "io_uring isn't available here: nothing to test\n";
+      return EXIT_SUCCESS;
+    }
+    read_test();
+    write_test();
+    full_test();
+    eventloop_test( EventLoop::Backend::Poll );
+    eventloop_test( EventLoop::Backend::Epoll );
+    busy_eventloop_test( EventLoop::Backend::Poll );
+    busy_eventloop_test( EventLoop::Backend::Epoll );
+    adapter_test( DatagramIO::Syscalls );
+    adapter_test( DatagramIO::IOUring );
+    tcp_stack_test();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
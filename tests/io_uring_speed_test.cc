@@ -0,0 +1,269 @@
+#include "address.hh"
+#include "eventloop.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+struct EchoResult
+{
+  double datagrams_per_second; // sent by either end
+  double syscalls_per_datagram;
+};
+
+constexpr size_t BURST = 32;     // datagrams sent at once
+constexpr size_t ROUNDS = 2'000; // bursts sent and echoed
+constexpr size_t TRIALS = 3;     // of each, alternating; the best counts (the machine may be busy)
+
+// One end of an AF_UNIX datagram socketpair sends a burst, the other echoes each datagram back, and the first
+// waits for every echo before the next burst. Both ends are served by one EventLoop that polls their fds.
+EchoResult echo( const DatagramIO io )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  FileDescriptor sender { fds[0] };
+  FileDescriptor echoer { fds[1] };
+  const string payload( 1400, 'x' );
+
+  EventLoop loop { EventLoop::Backend::Poll };
+  vector<string> buffers;
+  size_t received = 0;
+  size_t waits = 0;
+  const auto run = [&]( auto& s, const auto& flush ) {
+    const auto start_time = steady_clock::now();
+    for ( size_t round = 0; round < ROUNDS; round++ ) {
+      for ( size_t i = 0; i < BURST; i++ ) {
+        s.write( payload );
+      }
+      flush( s );
+      while ( received < ( round + 1 ) * BURST ) {
+        loop.wait_next_event( 100 );
+        waits++;
+      }
+    }
+    return 2 * static_cast<double>( ROUNDS * BURST )
+           / duration_cast<duration<double>>( steady_clock::now() - start_time ).count();
+  };
+
+  if ( io == DatagramIO::IOUring ) {
+    IOUringFD s { std::move( sender ) };
+    IOUringFD e { std::move( echoer ) };
+    loop.add_rule( "echo", e.watch_fd(), Direction::In, [&] {
+      while ( ( buffers.assign( 1, {} ), e.read( buffers ), not buffers.empty() ) ) {
+        e.write( buffers );
+      }
+      e.submit();
+    } );
+    loop.add_rule( "receive", s.watch_fd(), Direction::In, [&] {
+      while ( ( buffers.assign( 1, {} ), s.read( buffers ), not buffers.empty() ) ) {
+        received++;
+      }
+    } );
+    const double pps = run( s, []( IOUringFD& fd ) { fd.submit(); } );
+    return { pps, static_cast<double>( waits + s.submits() + e.submits() ) / ( 2 * ROUNDS * BURST ) };
+  }
+
+  // poll, then one read() per datagram (and a write() per echo)
+  loop.add_rule( "echo", echoer, Direction::In, [&] {
+    buffers.assign( 1, {} );
+    echoer.read( buffers );
+    echoer.write( buffers );
+  } );
+  loop.add_rule( "receive", sender, Direction::In, [&] {
+    buffers.assign( 1, {} );
+    sender.read( buffers );
+    received++;
+  } );
+  const double pps = run( sender, []( FileDescriptor& ) {} );
+  const auto syscalls
+    = waits + sender.read_count() + sender.write_count() + echoer.read_count() + echoer.write_count();
+  return { pps, static_cast<double>( syscalls ) / ( 2 * ROUNDS * BURST ) };
+}
+
+// `connections` clients each send `total / connections` bytes to one server port. The two TCPStacks, run by
+// this one thread with an EventLoop that polls their fds, are connected by an AF_UNIX datagram socketpair that
+// stands in for the TUN device. Returns the datagrams sent by either stack per second.
+double packets_per_second( const DatagramIO io, const size_t connections, const string& data )
+{
+  constexpr int socket_buffer = 4 << 20;
+  const size_t per_connection = data.size() / connections;
+
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  for ( const int fd : fds ) {
+    CheckSystemCall( "setsockopt",
+                     ::setsockopt( fd, SOL_SOCKET, SO_SNDBUF, &socket_buffer, sizeof( socket_buffer ) ) );
+  }
+  TCPStack client { FileDescriptor { fds[0] }, io };
+  TCPStack server { FileDescriptor { fds[1] }, io };
+
+  TCPConfig config;
+  config.rt_timeout = 10;
+  config.rto_min = 10;
+
+  // the server reads everything, and closes its end when the client has
+  uint64_t bytes_read = 0;
+  size_t finished = 0;
+  server.listen( config, Address { "10.144.0.2", 80 }, connections );
+  const auto read_and_close = [&]( TCPStack::Connection& connection ) {
+    Reader& inbound = connection.peer.inbound_reader();
+    while ( inbound.bytes_buffered() ) {
+      const auto chunk = inbound.peek();
+      bytes_read += chunk.size();
+      inbound.pop( chunk.size() );
+    }
+    if ( inbound.is_finished() and not connection.peer.outbound_writer().is_closed() ) {
+      connection.peer.outbound_writer().close();
+      server.push( connection );
+      finished++;
+    }
+  };
+  server.set_handler( read_and_close );
+  server.set_accept_handler( [&]( uint16_t port ) {
+    while ( TCPStack::Connection* connection = server.accept( port ) ) {
+      read_and_close( *connection );
+    }
+  } );
+
+  // each client writes its share as the window opens
+  unordered_map<uint16_t, size_t> written;
+  const auto write_more = [&]( TCPStack::Connection& connection ) {
+    Writer& outbound = connection.peer.outbound_writer();
+    size_t& done = written[connection.tuple.local_port];
+    if ( outbound.is_closed() ) {
+      return;
+    }
+    const size_t len = min( per_connection - done, outbound.available_capacity() );
+    outbound.push( data.substr( done, len ) );
+    done += len;
+    if ( done == per_connection ) {
+      outbound.close();
+    }
+    client.push( connection );
+  };
+  client.set_handler( write_more );
+
+  EventLoop loop { EventLoop::Backend::Poll };
+  loop.add_rule( "client", client.watch_fd(), Direction::In, [&] { client.receive(); } );
+  loop.add_rule( "server", server.watch_fd(), Direction::In, [&] { server.receive(); } );
+
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < connections; i++ ) {
+    const Address local { "10.144.0.1", static_cast<uint16_t>( 1024 + i ) };
+    write_more( client.connect( config, local, Address { "10.144.0.2", 80 } ) );
+  }
+
+  auto last_tick = start_time;
+  while ( finished < connections ) {
+    loop.wait_next_event( 1 );
+    const auto ms = duration_cast<milliseconds>( steady_clock::now() - last_tick ).count();
+    if ( ms > 0 ) {
+      client.tick( ms );
+      server.tick( ms );
+      last_tick += milliseconds { ms };
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( bytes_read != per_connection * connections or client.io() != io ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const auto elapsed = duration_cast<duration<double>>( stop_time - start_time ).count();
+  return static_cast<double>( client.stats().datagrams_sent + server.stats().datagrams_sent ) / elapsed;
+}
+
+void program_body()
+{
+  if ( not IOUringFD::available() ) {
+    cout << "io_uring isn't available here: nothing to compare.\n";
+    return;
+  }
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  EchoResult poll_echo {};
+  EchoResult uring_echo {};
+  for ( size_t trial = 0; trial < TRIALS; trial++ ) {
+    for ( auto [io, best] :
+          { pair { DatagramIO::Syscalls, &poll_echo }, pair { DatagramIO::IOUring, &uring_echo } } ) {
+      const auto result = echo( io );
+      if ( result.datagrams_per_second > best->datagrams_per_second ) {
+        *best = result;
+      }
+    }
+  }
+  cout << "Echoing bursts of " << BURST << " datagrams: poll + read + write " << fixed << setprecision( 0 )
+       << poll_echo.datagrams_per_second / 1000 << "k datagrams/s with " << setprecision( 2 )
+       << poll_echo.syscalls_per_datagram << " system calls each, io_uring " << setprecision( 0 )
+       << uring_echo.datagrams_per_second / 1000 << "k datagrams/s with " << setprecision( 2 )
+       << uring_echo.syscalls_per_datagram << " ("
+       << uring_echo.datagrams_per_second / poll_echo.datagrams_per_second << "x the datagrams/s).\n";
+  debug_output << "      echo: poll " << fixed << setprecision( 0 ) << setw( 4 )
+               << poll_echo.datagrams_per_second / 1000 << "k pps, " << setprecision( 2 )
+               << poll_echo.syscalls_per_datagram << " syscalls/datagram; io_uring " << setprecision( 0 )
+               << setw( 4 ) << uring_echo.datagrams_per_second / 1000 << "k pps, " << setprecision( 2 )
+               << uring_echo.syscalls_per_datagram << " syscalls/datagram\n";
+
+  // the point of the ring: a system call per batch, not three per datagram (on this loopback, that doesn't make
+  // it faster than poll, so the datagrams/s are only guarded against a collapse)
+  if ( uring_echo.syscalls_per_datagram > poll_echo.syscalls_per_datagram / 4 ) {
+    throw runtime_error( "io_uring didn't batch the system calls" );
+  }
+  if ( uring_echo.datagrams_per_second < 0.3 * poll_echo.datagrams_per_second ) {
+    throw runtime_error( "io_uring was far slower than poll + read + write" );
+  }
+
+  const string data( 16 << 20, 'x' );
+  for ( const size_t connections : { 1, 64 } ) {
+    double poll_pps = 0;
+    double uring_pps = 0;
+    for ( size_t trial = 0; trial < TRIALS; trial++ ) {
+      poll_pps = max( poll_pps, packets_per_second( DatagramIO::Syscalls, connections, data ) );
+      uring_pps = max( uring_pps, packets_per_second( DatagramIO::IOUring, connections, data ) );
+    }
+
+    cout << "16 MiB over " << connections << " connection" << ( connections == 1 ? "" : "s" )
+         << " between two TCPStacks: poll + read + writev " << fixed << setprecision( 0 ) << poll_pps / 1000
+         << "k datagrams/s, io_uring " << uring_pps / 1000 << "k datagrams/s (" << setprecision( 2 )
+         << uring_pps / poll_pps << "x).\n";
+
+    debug_output << "      " << setw( 2 ) << connections << " connections: poll " << fixed << setprecision( 0 )
+                 << setw( 4 ) << poll_pps / 1000 << "k pps, io_uring " << setw( 4 ) << uring_pps / 1000
+                 << "k pps\n";
+
+    if ( uring_pps < 0.3 * poll_pps ) {
+      throw runtime_error( "a TCPStack on io_uring was far slower than on poll + read + writev" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
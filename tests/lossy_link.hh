@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <utility>
+
+// A one-way, in-process link for benchmarks, driven by simulated time. Each message is delivered
+// `delay_ms` after it was sent, unless it is dropped (independently, with probability `loss_rate`).
+// The link can also be made a bottleneck with a drop-tail queue (see set_bottleneck()), and can drop
+// messages too big for some hop on the path (see set_mtu()).
+template<class Message>
+class LossyLink
+{
+  uint64_t delay_ms_;
+  std::bernoulli_distribution drop_;
+  std::default_random_engine rd_;
+  std::queue<std::pair<uint64_t, Message>> in_flight_ {}; // (delivery time, message)
+  uint64_t sent_ {};
+  uint64_t dropped_ {};
+
+  double bytes_per_ms_ {}; // 0 if the link isn't a bottleneck
+  uint64_t queue_limit_ {};
+  double busy_until_ {}; // when the last queued message will have been serialized
+  uint64_t queue_drops_ {};
+
+  uint64_t mtu_ {}; // 0 if any size gets through
+  uint64_t mtu_drops_ {};
+
+public:
+  LossyLink( uint64_t delay_ms, double loss_rate, uint64_t random_seed )
+    : delay_ms_( delay_ms ), drop_( loss_rate ), rd_( random_seed )
+  {}
+
+  // Serialize messages at `bytes_per_ms`, and drop any that would find more than `queue_limit` bytes
+  // waiting ahead of them
+  void set_bottleneck( double bytes_per_ms, uint64_t queue_limit )
+  {
+    bytes_per_ms_ = bytes_per_ms;
+    queue_limit_ = queue_limit;
+  }
+
+  // Silently drop every message bigger than `mtu` bytes
+  void set_mtu( uint64_t mtu ) { mtu_ = mtu; }
+
+  // `size` is only needed if the link is a bottleneck or has an MTU
+  void send( const Message& msg, uint64_t now_ms, uint64_t size = 0 )
+  {
+    sent_++;
+    if ( mtu_ > 0 and size > mtu_ ) {
+      dropped_++;
+      mtu_drops_++;
+      return;
+    }
+    uint64_t delivery_time = now_ms + delay_ms_;
+    if ( bytes_per_ms_ > 0 ) {
+      const double now = static_cast<double>( now_ms );
+      if ( ( busy_until_ - now ) * bytes_per_ms_ > static_cast<double>( queue_limit_ ) ) {
+        dropped_++;
+        queue_drops_++;
+        return;
+      }
+      busy_until_ = std::max( busy_until_, now ) + static_cast<double>( size ) / bytes_per_ms_;
+      delivery_time = static_cast<uint64_t>( std::ceil( busy_until_ ) ) + delay_ms_;
+    }
+    if ( drop_( rd_ ) ) {
+      dropped_++;
+      return;
+    }
+    in_flight_.emplace( delivery_time, msg );
+  }
+
+  // Hand every message due by `now_ms` to `receive`
+  template<class Receive>
+  void deliver( uint64_t now_ms, Receive&& receive )
+  {
+    while ( not in_flight_.empty() and in_flight_.front().first <= now_ms ) {
+      Message msg = std::move( in_flight_.front().second );
+      in_flight_.pop();
+      receive( std::move( msg ) );
+    }
+  }
+
+  uint64_t sent() const { return sent_; }
+  uint64_t dropped() const { return dropped_; }
+  uint64_t queue_drops() const { return queue_drops_; }
+  uint64_t mtu_drops() const { return mtu_drops_; }
+};
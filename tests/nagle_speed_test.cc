@@ -0,0 +1,152 @@
+#include "lossy_link.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+// An application writing `write_size` bytes at a time, `writes_per_ms` times every `interval_ms`
+struct Workload
+{
+  string name;
+  size_t write_size;
+  uint64_t writes_per_ms;
+  uint64_t interval_ms;
+  size_t total_bytes;
+};
+
+struct TransferResult
+{
+  double packets_per_kilobyte;   // segments sent in both directions, per KB delivered
+  double data_bytes_per_segment; // payload bytes per segment from the writer
+  double mean_latency_ms;        // from a write to its delivery to the reading application
+};
+
+// Send the workload from one TCPPeer to another over a 20 ms RTT path. The application's writes are each
+// followed by a push(), as in TCPMinnowSocket. With autocork, each simulated millisecond is an iteration of
+// the event loop: the writer is corked while it runs, and uncorked and pushed at its end.
+TransferResult transfer( const Workload& workload, const bool nodelay, const bool autocork )
+{
+  constexpr uint64_t delay_ms = 10;
+
+  TCPConfig config;
+  config.nodelay = nodelay;
+  config.autocork = autocork;
+  TCPPeer writer { config };
+  TCPPeer reader { config };
+
+  LossyLink<TCPMessage> data_link { delay_ms, 0, 1 };
+  LossyLink<TCPMessage> ack_link { delay_ms, 0, 2 };
+
+  uint64_t now = 0;
+  const auto send_data = [&]( const TCPMessage& msg ) { data_link.send( msg, now ); };
+  const auto send_ack = [&]( const TCPMessage& msg ) { ack_link.send( msg, now ); };
+
+  const string chunk( workload.write_size, 'x' );
+  const uint64_t writes = workload.total_bytes / workload.write_size;
+  uint64_t written = 0;
+  uint64_t bytes_read = 0;
+  uint64_t latency_sum = 0;
+  vector<uint64_t> write_times;
+
+  writer.push( send_data ); // SYN
+  while ( not reader.inbound_reader().is_finished() ) {
+    if ( autocork ) {
+      writer.set_corked( true );
+    }
+    if ( writer.has_ackno() and now % workload.interval_ms == 0 ) {
+      for ( uint64_t i = 0; i < workload.writes_per_ms and written < writes; i++ ) {
+        if ( writer.outbound_writer().available_capacity() < chunk.size() ) {
+          break;
+        }
+        writer.outbound_writer().push( chunk );
+        write_times.push_back( now );
+        if ( ++written == writes ) {
+          writer.outbound_writer().close();
+        }
+        writer.push( send_data );
+      }
+    }
+
+    data_link.deliver( now, [&]( TCPMessage msg ) {
+      reader.receive( std::move( msg ), send_ack );
+      Reader& inbound = reader.inbound_reader();
+      const uint64_t first_write = bytes_read / workload.write_size;
+      bytes_read += inbound.bytes_buffered();
+      inbound.pop( inbound.bytes_buffered() );
+      for ( uint64_t i = first_write; i < bytes_read / workload.write_size; i++ ) {
+        latency_sum += now - write_times.at( i );
+      }
+    } );
+    ack_link.deliver( now, [&]( TCPMessage msg ) { writer.receive( std::move( msg ), send_data ); } );
+
+    if ( autocork ) {
+      writer.set_corked( false );
+      writer.push( send_data );
+    }
+    writer.tick( 1, send_data );
+    reader.tick( 1, send_ack );
+    ++now;
+  }
+
+  if ( bytes_read != writes * workload.write_size ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const double kilobytes = static_cast<double>( bytes_read ) / 1024;
+  const uint64_t segments = writer.stats().segments_sent + reader.stats().segments_sent;
+  const uint64_t data_segments = writer.stats().segments_sent - writer.stats().pure_acks_sent;
+  return { static_cast<double>( segments ) / kilobytes,
+           static_cast<double>( bytes_read ) / static_cast<double>( data_segments ),
+           static_cast<double>( latency_sum ) / static_cast<double>( writes ) };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  for ( const auto& workload : { Workload { "interactive (20 B every 5 ms)", 20, 1, 5, 40'000 },
+                                 Workload { "chatty (10 x 20 B every 5 ms)", 20, 10, 5, 400'000 },
+                                 Workload { "bulk (100 B writes, 10 MB/s)", 100, 100, 1, 5'000'000 } } ) {
+    double nodelay_packets = 0;
+    for ( const auto& [nodelay, autocork, mode] : { tuple { true, false, "TCP_NODELAY" },
+                                                    tuple { false, false, "Nagle" },
+                                                    tuple { true, true, "TCP_NODELAY + autocork" },
+                                                    tuple { false, true, "Nagle + autocork" } } ) {
+      const auto result = transfer( workload, nodelay, autocork );
+
+      cout << workload.name << ", " << mode << ": " << fixed << setprecision( 2 ) << result.packets_per_kilobyte
+           << " packets/KB, " << setprecision( 0 ) << result.data_bytes_per_segment << " bytes per data segment, "
+           << setprecision( 1 ) << result.mean_latency_ms << " ms mean latency.\n";
+
+      debug_output << "      " << setw( 29 ) << workload.name << ", " << setw( 22 ) << mode << ": " << fixed
+                   << setprecision( 2 ) << setw( 6 ) << result.packets_per_kilobyte << " packets/KB, "
+                   << setprecision( 1 ) << setw( 5 ) << result.mean_latency_ms << " ms latency\n";
+
+      if ( nodelay and not autocork ) {
+        nodelay_packets = result.packets_per_kilobyte;
+      } else if ( result.packets_per_kilobyte > nodelay_packets ) {
+        throw runtime_error( "coalescing sent more packets than TCP_NODELAY" );
+      }
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+#include "byte_stream.hh"
+#include "lossy_link.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+struct TransferResult
+{
+  double simulated_megabits_per_second; // goodput over the simulated link
+  uint64_t queue_drops;                 // segments that found the bottleneck queue full
+  uint64_t largest_burst;               // most bytes the sender sent in one millisecond
+};
+
+// Send `data` from a TCPSender to a TCPReceiver over a 100 Mbit/s, 40 ms RTT path whose bottleneck queue
+// holds only 2 ms of traffic
+TransferResult transfer( const bool pacing, const string& data )
+{
+  constexpr uint64_t delay_ms = 20;
+  constexpr double bytes_per_ms = 12500;
+  constexpr uint64_t queue_limit = 25'000;
+
+  TCPConfig config;
+  config.isn = Wrap32 { 0 };
+  config.pacing = pacing;
+
+  TCPSender sender { ByteStream { 1 << 20 }, config };
+  TCPReceiver receiver { Reassembler { ByteStream { 1 << 20 } }, TCPConfig::MAX_WINDOW };
+  LossyLink<TCPSenderMessage> data_link { delay_ms, 0, 1370 };
+  LossyLink<TCPReceiverMessage> ack_link { delay_ms, 0, 1371 };
+  data_link.set_bottleneck( bytes_per_ms, queue_limit );
+
+  uint64_t now = 0;
+  uint64_t sent_this_ms = 0;
+  uint64_t largest_burst = 0;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    const uint64_t size = msg.sequence_length() + TCPConfig::HEADERS_LEN + TCPConfig::TIMESTAMPS_LEN;
+    sent_this_ms += size;
+    data_link.send( msg, now, size );
+  };
+
+  size_t bytes_written = 0;
+  uint64_t bytes_read = 0;
+  bool intact = true;
+
+  while ( not receiver.reader().is_finished() ) {
+    const size_t len = min( data.size() - bytes_written, sender.writer().available_capacity() );
+    sender.writer().push( data.substr( bytes_written, len ) );
+    bytes_written += len;
+    if ( bytes_written == data.size() ) {
+      sender.writer().close();
+    }
+    sender.push( transmit );
+
+    data_link.deliver( now, [&]( TCPSenderMessage msg ) {
+      receiver.receive( std::move( msg ) );
+      Reader& reader = receiver.reader();
+      while ( reader.bytes_buffered() ) {
+        const string_view chunk = reader.peek();
+        intact &= chunk == string_view { data }.substr( bytes_read, chunk.size() );
+        bytes_read += chunk.size();
+        reader.pop( chunk.size() );
+      }
+      ack_link.send( receiver.send(), now );
+    } );
+    ack_link.deliver( now, [&]( const TCPReceiverMessage& ack ) {
+      sender.receive( ack );
+      sender.push( transmit );
+    } );
+
+    sender.tick( 1, transmit );
+    largest_burst = max( largest_burst, sent_this_ms );
+    sent_this_ms = 0;
+    ++now;
+  }
+
+  if ( not intact or bytes_read != data.size() ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  return { 8 * static_cast<double>( data.size() ) / 1e6 / ( static_cast<double>( now ) / 1000 ),
+           data_link.queue_drops(),
+           largest_burst };
+}
+
+void program_body()
+{
+  constexpr size_t input_len = 20e6;
+
+  const string data = [] {
+    default_random_engine rd { 1370 };
+    uniform_int_distribution<char> ud;
+    string ret( input_len, 0 );
+    for ( auto& c : ret ) {
+      c = ud( rd );
+    }
+    return ret;
+  }();
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  double unpaced_goodput = 0;
+  for ( const bool pacing : { false, true } ) {
+    const auto result = transfer( pacing, data );
+    const string name = pacing ? "paced" : "unpaced";
+
+    cout << "20 MB over a 100 Mbit/s, 40 ms RTT link with a 2 ms queue, " << name << ": " << fixed
+         << setprecision( 2 ) << result.simulated_megabits_per_second << " Mbit/s, " << result.queue_drops
+         << " queue drops, largest burst " << result.largest_burst << " bytes in 1 ms.\n";
+
+    debug_output << "      " << setw( 8 ) << name << ": " << fixed << setprecision( 2 ) << setw( 6 )
+                 << result.simulated_megabits_per_second << " Mbit/s, " << setw( 4 ) << result.queue_drops
+                 << " queue drops, largest burst " << setw( 6 ) << result.largest_burst << " bytes/ms\n";
+
+    if ( not pacing ) {
+      unpaced_goodput = result.simulated_megabits_per_second;
+    } else if ( result.simulated_megabits_per_second <= unpaced_goodput ) {
+      throw runtime_error( "pacing did not help a transfer through a shallow queue" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+#include "byte_stream.hh"
+#include "cord.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_sender.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+struct CopyResult
+{
+  double bytes_copied_per_byte_delivered;
+  double gigabits_per_second;
+};
+
+// Send `input_len` bytes from a TCPSender to a TCPReceiver over an in-process link that
+// reorders neighbouring segments and drops one in `drop_every`, and count the payload bytes memcpy'd.
+// Each segment is also serialized as it would be written to the TUN device.
+CopyResult copy_test( const ByteStream::Backend backend,
+                      const size_t input_len,  // NOLINT(bugprone-easily-swappable-parameters)
+                      const size_t write_size, // NOLINT(bugprone-easily-swappable-parameters)
+                      const size_t drop_every,
+                      const size_t random_seed )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPSender sender { ByteStream { TCPConfig::DEFAULT_CAPACITY, backend }, Wrap32 { 0 }, TCPConfig::TIMEOUT_DFLT };
+  TCPReceiver receiver { Reassembler { ByteStream { TCPConfig::DEFAULT_CAPACITY, backend } } };
+
+  vector<TCPSenderMessage> link;
+  const FourTuple tuple { 0x0A000001, 0x0A000002, 1234, 80 };
+  string headers;
+  size_t wire_bytes = 0;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    const TCPMessage segment { .sender = msg };
+    for ( const auto piece : TCPOverIPv4Adapter::serialize_tcp_in_ip( segment, tuple, headers ) ) {
+      wire_bytes += piece.size();
+    }
+    link.push_back( msg );
+  };
+
+  size_t bytes_written = 0;
+  size_t segments_sent = 0;
+  string output_data;
+  output_data.reserve( data.size() );
+  Cord chunk;
+
+  CopyCounter::reset();
+  const auto start_time = steady_clock::now();
+  while ( not receiver.reader().is_finished() ) {
+    // the application writes in pieces (each piece is a new string, handed over without a copy)
+    while ( bytes_written < data.size() and sender.writer().available_capacity() >= write_size ) {
+      sender.writer().push( data.substr( bytes_written, write_size ) );
+      bytes_written += write_size;
+      if ( bytes_written >= data.size() ) {
+        sender.writer().close();
+      }
+    }
+
+    sender.push( transmit );
+    if ( link.empty() ) {
+      sender.tick( TCPConfig::TIMEOUT_DFLT, transmit );
+    }
+
+    // deliver neighbouring segments in swapped order, occasionally dropping one
+    for ( size_t i = 0; i < link.size(); i += 2 ) {
+      for ( const size_t j : { i + 1, i } ) {
+        if ( j < link.size() and ++segments_sent % drop_every ) {
+          receiver.receive( move( link[j] ) );
+        }
+      }
+    }
+    link.clear();
+    sender.receive( receiver.send() );
+
+    // the application reads what was delivered (the CopyCounter counts only copies the stack makes)
+    while ( receiver.reader().bytes_buffered() ) {
+      read( receiver.reader(), receiver.reader().bytes_buffered(), chunk );
+      for ( const auto& slice : chunk.slices() ) {
+        output_data.append( slice.view() );
+      }
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( data != output_data or wire_bytes < data.size() ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  // a ring-backed ByteStream copies every byte pushed into it (which CopyCounter leaves to the test to count):
+  // the application's writes into the outbound stream, and the Reassembler's into the inbound one
+  uint64_t bytes_copied = CopyCounter::bytes();
+  if ( backend != ByteStream::Backend::Deque ) {
+    bytes_copied += sender.writer().bytes_pushed() + receiver.reader().bytes_popped();
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return { static_cast<double>( bytes_copied ) / static_cast<double>( input_len ),
+           8 * static_cast<double>( input_len ) / test_duration.count() / 1e9 };
+}
+
+void speed_test( const ByteStream::Backend backend )
+{
+  constexpr size_t input_len = 1e7;
+  constexpr size_t write_size = 1500;
+  constexpr size_t drop_every = 97;
+  const auto backend_name = ByteStream::backend_name( backend );
+
+  const auto result = copy_test( backend, input_len, write_size, drop_every, 1370 );
+
+  cout << "TCPSender -> TCPReceiver with ByteStream (" << backend_name << ") copied " << fixed
+       << setprecision( 2 ) << result.bytes_copied_per_byte_delivered << " bytes per byte delivered at "
+       << result.gigabits_per_second << " Gbit/s.\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "             " << setw( 13 ) << backend_name << ": " << fixed << setprecision( 2 )
+               << result.bytes_copied_per_byte_delivered << " bytes copied per byte delivered, "
+               << result.gigabits_per_second << " Gbit/s\n";
+
+  if ( backend == ByteStream::Backend::Deque and result.bytes_copied_per_byte_delivered > 0 ) {
+    throw runtime_error( "payload bytes were copied even though every ByteStream shares its Slices (and "
+                         "serialization writes them in place)" );
+  }
+}
+
+void program_body()
+{
+  speed_test( ByteStream::Backend::Deque );
+  speed_test( ByteStream::Backend::Ring );
+  speed_test( ByteStream::Backend::MirroredRing );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "peer_test_harness.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    // A client with more to send than the server's window holds, and a server whose application reads
+    // only when the test says so
+    TCPConfig cfg;
+    cfg.plpmtud = false;
+    cfg.delayed_ack = false;
+    cfg.congestion_control = CongestionControl::None;
+    cfg.recv_capacity = 4000;
+    cfg.send_capacity = 1 << 20;
+
+    {
+      TCPPeerTestHarness test { "An ACK that moves the window along lets the client send more, straight away",
+                                cfg };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, string( 20000, 'x' ) } );
+      test.execute( ExpectSeqnosInFlight { Side::Client, 4000 } );
+
+      // the server's application reads as data arrives, so each ACK reopens the window
+      for ( int round = 0; round < 3; round++ ) {
+        test.execute( Deliver { Side::Server } );
+        test.execute( Read { Side::Server } );
+        test.execute( Tick { Side::Server, 1 } );
+        test.execute( Deliver { Side::Client } );
+        test.execute( ExpectUndeliveredPayload { Side::Client, 4000 } );
+      }
+    }
+
+    {
+      TCPPeerTestHarness test { "A window update from a server whose window was closed does the same", cfg };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, string( 20000, 'x' ) } );
+      test.execute( Deliver { Side::Server } );
+      // the ACKs of everything close the window; the client sends nothing but a one-byte probe
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectUndeliveredPayload { Side::Client, 1 } );
+      test.execute( Drop { Side::Server } );
+
+      test.execute( Read { Side::Server } );
+      test.execute( Tick { Side::Server, 1 } );
+      test.execute( ExpectWindowUpdatesSent { Side::Server, 1 } );
+      // and the client fills the window (less the lost probe, still in flight) without being pushed
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectUndeliveredPayload { Side::Client, 3999 } );
+    }
+
+    {
+      TCPConfig cc = cfg;
+      cc.congestion_control = CongestionControl::NewReno;
+      cc.recv_capacity = 1 << 20;
+
+      TCPPeerTestHarness test { "In slow start, ACKs release a larger window in reply", cc };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, string( 200000, 'x' ) } );
+      // the full segments that fit the initial window
+      test.execute( ExpectCongestionWindow { Side::Client, 10000 } );
+      test.execute( ExpectSeqnosInFlight { Side::Client, 6 * 1448 } );
+      test.execute( Deliver { Side::Server } );
+      // each ACK grows cwnd by the bytes it acknowledges, and what that lets out goes in reply
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectCongestionWindow { Side::Client, 10000 + 6 * 1448 } );
+      test.execute( ExpectUndeliveredPayload { Side::Client, 12 * 1448 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
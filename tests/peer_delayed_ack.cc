@@ -0,0 +1,144 @@
+#include "peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr size_t mss = TCPConfig::DEFAULT_MTU - TCPConfig::HEADERS_LEN - TCPConfig::TIMESTAMPS_LEN;
+
+// `segments` full segments of data
+string segments( size_t count )
+{
+  return string( count * mss, 'x' );
+}
+} // namespace
+
+int main()
+{
+  try {
+    TCPConfig cfg;
+    cfg.plpmtud = false;
+    cfg.congestion_control = CongestionControl::None;
+    cfg.recv_capacity = 1 << 20;
+    cfg.send_capacity = 1 << 20;
+
+    {
+      TCPPeerTestHarness test { "One ACK for every second full segment", cfg };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, segments( 10 ) } );
+      test.execute( Deliver { Side::Server, 10 } );
+      test.execute( ExpectUndelivered { Side::Server, 5 } );
+      test.execute( ExpectPureAcksSent { Side::Server, 5 } );
+
+      // a lone segment's ACK is held back for 40 ms
+      test.execute( Write { Side::Client, segments( 1 ) } );
+      test.execute( Deliver { Side::Server, 1 } );
+      test.execute( Tick { Side::Server, 39 } );
+      test.execute( ExpectUndelivered { Side::Server, 5 } );
+      test.execute( Tick { Side::Server, 1 } );
+      test.execute( ExpectUndelivered { Side::Server, 6 } );
+      test.execute( ExpectDelayedAcksSent { Side::Server, 1 } );
+    }
+
+    {
+      TCPConfig immediate = cfg;
+      immediate.delayed_ack = false;
+
+      TCPPeerTestHarness test { "Without delayed ACKs, every segment is acknowledged", immediate };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, segments( 10 ) } );
+      test.execute( Deliver { Side::Server, 10 } );
+      test.execute( ExpectUndelivered { Side::Server, 10 } );
+    }
+
+    {
+      TCPPeerTestHarness test { "Out-of-order data, and what fills the hole, is acknowledged at once", cfg };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, segments( 4 ) } );
+      test.execute( HoldBack {} );
+      test.execute( Deliver { Side::Server, 1 } );
+      test.execute( ExpectUndelivered { Side::Server, 1 } );
+      test.execute( ExpectSegment { Side::Server }.with_sack_blocks( 1 ) );
+      test.execute( Deliver { Side::Server, 1 } );
+      test.execute( ExpectUndelivered { Side::Server, 2 } );
+      test.execute( DeliverHeldBack {} );
+      test.execute( ExpectUndelivered { Side::Server, 3 } );
+      test.execute( ExpectSegment { Side::Server }.with_sack_blocks( 0 ) );
+
+      // in order again, the next ACK is delayed
+      test.execute( Deliver { Side::Server, 1 } );
+      test.execute( ExpectUndelivered { Side::Server, 3 } );
+      test.execute( Tick { Side::Server, 40 } );
+      test.execute( ExpectUndelivered { Side::Server, 4 } );
+
+      // a duplicate segment is acknowledged at once
+      test.execute( DeliverHeldBack {} );
+      test.execute( ExpectUndelivered { Side::Server, 5 } );
+    }
+
+    {
+      TCPPeerTestHarness test { "A FIN is acknowledged at once", cfg };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, segments( 1 ) } );
+      test.execute( Write { Side::Client, "" }.with_close() );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectUndelivered { Side::Server, 1 } );
+      test.execute( ExpectSegment { Side::Server }.with_ackno( true ) );
+    }
+
+    {
+      TCPConfig small = cfg;
+      small.recv_capacity = 8 * mss;
+
+      TCPPeerTestHarness test { "A window update is sent once a full segment fits (RFC 1122)", small };
+      test.execute( Connect {} );
+      test.execute( Write { Side::Client, segments( 8 ) } );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectUndelivered { Side::Server, 4 } );
+      test.execute( ExpectSegment { Side::Server }.with_window( 0 ) );
+
+      test.execute( Read { Side::Server, 1000 } );
+      test.execute( Tick { Side::Server, 0 } );
+      test.execute( ExpectUndelivered { Side::Server, 4 } );
+      test.execute( Read { Side::Server, mss - 1000 } );
+      test.execute( Tick { Side::Server, 0 } );
+      test.execute( ExpectUndelivered { Side::Server, 5 } );
+      test.execute( ExpectSegment { Side::Server }.with_window( mss ) );
+      test.execute( ExpectWindowUpdatesSent { Side::Server, 1 } );
+    }
+
+    {
+      TCPConfig stretch = cfg;
+      stretch.stretch_ack = 8;
+
+      TCPPeerTestHarness test { "Stretch ACKs while data streams in", stretch };
+      test.execute( Connect {} );
+      // after the first ACK, one ACK for every eighth segment
+      test.execute( Write { Side::Client, segments( 34 ) } );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectUndelivered { Side::Server, 5 } );
+
+      // the timer still bounds the delay
+      test.execute( Write { Side::Client, segments( 2 ) } );
+      test.execute( Deliver { Side::Server, 1 } );
+      test.execute( Tick { Side::Server, 40 } );
+      test.execute( ExpectUndelivered { Side::Server, 6 } );
+
+      // once the flow pauses, it is back to every second segment
+      test.execute( Deliver { Side::Server, 1 } );
+      test.execute( Write { Side::Client, segments( 1 ) } );
+      test.execute( Deliver { Side::Server, 1 } );
+      test.execute( ExpectUndelivered { Side::Server, 7 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
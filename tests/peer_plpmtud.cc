@@ -0,0 +1,153 @@
+#include "parser.hh"
+#include "peer_test_harness.hh"
+#include "tcp_receiver.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+#include "test_should_be.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// Send data through a path that drops anything with more than `path_payload` bytes of payload.
+// Returns the sender's payload size at the end.
+uint64_t probe( uint64_t max_payload, uint64_t path_payload )
+{
+  TCPConfig config;
+  config.isn = Wrap32 { 0 };
+  TCPSender sender { ByteStream { 1 << 20 }, config };
+  TCPReceiver receiver { Reassembler { ByteStream { 1 << 20 } }, TCPConfig::MAX_WINDOW };
+  sender.set_max_payload_size( max_payload );
+
+  const string data( 4 << 20, 'x' );
+  sender.writer().push( data.substr( 0, 1 << 20 ) );
+  size_t written = 1 << 20;
+
+  vector<TCPSenderMessage> in_flight;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    if ( msg.payload.size() <= path_payload ) {
+      in_flight.push_back( msg );
+    }
+  };
+
+  uint64_t smallest_cwnd = UINT64_MAX;
+  uint64_t bytes_read = 0;
+  for ( int ms = 0; ms < 100'000 and bytes_read < data.size(); ms++ ) {
+    sender.push( transmit );
+    for ( auto& msg : in_flight ) {
+      receiver.receive( std::move( msg ) );
+      sender.receive( receiver.send() );
+    }
+    in_flight.clear();
+    bytes_read += receiver.reader().bytes_buffered();
+    receiver.reader().pop( receiver.reader().bytes_buffered() );
+
+    const size_t len = min( data.size() - written, sender.writer().available_capacity() );
+    sender.writer().push( data.substr( written, len ) );
+    written += len;
+    sender.tick( 1, transmit );
+    smallest_cwnd = min( smallest_cwnd, sender.congestion_window().value() );
+  }
+
+  // every byte gets through, and lost probes are not taken as congestion
+  test_should_be( bytes_read, data.size() );
+  test_should_be( smallest_cwnd >= 10 * TCPConfig::MAX_PAYLOAD_SIZE, true );
+  return sender.max_payload_size();
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      TCPSegment segment;
+      segment.message.sender.SYN = true;
+      segment.message.sender.TSval = 1;
+      segment.message.mss = 8960;
+      segment.message.window_scale = 7;
+      segment.compute_checksum( 0 );
+      // a SYN with MSS, window scale and timestamps options
+      test_should_be( segment.header_length(), 40UL );
+
+      Parser parser { serialize( segment ) };
+      TCPSegment parsed;
+      parsed.parse( parser, 0 );
+      test_should_be( parser.has_error(), false );
+      // the MSS survives serializing and parsing, and the window scale still parses after it
+      test_should_be( parsed.message.mss.value(), uint16_t { 8960 } );
+      test_should_be( parsed.message.window_scale.value(), uint8_t { 7 } );
+    }
+
+    TCPConfig ethernet;
+    ethernet.plpmtud = false;
+    TCPConfig jumbo = ethernet;
+    jumbo.mtu = 9000;
+
+    {
+      TCPPeerTestHarness test { "Jumbo frames, less room for timestamps", jumbo };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_mss( 9000 - TCPConfig::HEADERS_LEN ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectMaxPayloadSize { Side::Client, 9000 - 40 - 12 } );
+    }
+
+    {
+      TCPPeerTestHarness test { "The peer's smaller MSS wins", jumbo, ethernet };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectSegment { Side::Server }.with_mss( 1500 - TCPConfig::HEADERS_LEN ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectMaxPayloadSize { Side::Client, 1500 - 40 - 12 } );
+    }
+
+    {
+      TCPPeerTestHarness test { "Our smaller MTU wins", ethernet, jumbo };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_mss( 1500 - TCPConfig::HEADERS_LEN ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectMaxPayloadSize { Side::Client, 1500 - 40 - 12 } );
+    }
+
+    {
+      TCPPeerTestHarness test { "Without an MSS option, 536 bytes", jumbo };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( StripMSS { Side::Client } );
+      test.execute( Deliver { Side::Server } );
+      test.execute( StripMSS { Side::Server } );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectMaxPayloadSize { Side::Client, 536 - 12 } );
+    }
+
+    {
+      TCPConfig probing = jumbo;
+      probing.plpmtud = true;
+
+      TCPPeerTestHarness test { "With PLPMTUD, start small", probing };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_mss( 9000 - TCPConfig::HEADERS_LEN ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectMaxPayloadSize { Side::Client, TCPConfig::MAX_PAYLOAD_SIZE } );
+    }
+
+    // PLPMTUD finds an Ethernet hop, or a jumbo-frame path, but never goes below the base size
+    const uint64_t ethernet_payload = probe( 8948, 1448 );
+    test_should_be( ethernet_payload <= 1448 and ethernet_payload + TCPConfig::PMTU_SEARCH_DONE > 1448, true );
+    test_should_be( probe( 8948, 8948 ) + TCPConfig::PMTU_SEARCH_DONE > 8948, true );
+    test_should_be( probe( 8948, 1000 ), 1000UL );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
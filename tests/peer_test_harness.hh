@@ -0,0 +1,425 @@
+#pragma once
+
+#include "common.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+enum class Side : uint8_t
+{
+  Client,
+  Server,
+};
+
+inline std::string to_string( Side side )
+{
+  return side == Side::Client ? "client" : "server";
+}
+
+inline Side other( Side side )
+{
+  return side == Side::Client ? Side::Server : Side::Client;
+}
+
+// Two TCPPeers, and the segments each has sent that the test hasn't yet delivered to the other
+struct PeerPair
+{
+  TCPPeer client;
+  TCPPeer server;
+  std::deque<TCPMessage> to_server {};
+  std::deque<TCPMessage> to_client {};
+  std::optional<TCPMessage> held_back {}; // a segment to the server, to be delivered out of order
+
+  TCPPeer& peer( Side side ) { return side == Side::Client ? client : server; }
+  std::deque<TCPMessage>& sent_by( Side side ) { return side == Side::Client ? to_server : to_client; }
+
+  auto make_transmit( Side side )
+  {
+    return [this, side]( TCPMessage msg ) { sent_by( side ).push_back( std::move( msg ) ); };
+  }
+
+  // Hand the next segment on its way to `side` to that peer
+  void deliver_one( Side side )
+  {
+    auto& segments = sent_by( other( side ) );
+    TCPMessage msg = std::move( segments.front() );
+    segments.pop_front();
+    peer( side ).receive( std::move( msg ), make_transmit( side ) );
+  }
+};
+
+class TCPPeerTestHarness : public TestHarness<PeerPair>
+{
+public:
+  TCPPeerTestHarness( std::string name, const TCPConfig& client_config, const TCPConfig& server_config )
+    : TestHarness( move( name ),
+                   "a client and a server, neither connected",
+                   { TCPPeer { client_config }, TCPPeer { server_config } } )
+  {}
+
+  TCPPeerTestHarness( std::string name, const TCPConfig& config )
+    : TCPPeerTestHarness( move( name ), config, config )
+  {}
+};
+
+struct Connect : public Action<PeerPair>
+{
+  std::string description() const override
+  {
+    return "client connects, and segments are delivered until none are left";
+  }
+  void execute( PeerPair& peers ) const override
+  {
+    peers.client.push( peers.make_transmit( Side::Client ) );
+    while ( not peers.to_server.empty() or not peers.to_client.empty() ) {
+      if ( not peers.to_server.empty() ) {
+        peers.deliver_one( Side::Server );
+      } else {
+        peers.deliver_one( Side::Client );
+      }
+    }
+  }
+};
+
+struct Write : public Action<PeerPair>
+{
+  Side side_;
+  std::string data_;
+  bool close_ {};
+
+  Write( Side side, std::string data ) : side_( side ), data_( move( data ) ) {}
+
+  Write& with_close()
+  {
+    close_ = true;
+    return *this;
+  }
+
+  std::string description() const override
+  {
+    if ( data_.empty() and not close_ ) {
+      return to_string( side_ ) + " pushes";
+    }
+    return to_string( side_ ) + " writes \"" + Printer::prettify( data_ ) + "\"" + ( close_ ? " and closes" : "" )
+           + ", then pushes";
+  }
+
+  void execute( PeerPair& peers ) const override
+  {
+    TCPPeer& peer = peers.peer( side_ );
+    peer.outbound_writer().push( data_ );
+    if ( close_ ) {
+      peer.outbound_writer().close();
+    }
+    peer.push( peers.make_transmit( side_ ) );
+  }
+};
+
+struct Tick : public Action<PeerPair>
+{
+  Side side_;
+  uint64_t ms_;
+
+  Tick( Side side, uint64_t ms ) : side_( side ), ms_( ms ) {}
+  std::string description() const override
+  {
+    return std::to_string( ms_ ) + " ms pass for the " + to_string( side_ );
+  }
+  void execute( PeerPair& peers ) const override { peers.peer( side_ ).tick( ms_, peers.make_transmit( side_ ) ); }
+};
+
+// Pop bytes (all of those buffered, by default) from a peer's inbound stream, as its application would
+struct Read : public Action<PeerPair>
+{
+  Side side_;
+  std::optional<uint64_t> len_;
+
+  explicit Read( Side side, std::optional<uint64_t> len = {} ) : side_( side ), len_( len ) {}
+
+  std::string description() const override
+  {
+    return to_string( side_ ) + " reads "
+           + ( len_.has_value() ? std::to_string( *len_ ) + " bytes" : std::string { "everything" } );
+  }
+
+  void execute( PeerPair& peers ) const override
+  {
+    Reader& inbound = peers.peer( side_ ).inbound_reader();
+    inbound.pop( len_.value_or( inbound.bytes_buffered() ) );
+  }
+};
+
+// Deliver the next `count` segments (all of them, by default) on their way to `to`
+struct Deliver : public Action<PeerPair>
+{
+  Side to_;
+  std::optional<size_t> count_;
+
+  explicit Deliver( Side to, std::optional<size_t> count = {} ) : to_( to ), count_( count ) {}
+
+  std::string description() const override
+  {
+    return "deliver " + ( count_.has_value() ? std::to_string( *count_ ) : std::string { "all" } )
+           + " segments to the " + to_string( to_ );
+  }
+
+  void execute( PeerPair& peers ) const override
+  {
+    const Side from = other( to_ );
+    if ( count_.has_value() and peers.sent_by( from ).size() < *count_ ) {
+      throw ExpectationViolation( "only " + std::to_string( peers.sent_by( from ).size() ) + " segments to the "
+                                  + to_string( to_ ) + " could be delivered" );
+    }
+    const size_t count = count_.value_or( peers.sent_by( from ).size() );
+    for ( size_t i = 0; i < count; i++ ) {
+      peers.deliver_one( to_ );
+    }
+  }
+};
+
+// Lose every segment on its way to `to`
+struct Drop : public Action<PeerPair>
+{
+  Side to_;
+
+  explicit Drop( Side to ) : to_( to ) {}
+  std::string description() const override { return "drop all segments to the " + to_string( to_ ); }
+  void execute( PeerPair& peers ) const override
+  {
+    peers.sent_by( other( to_ ) ).clear();
+  }
+};
+
+// Take the next segment to the server out of order, for DeliverHeldBack to deliver later
+struct HoldBack : public Action<PeerPair>
+{
+  std::string description() const override { return "hold back the next segment to the server"; }
+  void execute( PeerPair& peers ) const override
+  {
+    if ( peers.to_server.empty() ) {
+      throw ExpectationViolation( "no segment to the server to hold back" );
+    }
+    peers.held_back = std::move( peers.to_server.front() );
+    peers.to_server.pop_front();
+  }
+};
+
+// Deliver (a copy of) the segment held back
+struct DeliverHeldBack : public Action<PeerPair>
+{
+  std::string description() const override { return "deliver the segment held back to the server"; }
+  void execute( PeerPair& peers ) const override
+  {
+    peers.server.receive( peers.held_back.value(), peers.make_transmit( Side::Server ) );
+  }
+};
+
+// Remove the MSS option from the last segment a peer sent, as a middlebox might
+struct StripMSS : public Action<PeerPair>
+{
+  Side from_;
+
+  explicit StripMSS( Side from ) : from_( from ) {}
+  std::string description() const override
+  {
+    return "strip the MSS option from the " + to_string( from_ ) + "'s SYN";
+  }
+  void execute( PeerPair& peers ) const override { peers.sent_by( from_ ).back().mss.reset(); }
+};
+
+template<typename Num>
+struct ExpectPeerNumber : public ExpectNumber<PeerPair, Num>
+{
+  Side side_;
+
+  ExpectPeerNumber( Side side, Num value ) : ExpectNumber<PeerPair, Num>( value ), side_( side ) {}
+  std::string name() const override { return to_string( side_ ) + "." + property(); }
+  Num value( PeerPair& peers ) const override { return peer_value( peers.peer( side_ ) ); }
+
+  virtual std::string property() const = 0;
+  virtual Num peer_value( const TCPPeer& peer ) const = 0;
+};
+
+struct ExpectSeqnosInFlight : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string property() const override { return "sequence_numbers_in_flight"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.sender().sequence_numbers_in_flight(); }
+};
+
+struct ExpectCongestionWindow : public ExpectPeerNumber<std::optional<uint64_t>>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string property() const override { return "congestion_window"; }
+  std::optional<uint64_t> peer_value( const TCPPeer& peer ) const override
+  {
+    return peer.sender().congestion_window();
+  }
+};
+
+struct ExpectMaxPayloadSize : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string property() const override { return "max_payload_size"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.sender().max_payload_size(); }
+};
+
+struct ExpectPureAcksSent : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string property() const override { return "stats().pure_acks_sent"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.stats().pure_acks_sent; }
+};
+
+struct ExpectDelayedAcksSent : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string property() const override { return "stats().delayed_acks_sent"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.stats().delayed_acks_sent; }
+};
+
+struct ExpectWindowUpdatesSent : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string property() const override { return "stats().window_updates_sent"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.stats().window_updates_sent; }
+};
+
+// The number of segments a peer has sent that haven't been delivered
+struct ExpectUndelivered : public ExpectNumber<PeerPair, uint64_t>
+{
+  Side from_;
+
+  ExpectUndelivered( Side from, uint64_t count ) : ExpectNumber( count ), from_( from ) {}
+  std::string name() const override { return "segments from the " + to_string( from_ ) + " not yet delivered"; }
+  uint64_t value( PeerPair& peers ) const override { return peers.sent_by( from_ ).size(); }
+};
+
+// ... and the payload bytes they carry
+struct ExpectUndeliveredPayload : public ExpectNumber<PeerPair, uint64_t>
+{
+  Side from_;
+
+  ExpectUndeliveredPayload( Side from, uint64_t bytes ) : ExpectNumber( bytes ), from_( from ) {}
+  std::string name() const override
+  {
+    return "payload bytes from the " + to_string( from_ ) + " not yet delivered";
+  }
+  uint64_t value( PeerPair& peers ) const override
+  {
+    uint64_t bytes = 0;
+    for ( const auto& msg : peers.sent_by( from_ ) ) {
+      bytes += msg.sender.payload.size();
+    }
+    return bytes;
+  }
+};
+
+// The options and fields of the last segment a peer sent
+struct ExpectSegment : public Expectation<PeerPair>
+{
+  Side from_;
+  std::optional<std::optional<uint8_t>> window_scale_ {};
+  std::optional<std::optional<uint16_t>> mss_ {};
+  std::optional<bool> timestamp_ {};
+  std::optional<bool> ackno_ {};
+  std::optional<uint32_t> window_ {};
+  std::optional<size_t> sack_blocks_ {};
+
+  explicit ExpectSegment( Side from ) : from_( from ) {}
+
+  ExpectSegment& with_window_scale( std::optional<uint8_t> window_scale )
+  {
+    window_scale_ = window_scale;
+    return *this;
+  }
+
+  ExpectSegment& with_mss( std::optional<uint16_t> mss )
+  {
+    mss_ = mss;
+    return *this;
+  }
+
+  ExpectSegment& with_timestamp( bool timestamp )
+  {
+    timestamp_ = timestamp;
+    return *this;
+  }
+
+  ExpectSegment& with_ackno( bool ackno )
+  {
+    ackno_ = ackno;
+    return *this;
+  }
+
+  ExpectSegment& with_window( uint32_t window )
+  {
+    window_ = window;
+    return *this;
+  }
+
+  ExpectSegment& with_sack_blocks( size_t count )
+  {
+    sack_blocks_ = count;
+    return *this;
+  }
+
+  std::string description() const override
+  {
+    std::ostringstream o;
+    o << "last segment from the " << to_string( from_ ) << " has";
+    if ( window_scale_.has_value() ) {
+      o << " window_scale=" << to_string( *window_scale_ );
+    }
+    if ( mss_.has_value() ) {
+      o << " mss=" << to_string( *mss_ );
+    }
+    if ( timestamp_.has_value() ) {
+      o << ( *timestamp_ ? " a timestamp" : " no timestamp" );
+    }
+    if ( ackno_.has_value() ) {
+      o << ( *ackno_ ? " an ackno" : " no ackno" );
+    }
+    if ( window_.has_value() ) {
+      o << " window=" << *window_;
+    }
+    if ( sack_blocks_.has_value() ) {
+      o << " " << *sack_blocks_ << " SACK blocks";
+    }
+    return o.str();
+  }
+
+  void execute( PeerPair& peers ) const override
+  {
+    if ( peers.sent_by( from_ ).empty() ) {
+      throw ExpectationViolation( "expected a segment from the " + to_string( from_ ) + ", but none was sent" );
+    }
+    const TCPMessage& msg = peers.sent_by( from_ ).back();
+
+    if ( window_scale_.has_value() and msg.window_scale != *window_scale_ ) {
+      throw ExpectationViolation( "window_scale", *window_scale_, msg.window_scale );
+    }
+    if ( mss_.has_value() and msg.mss != *mss_ ) {
+      throw ExpectationViolation( "mss", *mss_, msg.mss );
+    }
+    if ( timestamp_.has_value() and msg.sender.TSval.has_value() != *timestamp_ ) {
+      throw ExpectationViolation( "TSval.has_value()", *timestamp_, msg.sender.TSval.has_value() );
+    }
+    if ( ackno_.has_value() and msg.receiver.ackno.has_value() != *ackno_ ) {
+      throw ExpectationViolation( "ackno.has_value()", *ackno_, msg.receiver.ackno.has_value() );
+    }
+    if ( window_.has_value() and msg.receiver.window_size != *window_ ) {
+      throw ExpectationViolation( "window_size", *window_, msg.receiver.window_size );
+    }
+    if ( sack_blocks_.has_value() and msg.receiver.sack_blocks.size() != *sack_blocks_ ) {
+      throw ExpectationViolation( "sack_blocks.size()", *sack_blocks_, msg.receiver.sack_blocks.size() );
+    }
+  }
+};
@@ -0,0 +1,77 @@
+#include "parser.hh"
+#include "peer_test_harness.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      TCPSegment segment;
+      segment.message.sender.TSval = 0xdeadbeef;
+      segment.message.receiver.ackno = Wrap32 { 1 };
+      segment.message.receiver.TSecr = 1234;
+      for ( uint32_t i = 0; i < 4; i++ ) {
+        segment.message.receiver.sack_blocks.emplace_back( Wrap32 { 10 * i + 5 }, Wrap32 { 10 * i + 8 } );
+      }
+      segment.compute_checksum( 0 );
+      // the options fill the header: timestamps and three SACK blocks
+      test_should_be( segment.header_length(), 60UL );
+
+      Parser parser { serialize( segment ) };
+      TCPSegment parsed;
+      parsed.parse( parser, 0 );
+      test_should_be( parser.has_error(), false );
+      // TSval and TSecr survive serializing and parsing, as do the most recent three SACK blocks
+      test_should_be( parsed.message.sender.TSval.value(), 0xdeadbeefU );
+      test_should_be( parsed.message.receiver.TSecr.value(), 1234U );
+      test_should_be( parsed.message.receiver.sack_blocks.size(), 3UL );
+    }
+
+    TCPConfig with;
+    TCPConfig without;
+    without.timestamps = false;
+
+    {
+      TCPPeerTestHarness test { "Timestamps are used when both SYNs have them", with };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_timestamp( true ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectSegment { Side::Server }.with_timestamp( true ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectSegment { Side::Client }.with_timestamp( true ) );
+    }
+
+    {
+      TCPPeerTestHarness test { "No timestamps if the peer's SYN has none", with, without };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_timestamp( true ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectSegment { Side::Server }.with_timestamp( false ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectSegment { Side::Client }.with_timestamp( false ) );
+    }
+
+    {
+      TCPPeerTestHarness test { "No timestamps if not configured", without, with };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_timestamp( false ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectSegment { Side::Server }.with_timestamp( false ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( ExpectSegment { Side::Client }.with_timestamp( false ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
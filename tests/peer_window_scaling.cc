@@ -0,0 +1,89 @@
+#include "parser.hh"
+#include "peer_test_harness.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      TCPSegment segment;
+      segment.message.sender.SYN = true;
+      segment.message.receiver.window_size = 40000;
+      segment.message.receiver.sack_blocks = { { Wrap32 { 10 }, Wrap32 { 20 } } };
+      segment.message.window_scale = 9;
+      segment.message.sender.payload = string { "payload" };
+      segment.compute_checksum( 0 );
+      // the header includes the window scale and SACK options
+      test_should_be( segment.header_length(), 20UL + 4 + 12 );
+
+      Parser parser { serialize( segment ) };
+      TCPSegment parsed;
+      parsed.parse( parser, 0 );
+      test_should_be( parser.has_error(), false );
+      // the window scale, the window and the SACK blocks survive serializing and parsing
+      test_should_be( parsed.message.window_scale.value(), uint8_t { 9 } );
+      test_should_be( parsed.message.receiver.window_size, 40000U );
+      test_should_be( parsed.message.receiver.sack_blocks == segment.message.receiver.sack_blocks, true );
+      // the payload follows the options
+      test_should_be( parsed.message.sender.payload == "payload", true );
+    }
+
+    constexpr size_t capacity = 16 << 20;
+    TCPConfig cfg;
+    cfg.recv_capacity = capacity;
+    cfg.send_capacity = capacity;
+    cfg.congestion_control = CongestionControl::None;
+    cfg.nodelay = true; // the last, partial segment goes out too
+
+    {
+      TCPPeerTestHarness test { "16 MiB needs a window scale of 9, offered in both SYNs", cfg };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_window_scale( 9 ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectSegment { Side::Server }.with_window_scale( 9 ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( Deliver { Side::Server } );
+
+      // the window field is scaled down, and the sender scales it up
+      test.execute( Write { Side::Server, "x" } );
+      test.execute( ExpectSegment { Side::Server }.with_window( capacity >> 9 ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( Write { Side::Client, string( 1'000'000, 'y' ) } );
+      test.execute( ExpectSeqnosInFlight { Side::Client, 1'000'000 } );
+    }
+
+    {
+      TCPConfig unscaled_cfg = cfg;
+      unscaled_cfg.window_scaling = false;
+
+      TCPPeerTestHarness test { "Without window scaling the window is capped at 64 KiB", cfg, unscaled_cfg };
+      test.execute( Write { Side::Client, "" } );
+      test.execute( ExpectSegment { Side::Client }.with_window_scale( 9 ) );
+      test.execute( Deliver { Side::Server } );
+      test.execute( ExpectSegment { Side::Server }.with_window_scale( nullopt ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( Deliver { Side::Server } );
+
+      test.execute( Write { Side::Server, "x" } );
+      test.execute( ExpectSegment { Side::Server }.with_window( UINT16_MAX ) );
+      test.execute( Deliver { Side::Client } );
+      test.execute( Write { Side::Client, string( 1'000'000, 'y' ) } );
+      test.execute( ExpectSeqnosInFlight { Side::Client, UINT16_MAX } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
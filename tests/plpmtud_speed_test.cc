@@ -0,0 +1,166 @@
+#include "byte_stream.hh"
+#include "lossy_link.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+
+using namespace std;
+
+enum class Sizing : uint8_t
+{
+  Fixed,   // TCPConfig::MAX_PAYLOAD_SIZE, whatever the MTU
+  FromMTU, // the interface MTU, trusting the whole path to carry it
+  PLPMTUD, // start at TCPConfig::MAX_PAYLOAD_SIZE and probe up towards the interface MTU
+};
+
+struct TransferResult
+{
+  optional<double> simulated_megabits_per_second; // goodput, or none if the transfer stalled
+  double segments_per_megabyte;                   // segments sent per megabyte delivered
+  uint64_t final_payload_size;                    // payload of a full-sized segment at the end
+};
+
+// Send `input_len` bytes from a TCPSender to a TCPReceiver over a 100 Mbit/s, 20 ms RTT path whose
+// interface MTU is `interface_mtu` but where some hop only carries `path_mtu`
+TransferResult transfer( const Sizing sizing,
+                         const size_t input_len,
+                         const uint16_t interface_mtu, // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint16_t path_mtu )
+{
+  constexpr uint64_t delay_ms = 10;
+  constexpr double bytes_per_ms = 12500;
+  constexpr uint64_t queue_limit = 250'000;
+  constexpr uint64_t give_up_ms = 20'000;
+  constexpr uint64_t header_len = TCPConfig::HEADERS_LEN + TCPConfig::TIMESTAMPS_LEN;
+
+  const string data = [&input_len] {
+    default_random_engine rd { 1370 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPConfig config;
+  config.isn = Wrap32 { 0 };
+  config.plpmtud = sizing == Sizing::PLPMTUD;
+
+  TCPSender sender { ByteStream { 1 << 20 }, config };
+  TCPReceiver receiver { Reassembler { ByteStream { 1 << 20 } }, TCPConfig::MAX_WINDOW };
+  if ( sizing != Sizing::Fixed ) {
+    sender.set_max_payload_size( interface_mtu - header_len );
+  }
+  LossyLink<TCPSenderMessage> data_link { delay_ms, 0, 1 };
+  LossyLink<TCPReceiverMessage> ack_link { delay_ms, 0, 2 };
+  data_link.set_bottleneck( bytes_per_ms, queue_limit );
+  data_link.set_mtu( path_mtu );
+
+  uint64_t now = 0;
+  const auto transmit
+    = [&]( const TCPSenderMessage& msg ) { data_link.send( msg, now, msg.payload.size() + header_len ); };
+
+  size_t bytes_written = 0;
+  string chunk;
+  string output_data;
+  output_data.reserve( data.size() );
+
+  while ( not receiver.reader().is_finished() and now < give_up_ms ) {
+    const size_t len = min( data.size() - bytes_written, sender.writer().available_capacity() );
+    sender.writer().push( data.substr( bytes_written, len ) );
+    bytes_written += len;
+    if ( bytes_written == data.size() ) {
+      sender.writer().close();
+    }
+    sender.push( transmit );
+
+    data_link.deliver( now, [&]( TCPSenderMessage msg ) {
+      receiver.receive( move( msg ) );
+      read( receiver.reader(), receiver.reader().bytes_buffered(), chunk );
+      output_data += chunk;
+      ack_link.send( receiver.send(), now );
+    } );
+    ack_link.deliver( now, [&]( const TCPReceiverMessage& ack ) {
+      sender.receive( ack );
+      sender.push( transmit );
+    } );
+
+    sender.tick( 1, transmit );
+    ++now;
+  }
+
+  TransferResult result { {},
+                          static_cast<double>( data_link.sent() ) / ( static_cast<double>( input_len ) / 1e6 ),
+                          sender.max_payload_size() };
+  if ( receiver.reader().is_finished() ) {
+    if ( data != output_data ) {
+      throw runtime_error( "Mismatch between data written and read" );
+    }
+    result.simulated_megabits_per_second
+      = 8 * static_cast<double>( input_len ) / ( static_cast<double>( now ) / 1000 ) / 1e6;
+  }
+  return result;
+}
+
+void speed_test( const uint16_t interface_mtu, const uint16_t path_mtu, const string& path_name )
+{
+  constexpr size_t input_len = 20e6;
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  for ( const auto& [sizing, sizing_name] : { pair { Sizing::Fixed, "fixed 1000-byte payloads" },
+                                              pair { Sizing::FromMTU, "MSS from the interface MTU" },
+                                              pair { Sizing::PLPMTUD, "PLPMTUD" } } ) {
+    const auto result = transfer( sizing, input_len, interface_mtu, path_mtu );
+
+    cout << path_name << ", " << sizing_name << ": " << fixed << setprecision( 2 );
+    if ( result.simulated_megabits_per_second.has_value() ) {
+      cout << *result.simulated_megabits_per_second << " Mbit/s, " << setprecision( 0 )
+           << result.segments_per_megabyte << " segments/MB, ";
+    } else {
+      cout << "stalled (black hole), ";
+    }
+    cout << "ending at " << result.final_payload_size << "-byte payloads.\n";
+
+    debug_output << "      " << setw( 34 ) << path_name << setw( 28 ) << sizing_name << ": " << fixed
+                 << setprecision( 2 ) << setw( 7 ) << result.simulated_megabits_per_second.value_or( 0 )
+                 << " Mbit/s, " << setprecision( 0 ) << setw( 5 ) << result.segments_per_megabyte
+                 << " segments/MB\n";
+
+    const uint64_t path_payload = path_mtu - TCPConfig::HEADERS_LEN - TCPConfig::TIMESTAMPS_LEN;
+    if ( sizing == Sizing::PLPMTUD
+         and ( not result.simulated_megabits_per_second.has_value()
+               or result.final_payload_size + TCPConfig::PMTU_SEARCH_DONE <= path_payload ) ) {
+      throw runtime_error( "PLPMTUD did not find the path MTU" );
+    }
+  }
+}
+
+void program_body()
+{
+  speed_test( 1500, 1500, "Ethernet" );
+  speed_test( 9000, 9000, "jumbo frames" );
+  speed_test( 9000, 1500, "jumbo interface, Ethernet hop" );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#include "byte_stream.hh"
+#include "lossy_link.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Send `data` from a TCPSender to a TCPReceiver over a 20 ms RTT link that drops segments (in both directions)
+// at `loss_rate`. The handshake is carried without loss, since a lost SYN is the RTO's job. Returns the
+// milliseconds from the first data segment until the receiver has it all.
+uint64_t transfer( const bool rack_tlp, const string& data, const double loss_rate, const size_t random_seed )
+{
+  constexpr uint64_t delay_ms = 10;
+
+  TCPConfig config;
+  config.isn = Wrap32 { 0 };
+  config.rack_tlp = rack_tlp;
+
+  TCPSender sender { ByteStream { TCPConfig::DEFAULT_CAPACITY }, config };
+  TCPReceiver receiver { Reassembler { ByteStream { TCPConfig::DEFAULT_CAPACITY } } };
+  LossyLink<TCPSenderMessage> data_link { delay_ms, loss_rate, random_seed };
+  LossyLink<TCPReceiverMessage> ack_link { delay_ms, loss_rate, random_seed + 1 };
+
+  sender.push( [&]( const TCPSenderMessage& syn ) { receiver.receive( syn ); } );
+  sender.tick( 2 * delay_ms, []( const TCPSenderMessage& ) {} );
+  sender.receive( receiver.send() );
+
+  uint64_t now = 0;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) { data_link.send( msg, now ); };
+
+  sender.writer().push( data );
+  sender.writer().close();
+
+  while ( not receiver.reader().is_finished() ) {
+    sender.push( transmit );
+    data_link.deliver( now, [&]( TCPSenderMessage msg ) {
+      receiver.receive( std::move( msg ) );
+      receiver.reader().pop( receiver.reader().bytes_buffered() );
+      ack_link.send( receiver.send(), now );
+    } );
+    ack_link.deliver( now, [&]( const TCPReceiverMessage& ack ) {
+      sender.receive( ack );
+      sender.push( transmit );
+    } );
+
+    sender.tick( 1, transmit );
+    ++now;
+  }
+
+  if ( receiver.writer().bytes_pushed() != data.size() ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+  return now;
+}
+
+struct Percentiles
+{
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+};
+
+Percentiles latency( const bool rack_tlp, const string& data, const double loss_rate, const size_t transfers )
+{
+  vector<uint64_t> times;
+  for ( size_t i = 0; i < transfers; ++i ) {
+    times.push_back( transfer( rack_tlp, data, loss_rate, 2 * i + 1 ) );
+  }
+  ranges::sort( times );
+  return { times[transfers / 2], times[transfers * 9 / 10], times[transfers * 99 / 100] };
+}
+
+void speed_test( const double loss_rate )
+{
+  constexpr size_t transfers = 2000;
+  const string data( 15'000, 'x' ); // a short response: 15 segments, a little more than an initial window
+
+  const auto without = latency( false, data, loss_rate, transfers );
+  const auto with = latency( true, data, loss_rate, transfers );
+
+  cout << transfers << " transfers of 15 kB over a 20 ms RTT link with " << fixed << setprecision( 0 )
+       << loss_rate * 100 << "% loss: p50/p90/p99 " << without.p50 << "/" << without.p90 << "/" << without.p99
+       << " ms with RTO recovery, " << with.p50 << "/" << with.p90 << "/" << with.p99 << " ms with RACK-TLP.\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "      " << setw( 2 ) << fixed << setprecision( 0 ) << loss_rate * 100
+               << "% loss: p99 " << setw( 4 ) << without.p99 << " -> " << setw( 4 ) << with.p99
+               << " ms with RACK-TLP\n";
+
+  if ( with.p99 > without.p99 ) {
+    throw runtime_error( "RACK-TLP made the tail latency worse" );
+  }
+}
+
+void program_body()
+{
+  for ( const double loss_rate : { 0.01, 0.02, 0.05 } ) {
+    speed_test( loss_rate );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+#include "reassembler.hh"
+#include "test_should_be.hh"
+
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+
+namespace {
+// Feed the same random overlapping, out-of-order, partly out-of-window substrings to both engines,
+// reading at random moments, and check they agree with each other and with the original data.
+// (The bitmap engine writes into the stream's storage, which for the plain ring wraps at its own offsets.)
+void differential_test( const uint64_t capacity,
+                        const size_t data_len,
+                        const size_t random_seed,
+                        const ByteStream::Backend backend = ByteStream::Backend::MirroredRing )
+{
+  default_random_engine rd { random_seed };
+  const string data = [&] {
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < data_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  Reassembler map_reassembler { ByteStream { capacity } };
+  BitmapReassembler bitmap_reassembler { ByteStream { capacity, backend } };
+  string map_output;
+  string bitmap_output;
+
+  const auto drain = [&] {
+    while ( map_reassembler.reader().bytes_buffered() ) {
+      map_output += map_reassembler.reader().peek();
+      map_reassembler.reader().pop( map_output.size() - map_reassembler.reader().bytes_popped() );
+    }
+    while ( bitmap_reassembler.reader().bytes_buffered() ) {
+      bitmap_output += bitmap_reassembler.reader().peek();
+      bitmap_reassembler.reader().pop( bitmap_output.size() - bitmap_reassembler.reader().bytes_popped() );
+    }
+  };
+
+  uniform_int_distribution<size_t> offset_dist { 0, capacity };
+  uniform_int_distribution<size_t> len_dist { 1, capacity };
+  while ( not map_reassembler.reader().is_finished() ) {
+    const uint64_t base = map_reassembler.writer().bytes_pushed();
+    const uint64_t first_index = min( data.size(), base + offset_dist( rd ) );
+    const string substring = data.substr( first_index, len_dist( rd ) );
+    const bool is_last = first_index + substring.size() == data.size();
+
+    map_reassembler.insert( first_index, substring, is_last );
+    bitmap_reassembler.insert( first_index, substring, is_last );
+
+    // bytes_pending agrees
+    test_should_be( map_reassembler.bytes_pending() == bitmap_reassembler.bytes_pending(), true );
+    // bytes_pushed agrees
+    test_should_be( map_reassembler.writer().bytes_pushed() == bitmap_reassembler.writer().bytes_pushed(), true );
+    // closed agrees
+    test_should_be( map_reassembler.writer().is_closed() == bitmap_reassembler.writer().is_closed(), true );
+    // held_ranges agrees
+    test_should_be( map_reassembler.held_ranges( 4 ) == bitmap_reassembler.held_ranges( 4 ), true );
+
+    if ( rd() % 3 == 0 or map_reassembler.writer().available_capacity() == 0 ) {
+      drain();
+    }
+  }
+  drain();
+
+  // bitmap engine finished
+  test_should_be( bitmap_reassembler.reader().is_finished(), true );
+  // interval map engine reassembled the data
+  test_should_be( map_output == data, true );
+  // bitmap engine reassembled the data
+  test_should_be( bitmap_output == data, true );
+}
+} // namespace
+
+int main()
+{
+  try {
+    differential_test( 1, 100, 1 );
+    differential_test( 63, 5'000, 2 );
+    differential_test( 64, 5'000, 3 );
+    differential_test( 1000, 30'000, 4 );
+    differential_test( 4097, 60'000, 5 );
+    differential_test( 1000, 30'000, 6, ByteStream::Backend::Ring );
+    differential_test( 1000, 30'000, 7, ByteStream::Backend::Deque );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      ReassemblerTestHarness test { "no ranges held", 65000 };
+
+      test.execute( HeldRanges { {} } );
+      test.execute( Insert { "abc", 0 } );
+      test.execute( HeldRanges { {} } );
+    }
+
+    {
+      ReassemblerTestHarness test { "most recent first", 65000 };
+
+      test.execute( Insert { "b", 1 } );
+      test.execute( HeldRanges { { { 1, 2 } } } );
+      test.execute( Insert { "f", 5 } );
+      test.execute( HeldRanges { { { 5, 6 }, { 1, 2 } } } );
+      test.execute( Insert { "d", 3 } );
+      test.execute( HeldRanges { { { 3, 4 }, { 5, 6 }, { 1, 2 } } } );
+      test.execute( Insert { "c", 2 } );
+      test.execute( HeldRanges { { { 1, 4 }, { 5, 6 } } } );
+    }
+
+    {
+      ReassemblerTestHarness test { "delivered ranges drop out", 65000 };
+
+      test.execute( Insert { "cd", 2 } );
+      test.execute( Insert { "gh", 6 } );
+      test.execute( HeldRanges { { { 6, 8 }, { 2, 4 } } } );
+      test.execute( Insert { "ab", 0 } );
+      test.execute( ReadAll( "abcd" ) );
+      test.execute( HeldRanges { { { 6, 8 } } } );
+      test.execute( BytesPending( 2 ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "at most four ranges, the rest in stream order", 65000 };
+
+      for ( const uint64_t i : { 3, 5, 7, 9, 11, 13, 15, 17, 19, 21 } ) {
+        test.execute( Insert { "x", i } );
+      }
+      test.execute( HeldRanges { { { 21, 22 }, { 19, 20 }, { 17, 18 }, { 15, 16 } } } );
+
+      test.execute( Insert { "y", 1 } );
+      test.execute( HeldRanges { { { 1, 2 }, { 21, 22 }, { 19, 20 }, { 17, 18 } } } );
+    }
+
+    {
+      ReassemblerTestHarness test { "ranges are clipped to the window", 8 };
+
+      test.execute( Insert { "cdefghijkl", 2 } );
+      test.execute( HeldRanges { { { 2, 8 } } } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -9,11 +9,14 @@
 #include <queue>
 #include <random>
 #include <tuple>
+#include <vector>
 
 using namespace std;
 using namespace std::chrono;
 
-void speed_test( const size_t num_chunks,   // NOLINT(bugprone-easily-swappable-parameters)
+template<class ReassemblerT>
+void speed_test( const string& engine_name,
+                 const size_t num_chunks,   // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t capacity,     // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t random_seed ) // NOLINT(bugprone-easily-swappable-parameters)
 {
@@ -36,7 +39,7 @@ void speed_test( const size_t num_chunks,   // NOLINT(bugprone-easily-swappable-
     split_data.emplace( i + 1, data.substr( i + 1, capacity * 2 ), i + 1 + capacity * 2 >= data.size() );
   }
 
-  Reassembler reassembler { ByteStream { capacity } };
+  ReassemblerT reassembler { ByteStream { capacity } };
 
   string output_data;
   output_data.reserve( data.size() );
@@ -71,20 +74,105 @@ void speed_test( const size_t num_chunks,   // NOLINT(bugprone-easily-swappable-
   fstream debug_output;
   debug_output.open( "/dev/tty" );
 
-  cout << "Reassembler to ByteStream with capacity=" << capacity << " reached " << fixed << setprecision( 2 )
-       << gigabits_per_second << " Gbit/s.\n";
+  cout << "Reassembler (" << engine_name << ") to ByteStream with capacity=" << capacity << " reached " << fixed
+       << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
 
-  debug_output << "             Reassembler throughput: " << fixed << setprecision( 2 ) << gigabits_per_second
-               << " Gbit/s\n";
+  debug_output << "             Reassembler (" << engine_name << ") throughput: " << fixed << setprecision( 2 )
+               << gigabits_per_second << " Gbit/s\n";
 
   if ( gigabits_per_second < 0.1 ) {
     throw runtime_error( "Reassembler did not meet minimum speed of 0.1 Gbit/s." );
   }
 }
 
+// Leave `num_holes` disjoint holes pending (every other chunk arrives first, in random order), then fill them.
+template<class ReassemblerT>
+void holes_speed_test( const string& engine_name,
+                       const size_t num_holes,   // NOLINT(bugprone-easily-swappable-parameters)
+                       const size_t chunk_size,  // NOLINT(bugprone-easily-swappable-parameters)
+                       const size_t random_seed ) // NOLINT(bugprone-easily-swappable-parameters)
+{
+  const size_t num_chunks = 2 * num_holes + 1;
+  default_random_engine rd { random_seed };
+
+  // Generate the data to be written
+  const string data = [&] {
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < num_chunks * chunk_size; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  vector<size_t> order;
+  for ( size_t i = 1; i < num_chunks; i += 2 ) {
+    order.push_back( i );
+  }
+  shuffle( order.begin(), order.end(), rd );
+  for ( size_t i = 0; i < num_chunks; i += 2 ) {
+    order.push_back( i );
+  }
+
+  queue<tuple<uint64_t, string, bool>> split_data;
+  for ( const size_t i : order ) {
+    split_data.emplace( i * chunk_size, data.substr( i * chunk_size, chunk_size ), i + 1 == num_chunks );
+  }
+
+  ReassemblerT reassembler { ByteStream { data.size() } };
+
+  string output_data;
+  output_data.reserve( data.size() );
+
+  const auto start_time = steady_clock::now();
+  while ( not split_data.empty() ) {
+    auto& next = split_data.front();
+    reassembler.insert( get<uint64_t>( next ), move( get<string>( next ) ), get<bool>( next ) );
+    split_data.pop();
+
+    while ( reassembler.reader().bytes_buffered() ) {
+      output_data += reassembler.reader().peek();
+      reassembler.reader().pop( output_data.size() - reassembler.reader().bytes_popped() );
+    }
+  }
+
+  const auto stop_time = steady_clock::now();
+
+  if ( not reassembler.reader().is_finished() ) {
+    throw runtime_error( "Reassembler did not close ByteStream when finished" );
+  }
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto inserts_per_second = static_cast<double>( num_chunks ) / test_duration.count();
+  auto gigabits_per_second = 8 * static_cast<double>( data.size() ) / test_duration.count() / 1e9;
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "Reassembler (" << engine_name << ") with " << num_holes << " holes pending reached " << fixed
+       << setprecision( 2 ) << gigabits_per_second << " Gbit/s (" << inserts_per_second / 1e6 << " M inserts/s).\n";
+
+  debug_output << "  Reassembler (" << engine_name << ") throughput (" << num_holes << " holes): " << fixed
+               << setprecision( 2 ) << gigabits_per_second << " Gbit/s, " << inserts_per_second / 1e6
+               << " M inserts/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "Reassembler did not meet minimum speed of 0.1 Gbit/s with holes pending." );
+  }
+}
+
 void program_body()
 {
-  speed_test( 10000, 1500, 1370 );
+  speed_test<Reassembler>( "interval map", 10000, 1500, 1370 );
+  speed_test<BitmapReassembler>( "bitmap", 10000, 1500, 1370 );
+  holes_speed_test<Reassembler>( "interval map", 10000, 100, 1370 );
+  holes_speed_test<BitmapReassembler>( "bitmap", 10000, 100, 1370 );
+  holes_speed_test<Reassembler>( "interval map", 100000, 100, 1370 );
+  holes_speed_test<BitmapReassembler>( "bitmap", 100000, 100, 1370 );
 }
 
 int main()
@@ -3,10 +3,12 @@
 #include "byte_stream_test_harness.hh"
 #include "common.hh"
 #include "reassembler.hh"
+#include "tcp_config.hh"
 
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<ByteStream>> T>
 struct ReassemblerTestStep : public TestStep<Reassembler>
@@ -49,6 +51,16 @@ struct BytesPending : public ConstExpectNumber<Reassembler, uint64_t>
   uint64_t value( const Reassembler& r ) const override { return r.bytes_pending(); }
 };
 
+struct HeldRanges : public ConstExpectNumber<Reassembler, std::vector<IndexRange>>
+{
+  using ConstExpectNumber::ConstExpectNumber;
+  std::string name() const override { return "held_ranges"; }
+  std::vector<IndexRange> value( const Reassembler& r ) const override
+  {
+    return r.held_ranges( TCPConfig::MAX_SACK_BLOCKS );
+  }
+};
+
 struct Insert : public Action<Reassembler>
 {
   std::string data_;
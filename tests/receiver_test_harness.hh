@@ -8,6 +8,7 @@
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<Reassembler>> T>
 struct DirectReassemblerTest : public TestStep<TCPReceiver>
@@ -40,10 +41,13 @@ struct DirectByteStreamTest : public TestStep<TCPReceiver>
 class TCPReceiverTestHarness : public TestHarness<TCPReceiver>
 {
 public:
-  TCPReceiverTestHarness( std::string test_name, uint64_t capacity )
+  TCPReceiverTestHarness( std::string test_name,
+                          uint64_t capacity,
+                          ByteStream::Backend backend = ByteStream::Backend::MirroredRing )
     : TestHarness( move( test_name ),
-                   "capacity=" + std::to_string( capacity ),
-                   { TCPReceiver { Reassembler { ByteStream { capacity } } } } )
+                   "capacity=" + std::to_string( capacity ) + ", "
+                     + std::string { ByteStream::backend_name( backend ) } + " backend",
+                   { TCPReceiver { Reassembler { ByteStream { capacity, backend } } } } )
   {}
 
   template<std::derived_from<TestStep<Reassembler>> T>
@@ -61,11 +65,11 @@ public:
   using TestHarness<TCPReceiver>::execute;
 };
 
-struct ExpectWindow : public ExpectNumber<TCPReceiver, uint16_t>
+struct ExpectWindow : public ExpectNumber<TCPReceiver, uint32_t>
 {
   using ExpectNumber::ExpectNumber;
   std::string name() const override { return "window_size"; }
-  uint16_t value( TCPReceiver& rs ) const override { return rs.send().window_size; }
+  uint32_t value( TCPReceiver& rs ) const override { return rs.send().window_size; }
 };
 
 struct ExpectAckno : public ExpectNumber<TCPReceiver, std::optional<Wrap32>>
@@ -75,6 +79,20 @@ struct ExpectAckno : public ExpectNumber<TCPReceiver, std::optional<Wrap32>>
   std::optional<Wrap32> value( TCPReceiver& rs ) const override { return rs.send().ackno; }
 };
 
+struct ExpectSACKBlocks : public ExpectNumber<TCPReceiver, std::vector<std::pair<Wrap32, Wrap32>>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "sack_blocks"; }
+  std::vector<std::pair<Wrap32, Wrap32>> value( TCPReceiver& rs ) const override { return rs.send().sack_blocks; }
+};
+
+struct ExpectTSecr : public ExpectNumber<TCPReceiver, std::optional<uint32_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "TSecr"; }
+  std::optional<uint32_t> value( TCPReceiver& rs ) const override { return rs.send().TSecr; }
+};
+
 struct ExpectReset : public ExpectBool<TCPReceiver>
 {
   using ExpectBool::ExpectBool;
@@ -155,6 +173,18 @@ struct SegmentArrives : public Action<TCPReceiver>
     return *this;
   }
 
+  SegmentArrives& with_data( Cord data )
+  {
+    msg_.payload = std::move( data );
+    return *this;
+  }
+
+  SegmentArrives& with_tsval( uint32_t tsval )
+  {
+    msg_.TSval = tsval;
+    return *this;
+  }
+
   SegmentArrives& without_ackno()
   {
     ackno_expected_ = HasAckno { false };
@@ -176,11 +206,16 @@ struct SegmentArrives : public Action<TCPReceiver>
       ss << " +SYN";
     }
     if ( not msg_.payload.empty() ) {
-      ss << " payload=\"" << Printer::prettify( msg_.payload ) << "\"";
+      // flatten no more than prettify() shows (and one byte more, so it can tell there is more)
+      const Cord shown = msg_.payload.substr( 0, 33 );
+      ss << " payload=\"" << Printer::prettify( static_cast<std::string>( shown ) ) << "\"";
     }
     if ( msg_.FIN ) {
       ss << " +FIN";
     }
+    if ( msg_.TSval.has_value() ) {
+      ss << " TSval=" << msg_.TSval.value();
+    }
     ss << ")";
 
     if ( ackno_expected_.value_ ) {
@@ -0,0 +1,133 @@
+#include "parser.hh"
+#include "random.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "no SACK blocks without holes", 4000 };
+      test.execute( ExpectSACKBlocks { {} } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcd" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 5 } } );
+      test.execute( ExpectSACKBlocks { {} } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "SACK blocks, most recent first", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 3 ).with_data( "cd" ) );
+      test.execute( ExpectSACKBlocks { { { Wrap32 { isn + 3 }, Wrap32 { isn + 5 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ).with_data( "gh" ) );
+      test.execute( ExpectSACKBlocks {
+        { { Wrap32 { isn + 7 }, Wrap32 { isn + 9 } }, { Wrap32 { isn + 3 }, Wrap32 { isn + 5 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "ef" ) );
+      test.execute( ExpectSACKBlocks { { { Wrap32 { isn + 3 }, Wrap32 { isn + 9 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "ab" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 9 } } );
+      test.execute( ExpectSACKBlocks { {} } );
+      test.execute( ReadAll { "abcdefgh" } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiver receiver { Reassembler { ByteStream { 4000 } } };
+      receiver.receive( { Wrap32 { isn }, true, {}, false, false } );
+      for ( const uint32_t offset : { 3, 7, 11, 15, 19 } ) {
+        receiver.receive( { Wrap32 { isn + offset }, false, string { "xy" }, false, false } );
+      }
+
+      TCPSegment segment;
+      segment.message.receiver = receiver.send();
+      segment.message.sender.payload = string { "payload" };
+      segment.compute_checksum( 0 );
+
+      Parser parser { serialize( segment ) };
+      TCPSegment parsed;
+      parsed.parse( parser, 0 );
+      if ( parser.has_error() ) {
+        throw runtime_error( "TCPSegment with a SACK option failed to parse" );
+      }
+      if ( parsed.message.receiver.sack_blocks != segment.message.receiver.sack_blocks
+           or parsed.message.receiver.sack_blocks.size() != TCPConfig::MAX_SACK_BLOCKS ) {
+        throw runtime_error( "SACK blocks did not survive serializing and parsing" );
+      }
+      if ( not( parsed.message.sender.payload == "payload" ) ) {
+        throw runtime_error( "payload after a SACK option did not survive serializing and parsing" );
+      }
+    }
+
+    {
+      TCPSegment syn;
+      syn.message.sender.SYN = true;
+      syn.message.sack_permitted = true;
+      syn.compute_checksum( 0 );
+      if ( syn.header_length() != 20 + 4 ) {
+        throw runtime_error( "SACK-permitted should take one word of options" );
+      }
+
+      Parser parser { serialize( syn ) };
+      TCPSegment parsed;
+      parsed.parse( parser, 0 );
+      if ( parser.has_error() or not parsed.message.sack_permitted ) {
+        throw runtime_error( "SACK-permitted did not survive serializing and parsing" );
+      }
+    }
+
+    // A TCPPeer sends SACK blocks only if the peer's SYN said SACK-permitted too
+    for ( const bool peer_permits : { true, false } ) {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPConfig config;
+      config.delayed_ack = false;
+      TCPPeer peer { config };
+      vector<TCPMessage> sent;
+      const auto transmit = [&]( TCPMessage msg ) { sent.push_back( std::move( msg ) ); };
+
+      TCPMessage syn;
+      syn.sender.seqno = Wrap32 { isn };
+      syn.sender.SYN = true;
+      syn.receiver.window_size = 4000;
+      syn.sack_permitted = peer_permits;
+      peer.receive( std::move( syn ), transmit );
+      if ( sent.size() != 1 or not sent.front().sender.SYN or sent.front().sack_permitted != peer_permits ) {
+        throw runtime_error( "the SYN-ACK should offer SACK only to a peer that offered it" );
+      }
+
+      TCPMessage data;
+      data.sender.seqno = Wrap32 { isn + 3 };
+      data.sender.payload = string { "cd" };
+      data.receiver.ackno = sent.front().sender.seqno + 1;
+      data.receiver.window_size = 4000;
+      peer.receive( std::move( data ), transmit );
+      if ( sent.size() != 2 ) {
+        throw runtime_error( "a segment past a hole should be acknowledged at once" );
+      }
+      if ( sent.back().receiver.sack_blocks.empty() == peer_permits ) {
+        throw runtime_error( peer_permits ? "SACK blocks should go out once both SYNs permit them"
+                                          : "SACK blocks went out to a peer that never said SACK-permitted" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
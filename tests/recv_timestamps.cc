@@ -0,0 +1,82 @@
+#include "random.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "The latest in-order timestamp is echoed, and older ones rejected (PAWS)",
+                                    100 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_tsval( 100 ) );
+      test.execute( ExpectTSecr { 100 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "a" ).with_tsval( 101 ) );
+      test.execute( ExpectTSecr { 101 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 2 ).with_data( "X" ).with_tsval( 99 ) );
+      test.execute( BytesPushed { 1 } );
+      // an out-of-order segment's timestamp is not echoed
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "e" ).with_tsval( 103 ) );
+      test.execute( ExpectTSecr { 101 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 2 ).with_data( "bcd" ).with_tsval( 102 ) );
+      test.execute( ExpectTSecr { 102 } );
+      test.execute( ReadAll { "abcde" } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "Timestamps are compared modulo 2^32", 100 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_tsval( UINT32_MAX - 1 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "a" ).with_tsval( 3 ) );
+      test.execute( BytesPushed { 1 } );
+      // a timestamp from before the clock wrapped is old
+      test.execute( SegmentArrives {}.with_seqno( isn + 2 ).with_data( "X" ).with_tsval( UINT32_MAX ) );
+      test.execute( BytesPushed { 1 } );
+      test.execute( ReadAll { "a" } );
+    }
+
+    // A 5 GiB transfer, long enough that the sequence numbers wrap (and, starting near the top of its range,
+    // so does the timestamp clock). Before each segment arrives, an old duplicate with the same Wrap32 seqno --
+    // the segment sent 4 GiB earlier -- arrives first. The checkpoint can't tell them apart; PAWS can.
+    {
+      constexpr uint64_t segment_size = 1 << 20;
+      constexpr uint64_t segments_per_wrap = ( 1ULL << 32 ) / segment_size;
+      constexpr uint64_t num_segments = 5 * 1024;
+      constexpr uint32_t first_tsval = UINT32_MAX - 2000;
+      const Cord payload { string( segment_size, 'x' ) };
+      const Wrap32 isn { UINT32_MAX - 1000 };
+
+      TCPReceiverTestHarness test { "PAWS rejects old duplicates once seqnos wrap",
+                                    4 * segment_size,
+                                    ByteStream::Backend::Deque };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_tsval( first_tsval ) );
+      for ( uint64_t i = 0; i < num_segments; i++ ) {
+        const Wrap32 seqno = Wrap32::wrap( 1 + i * segment_size, isn );
+        if ( i >= segments_per_wrap ) {
+          const uint32_t old_tsval = first_tsval + 1 + static_cast<uint32_t>( i - segments_per_wrap );
+          test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( payload ).with_tsval( old_tsval ) );
+          test.execute( ExpectAckno { seqno } );
+        }
+        const uint32_t tsval = first_tsval + 1 + static_cast<uint32_t>( i );
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( payload ).with_tsval( tsval ) );
+        test.execute( ExpectAckno { Wrap32::wrap( 1 + ( i + 1 ) * segment_size, isn ) } );
+        test.execute( Pop { segment_size } );
+      }
+      test.execute( BytesPushed { num_segments * segment_size } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
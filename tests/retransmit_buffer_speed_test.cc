@@ -0,0 +1,143 @@
+#include "byte_stream.hh"
+#include "tcp_config.hh"
+#include "tcp_sender.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+
+using namespace std;
+using namespace std::chrono;
+
+// Count the heap this program uses: live bytes and allocations
+namespace {
+uint64_t heap_bytes = 0;
+uint64_t heap_allocations = 0;
+} // namespace
+
+void* operator new( size_t size )
+{
+  void* ptr = malloc( size ? size : 1 );
+  if ( not ptr ) {
+    throw bad_alloc {};
+  }
+  heap_bytes += malloc_usable_size( ptr );
+  heap_allocations++;
+  return ptr;
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  if ( ptr ) {
+    heap_bytes -= malloc_usable_size( ptr );
+    free( ptr );
+  }
+}
+
+void operator delete( void* ptr, size_t ) noexcept
+{
+  operator delete( ptr );
+}
+
+struct MemoryResult
+{
+  double heap_megabytes;            // heap held by one connection with the whole window outstanding
+  double overhead_bytes_per_segment; // heap beyond the payload itself, per outstanding segment
+  double allocations_per_ack;        // heap allocations while the sender processes an ACK
+  double ns_per_ack;                 // time to process an ACK
+};
+
+// Fill a 16 MiB window with full segments from a sender with a 16 MiB buffer, then acknowledge them two
+// segments at a time
+MemoryResult window_test( const ByteStream::Backend backend )
+{
+  constexpr uint64_t window = 16 << 20;
+  constexpr uint64_t mss = 1448;
+  constexpr uint64_t write_size = 64 << 10;
+
+  TCPConfig config;
+  config.isn = Wrap32 { 0 };
+  config.congestion_control = CongestionControl::None;
+  config.plpmtud = false;
+  config.rack_tlp = false;
+  config.nodelay = true;
+
+  const uint64_t heap_before = heap_bytes;
+  TCPSender sender { ByteStream { window, backend }, config };
+  sender.set_max_payload_size( mss );
+  const auto ignore = []( const TCPSenderMessage& ) {};
+  sender.push( ignore );
+  sender.receive( { Wrap32 { 1 }, static_cast<uint32_t>( window ) } );
+
+  const string piece( write_size, 'x' );
+  while ( sender.writer().available_capacity() >= write_size ) {
+    sender.writer().push( piece );
+  }
+  sender.push( ignore );
+  if ( sender.sequence_numbers_in_flight() != window ) {
+    throw runtime_error( "the window was not filled" );
+  }
+  const uint64_t heap_used = heap_bytes - heap_before;
+  const uint64_t segments = ( window + mss - 1 ) / mss;
+
+  const uint64_t allocations_before = heap_allocations;
+  uint64_t acks = 0;
+  const auto start_time = steady_clock::now();
+  for ( uint64_t acked = 0; acked < window; acks++ ) {
+    acked = min( acked + 2 * mss, window );
+    sender.receive( { Wrap32 { static_cast<uint32_t>( 1 + acked ) }, static_cast<uint32_t>( window ) } );
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( sender.sequence_numbers_in_flight() != 0 ) {
+    throw runtime_error( "not everything was acknowledged" );
+  }
+
+  return { static_cast<double>( heap_used ) / ( 1 << 20 ),
+           ( static_cast<double>( heap_used ) - static_cast<double>( window ) ) / static_cast<double>( segments ),
+           static_cast<double>( heap_allocations - allocations_before ) / static_cast<double>( acks ),
+           static_cast<double>( duration_cast<nanoseconds>( stop_time - start_time ).count() )
+             / static_cast<double>( acks ) };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  for ( const auto& [backend, name] : { pair { ByteStream::Backend::Deque, "deque" },
+                                        pair { ByteStream::Backend::MirroredRing, "mirrored ring" } } ) {
+    const auto result = window_test( backend );
+
+    cout << "16 MiB window outstanding, ByteStream (" << name << "): " << fixed << setprecision( 1 )
+         << result.heap_megabytes << " MiB of heap per connection, " << result.overhead_bytes_per_segment
+         << " bytes of overhead per segment; ACK processing: " << setprecision( 2 ) << result.allocations_per_ack
+         << " allocations and " << setprecision( 0 ) << result.ns_per_ack << " ns per ACK.\n";
+
+    debug_output << "      " << setw( 13 ) << name << ": " << fixed << setprecision( 1 ) << setw( 5 )
+                 << result.heap_megabytes << " MiB heap, " << setw( 5 ) << result.overhead_bytes_per_segment
+                 << " B overhead/segment, " << setprecision( 2 ) << result.allocations_per_ack
+                 << " allocations/ACK, " << setprecision( 0 ) << setw( 4 ) << result.ns_per_ack << " ns/ACK\n";
+
+    if ( result.allocations_per_ack > 0 ) {
+      throw runtime_error( "processing an ACK allocated memory" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
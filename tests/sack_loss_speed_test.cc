@@ -0,0 +1,144 @@
+#include "byte_stream.hh"
+#include "lossy_link.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+struct TransferResult
+{
+  double simulated_megabits_per_second; // goodput over the simulated link
+  double retransmitted_fraction;        // payload bytes sent more than once, over bytes delivered
+};
+
+// Send `input_len` bytes from a TCPSender to a TCPReceiver over a simulated link with the given
+// one-way delay that drops segments (in both directions) at `loss_rate`, with or without SACK.
+TransferResult transfer( const double loss_rate,
+                         const bool use_sack,
+                         const size_t input_len,   // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint64_t delay_ms,  // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint64_t rto_ms,    // NOLINT(bugprone-easily-swappable-parameters)
+                         const size_t random_seed )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPSender sender { ByteStream { TCPConfig::DEFAULT_CAPACITY }, Wrap32 { 0 }, rto_ms };
+  TCPReceiver receiver { Reassembler { ByteStream { TCPConfig::DEFAULT_CAPACITY } } };
+  LossyLink<TCPSenderMessage> data_link { delay_ms, loss_rate, random_seed };
+  LossyLink<TCPReceiverMessage> ack_link { delay_ms, loss_rate, random_seed + 1 };
+
+  uint64_t now = 0;
+  uint64_t payload_bytes_sent = 0;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    payload_bytes_sent += msg.payload.size();
+    data_link.send( msg, now );
+  };
+
+  size_t bytes_written = 0;
+  string chunk;
+  string output_data;
+  output_data.reserve( data.size() );
+
+  while ( not receiver.reader().is_finished() ) {
+    const size_t len = min( data.size() - bytes_written, sender.writer().available_capacity() );
+    sender.writer().push( data.substr( bytes_written, len ) );
+    bytes_written += len;
+    if ( bytes_written == data.size() ) {
+      sender.writer().close();
+    }
+    sender.push( transmit );
+
+    // the application reads as soon as bytes arrive, so the window advertised is never held back
+    data_link.deliver( now, [&]( TCPSenderMessage msg ) {
+      receiver.receive( move( msg ) );
+      read( receiver.reader(), receiver.reader().bytes_buffered(), chunk );
+      output_data += chunk;
+      TCPReceiverMessage ack = receiver.send();
+      if ( not use_sack ) {
+        ack.sack_blocks.clear();
+      }
+      ack_link.send( ack, now );
+    } );
+    ack_link.deliver( now, [&]( const TCPReceiverMessage& ack ) {
+      sender.receive( ack );
+      sender.push( transmit );
+    } );
+
+    sender.tick( 1, transmit );
+    ++now;
+  }
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  return { 8 * static_cast<double>( input_len ) / ( static_cast<double>( now ) / 1000 ) / 1e6,
+           static_cast<double>( payload_bytes_sent ) / static_cast<double>( input_len ) - 1 };
+}
+
+void speed_test( const double loss_rate )
+{
+  constexpr size_t input_len = 4e6;
+  constexpr uint64_t delay_ms = 10;
+  constexpr uint64_t rto_ms = 100;
+
+  const auto start_time = steady_clock::now();
+  const auto without_sack = transfer( loss_rate, false, input_len, delay_ms, rto_ms, 1370 );
+  const auto with_sack = transfer( loss_rate, true, input_len, delay_ms, rto_ms, 1370 );
+  const auto test_duration = duration_cast<duration<double>>( steady_clock::now() - start_time );
+
+  cout << "TCPSender -> TCPReceiver over a " << 2 * delay_ms << " ms RTT link with " << fixed << setprecision( 0 )
+       << loss_rate * 100 << "% loss: " << setprecision( 2 ) << without_sack.simulated_megabits_per_second
+       << " Mbit/s without SACK (" << without_sack.retransmitted_fraction * 100 << "% resent), "
+       << with_sack.simulated_megabits_per_second << " Mbit/s with SACK ("
+       << with_sack.retransmitted_fraction * 100 << "% resent). Simulated in " << test_duration.count()
+       << " s.\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "             " << setw( 2 ) << fixed << setprecision( 0 ) << loss_rate * 100
+               << "% loss: " << setprecision( 2 ) << without_sack.simulated_megabits_per_second << " -> "
+               << with_sack.simulated_megabits_per_second << " Mbit/s with SACK\n";
+
+  if ( loss_rate > 0 and with_sack.simulated_megabits_per_second < without_sack.simulated_megabits_per_second ) {
+    throw runtime_error( "SACK made a lossy transfer slower" );
+  }
+}
+
+void program_body()
+{
+  for ( const double loss_rate : { 0.0, 0.01, 0.02, 0.05 } ) {
+    speed_test( loss_rate );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+#include "congestion_control.hh"
+#include "random.hh"
+#include "sender_test_harness.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr uint64_t mss = 1000;
+
+    {
+      NewReno cc { mss };
+      // the initial window is ten segments
+      test_should_be( cc.cwnd(), 10 * mss );
+
+      // slow start doubles the window every round trip
+      for ( int i = 0; i < 10; i++ ) {
+        cc.on_ack( mss, 0 );
+      }
+      test_should_be( cc.cwnd(), 20 * mss );
+
+      // a loss halves the window
+      cc.on_congestion_event( 20 * mss, 0 );
+      test_should_be( cc.cwnd(), 10 * mss );
+
+      // congestion avoidance grows the window by one segment per round trip
+      for ( int i = 0; i < 10; i++ ) {
+        cc.on_ack( mss, 0 );
+      }
+      test_should_be( cc.cwnd(), 11 * mss );
+
+      // a timeout resets the window to one segment, and slow start begins again
+      cc.on_timeout( 11 * mss, 0 );
+      test_should_be( cc.cwnd(), mss );
+      cc.on_ack( mss, 0 );
+      test_should_be( cc.cwnd(), 2 * mss );
+
+      // the window never drops below two segments on a loss
+      cc.on_congestion_event( mss, 0 );
+      test_should_be( cc.cwnd(), 2 * mss );
+
+      // after a timeout, the window still holds one segment of the current size
+      cc.set_mss( 1448 );
+      cc.on_timeout( 2 * mss, 0 );
+      test_should_be( cc.cwnd(), 1448UL );
+    }
+
+    {
+      CUBIC cc { mss };
+      for ( int i = 0; i < 90; i++ ) {
+        cc.on_ack( mss, 0 );
+      }
+      test_should_be( cc.cwnd(), 100 * mss );
+
+      // a loss reduces the window to 0.7 of what it was
+      cc.on_congestion_event( 100 * mss, 0 );
+      test_should_be( cc.cwnd(), 70 * mss );
+
+      // grows quickly at first, then plateaus around the old window (K = cbrt(30 / 0.4) = 4.2 s)
+      uint64_t now = 0;
+      const auto run_for = [&]( uint64_t ms ) {
+        for ( const uint64_t end = now + ms; now < end; now += 10 ) {
+          cc.on_ack( cc.cwnd() / 10, now ); // ten round trips per second, a window of bytes each
+        }
+      };
+      run_for( 2000 );
+      const uint64_t after_2s = cc.cwnd();
+      test_should_be( after_2s > 85 * mss and after_2s < 100 * mss, true );
+      run_for( 2000 );
+      const uint64_t after_4s = cc.cwnd();
+      test_should_be( after_4s - after_2s < after_2s - 70 * mss, true );
+      run_for( 4000 );
+      test_should_be( cc.cwnd() > 105 * mss, true );
+
+      // a timeout resets the window to one segment
+      cc.on_timeout( cc.cwnd(), now );
+      test_should_be( cc.cwnd(), mss );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = CongestionControl::NewReno;
+
+      ConfiguredSenderTestHarness test { "NewReno sends an initial window, and grows it in slow start", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+      test.execute( Push { string( 50000, 'x' ) } );
+      for ( uint32_t i = 0; i < 10; i++ ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 10 * mss } );
+      test.execute( ExpectCongestionWindow { 10 * mss } );
+
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ) );
+      test.execute( AckReceived { isn + 1 + 2 * mss }.with_win( 60000 ) );
+      for ( uint32_t i = 10; i < 14; i++ ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCongestionWindow { 12 * mss } );
+      test.execute( ExpectSeqnosInFlight { 12 * mss } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = CongestionControl::NewReno;
+
+      ConfiguredSenderTestHarness test { "The receiver's window still limits the flight", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+      test.execute( Push { string( 50000, 'x' ) } );
+      for ( uint32_t i = 0; i < 10; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+      }
+      test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 2000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 10 * mss ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 11 * mss ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 2 * mss } );
+      test.execute( ExpectCongestionWindow { 12 * mss } );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.congestion_control = CongestionControl::None;
+
+      ConfiguredSenderTestHarness test { "No congestion window without congestion control", cfg };
+      test.execute( ExpectCongestionWindow { nullopt } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
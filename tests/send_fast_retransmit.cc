@@ -0,0 +1,148 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint32_t mss = TCPConfig::MAX_PAYLOAD_SIZE;
+
+// Connect, write 20 full segments, and see an initial window of them sent
+void send_initial_window( ConfiguredSenderTestHarness& test, Wrap32 isn )
+{
+  test.execute( Push {} );
+  test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+  test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+  test.execute( Push { string( 20 * mss, 'x' ) } );
+  for ( uint32_t i = 0; i < 10; i++ ) {
+    test.execute( ExpectMessage {}.with_no_flags().with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+  }
+  test.execute( ExpectNoSegment {} );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "The third duplicate ACK resends the segment, and halves cwnd", cfg };
+      send_initial_window( test, isn );
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 10 * mss ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 11 * mss ) );
+
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ) );
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ) );
+      test.execute( ExpectNoSegment {} );
+      // an ACK with data or a new window is not a duplicate
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ).carrying_data() );
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 50000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 50000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + mss ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCongestionWindow { 11 * mss / 2 } );
+
+      // further duplicates let new segments out as old ones leave the network
+      for ( int i = 0; i < 5; i++ ) {
+        test.execute( AckReceived { isn + 1 + mss }.with_win( 50000 ) );
+      }
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 12 * mss ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 13 * mss ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "A partial ACK resends the next hole, and a full one ends recovery", cfg };
+      send_initial_window( test, isn );
+      // segments 2 and 5 (starting at 1 + mss and 1 + 4 * mss) are lost
+      for ( int i = 0; i < 4; i++ ) {
+        test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ) );
+      }
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 10 * mss ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 11 * mss ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + mss ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( AckReceived { isn + 1 + 4 * mss }.with_win( 60000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 4 * mss ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCongestionWindow { 11 * mss / 2 } );
+
+      test.execute( AckReceived { isn + 1 + 12 * mss }.with_win( 60000 ) );
+      for ( uint32_t i = 12; i < 18; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      // a new loss can be fast retransmitted, and halves the flight again
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { isn + 1 + 12 * mss }.with_win( 60000 ) );
+      }
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 12 * mss ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCongestionWindow { 3 * mss } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "No fast retransmit of data sent before a timeout (RFC 6582 recover)",
+                                         cfg };
+      send_initial_window( test, isn );
+      test.execute( Tick { TCPConfig::TIMEOUT_DFLT } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.fast_retransmit = false;
+
+      ConfiguredSenderTestHarness test { "Fast retransmit can be turned off", cfg };
+      send_initial_window( test, isn );
+      test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 10 * mss ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 11 * mss ) );
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { isn + 1 + mss }.with_win( 60000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint32_t mss = TCPConfig::MAX_PAYLOAD_SIZE;
+
+// Send the SYN, and have it acknowledged
+void connect( ConfiguredSenderTestHarness& test, Wrap32 isn )
+{
+  test.execute( Push {} );
+  test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+  test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+  test.execute( ExpectNoSegment {} );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "Small writes wait while data is unacknowledged", cfg };
+      connect( test, isn );
+      // with nothing in flight, a small write goes at once
+      test.execute( Push { string( 100, 'a' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( string( 100, 'a' ) ).with_seqno( isn + 1 ) );
+      test.execute( Push { string( 100, 'b' ) } );
+      test.execute( Push { string( 100, 'c' ) } );
+      test.execute( ExpectNoSegment {} );
+      // until they fill a segment
+      test.execute( Push { string( mss - 200, 'd' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( mss ).with_seqno( isn + 101 ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( Push { string( 10, 'e' ) } );
+      test.execute( AckReceived { isn + 101 }.with_win( 60000 ) );
+      test.execute( ExpectNoSegment {} );
+      // once it is all acknowledged, they go
+      test.execute( AckReceived { isn + 101 + mss }.with_win( 60000 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "eeeeeeeeee" ).with_seqno( isn + 101 + mss ) );
+      test.execute( ExpectNoSegment {} );
+
+      // a FIN isn't held back
+      test.execute( Push { "f" }.with_close() );
+      test.execute( ExpectMessage {}.with_fin( true ).with_data( "f" ).with_seqno( isn + 111 + mss ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.nodelay = true;
+
+      ConfiguredSenderTestHarness test { "TCP_NODELAY sends every write", cfg };
+      connect( test, isn );
+      for ( uint32_t i = 0; i < 3; i++ ) {
+        test.execute( Push { "x" } );
+        test.execute( ExpectMessage {}.with_no_flags().with_data( "x" ).with_seqno( isn + 1 + i ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.nodelay = true;
+
+      ConfiguredSenderTestHarness test { "A corked sender holds small segments, even with nothing in flight", cfg };
+      connect( test, isn );
+      test.execute( SetCorked { true } );
+      test.execute( Push { string( 100, 'a' ) } );
+      test.execute( Push { string( 100, 'b' ) } );
+      test.execute( ExpectNoSegment {} );
+      // but sends full ones
+      test.execute( Push { string( 2 * mss, 'c' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( mss ).with_seqno( isn + 1 + mss ) );
+      test.execute( ExpectNoSegment {} );
+      // uncorking sends the rest
+      test.execute( SetCorked { false } );
+      test.execute( Push {} );
+      test.execute(
+        ExpectMessage {}.with_no_flags().with_data( string( 200, 'c' ) ).with_seqno( isn + 1 + 2 * mss ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint32_t mss = TCPConfig::MAX_PAYLOAD_SIZE;
+
+// Send the SYN, and have it acknowledged 20 ms later
+void connect( ConfiguredSenderTestHarness& test, Wrap32 isn )
+{
+  test.execute( Push {} );
+  test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+  test.execute( Tick { 20 } );
+  test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+  test.execute( ExpectNoSegment {} );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "Without pacing, a window is a burst", cfg };
+      connect( test, isn );
+      test.execute( ExpectPacingRate { nullopt } );
+      test.execute( Push { string( 10 * mss, 'x' ) } );
+      for ( uint32_t i = 0; i < 10; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.pacing = true;
+
+      ConfiguredSenderTestHarness test { "A paced window goes out over half a round trip", cfg };
+      connect( test, isn );
+      // in slow start, twice cwnd/SRTT: 10 segments per 20 ms, doubled
+      test.execute( ExpectPacingRate { 1.0 * mss } );
+      test.execute( Push { string( 10 * mss, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextDeadline { 1 } );
+      // push() holds the next segment back until then, and tick() releases it
+      test.execute( Push {} );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + mss ) );
+      test.execute( ExpectNoSegment {} );
+      // a late tick releases one segment, not a burst
+      test.execute( Tick { 8 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 2 * mss ) );
+      test.execute( ExpectNoSegment {} );
+      for ( uint32_t i = 3; i < 10; i++ ) {
+        test.execute( Tick { 1 } );
+        test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+        test.execute( ExpectNoSegment {} );
+      }
+      // with nothing held back, the next deadline is a timer's (the PTO)
+      test.execute( ExpectNextDeadline { 40 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.pacing = true;
+      cfg.pacing_rate = 250'000; // a segment every 4 ms
+
+      ConfiguredSenderTestHarness test { "A pacing rate set in the config wins, and idling earns no burst", cfg };
+      connect( test, isn );
+      test.execute( Push { string( 3 * mss, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextDeadline { 4 } );
+      test.execute( Tick { 3 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + mss ) );
+      test.execute( Tick { 4 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 2 * mss ) );
+
+      test.execute( AckReceived { isn + 1 + 3 * mss }.with_win( 60000 ).without_push() );
+      test.execute( Tick { 1000 } );
+      test.execute( Push { string( 3 * mss, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 3 * mss ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
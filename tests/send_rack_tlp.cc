@@ -0,0 +1,179 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint32_t mss = TCPConfig::MAX_PAYLOAD_SIZE;
+
+// Connect with a 20 ms round trip, write `segments` full segments, and see an initial window of them sent
+void send_segments( ConfiguredSenderTestHarness& test, Wrap32 isn, uint32_t segments )
+{
+  test.execute( Push {} );
+  test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+  test.execute( Tick { 20 } );
+  test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+  test.execute( Push { string( segments * mss, 'x' ) } );
+  for ( uint32_t i = 0; i < min( segments, 10U ); i++ ) {
+    test.execute( ExpectMessage {}.with_no_flags().with_payload_size( mss ).with_seqno( isn + 1 + i * mss ) );
+  }
+  test.execute( ExpectNoSegment {} );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "RACK resends a segment once the reordering window passes", cfg };
+      send_segments( test, isn, 10 );
+      test.execute( Tick { 20 } );
+      // the second segment arrives, but not the first: too few SACKed segments for the DUP_THRESH rule
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ).with_sack( isn + 1 + mss, isn + 1 + 2 * mss ) );
+      test.execute( ExpectNoSegment {} );
+      // the reordering window is a quarter of the min RTT
+      test.execute( Tick { 4 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCongestionWindow { 5 * mss } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "RACK resends a lost retransmission", cfg };
+      send_segments( test, isn, 10 );
+      test.execute( Tick { 20 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ).with_sack( isn + 1 + mss, isn + 1 + 2 * mss ) );
+      test.execute( Tick { 5 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+
+      // segments sent before the retransmission say nothing about it
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ).with_sack( isn + 1 + mss, isn + 1 + 10 * mss ) );
+      test.execute( Tick { 30 } );
+      test.execute( ExpectNoSegment {} );
+      // a segment sent after it does
+      test.execute( Push { string( mss, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 10 * mss ) );
+      test.execute( Tick { 25 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ).with_sack( isn + 1 + mss, isn + 1 + 11 * mss ) );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "A tail loss probe resends the last segment after two round trips", cfg };
+      send_segments( test, isn, 3 );
+      test.execute( Tick { 39 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 2 * mss ) );
+      // only one probe at a time
+      test.execute( Tick { 100 } );
+      test.execute( ExpectNoSegment {} );
+
+      // without DSACK, a resent probe counts as a loss
+      test.execute( AckReceived { isn + 1 + 3 * mss }.with_win( 60000 ).without_push() );
+      test.execute( ExpectCongestionWindow { 2 * mss } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "A tail loss probe sends new data if there is any", cfg };
+      send_segments( test, isn, 12 );
+      test.execute( ExpectSeqnosInFlight { 10 * mss } );
+      test.execute( Tick { 40 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 + 10 * mss ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+
+      ConfiguredSenderTestHarness test { "With one segment out, the probe waits out a delayed ACK", cfg };
+      send_segments( test, isn, 1 );
+      test.execute( Tick { 79 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.ack_delay = 200;
+
+      ConfiguredSenderTestHarness test { "A probe that would come after the RTO isn't armed", cfg };
+      send_segments( test, isn, 1 );
+      test.execute( Tick { 199 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.rack_tlp = false;
+
+      ConfiguredSenderTestHarness test { "Without RACK-TLP, only the RTO resends", cfg };
+      send_segments( test, isn, 3 );
+      test.execute( Tick { 199 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( mss ).with_seqno( isn + 1 ) );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
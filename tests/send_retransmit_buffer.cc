@@ -0,0 +1,114 @@
+#include "random.hh"
+#include "retransmit_buffer.hh"
+#include "sender_test_harness.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const Slice storage { string { "abcdefghij" } };
+      RetransmitBuffer buffer;
+      Cord first { storage.substr( 0, 4 ) };
+      first.append( storage.substr( 4, 3 ) );
+      buffer.append( first );
+      buffer.append( Cord { storage.substr( 7 ) } );
+      buffer.append( Cord { string { "klm" } } );
+      // neighbouring Slices of one string are kept as one
+      test_should_be( buffer.size(), 13UL );
+      test_should_be( buffer.pieces(), 2UL );
+      // a cut may span pieces, and shares them
+      test_should_be( buffer.cut( 5, 7 ) == "fghijkl", true );
+      test_should_be( buffer.cut( 5, 7 ).slices().front().view().data() == storage.view().data() + 5, true );
+
+      // released bytes are gone from the front, and can't be cut any more
+      buffer.release( 3 );
+      test_should_be( buffer.first_index(), 3UL );
+      test_should_be( buffer.cut( 3, 2 ) == "de", true );
+      bool threw = false;
+      try {
+        buffer.cut( 2, 2 );
+      } catch ( const out_of_range& ) {
+        threw = true;
+      }
+      test_should_be( threw, true );
+
+      // releasing past the end empties it
+      buffer.release( 100 );
+      test_should_be( buffer.size(), 0UL );
+      test_should_be( buffer.pieces(), 0UL );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.plpmtud = false;
+      cfg.nodelay = true;
+      cfg.rack_tlp = false;
+      cfg.adaptive_rto = false;
+      string data;
+      for ( int i = 0; i < 3600; i++ ) {
+        data += static_cast<char>( 'a' + i % 26 );
+      }
+      const uint64_t past_rto = 10 * TCPConfig::TIMEOUT_DFLT; // past the backed-off RTO too
+
+      ConfiguredSenderTestHarness test { "Segments cut for a bigger MSS are resent at the MSS in use", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+      test.execute( SetMaxPayloadSize { 1400 } );
+      test.execute( Push { data }.with_close() );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( data.substr( 0, 1400 ) ).with_seqno( isn + 1 ) );
+      test.execute(
+        ExpectMessage {}.with_no_flags().with_data( data.substr( 1400, 1400 ) ).with_seqno( isn + 1401 ) );
+      test.execute( ExpectMessage {}.with_fin( true ).with_data( data.substr( 2800 ) ).with_seqno( isn + 2801 ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( SetMaxPayloadSize { 1000 } );
+      test.execute( Tick { past_rto } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( data.substr( 0, 1000 ) ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 3601 } );
+
+      test.execute( AckReceived { isn + 1001 }.with_win( 60000 ) );
+      test.execute( Tick { past_rto } );
+      test.execute(
+        ExpectMessage {}.with_no_flags().with_data( data.substr( 1000, 400 ) ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( AckReceived { isn + 2801 }.with_win( 60000 ) );
+      test.execute( SetMaxPayloadSize { 500 } );
+      test.execute( Tick { past_rto } );
+      test.execute(
+        ExpectMessage {}.with_no_flags().with_data( data.substr( 2800, 500 ) ).with_seqno( isn + 2801 ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( AckReceived { isn + 3301 }.with_win( 60000 ) );
+      test.execute( Tick { past_rto } );
+      test.execute( ExpectMessage {}.with_fin( true ).with_data( data.substr( 3300 ) ).with_seqno( isn + 3301 ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( AckReceived { isn + 3602 }.with_win( 60000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      RetransmissionTimer timer { 1000, 200, 60000 };
+      // the initial RTO is used until there is a sample
+      test_should_be( timer.rto(), 1000UL );
+      test_should_be( timer.srtt().has_value(), false );
+
+      // the first sample sets SRTT = R, RTTVAR = R/2, and RTO = SRTT + 4 * RTTVAR
+      timer.on_new_ack( 100 );
+      test_should_be( timer.srtt().value(), 100.0 );
+      test_should_be( timer.rttvar().value(), 50.0 );
+      test_should_be( timer.rto(), 300UL );
+
+      // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R
+      timer.on_new_ack( 200 );
+      test_should_be( timer.rttvar().value(), 62.5 );
+      test_should_be( timer.srtt().value(), 112.5 );
+      // the RTO is rounded up to whole milliseconds
+      test_should_be( timer.rto(), 363UL );
+
+      // a timeout doubles the RTO, which stays backed off until an unambiguous sample (Karn's algorithm)
+      timer.exponential_backoff();
+      test_should_be( timer.rto(), 726UL );
+      timer.on_new_ack( {} );
+      test_should_be( timer.rto(), 726UL );
+      timer.on_new_ack( 112 );
+      test_should_be( timer.rto() < 363, true );
+
+      // the RTO is never below the minimum, or above the maximum
+      for ( int i = 0; i < 50; i++ ) {
+        timer.on_new_ack( 5 );
+      }
+      test_should_be( timer.rto(), 200UL );
+      for ( int i = 0; i < 20; i++ ) {
+        timer.exponential_backoff();
+      }
+      test_should_be( timer.rto(), 60000UL );
+
+      // a fixed timer goes back to its initial RTO
+      RetransmissionTimer fixed { 1000 };
+      fixed.exponential_backoff();
+      fixed.on_new_ack( 100 );
+      test_should_be( fixed.rto(), 1000UL );
+      test_should_be( fixed.srtt().has_value(), false );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rack_tlp = false; // no tail loss probe ahead of the RTO
+
+      ConfiguredSenderTestHarness test { "The RTO follows measured round trips, except of retransmissions", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 214 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+      test.execute( ExpectSRTT { 214.0 } );
+      test.execute( ExpectRTO { 642 } );
+
+      test.execute( Push { string( 1000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( Tick { 641 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectRTO { 1284 } );
+
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { isn + 1001 }.with_win( 60000 ) );
+      test.execute( ExpectSRTT { 214.0 } );
+      test.execute( ExpectRTO { 1284 } );
+
+      test.execute( Push { string( 1000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( Tick { 300 } );
+      test.execute( AckReceived { isn + 2001 }.with_win( 60000 ) );
+      test.execute( ExpectSRTT { 224.75 } );
+      test.execute( ExpectRTO { 632 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+
+      ConfiguredSenderTestHarness test { "A fixed RTO ignores round trips", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Tick { 214 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ) );
+      test.execute( ExpectSRTT { nullopt } );
+      test.execute( ExpectRTO { TCPConfig::TIMEOUT_DFLT } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      ConfiguredSenderTestHarness test { "Segments carry the sender's clock, and echoes of it give RTT samples",
+                                         cfg };
+      test.execute( Tick { 10 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ).with_tsval( 10 ) );
+      test.execute( Tick { 50 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 60000 ).with_tsecr( 10 ) );
+      test.execute( ExpectSRTT { 50.0 } );
+
+      test.execute( Push { "hello" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "hello" ).with_seqno( isn + 1 ).with_tsval( 60 ) );
+      // a retransmission carries the time it was resent
+      test.execute( Tick { 200 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "hello" ).with_seqno( isn + 1 ).with_tsval( 260 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // so the ACK of a retransmission still gives a sample
+      test.execute( Tick { 30 } );
+      test.execute( AckReceived { isn + 6 }.with_win( 60000 ).with_tsecr( 260 ) );
+      test.execute( ExpectSRTT { 47.5 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -7,6 +7,7 @@
 #include "tcp_sender.hh"
 #include "wrapping_integers.hh"
 
+#include <array>
 #include <optional>
 #include <queue>
 #include <sstream>
@@ -34,7 +35,7 @@ inline std::string to_string( const TCPSenderMessage& msg )
     o << " +SYN";
   }
   if ( not msg.payload.empty() ) {
-    o << " payload=\"" << Printer::prettify( msg.payload ) << "\"";
+    o << " payload=\"" << Printer::prettify( static_cast<std::string>( msg.payload ) ) << "\"";
   }
   if ( msg.FIN ) {
     o << " +FIN";
@@ -80,6 +81,44 @@ struct ExpectConsecutiveRetransmissions : public ExpectNumber<SenderAndOutput, u
   uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.consecutive_retransmissions(); }
 };
 
+struct ExpectCongestionWindow : public ExpectNumber<SenderAndOutput, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "congestion_window"; }
+  std::optional<uint64_t> value( SenderAndOutput& ss ) const override { return ss.sender.congestion_window(); }
+};
+
+struct ExpectRTO : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "retransmission_timer().rto()"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.retransmission_timer().rto(); }
+};
+
+struct ExpectSRTT : public ExpectNumber<SenderAndOutput, std::optional<double>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "retransmission_timer().srtt()"; }
+  std::optional<double> value( SenderAndOutput& ss ) const override
+  {
+    return ss.sender.retransmission_timer().srtt();
+  }
+};
+
+struct ExpectPacingRate : public ExpectNumber<SenderAndOutput, std::optional<double>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_rate"; }
+  std::optional<double> value( SenderAndOutput& ss ) const override { return ss.sender.pacing_rate(); }
+};
+
+struct ExpectNextDeadline : public ExpectNumber<SenderAndOutput, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "next_deadline"; }
+  std::optional<uint64_t> value( SenderAndOutput& ss ) const override { return ss.sender.next_deadline(); }
+};
+
 struct ExpectNoSegment : public Expectation<SenderAndOutput>
 {
   std::string description() const override { return "nothing to send"; }
@@ -104,6 +143,27 @@ struct HasError : public ExpectBool<SenderAndOutput>
   bool value( SenderAndOutput& ss ) const override { return ss.sender.writer().has_error(); }
 };
 
+struct SetCorked : public Action<SenderAndOutput>
+{
+  bool corked_;
+
+  explicit SetCorked( bool corked ) : corked_( corked ) {}
+  std::string description() const override
+  {
+    return "set_corked(" + ExpectationViolation::boolstr( corked_ ) + ")";
+  }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.set_corked( corked_ ); }
+};
+
+struct SetMaxPayloadSize : public Action<SenderAndOutput>
+{
+  uint64_t size_;
+
+  explicit SetMaxPayloadSize( uint64_t size ) : size_( size ) {}
+  std::string description() const override { return "set_max_payload_size(" + std::to_string( size_ ) + ")"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.set_max_payload_size( size_ ); }
+};
+
 struct Push : public Action<SenderAndOutput>
 {
   std::string data_;
@@ -186,13 +246,24 @@ struct Tick : public Action<SenderAndOutput>
 struct Receive : public Action<SenderAndOutput>
 {
   TCPReceiverMessage msg_;
+  bool carries_data_ {};
   bool push_ = true;
 
   explicit Receive( TCPReceiverMessage msg ) : msg_( msg ) {}
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size;
+    if ( not msg_.sack_blocks.empty() ) {
+      desc << ", sack=" << to_string( msg_.sack_blocks );
+    }
+    if ( msg_.TSecr.has_value() ) {
+      desc << ", TSecr=" << msg_.TSecr.value();
+    }
+    desc << ")";
+    if ( carries_data_ ) {
+      desc << " with data";
+    }
     if ( push_ ) {
       desc << ", then push stream to TCPSender";
     }
@@ -205,9 +276,27 @@ struct Receive : public Action<SenderAndOutput>
     return *this;
   }
 
+  Receive& with_sack( Wrap32 left, Wrap32 right )
+  {
+    msg_.sack_blocks.emplace_back( left, right );
+    return *this;
+  }
+
+  Receive& with_tsecr( uint32_t tsecr )
+  {
+    msg_.TSecr = tsecr;
+    return *this;
+  }
+
+  Receive& carrying_data()
+  {
+    carries_data_ = true;
+    return *this;
+  }
+
   void execute( SenderAndOutput& ss ) const override
   {
-    ss.sender.receive( msg_ );
+    ss.sender.receive( msg_, carries_data_ );
     if ( push_ ) {
       ss.sender.push( ss.make_transmit() );
     }
@@ -238,6 +327,7 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<uint32_t> tsval {};
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -283,6 +373,12 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     return *this;
   }
 
+  ExpectMessage& with_tsval( uint32_t tsval_ )
+  {
+    tsval = tsval_;
+    return *this;
+  }
+
   std::string message_description() const
   {
     std::ostringstream o;
@@ -308,6 +404,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( rst.has_value() ) {
       o << ( rst.value() ? " +RST" : " (no RST)" );
     }
+    if ( tsval.has_value() ) {
+      o << " TSval=" << tsval.value();
+    }
     return o.str();
   }
 
@@ -337,16 +436,20 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( seqno.has_value() and seg.seqno != seqno.value() ) {
       throw ExpectationViolation( "sequence number", seqno.value(), seg.seqno );
     }
+    if ( tsval.has_value() and seg.TSval != tsval ) {
+      throw ExpectationViolation( "TSval", tsval, seg.TSval );
+    }
     if ( payload_size.has_value() and seg.payload.size() != payload_size.value() ) {
       throw ExpectationViolation( "payload_size", payload_size.value(), seg.payload.size() );
     }
-    if ( seg.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE ) {
+    if ( seg.payload.size() > ss.sender.max_payload_size() ) {
       throw ExpectationViolation( "payload has length (" + std::to_string( seg.payload.size() )
                                   + ") greater than the maximum" );
     }
     if ( data.has_value() and data.value() != static_cast<std::string>( seg.payload ) ) {
       throw ExpectationViolation( "Expecting payload of \"" + Printer::prettify( data.value() )
-                                  + "\", but instead it was \"" + Printer::prettify( seg.payload ) + "\"" );
+                                  + "\", but instead it was \""
+                                  + Printer::prettify( static_cast<std::string>( seg.payload ) ) + "\"" );
     }
 
     ss.output.pop();
@@ -362,3 +465,25 @@ public:
                    { TCPSender { ByteStream { config.send_capacity }, config.isn, config.rt_timeout } } )
   {}
 };
+
+// A TCPSender built from all of the TCPConfig, with the congestion control, loss recovery, pacing and Nagle
+// options it names
+class ConfiguredSenderTestHarness : public TestHarness<SenderAndOutput>
+{
+  static std::string describe( const TCPConfig& config )
+  {
+    static constexpr std::array congestion_control_names { "None", "NewReno", "CUBIC" };
+    const auto congestion_control = static_cast<size_t>( config.congestion_control );
+    std::ostringstream desc;
+    desc << "initial_RTO_ms=" << config.rt_timeout << " adaptive_rto=" << config.adaptive_rto
+         << " congestion_control=" << congestion_control_names.at( congestion_control )
+         << " fast_retransmit=" << config.fast_retransmit << " rack_tlp=" << config.rack_tlp
+         << " pacing=" << config.pacing << " nodelay=" << config.nodelay;
+    return desc.str();
+  }
+
+public:
+  ConfiguredSenderTestHarness( std::string name, const TCPConfig& config )
+    : TestHarness( move( name ), describe( config ), { TCPSender { ByteStream { config.send_capacity }, config } } )
+  {}
+};
@@ -0,0 +1,176 @@
+#include "address.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "sharded_tcp_stack.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+string read_all( TCPStack::Connection& connection )
+{
+  string ret;
+  Reader& inbound = connection.peer.inbound_reader();
+  while ( inbound.bytes_buffered() ) {
+    ret += inbound.peek();
+    inbound.pop( inbound.peek().size() );
+  }
+  return ret;
+}
+
+constexpr size_t SHARDS = 3;
+constexpr uint16_t CONNECTIONS = 30;
+
+// Clients on one sharded stack and an echo server on another, with their queues linked by socketpairs. With
+// `crossed`, each client queue is linked to the server queue after its own, so every datagram arrives on a
+// shard that doesn't own its connection and has to be passed on.
+void echo_test( const bool crossed )
+{
+  vector<FileDescriptor> client_queues;
+  array<int, SHARDS> server_fds {};
+  for ( size_t i = 0; i < SHARDS; i++ ) {
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+    client_queues.emplace_back( fds[0] );
+    server_fds.at( ( i + ( crossed ? 1 : 0 ) ) % SHARDS ) = fds[1];
+  }
+  vector<FileDescriptor> server_queues;
+  for ( const int fd : server_fds ) {
+    server_queues.emplace_back( fd );
+  }
+
+  TCPConfig config;
+  config.rt_timeout = 10;
+  config.rto_min = 10;
+
+  // what each shard saw, written only by its own thread
+  array<vector<FourTuple>, SHARDS> server_seen {};
+  array<map<uint16_t, string>, SHARDS> echoed {};
+  array<set<uint16_t>, SHARDS> finished {};
+  atomic<size_t> finished_count {};
+
+  const auto server_setup = [&]( TCPStack& stack, size_t shard ) {
+    const auto echo = [&stack, &server_seen, shard]( TCPStack::Connection& connection ) {
+      server_seen.at( shard ).push_back( connection.tuple );
+      connection.peer.outbound_writer().push( read_all( connection ) );
+      if ( connection.peer.inbound_reader().is_finished() ) {
+        connection.peer.outbound_writer().close();
+      }
+      stack.push( connection );
+    };
+    stack.listen( config, Address { "10.0.0.2", 80 } );
+    stack.set_handler( echo );
+    stack.set_accept_handler( [&stack, echo]( uint16_t port ) {
+      while ( TCPStack::Connection* connection = stack.accept( port ) ) {
+        echo( *connection );
+      }
+    } );
+  };
+  const auto client_setup = [&]( TCPStack& stack, size_t shard ) {
+    stack.set_handler( [&, shard]( TCPStack::Connection& connection ) {
+      const uint16_t port = connection.tuple.local_port;
+      echoed.at( shard )[port] += read_all( connection );
+      if ( connection.peer.inbound_reader().is_finished() and finished.at( shard ).insert( port ).second ) {
+        finished_count++;
+      }
+    } );
+  };
+
+  uint64_t forwarded = 0;
+  array<size_t, CONNECTIONS> owner {};
+  {
+    ShardedTCPStack server { std::move( server_queues ), server_setup };
+    ShardedTCPStack client { std::move( client_queues ), client_setup };
+
+    const Address remote { "10.0.0.2", 80 };
+    for ( uint16_t i = 0; i < CONNECTIONS; i++ ) {
+      const Address local { "10.0.0.1", static_cast<uint16_t>( 1000 + i ) };
+      owner.at( i ) = client.shard_of( { local.ipv4_numeric(), remote.ipv4_numeric(), local.port(), 80 } );
+      client.post( owner.at( i ), [&config, local, remote]( TCPStack& stack ) {
+        TCPStack::Connection& connection = stack.connect( config, local, remote );
+        connection.peer.outbound_writer().push( "hello from " + to_string( local.port() ) );
+        connection.peer.outbound_writer().close();
+        stack.push( connection );
+      } );
+    }
+
+    const auto start = steady_clock::now();
+    while ( finished_count < CONNECTIONS and steady_clock::now() - start < seconds { 10 } ) {
+      this_thread::sleep_for( milliseconds { 1 } );
+    }
+    // (each stack stops before either closes its fds, which would make the other's writes fail)
+    client.stop();
+    server.stop();
+    for ( size_t shard = 0; shard < SHARDS; shard++ ) {
+      forwarded += client.forwarded( shard ) + server.forwarded( shard );
+    }
+  }
+
+  // every connection finishes
+  test_should_be( finished_count == CONNECTIONS, true );
+  for ( uint16_t i = 0; i < CONNECTIONS; i++ ) {
+    const uint16_t port = 1000 + i;
+    // each connection gets its own bytes back, on the shard that owns it
+    test_should_be( echoed.at( owner.at( i ) )[port] == "hello from " + to_string( port ), true );
+  }
+  for ( size_t shard = 0; shard < SHARDS; shard++ ) {
+    for ( const FourTuple& tuple : server_seen.at( shard ) ) {
+      // the server handles it on the client's shard
+      test_should_be( owner.at( tuple.remote_port - 1000 ) == shard, true );
+    }
+  }
+  if ( crossed ) {
+    // datagrams that arrive on the wrong queue are passed on
+    test_should_be( forwarded > 0, true );
+  } else {
+    // and with the queues matched, nothing has to be
+    test_should_be( forwarded == 0, true );
+  }
+}
+
+void flow_hash_test()
+{
+  const FourTuple tuple { 0x0a000001, 0x0a000002, 1000, 80 };
+  const FourTuple reverse { 0x0a000002, 0x0a000001, 80, 1000 };
+  // both ends hash a flow alike
+  test_should_be( FourTuple::FlowHash {}( tuple ) == FourTuple::FlowHash {}( reverse ), true );
+
+  array<size_t, 4> per_shard {};
+  for ( uint16_t port = 1000; port < 5000; port++ ) {
+    per_shard.at( FourTuple::FlowHash {}( { 0x0a000001, 0x0a000002, port, 80 } ) % per_shard.size() )++;
+  }
+  for ( const size_t count : per_shard ) {
+    // and consecutive ports spread evenly over the shards
+    test_should_be( count > 800 and count < 1200, true );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    flow_hash_test();
+    echo_test( false );
+    echo_test( true );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
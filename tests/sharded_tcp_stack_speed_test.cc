@@ -0,0 +1,175 @@
+#include "address.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "sharded_tcp_stack.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t CONNECTIONS = 256;
+
+// CONNECTIONS clients, spread over `shards` shards of one ShardedTCPStack, each send their share of `data` to
+// a server on another one with as many shards. Queue i of one is linked to queue i of the other by an AF_UNIX
+// datagram socketpair, as two multi-queue devices steering by the same flow hash would be.
+double transfer( const size_t shards, const string& data )
+{
+  constexpr int socket_buffer = 4 << 20;
+  const size_t per_connection = data.size() / CONNECTIONS;
+
+  vector<FileDescriptor> client_queues;
+  vector<FileDescriptor> server_queues;
+  for ( size_t i = 0; i < shards; i++ ) {
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+    for ( const int fd : fds ) {
+      CheckSystemCall( "setsockopt",
+                       ::setsockopt( fd, SOL_SOCKET, SO_SNDBUF, &socket_buffer, sizeof( socket_buffer ) ) );
+    }
+    client_queues.emplace_back( fds[0] );
+    server_queues.emplace_back( fds[1] );
+  }
+
+  TCPConfig config;
+  config.rt_timeout = 10;
+  config.rto_min = 10;
+
+  // the server reads everything, and closes its end when the client has
+  atomic<uint64_t> bytes_read {};
+  atomic<size_t> finished {};
+  const auto server_setup = [&]( TCPStack& stack, size_t ) {
+    const auto read_and_close = [&stack, &bytes_read, &finished]( TCPStack::Connection& connection ) {
+      Reader& inbound = connection.peer.inbound_reader();
+      uint64_t len = 0;
+      while ( inbound.bytes_buffered() ) {
+        const auto chunk = inbound.peek();
+        len += chunk.size();
+        inbound.pop( chunk.size() );
+      }
+      bytes_read.fetch_add( len, memory_order_relaxed );
+      if ( inbound.is_finished() and not connection.peer.outbound_writer().is_closed() ) {
+        connection.peer.outbound_writer().close();
+        stack.push( connection );
+        finished++;
+      }
+    };
+    stack.listen( config, Address { "10.144.0.2", 80 }, CONNECTIONS );
+    stack.set_handler( read_and_close );
+    stack.set_accept_handler( [&stack, read_and_close]( uint16_t port ) {
+      while ( TCPStack::Connection* connection = stack.accept( port ) ) {
+        read_and_close( *connection );
+      }
+    } );
+  };
+
+  // each client writes its share as the window opens (what it has written is kept by its shard's thread)
+  vector<unordered_map<uint16_t, size_t>> written( shards );
+  const auto write_more = [&]( TCPStack& stack, size_t shard, TCPStack::Connection& connection ) {
+    Writer& outbound = connection.peer.outbound_writer();
+    size_t& done = written.at( shard )[connection.tuple.local_port];
+    if ( outbound.is_closed() ) {
+      return;
+    }
+    const size_t len = min( per_connection - done, outbound.available_capacity() );
+    outbound.push( data.substr( done, len ) );
+    done += len;
+    if ( done == per_connection ) {
+      outbound.close();
+    }
+    stack.push( connection );
+  };
+  const auto client_setup = [&]( TCPStack& stack, size_t shard ) {
+    stack.set_handler( [&stack, shard, &write_more]( TCPStack::Connection& connection ) {
+      write_more( stack, shard, connection );
+    } );
+  };
+
+  ShardedTCPStack server { std::move( server_queues ), server_setup };
+  ShardedTCPStack client { std::move( client_queues ), client_setup };
+
+  const auto start_time = steady_clock::now();
+  const Address remote { "10.144.0.2", 80 };
+  for ( size_t i = 0; i < CONNECTIONS; i++ ) {
+    const Address local { "10.144.0.1", static_cast<uint16_t>( 1024 + i ) };
+    const size_t shard = client.shard_of( { local.ipv4_numeric(), remote.ipv4_numeric(), local.port(), 80 } );
+    client.post( shard, [&, local, shard]( TCPStack& stack ) {
+      write_more( stack, shard, stack.connect( config, local, remote ) );
+    } );
+  }
+  while ( finished < CONNECTIONS ) {
+    this_thread::sleep_for( microseconds { 100 } );
+  }
+  const auto stop_time = steady_clock::now();
+  client.stop();
+  server.stop();
+
+  uint64_t forwarded = 0;
+  for ( size_t shard = 0; shard < shards; shard++ ) {
+    forwarded += client.forwarded( shard ) + server.forwarded( shard );
+  }
+  if ( bytes_read != per_connection * CONNECTIONS or forwarded != 0 ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const auto elapsed = duration_cast<duration<double>>( stop_time - start_time ).count();
+  return 8 * static_cast<double>( bytes_read ) / elapsed / 1e9;
+}
+
+void program_body()
+{
+  const string data( 16 << 20, 'x' );
+  const size_t cores = max( 1U, thread::hardware_concurrency() );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  double one_shard = 0;
+  for ( const size_t shards : { 1, 2, 4 } ) {
+    const double gigabits_per_second = transfer( shards, data );
+    if ( shards == 1 ) {
+      one_shard = gigabits_per_second;
+    }
+
+    // each shard is two threads (one in the client stack and one in the server's)
+    const double expected = static_cast<double>( min( shards, max<size_t>( 1, cores / 2 ) ) );
+
+    cout << "16 MiB over " << CONNECTIONS << " connections on " << shards << " shard" << ( shards == 1 ? "" : "s" )
+         << " (" << cores << " core" << ( cores == 1 ? "" : "s" ) << "): " << fixed << setprecision( 2 )
+         << gigabits_per_second << " Gbit/s, " << gigabits_per_second / one_shard << "x one shard's (vs. "
+         << expected << "x with perfect scaling).\n";
+
+    debug_output << "      " << shards << " shards: " << fixed << setprecision( 2 ) << setw( 5 )
+                 << gigabits_per_second << " Gbit/s (" << gigabits_per_second / one_shard << "x)\n";
+
+    if ( gigabits_per_second < 0.5 * expected * one_shard ) {
+      throw runtime_error( "throughput didn't scale with the shards" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+#include "eventfd.hh"
+#include "exception.hh"
+#include "spsc_byte_ring.hh"
+#include "test_should_be.hh"
+
+#include <exception>
+#include <iostream>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace {
+void wait_for( EventFD& wakeup )
+{
+  pollfd pfd { wakeup.fd_num(), POLLIN, 0 };
+  CheckSystemCall( "poll", ::poll( &pfd, 1, -1 ) );
+  wakeup.clear();
+}
+
+void single_thread_test()
+{
+  EventFD consumer_wakeup;
+  EventFD producer_wakeup;
+  SPSCByteRing ring { 8, consumer_wakeup, producer_wakeup };
+
+  // push into an empty ring
+  test_should_be( ring.push( "abcdef" ) == 6, true );
+  // no wakeup when the consumer didn't ask for one
+  test_should_be( consumer_wakeup.clear() == 0, true );
+  // peek
+  test_should_be( ring.peek() == "abcdef", true );
+  ring.pop( 4 );
+  // push stops when the ring is full
+  test_should_be( ring.push( "ghijklmn" ) == 6, true );
+  // full
+  test_should_be( ring.available_capacity() == 0, true );
+  // peek stops at the wrap point
+  test_should_be( ring.peek() == "efgh", true );
+
+  // producer may sleep on a full ring
+  test_should_be( ring.request_space_wakeup(), true );
+  ring.pop( 3 );
+  // no wakeup until half the ring is free
+  test_should_be( producer_wakeup.clear() == 0, true );
+  ring.pop( 1 );
+  // wakeup once half the ring is free
+  test_should_be( producer_wakeup.clear() == 1, true );
+
+  // peek after the wrap point
+  test_should_be( ring.peek() == "ijkl", true );
+  ring.pop( 4 );
+  // consumer may sleep on an empty ring
+  test_should_be( ring.request_data_wakeup(), true );
+  // push after the consumer asked for a wakeup
+  test_should_be( ring.push( "o" ) == 1, true );
+  // wakeup when the ring becomes non-empty
+  test_should_be( consumer_wakeup.clear() == 1, true );
+  // consumer shouldn't sleep with bytes buffered
+  test_should_be( ring.request_data_wakeup(), false );
+
+  ring.close();
+  // not finished with bytes buffered
+  test_should_be( ring.is_finished(), false );
+  ring.pop( 1 );
+  // finished
+  test_should_be( ring.is_finished(), true );
+  // consumer shouldn't sleep on a closed ring
+  test_should_be( ring.request_data_wakeup(), false );
+}
+
+void two_thread_test()
+{
+  const string data = [] {
+    default_random_engine rd { 1370 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < 4'000'000; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  EventFD consumer_wakeup;
+  EventFD producer_wakeup;
+  SPSCByteRing ring { 4093, consumer_wakeup, producer_wakeup };
+
+  thread producer( [&] {
+    size_t offset = 0;
+    while ( offset < data.size() ) {
+      offset += ring.push( string_view { data }.substr( offset, 1500 ) );
+      if ( ring.available_capacity() == 0 and ring.request_space_wakeup() ) {
+        wait_for( producer_wakeup );
+      }
+    }
+    ring.close();
+  } );
+
+  string received;
+  while ( not ring.is_finished() ) {
+    const string_view bytes = ring.peek();
+    received.append( bytes );
+    ring.pop( bytes.size() );
+    if ( ring.request_data_wakeup() ) {
+      wait_for( consumer_wakeup );
+    }
+  }
+  producer.join();
+
+  // bytes received by the consumer thread match those pushed by the producer
+  test_should_be( received == data, true );
+}
+} // namespace
+
+int main()
+{
+  try {
+    single_thread_test();
+    two_thread_test();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+#include "address.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "random.hh"
+#include "tcp_config.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_stack.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+
+using namespace std;
+using namespace std::chrono;
+
+struct ListenResult
+{
+  double connections_per_second; // short request/response connections completed
+  size_t peak_connections;       // most connections the server held at once (real, spoofed and lingering)
+  size_t completed;
+};
+
+constexpr size_t BACKLOG = 128;
+constexpr size_t CONCURRENT = 64;           // clients in progress at once
+constexpr size_t TOTAL = 2000;              // connections to complete
+constexpr uint64_t FLOOD_SYNS_PER_MS = 10;  // spoofed SYNs, from addresses that never answer
+constexpr uint64_t TIME_LIMIT_MS = 3000;    // (the legitimate clients may not get through at all)
+
+// Clients open short connections (a request, a response and both FINs) to a listener on one TCPStack, while
+// an attacker may be sending SYNs from spoofed addresses through the same fd. Each round of reading both
+// stacks counts as a millisecond, so what happens doesn't depend on how busy the machine is (only how fast).
+ListenResult serve( const bool syn_cookies, const bool flood )
+{
+  constexpr int socket_buffer = 4 << 20;
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  for ( const int fd : fds ) {
+    CheckSystemCall( "setsockopt",
+                     ::setsockopt( fd, SOL_SOCKET, SO_SNDBUF, &socket_buffer, sizeof( socket_buffer ) ) );
+  }
+  FileDescriptor client_fd { fds[0] };
+  FileDescriptor spoofer = client_fd.duplicate(); // for SYNs from nowhere, bypassing the client's stack
+  TCPStack client { std::move( client_fd ) };
+  TCPStack server { FileDescriptor { fds[1] } };
+
+  TCPConfig config;
+  config.rt_timeout = 4; // a closed connection lingers for ten of these
+  config.rto_min = 4;
+
+  const Address server_address { "10.144.0.2", 80 };
+  server.listen( config, server_address, BACKLOG, syn_cookies );
+  const auto respond = [&]( TCPStack::Connection& connection ) {
+    Reader& inbound = connection.peer.inbound_reader();
+    inbound.pop( inbound.bytes_buffered() );
+    if ( inbound.is_finished() and not connection.peer.outbound_writer().is_closed() ) {
+      connection.peer.outbound_writer().push( "HTTP/1.1 200 OK\r\n\r\n" );
+      connection.peer.outbound_writer().close();
+      server.push( connection );
+    }
+  };
+  server.set_handler( respond );
+
+  size_t started = 0;
+  size_t completed = 0;
+  client.set_handler( [&]( TCPStack::Connection& connection ) {
+    Reader& inbound = connection.peer.inbound_reader();
+    inbound.pop( inbound.bytes_buffered() );
+    if ( inbound.is_finished() ) {
+      completed++;
+    }
+  } );
+  const auto start_one = [&] {
+    const Address local { "10.144.0.1", static_cast<uint16_t>( 1024 + started++ ) };
+    TCPStack::Connection& connection = client.connect( config, local, server_address );
+    connection.peer.outbound_writer().push( "GET / HTTP/1.1\r\n\r\n" );
+    connection.peer.outbound_writer().close();
+  };
+
+  auto rng = get_random_engine();
+  const auto spoof_syns = [&]( uint64_t count ) {
+    for ( ; count > 0; count-- ) {
+      const FourTuple tuple { static_cast<uint32_t>( rng() ),
+                              server_address.ipv4_numeric(),
+                              static_cast<uint16_t>( rng() ),
+                              server_address.port() };
+      TCPMessage syn;
+      syn.sender.seqno = Wrap32 { static_cast<uint32_t>( rng() ) };
+      syn.sender.SYN = true;
+      syn.receiver.window_size = 65535;
+      syn.mss = 1460;
+      spoofer.write( serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip( syn, tuple ) ) );
+    }
+  };
+
+  const auto start_time = steady_clock::now();
+  size_t peak = 0;
+  for ( uint64_t ms = 0; completed < TOTAL and ms < TIME_LIMIT_MS; ms++ ) {
+    while ( started < TOTAL and started - completed < CONCURRENT ) {
+      start_one();
+    }
+    client.receive();
+    server.receive();
+    while ( TCPStack::Connection* connection = server.accept( server_address.port() ) ) {
+      respond( *connection );
+    }
+    peak = max( peak, server.size() );
+
+    if ( flood ) {
+      spoof_syns( FLOOD_SYNS_PER_MS );
+    }
+    client.tick( 1 );
+    server.tick( 1 );
+  }
+  const auto elapsed = duration_cast<duration<double>>( steady_clock::now() - start_time ).count();
+
+  return { static_cast<double>( completed ) / elapsed, peak, completed };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  const auto baseline = serve( false, false );
+  for ( const bool syn_cookies : { false, true } ) {
+    const auto result = serve( syn_cookies, true );
+
+    cout << TOTAL << " connections, " << CONCURRENT << " at a time, during a flood of " << FLOOD_SYNS_PER_MS
+         << " spoofed SYNs/ms, " << ( syn_cookies ? "with" : "without" ) << " SYN cookies: " << result.completed
+         << " completed, " << fixed << setprecision( 0 ) << result.connections_per_second
+         << " connections/s (vs. " << baseline.connections_per_second << " with no flood), at most "
+         << result.peak_connections << " connections held by the server (vs. " << baseline.peak_connections
+         << ").\n";
+
+    debug_output << "      " << ( syn_cookies ? "   cookies" : "no cookies" ) << ": " << fixed << setprecision( 0 )
+                 << setw( 6 ) << result.connections_per_second << " conn/s under flood (" << setw( 6 )
+                 << baseline.connections_per_second << " without), peak state " << setw( 4 )
+                 << result.peak_connections << " (" << baseline.peak_connections << ")\n";
+
+    if ( syn_cookies and result.completed < TOTAL ) {
+      throw runtime_error( "SYN cookies didn't let the clients through the flood" );
+    }
+    // (closed connections linger for a while, so the server holds many even without a flood)
+    if ( syn_cookies and result.peak_connections > baseline.peak_connections + BACKLOG + CONCURRENT ) {
+      throw runtime_error( "the flood made the server keep state for spoofed connections" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "tcp_config.hh"
+#include "tcp_minnow_socket.hh"
+#include "tuntap_adapter.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+
+using namespace std;
+using namespace std::chrono;
+
+struct ThroughputResult
+{
+  double gigabits_per_second;
+  double owner_cpu_ns_per_byte; // CPU time spent by the two owner threads (writing, reading and waiting)
+};
+
+// CPU time used so far by the calling thread
+duration<double> thread_cpu_time()
+{
+  timespec ts {};
+  CheckSystemCall( "clock_gettime", ::clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) );
+  return seconds { ts.tv_sec } + nanoseconds { ts.tv_nsec };
+}
+
+// Two TCPMinnowSockets, each with its own TCPPeer thread, connected through an AF_UNIX datagram
+// socketpair that stands in for the TUN device.
+ThroughputResult throughput_test( const ThreadChannel channel,
+                        const size_t input_len,  // NOLINT(bugprone-easily-swappable-parameters)
+                        const size_t write_size, // NOLINT(bugprone-easily-swappable-parameters)
+                        const size_t random_seed )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  TCPOverIPv4MinnowSocket client { TCPOverIPv4OverTunFdAdapter { FileDescriptor { fds[0] } }, channel };
+  TCPOverIPv4MinnowSocket server { TCPOverIPv4OverTunFdAdapter { FileDescriptor { fds[1] } }, channel };
+
+  TCPConfig tcp_config;
+  tcp_config.rt_timeout = 10; // keep the lingering after the connection closes short
+
+  FdAdapterConfig client_config;
+  client_config.source = { "10.144.0.1", "40000" };
+  client_config.destination = { "10.144.0.2", "50000" };
+
+  FdAdapterConfig server_config;
+  server_config.source = { "10.144.0.2", "50000" };
+
+  string output_data;
+  output_data.reserve( data.size() );
+  steady_clock::time_point stop_time;
+  duration<double> server_cpu_time {};
+
+  // the server's owner thread reads until EOF
+  thread server_thread( [&] {
+    server.listen_and_accept( tcp_config, server_config );
+    const auto cpu_start = thread_cpu_time();
+    string buffer;
+    while ( not server.eof() ) {
+      buffer.clear();
+      server.read( buffer );
+      if ( buffer.empty() ) {
+        server.wait_until_ready( false );
+      }
+      output_data += buffer;
+    }
+    stop_time = steady_clock::now();
+    server_cpu_time = thread_cpu_time() - cpu_start;
+    server.wait_until_closed();
+  } );
+
+  // the client's owner thread writes everything, then closes
+  client.connect( tcp_config, client_config );
+  const auto start_time = steady_clock::now();
+  const auto cpu_start = thread_cpu_time();
+  for ( size_t offset = 0; offset < data.size(); ) {
+    client.wait_until_ready( true );
+    offset += client.write( string_view { data }.substr( offset, write_size ) );
+  }
+  const auto client_cpu_time = thread_cpu_time() - cpu_start;
+  client.wait_until_closed();
+  server_thread.join();
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return { 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9,
+           ( client_cpu_time + server_cpu_time ).count() * 1e9 / static_cast<double>( input_len ) };
+}
+
+void speed_test( const ThreadChannel channel, const string& channel_name )
+{
+  constexpr size_t input_len = 2e7;
+  constexpr size_t write_size = 16384;
+
+  const auto result = throughput_test( channel, input_len, write_size, 1370 );
+
+  cout << "TCPMinnowSocket (" << channel_name << ") to TCPMinnowSocket over a datagram socketpair: " << fixed
+       << setprecision( 2 ) << result.gigabits_per_second << " Gbit/s, owner threads used "
+       << result.owner_cpu_ns_per_byte << " ns of CPU per byte.\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "             " << setw( 13 ) << channel_name << ": " << fixed << setprecision( 2 )
+               << result.gigabits_per_second << " Gbit/s, " << result.owner_cpu_ns_per_byte
+               << " owner-thread CPU ns/byte\n";
+}
+
+void program_body()
+{
+  speed_test( ThreadChannel::SocketPair, "socketpair" );
+  speed_test( ThreadChannel::SharedMemory, "shared memory" );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+#include "address.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "tcp_config.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+#include "tcp_stack.hh"
+#include "test_should_be.hh"
+
+#include <array>
+#include <exception>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+string read_all( TCPStack::Connection& connection )
+{
+  string ret;
+  Reader& inbound = connection.peer.inbound_reader();
+  while ( inbound.bytes_buffered() ) {
+    ret += inbound.peek();
+    inbound.pop( inbound.peek().size() );
+  }
+  return ret;
+}
+
+void echo( TCPStack& stack, TCPStack::Connection& connection )
+{
+  connection.peer.outbound_writer().push( read_all( connection ) );
+  if ( connection.peer.inbound_reader().is_finished() ) {
+    connection.peer.outbound_writer().close();
+  }
+  stack.push( connection );
+}
+
+// The application accepts every connection whose handshake has finished, and answers what already arrived
+void accept_all( TCPStack& server, initializer_list<uint16_t> ports )
+{
+  for ( const uint16_t port : ports ) {
+    while ( TCPStack::Connection* connection = server.accept( port ) ) {
+      echo( server, *connection );
+    }
+  }
+}
+
+// Two stacks on a datagram socketpair: an echo server on two ports, and clients with several connections
+void demux_test()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  TCPStack client { FileDescriptor { fds[0] } };
+  TCPStack server { FileDescriptor { fds[1] } };
+
+  TCPConfig config;
+  config.rt_timeout = 10;
+
+  server.listen( config, Address { "10.0.0.2", 80 } );
+  server.listen( config, Address { "0.0.0.0", 443 } );
+  server.set_handler( [&]( TCPStack::Connection& connection ) { echo( server, connection ); } );
+
+  map<uint16_t, string> echoed;
+  client.set_handler(
+    [&]( TCPStack::Connection& connection ) { echoed[connection.tuple.local_port] += read_all( connection ); } );
+
+  const Address server_80 { "10.0.0.2", 80 };
+  const Address server_443 { "10.0.0.2", 443 };
+  const Address server_22 { "10.0.0.2", 22 }; // nobody listens
+  for ( const auto& [port, remote] :
+        { pair { 1000, server_80 }, pair { 1001, server_80 }, pair { 1002, server_443 } } ) {
+    TCPStack::Connection& connection = client.connect( config, Address { "10.0.0.1", uint16_t( port ) }, remote );
+    connection.peer.outbound_writer().push( "hello from " + to_string( port ) );
+    connection.peer.outbound_writer().close();
+  }
+  client.connect( config, Address { "10.0.0.1", 1003 }, server_22 );
+
+  for ( int ms = 0; ms < 1000 and ( client.size() > 1 or server.size() > 0 ); ms++ ) {
+    client.receive();
+    server.receive();
+    accept_all( server, { 80, 443 } );
+    client.tick( 1 );
+    server.tick( 1 );
+  }
+
+  // a SYN to each listening port opens a connection
+  test_should_be( server.stats().passive_opens == 3, true );
+  // a SYN to a port nobody listens on opens nothing
+  test_should_be( server.stats().unmatched > 0, true );
+  for ( auto port : { 1000, 1001, 1002 } ) {
+    // each connection gets its own bytes back
+    test_should_be( echoed[port] == "hello from " + to_string( port ), true );
+  }
+  // finished connections are removed
+  test_should_be( server.size() == 0 and client.size() == 1, true );
+  // and the one still trying to connect is found by its 4-tuple
+  test_should_be(
+    client.find( { Address { "10.0.0.1" }.ipv4_numeric(), server_22.ipv4_numeric(), 1003, 22 } ) != nullptr, true );
+}
+
+// Five clients connect at once to a listener with a backlog of two
+void backlog_test( const bool syn_cookies )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  TCPStack client { FileDescriptor { fds[0] } };
+  TCPStack server { FileDescriptor { fds[1] } };
+
+  TCPConfig config;
+  config.rt_timeout = 10;
+  config.rto_min = 10;
+  server.listen( config, Address { "10.0.0.2", 80 }, 2, syn_cookies );
+  server.set_handler( [&]( TCPStack::Connection& connection ) { echo( server, connection ); } );
+
+  map<uint16_t, string> echoed;
+  client.set_handler(
+    [&]( TCPStack::Connection& connection ) { echoed[connection.tuple.local_port] += read_all( connection ); } );
+  const Address remote { "10.0.0.2", 80 };
+  for ( uint16_t port = 1000; port < 1005; port++ ) {
+    TCPStack::Connection& connection = client.connect( config, Address { "10.0.0.1", port }, remote );
+    connection.peer.outbound_writer().push( "hello from " + to_string( port ) );
+    connection.peer.outbound_writer().close();
+  }
+
+  server.receive();
+  // the backlog holds two half-open connections
+  test_should_be( server.size() == 2, true );
+  if ( syn_cookies ) {
+    // and the rest get cookies
+    test_should_be( server.stats().cookies_sent == 3 and server.stats().syn_drops == 0, true );
+  } else {
+    // and the rest are dropped
+    test_should_be( server.stats().syn_drops == 3 and server.stats().cookies_sent == 0, true );
+  }
+
+  // nobody accepts for a while: two connections wait in the accept queue, and the rest can't join them
+  for ( int ms = 0; ms < 200; ms++ ) {
+    client.receive();
+    server.receive();
+    client.tick( 1 );
+    server.tick( 1 );
+  }
+  // the handshakes that found the accept queue full aren't finished
+  test_should_be( server.stats().accept_drops > 0, true );
+  for ( const auto& [port, bytes] : echoed ) {
+    // and nothing is echoed before the application accepts
+    test_should_be( bytes.empty(), true );
+  }
+
+  for ( int ms = 0; ms < 5000 and ( client.size() > 0 or server.size() > 0 ); ms++ ) {
+    client.receive();
+    server.receive();
+    accept_all( server, { 80 } );
+    client.tick( 1 );
+    server.tick( 1 );
+  }
+  for ( uint16_t port = 1000; port < 1005; port++ ) {
+    // every client is served in the end
+    test_should_be( echoed[port] == "hello from " + to_string( port ), true );
+  }
+  // each opened once
+  test_should_be( server.stats().passive_opens == 5 and server.stats().bad_cookies == 0, true );
+  // and all are gone
+  test_should_be( server.size() == 0 and client.size() == 0, true );
+}
+
+// An ACK that doesn't carry a cookie the server made opens nothing
+void forged_cookie_test()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  FileDescriptor attacker { fds[0] };
+  TCPStack server { FileDescriptor { fds[1] } };
+  server.listen( TCPConfig {}, Address { "10.0.0.2", 80 }, 2, true );
+
+  const FourTuple tuple { Address { "10.0.0.1" }.ipv4_numeric(), Address { "10.0.0.2" }.ipv4_numeric(), 1000, 80 };
+  TCPMessage ack;
+  ack.sender.seqno = Wrap32 { 1001 };
+  ack.receiver.ackno = Wrap32 { 123456 };
+  ack.receiver.window_size = 1000;
+  attacker.write( serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip( ack, tuple ) ) );
+  server.receive();
+  // a guessed cookie is refused
+  test_should_be( server.stats().bad_cookies == 1 and server.size() == 0, true );
+}
+
+// A datagram serialized in place, from its payload's Slices, has the same bytes as one serialized into strings
+void serialize_in_place_test()
+{
+  const FourTuple tuple { Address { "10.0.0.1" }.ipv4_numeric(), Address { "10.0.0.2" }.ipv4_numeric(), 1000, 80 };
+  TCPMessage msg;
+  msg.sender.seqno = Wrap32 { 1001 };
+  msg.sender.payload.append( Slice { string( 700, 'a' ) } );
+  msg.sender.payload.append( Slice { string( 700, 'b' ) } );
+  msg.receiver.ackno = Wrap32 { 2002 };
+  msg.receiver.window_size = 5000;
+
+  string flattened;
+  for ( const auto& buffer : serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, tuple ) ) ) {
+    flattened += buffer;
+  }
+
+  string headers;
+  CopyCounter::reset();
+  const auto pieces = TCPOverIPv4Adapter::serialize_tcp_in_ip( msg, tuple, headers );
+  // the payload isn't copied
+  test_should_be( CopyCounter::bytes() == 0, true );
+  // the Slices are written where they are
+  test_should_be( pieces.size() == 3 and pieces[1].data() == msg.sender.payload.slices()[0].view().data(), true );
+  string joined;
+  for ( const auto piece : pieces ) {
+    joined += piece;
+  }
+  // and the datagram is the same
+  test_should_be( joined == flattened, true );
+}
+
+// With TCPConfig::zero_copy, the bytes an application writes reach the wire uncopied; by default they are copied
+void zero_copy_test( const bool zero_copy )
+{
+  TCPConfig config;
+  config.zero_copy = zero_copy;
+  TCPPeer client { config };
+  TCPPeer server { config };
+  vector<TCPMessage> to_server;
+  vector<TCPMessage> to_client;
+  const auto send_to_server = [&]( TCPMessage msg ) { to_server.push_back( std::move( msg ) ); };
+  const auto send_to_client = [&]( TCPMessage msg ) { to_client.push_back( std::move( msg ) ); };
+  client.push( send_to_server );
+  server.receive( std::move( to_server.at( 0 ) ), send_to_client );
+  to_server.clear();
+  client.receive( std::move( to_client.at( 0 ) ), send_to_server );
+  to_server.clear();
+
+  CopyCounter::reset();
+  client.outbound_writer().push( string( 1000, 'x' ) );
+  client.push( send_to_server );
+  const FourTuple tuple { Address { "10.0.0.1" }.ipv4_numeric(), Address { "10.0.0.2" }.ipv4_numeric(), 1000, 80 };
+  string headers;
+  size_t payload = 0;
+  for ( const auto& msg : to_server ) {
+    payload += msg.sender.payload.size();
+    TCPOverIPv4Adapter::serialize_tcp_in_ip( msg, tuple, headers );
+  }
+
+  // the bytes are sent
+  test_should_be( payload == 1000, true );
+  // copied only without zero_copy
+  test_should_be( ( CopyCounter::bytes() == 0 ) == zero_copy, true );
+}
+} // namespace
+
+int main()
+{
+  try {
+    demux_test();
+    backlog_test( false );
+    backlog_test( true );
+    forged_cookie_test();
+    serialize_in_place_test();
+    zero_copy_test( false );
+    zero_copy_test( true );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+#include "address.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <unordered_map>
+
+using namespace std;
+using namespace std::chrono;
+
+struct TransferResult
+{
+  double gigabits_per_second; // goodput of all the connections together
+  double ns_per_datagram;     // time in receive() per datagram read by either stack (including the replies)
+  uint64_t send_drops;        // datagrams a full socket buffer dropped (and TCP had to recover)
+};
+
+// `connections` clients each send `total / connections` bytes to one server port. The two TCPStacks, run by
+// this one thread, are connected by an AF_UNIX datagram socketpair that stands in for the TUN device.
+TransferResult transfer( const size_t connections, const string& data )
+{
+  constexpr int socket_buffer = 4 << 20;
+  const size_t per_connection = data.size() / connections;
+
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  for ( const int fd : fds ) {
+    CheckSystemCall( "setsockopt",
+                     ::setsockopt( fd, SOL_SOCKET, SO_SNDBUF, &socket_buffer, sizeof( socket_buffer ) ) );
+  }
+  TCPStack client { FileDescriptor { fds[0] } };
+  TCPStack server { FileDescriptor { fds[1] } };
+
+  TCPConfig config;
+  config.rt_timeout = 10; // keep the lingering after each connection closes short
+  config.rto_min = 10;    // the link's round trip is well under a millisecond
+
+  // the server reads everything, and closes its end when the client has
+  uint64_t bytes_read = 0;
+  size_t finished = 0;
+  server.listen( config, Address { "10.144.0.2", 80 }, connections );
+  const auto read_and_close = [&]( TCPStack::Connection& connection ) {
+    Reader& inbound = connection.peer.inbound_reader();
+    while ( inbound.bytes_buffered() ) {
+      const auto chunk = inbound.peek();
+      bytes_read += chunk.size();
+      inbound.pop( chunk.size() );
+    }
+    if ( inbound.is_finished() and not connection.peer.outbound_writer().is_closed() ) {
+      connection.peer.outbound_writer().close();
+      server.push( connection );
+      finished++;
+    }
+  };
+  server.set_handler( read_and_close );
+
+  // each client writes its share as the window opens
+  unordered_map<uint16_t, size_t> written;
+  const auto write_more = [&]( TCPStack::Connection& connection ) {
+    Writer& outbound = connection.peer.outbound_writer();
+    size_t& done = written[connection.tuple.local_port];
+    if ( outbound.is_closed() ) {
+      return;
+    }
+    const size_t len = min( per_connection - done, outbound.available_capacity() );
+    outbound.push( data.substr( done, len ) );
+    done += len;
+    if ( done == per_connection ) {
+      outbound.close();
+    }
+    client.push( connection );
+  };
+  client.set_handler( write_more );
+
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < connections; i++ ) {
+    const Address local { "10.144.0.1", static_cast<uint16_t>( 1024 + i ) };
+    write_more( client.connect( config, local, Address { "10.144.0.2", 80 } ) );
+  }
+
+  auto last_tick = start_time;
+  uint64_t datagrams = 0;
+  nanoseconds receive_time {};
+  while ( finished < connections ) {
+    const auto receive_start = steady_clock::now();
+    datagrams += client.receive() + server.receive();
+    while ( TCPStack::Connection* connection = server.accept( 80 ) ) {
+      read_and_close( *connection );
+    }
+    const auto now = steady_clock::now();
+    receive_time += now - receive_start;
+    const auto ms = duration_cast<milliseconds>( now - last_tick ).count();
+    if ( ms > 0 ) {
+      client.tick( ms );
+      server.tick( ms );
+      last_tick += milliseconds { ms };
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( bytes_read != per_connection * connections or server.stats().passive_opens != connections ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const auto elapsed = duration_cast<duration<double>>( stop_time - start_time ).count();
+  return { 8 * static_cast<double>( bytes_read ) / elapsed / 1e9,
+           static_cast<double>( receive_time.count() ) / static_cast<double>( datagrams ),
+           client.stats().send_drops + server.stats().send_drops };
+}
+
+void program_body()
+{
+  const string data( 16 << 20, 'x' );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  double few_connections_ns = 0;
+  for ( const size_t connections : { 1, 10, 100, 1000, 4000 } ) {
+    const auto result = transfer( connections, data );
+
+    cout << "16 MiB over " << connections << " connection" << ( connections == 1 ? "" : "s" )
+         << " on one TCPStack thread: " << fixed << setprecision( 2 ) << result.gigabits_per_second
+         << " Gbit/s, " << setprecision( 0 ) << result.ns_per_datagram << " ns per datagram, " << result.send_drops
+         << " datagrams dropped by a full socket buffer.\n";
+
+    debug_output << "      " << setw( 4 ) << connections << " connections: " << fixed << setprecision( 2 )
+                 << setw( 5 ) << result.gigabits_per_second << " Gbit/s, " << setprecision( 0 ) << setw( 5 )
+                 << result.ns_per_datagram << " ns/datagram\n";
+
+    if ( connections == 10 ) {
+      few_connections_ns = result.ns_per_datagram;
+    } else if ( connections > 10 and result.ns_per_datagram > 4 * few_connections_ns ) {
+      throw runtime_error( "the cost of a datagram grew with the number of connections" );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
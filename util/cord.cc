@@ -0,0 +1,171 @@
+#include "cord.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+Slice::Slice( string str )
+{
+  if ( not str.empty() ) {
+    size_ = str.size();
+    storage_ = make_shared<const string>( move( str ) );
+  }
+}
+
+Slice Slice::copy_of( string_view data )
+{
+  CopyCounter::add( data.size() );
+  return Slice { string { data } };
+}
+
+Slice::operator string() const
+{
+  CopyCounter::add( size_ );
+  return string { view() };
+}
+
+Slice Slice::substr( const size_t pos, const size_t len ) const
+{
+  if ( pos > size_ ) {
+    throw out_of_range( "Slice::substr: pos is past the end" );
+  }
+  Slice ret = *this;
+  ret.offset_ += pos;
+  ret.size_ = min( len, size_ - pos );
+  return ret;
+}
+
+void Slice::remove_prefix( const size_t n )
+{
+  if ( n > size_ ) {
+    throw out_of_range( "Slice::remove_prefix: n is larger than the Slice" );
+  }
+  offset_ += n;
+  size_ -= n;
+}
+
+void Slice::remove_suffix( const size_t n )
+{
+  if ( n > size_ ) {
+    throw out_of_range( "Slice::remove_suffix: n is larger than the Slice" );
+  }
+  size_ -= n;
+}
+
+bool Slice::extend( const Slice& next )
+{
+  if ( not storage_ or storage_ != next.storage_ or offset_ + size_ != next.offset_ ) {
+    return false;
+  }
+  size_ += next.size_;
+  return true;
+}
+
+Cord::Cord( string str ) : Cord( Slice { move( str ) } ) {}
+
+Cord::Cord( Slice slice )
+{
+  append( move( slice ) );
+}
+
+void Cord::append( Slice slice )
+{
+  if ( slice.empty() ) {
+    return;
+  }
+  size_ += slice.size();
+  slices_.push_back( move( slice ) );
+}
+
+void Cord::append( Cord other )
+{
+  if ( slices_.empty() ) {
+    *this = move( other );
+    return;
+  }
+  size_ += other.size_;
+  slices_.insert(
+    slices_.end(), make_move_iterator( other.slices_.begin() ), make_move_iterator( other.slices_.end() ) );
+}
+
+void Cord::remove_prefix( size_t n )
+{
+  if ( n > size_ ) {
+    throw out_of_range( "Cord::remove_prefix: n is larger than the Cord" );
+  }
+  size_ -= n;
+
+  auto it = slices_.begin();
+  while ( n and n >= it->size() ) {
+    n -= it->size();
+    ++it;
+  }
+  if ( n ) {
+    it->remove_prefix( n );
+  }
+  slices_.erase( slices_.begin(), it );
+}
+
+void Cord::remove_suffix( size_t n )
+{
+  if ( n > size_ ) {
+    throw out_of_range( "Cord::remove_suffix: n is larger than the Cord" );
+  }
+  size_ -= n;
+
+  while ( n and n >= slices_.back().size() ) {
+    n -= slices_.back().size();
+    slices_.pop_back();
+  }
+  if ( n ) {
+    slices_.back().remove_suffix( n );
+  }
+}
+
+Cord Cord::substr( const size_t pos, const size_t len ) const
+{
+  if ( pos > size_ ) {
+    throw out_of_range( "Cord::substr: pos is past the end" );
+  }
+  size_t skip = pos;
+  size_t remaining = min( len, size_ - pos );
+
+  Cord ret;
+  for ( auto it = slices_.begin(); remaining and it != slices_.end(); ++it ) {
+    if ( skip >= it->size() ) {
+      skip -= it->size();
+      continue;
+    }
+    Slice piece = it->substr( skip, remaining );
+    skip = 0;
+    remaining -= piece.size();
+    ret.append( move( piece ) );
+  }
+  return ret;
+}
+
+Cord::operator string() const
+{
+  CopyCounter::add( size_ );
+  string ret;
+  ret.reserve( size_ );
+  for ( const auto& slice : slices_ ) {
+    ret.append( slice.view() );
+  }
+  return ret;
+}
+
+bool Cord::operator==( string_view other ) const
+{
+  if ( other.size() != size_ ) {
+    return false;
+  }
+  for ( const auto& slice : slices_ ) {
+    if ( other.substr( 0, slice.size() ) != slice.view() ) {
+      return false;
+    }
+    other.remove_prefix( slice.size() );
+  }
+  return true;
+}
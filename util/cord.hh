@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! Process-wide tally of payload bytes that were memcpy'd from one buffer into another.
+//! \details Divide by the number of bytes delivered to get "bytes copied per byte delivered". (The copy of each
+//! byte pushed into a ring-backed ByteStream isn't counted here, to keep RingBuffer::push() uninstrumented: a
+//! test that wants it counts the bytes pushed.)
+class CopyCounter
+{
+  static inline std::atomic<uint64_t> bytes_ {};
+
+public:
+  static void add( uint64_t n ) { bytes_.fetch_add( n, std::memory_order_relaxed ); }
+  static uint64_t bytes() { return bytes_.load( std::memory_order_relaxed ); }
+  static void reset() { bytes_.store( 0, std::memory_order_relaxed ); }
+};
+
+//! A reference-counted, immutable view of part of a string.
+//! \details Copying a Slice, or trimming it, only adjusts a reference count and two offsets;
+//! the bytes themselves are shared.
+class Slice
+{
+  std::shared_ptr<const std::string> storage_ {};
+  size_t offset_ {};
+  size_t size_ {};
+
+public:
+  Slice() = default;
+
+  //! Take ownership of a string (no copy)
+  explicit Slice( std::string str );
+
+  //! Make a Slice holding a copy of `data` (counted by CopyCounter)
+  static Slice copy_of( std::string_view data );
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  std::string_view view() const { return { storage_ ? storage_->data() + offset_ : nullptr, size_ }; }
+  operator std::string_view() const { return view(); } // NOLINT(*-explicit-*)
+
+  //! Copy the bytes out into a new string (counted by CopyCounter)
+  explicit operator std::string() const;
+
+  //! A Slice of `len` bytes starting at `pos`, sharing this Slice's storage
+  Slice substr( size_t pos, size_t len = std::string::npos ) const;
+
+  void remove_prefix( size_t n );
+  void remove_suffix( size_t n );
+
+  //! If `next` starts just past this Slice in the same storage, grow this Slice to cover it too (no copy)
+  //! \returns whether it did
+  bool extend( const Slice& next );
+};
+
+//! A chain of Slices that together represent one byte string (a "cord").
+//! \details Splitting, concatenating and copying a Cord only moves Slices around, so a payload can be
+//! handed from the ByteStream to the TCPSender, retransmitted, and reassembled without copying its bytes.
+//! The bytes are only copied if the Cord is flattened into a std::string.
+class Cord
+{
+  std::vector<Slice> slices_ {};
+  size_t size_ {};
+
+public:
+  Cord() = default;
+
+  //! Take ownership of a string (no copy)
+  Cord( std::string str ); // NOLINT(*-explicit-*)
+
+  //! A Cord made of one Slice
+  explicit Cord( Slice slice );
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  //! The Slices that make up this Cord, in order (none are empty)
+  const std::vector<Slice>& slices() const { return slices_; }
+
+  //! Add bytes to the end (no copy)
+  void append( Slice slice );
+  void append( Cord other );
+
+  //! Discard bytes from the front or back (no copy)
+  void remove_prefix( size_t n );
+  void remove_suffix( size_t n );
+
+  //! A Cord of `len` bytes starting at `pos`, sharing this Cord's storage
+  Cord substr( size_t pos, size_t len = std::string::npos ) const;
+
+  //! Flatten into a new string (counted by CopyCounter)
+  explicit operator std::string() const;
+
+  bool operator==( std::string_view other ) const;
+};
@@ -0,0 +1,31 @@
+#include "eventfd.hh"
+#include "exception.hh"
+
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+EventFD::EventFD() : FileDescriptor( ::CheckSystemCall( "eventfd", ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) )
+{}
+
+void EventFD::notify()
+{
+  // (not counted with register_write(): notify() is usually called from another thread than the fd's owner)
+  const uint64_t one = 1;
+  CheckSystemCall( "write", ::write( fd_num(), &one, sizeof( one ) ) );
+}
+
+uint64_t EventFD::clear()
+{
+  uint64_t count = 0;
+  if ( ::read( fd_num(), &count, sizeof( count ) ) < 0 ) {
+    if ( errno == EAGAIN ) {
+      return 0;
+    }
+    throw unix_error { "read" };
+  }
+  register_read();
+  return count;
+}
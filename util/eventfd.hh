@@ -0,0 +1,19 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <cstdint>
+
+//! A FileDescriptor to an [eventfd](\ref man2::eventfd) counter, used by one thread to wake another
+//! \details The fd is readable (for poll) while the counter is nonzero. It is always non-blocking.
+class EventFD : public FileDescriptor
+{
+public:
+  EventFD();
+
+  //! Add one to the counter, waking anyone polling the fd
+  void notify();
+
+  //! Reset the counter to zero; returns its previous value (0 if no notify() happened since the last clear())
+  uint64_t clear();
+};
@@ -2,17 +2,40 @@
 #include "exception.hh"
 #include "socket.hh"
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
 
 using namespace std;
 
+namespace {
+// The milliseconds left until `deadline` (for a wait that a signal interrupted), or -1 to wait forever
+int remaining_ms( const int timeout_ms, const chrono::steady_clock::time_point deadline )
+{
+  if ( timeout_ms < 0 ) {
+    return -1;
+  }
+  const auto left = chrono::ceil<chrono::milliseconds>( deadline - chrono::steady_clock::now() );
+  return static_cast<int>( max( left.count(), chrono::milliseconds::rep { 0 } ) );
+}
+} // namespace
+
 unsigned int EventLoop::FDRule::service_count() const
 {
   return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
 
+EventLoop::EventLoop( const Backend backend ) : _backend( backend )
+{
+  _rule_categories.reserve( 64 );
+  if ( _backend == Backend::Epoll ) {
+    _epoll_fd.emplace( CheckSystemCall( "epoll_create1", ::epoll_create1( EPOLL_CLOEXEC ) ) );
+    _epoll_events.resize( EVENT_BUDGET );
+  }
+}
+
 size_t EventLoop::add_category( const string& name )
 {
   if ( _rule_categories.size() >= _rule_categories.capacity() ) {
@@ -40,7 +63,7 @@ EventLoop::FDRule::FDRule( BasicRule&& base,
 {}
 
 EventLoop::RuleHandle EventLoop::add_rule( size_t category_id,
-                                           FileDescriptor& fd,
+                                           const FileDescriptor& fd,
                                            Direction direction,
                                            const CallbackT& callback,
                                            const InterestT& interest,
@@ -83,37 +106,79 @@ void EventLoop::RuleHandle::cancel()
 EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 {
   // first, handle the non-file-descriptor-related rules
-  {
-    for ( auto it = _non_fd_rules.begin(); it != _non_fd_rules.end(); ) {
-      auto& this_rule = **it;
-      bool rule_fired = false;
-
-      if ( this_rule.cancel_requested ) {
-        it = _non_fd_rules.erase( it );
-        continue;
-      }
+  if ( serve_non_fd_rules() ) {
+    return Result::Success; /* only serve one rule on each iteration */
+  }
 
-      uint8_t iterations = 0;
-      while ( this_rule.interest() ) {
-        if ( iterations++ >= 128 ) {
-          throw runtime_error( "EventLoop: busy wait detected: rule \""
-                               + _rule_categories.at( this_rule.category_id ).name + "\" is still interested after "
-                               + to_string( iterations ) + " iterations" );
-        }
+  // now the file-descriptor-related rules
+  return _backend == Backend::Epoll ? wait_epoll( timeout_ms ) : wait_poll( timeout_ms );
+}
 
-        rule_fired = true;
-        this_rule.callback();
-      }
+bool EventLoop::serve_non_fd_rules()
+{
+  for ( auto it = _non_fd_rules.begin(); it != _non_fd_rules.end(); ) {
+    auto& this_rule = **it;
+    bool rule_fired = false;
+
+    if ( this_rule.cancel_requested ) {
+      it = _non_fd_rules.erase( it );
+      continue;
+    }
 
-      if ( rule_fired ) {
-        return Result::Success; /* only serve one rule on each iteration */
+    uint8_t iterations = 0;
+    while ( this_rule.interest() ) {
+      if ( iterations++ >= 128 ) {
+        throw runtime_error( "EventLoop: busy wait detected: rule \""
+                             + _rule_categories.at( this_rule.category_id ).name + "\" is still interested after "
+                             + to_string( iterations ) + " iterations" );
       }
 
-      ++it;
+      rule_fired = true;
+      this_rule.callback();
+    }
+
+    if ( rule_fired ) {
+      return true;
     }
+
+    ++it;
   }
+  return false;
+}
 
-  // now the file-descriptor-related rules. poll any "interested" file descriptors
+void EventLoop::report_error( const FDRule& rule ) const
+{
+  /* see if fd is a socket */
+  int socket_error = 0;
+  socklen_t optlen = sizeof( socket_error );
+  const int ret = getsockopt( rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
+  if ( ret == -1 and errno == ENOTSOCK ) {
+    cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( rule.category_id ).name
+         << "\"\n";
+  } else if ( ret == -1 ) {
+    throw unix_error( "getsockopt" );
+  } else if ( optlen != sizeof( socket_error ) ) {
+    throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
+  } else if ( socket_error ) {
+    cerr << "error on polled socket for rule \"" << _rule_categories.at( rule.category_id ).name
+         << "\": " << strerror( socket_error ) << "\n";
+  }
+}
+
+void EventLoop::serve( FDRule& rule )
+{
+  const auto count_before = rule.service_count();
+  rule.callback();
+
+  if ( count_before == rule.service_count() and ( not rule.fd.closed() ) and rule.interest() ) {
+    throw runtime_error( "EventLoop: busy wait detected: rule \"" + _rule_categories.at( rule.category_id ).name
+                         + "\" did not read/write fd and is still interested" );
+  }
+}
+
+EventLoop::Result EventLoop::wait_poll( const int timeout_ms )
+{
+  // poll any "interested" file descriptors
   vector<pollfd> pollfds {};
   pollfds.reserve( _fd_rules.size() );
   bool something_to_poll = false;
@@ -157,8 +222,16 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     return Result::Exit;
   }
 
-  // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
-  if ( 0 == CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), timeout_ms ) ) ) {
+  // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable). If a signal
+  // interrupts it, wait again for the rest of the timeout.
+  const auto deadline = chrono::steady_clock::now() + chrono::milliseconds { timeout_ms };
+  int count = 0;
+  while ( ( count = ::poll( pollfds.data(), pollfds.size(), remaining_ms( timeout_ms, deadline ) ) ) < 0 ) {
+    if ( errno != EINTR ) {
+      throw unix_error { "poll" };
+    }
+  }
+  if ( count == 0 ) {
     return Result::Timeout;
   }
 
@@ -169,22 +242,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 
     const auto poll_error = static_cast<bool>( this_pollfd.revents & ( POLLERR | POLLNVAL ) );
     if ( poll_error ) {
-      /* see if fd is a socket */
-      int socket_error = 0;
-      socklen_t optlen = sizeof( socket_error );
-      const int ret = getsockopt( this_rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
-      if ( ret == -1 and errno == ENOTSOCK ) {
-        cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\"\n";
-      } else if ( ret == -1 ) {
-        throw unix_error( "getsockopt" );
-      } else if ( optlen != sizeof( socket_error ) ) {
-        throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
-      } else if ( socket_error ) {
-        cerr << "error on polled socket for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\": " << strerror( socket_error ) << "\n";
-      }
-
+      report_error( this_rule );
       this_rule.error();
       this_rule.cancel();
       it = _fd_rules.erase( it );
@@ -205,15 +263,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 
     if ( poll_ready ) {
       // we only want to call callback if revents includes the event we asked for
-      const auto count_before = this_rule.service_count();
-      this_rule.callback();
-
-      if ( count_before == this_rule.service_count() and ( not this_rule.fd.closed() ) and this_rule.interest() ) {
-        throw runtime_error( "EventLoop: busy wait detected: rule \""
-                             + _rule_categories.at( this_rule.category_id ).name
-                             + "\" did not read/write fd and is still interested" );
-      }
-
+      serve( this_rule );
       return Result::Success; /* only serve one rule on each iteration */
     }
 
@@ -222,5 +272,202 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 
   return Result::Success;
 }
+
+void EventLoop::epoll_forget( const shared_ptr<FDRule>& rule )
+{
+  if ( not rule->registered ) {
+    return;
+  }
+  const int fd_num = rule->fd.fd_num();
+  auto& entry = _epoll_entries.at( fd_num );
+  erase( entry.rules, rule );
+  if ( entry.rules.empty() ) {
+    // (the kernel has already forgotten an fd that was closed, so this may fail)
+    ::epoll_ctl( _epoll_fd->fd_num(), EPOLL_CTL_DEL, fd_num, nullptr );
+    _epoll_entries.erase( fd_num );
+  }
+}
+
+EventLoop::Result EventLoop::wait_epoll( const int timeout_ms )
+{
+  // drop the rules that are finished, and note what the rest are interested in
+  bool something_to_poll = false;
+  for ( auto it = _fd_rules.begin(); it != _fd_rules.end(); ) {
+    auto& this_rule = **it;
+    const bool finished
+      = this_rule.cancel_requested or this_rule.fd.closed()
+        or ( this_rule.direction == Direction::In and this_rule.fd.eof() );
+    if ( finished ) {
+      if ( not this_rule.cancel_requested ) {
+        this_rule.cancel();
+      }
+      epoll_forget( *it );
+      it = _fd_rules.erase( it );
+      continue;
+    }
+
+    this_rule.interested = this_rule.interest();
+    something_to_poll |= this_rule.interested;
+    if ( not this_rule.registered ) {
+      _epoll_entries[this_rule.fd.fd_num()].rules.push_back( *it );
+      this_rule.registered = true;
+    }
+    ++it;
+  }
+
+  // quit if there is nothing left to poll
+  if ( not something_to_poll ) {
+    return Result::Exit;
+  }
+
+  // register new fds, and widen the events of any fd with a newly interested rule. (An fd whose rules have
+  // lost interest stays registered until an unwanted event arrives, which saves a system call each time a
+  // rule's interest comes and goes between events.) Errors and hangups are reported even with no events, so an
+  // fd taken out of the set after an unwanted hangup stays out until one of its rules is interested again.
+  vector<pair<int, uint32_t>> always_ready {};
+  for ( auto& [fd_num, entry] : _epoll_entries ) {
+    uint32_t wanted = 0;
+    for ( const auto& rule : entry.rules ) {
+      wanted |= rule->interested ? static_cast<uint32_t>( rule->direction ) : 0;
+    }
+    if ( entry.always_ready ) {
+      if ( wanted ) {
+        always_ready.emplace_back( fd_num, wanted );
+      }
+      continue;
+    }
+    if ( entry.added and ( wanted & ~entry.events ) == 0 ) {
+      continue;
+    }
+    if ( entry.hung_up and not wanted ) {
+      continue;
+    }
+
+    epoll_event event {};
+    event.events = entry.events | wanted;
+    event.data.fd = fd_num;
+    if ( ::epoll_ctl( _epoll_fd->fd_num(), entry.added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd_num, &event ) == 0 ) {
+      entry.added = true;
+      entry.hung_up = false;
+      entry.events = event.events;
+    } else if ( errno == EPERM ) {
+      entry.always_ready = true;
+      if ( wanted ) {
+        always_ready.emplace_back( fd_num, wanted );
+      }
+    } else {
+      throw unix_error( "epoll_ctl" );
+    }
+  }
+
+  // wait until some of the fds are ready (or don't wait, if one always is)
+  const auto deadline = chrono::steady_clock::now() + chrono::milliseconds { timeout_ms };
+  int wait_ms = always_ready.empty() ? timeout_ms : 0;
+  while ( true ) {
+    const int capacity = static_cast<int>( _epoll_events.size() );
+    int count = ::epoll_wait( _epoll_fd->fd_num(), _epoll_events.data(), capacity, wait_ms );
+    if ( count < 0 ) {
+      if ( errno != EINTR ) {
+        throw unix_error { "epoll_wait" };
+      }
+      count = 0; // a signal interrupted the wait: serve the always-ready fds, or wait again below
+    } else if ( count == 0 and always_ready.empty() ) {
+      return Result::Timeout;
+    }
+
+    // serve every ready fd
+    bool served = false;
+    for ( const auto& [fd_num, revents] : always_ready ) {
+      served |= epoll_dispatch( fd_num, revents );
+    }
+    for ( int i = 0; i < count; i++ ) {
+      served |= epoll_dispatch( _epoll_events[i].data.fd, _epoll_events[i].events );
+    }
+    if ( served ) {
+      return Result::Success;
+    }
+
+    // only events that nobody wanted any more (and now won't get again), or a signal: wait out the rest of the
+    // timeout. (The always-ready fds' rules have all lost interest, and nothing has run that could bring it back.)
+    always_ready.clear();
+    wait_ms = remaining_ms( timeout_ms, deadline );
+    if ( wait_ms == 0 ) {
+      return Result::Timeout;
+    }
+  }
+}
+
+bool EventLoop::epoll_dispatch( const int fd_num, const uint32_t revents )
+{
+  const auto entry_it = _epoll_entries.find( fd_num );
+  if ( entry_it == _epoll_entries.end() ) {
+    return false;
+  }
+  EpollEntry& entry = entry_it->second;
+
+  // (the callbacks may add and cancel rules, but the entries only change in wait_epoll() before the wait)
+  uint32_t wanted = 0;
+  bool served = false;
+  for ( const auto& rule_ptr : entry.rules ) {
+    auto& this_rule = *rule_ptr;
+    if ( this_rule.cancel_requested or this_rule.fd.closed() ) {
+      continue;
+    }
+
+    if ( revents & EPOLLERR ) {
+      report_error( this_rule );
+      this_rule.error();
+      this_rule.cancel();
+      this_rule.cancel_requested = true; // (already cancelled: drop it without calling cancel again)
+      served = true;
+      continue;
+    }
+
+    const uint32_t requested = this_rule.interested ? static_cast<uint32_t>( this_rule.direction ) : 0;
+    const bool ready = revents & requested;
+    const bool hup = revents & EPOLLHUP;
+    if ( hup and ( ( requested and not ready ) or this_rule.direction == Direction::Out ) ) {
+      // the fd is defunct, as in wait_poll()
+      this_rule.cancel();
+      this_rule.cancel_requested = true;
+      served = true;
+      continue;
+    }
+
+    // (an earlier callback in this wakeup may have taken the rule's interest away)
+    if ( ready and not this_rule.interest() ) {
+      this_rule.interested = false;
+      continue;
+    }
+    if ( ready ) {
+      serve( this_rule );
+      served = true;
+    }
+    wanted |= requested;
+  }
+
+  // a hangup is reported whatever events are asked for, so one that nobody wanted would wake every wait:
+  // take the fd out of the epoll set until a rule is interested in it again
+  if ( entry.added and ( revents & EPOLLHUP ) and not wanted ) {
+    if ( ::epoll_ctl( _epoll_fd->fd_num(), EPOLL_CTL_DEL, fd_num, nullptr ) == 0 ) {
+      entry.added = false;
+      entry.hung_up = true;
+      entry.events = 0;
+    }
+    return served;
+  }
+
+  // an event nobody wanted: stop asking for it. (If a callback closed the fd, this fails, and the next
+  // wait_epoll() drops its rules.)
+  if ( entry.added and ( revents & entry.events & ~wanted ) ) {
+    epoll_event event {};
+    event.events = wanted;
+    event.data.fd = fd_num;
+    if ( ::epoll_ctl( _epoll_fd->fd_num(), EPOLL_CTL_MOD, fd_num, &event ) == 0 ) {
+      entry.events = wanted;
+    }
+  }
+  return served;
+}
 // NOLINTEND(*-signed-bitwise)
 // NOLINTEND(*-cognitive-complexity)
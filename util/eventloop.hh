@@ -3,9 +3,13 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <poll.h>
 #include <string_view>
+#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
 
 #include "file_descriptor.hh"
 
@@ -20,6 +24,17 @@ public:
     Out = POLLOUT //!< Callback will be triggered when Rule::fd is writable.
   };
 
+  //! How wait_next_event() waits for the fds
+  enum class Backend
+  {
+    Poll, //!< builds a pollfd for every rule and calls poll(2) each time, then serves one ready rule
+    Epoll //!< keeps the fds in an epoll(7) set, changed only as interest changes, and serves every ready fd
+          //!< (up to EVENT_BUDGET)
+  };
+
+  //! The most ready fds one wait_next_event() serves with Backend::Epoll
+  static constexpr size_t EVENT_BUDGET = 64;
+
 private:
   using CallbackT = std::function<void( void )>;
   using InterestT = std::function<bool( void )>;
@@ -46,6 +61,9 @@ private:
     CallbackT cancel;    //!< A callback that is called when the rule is cancelled (e.g. on EOF or hangup)
     CallbackT error;     //!< A callback that is called when the fd has an error before cancellation
 
+    bool interested {}; //!< Backend::Epoll: what interest() said before the last wait
+    bool registered {}; //!< Backend::Epoll: is it in _epoll_entries?
+
     FDRule( BasicRule&& base, FileDescriptor&& s_fd, Direction s_direction, CallbackT s_cancel, CallbackT s_error );
 
     //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
@@ -53,12 +71,27 @@ private:
     unsigned int service_count() const;
   };
 
+  //! Backend::Epoll: the rules on one fd number, and the events it is registered for
+  struct EpollEntry
+  {
+    std::vector<std::shared_ptr<FDRule>> rules {};
+    uint32_t events {};
+    bool added {};        //!< is it in the epoll set yet?
+    bool hung_up {};      //!< taken out of the epoll set after a hangup that no rule wanted to hear about
+    bool always_ready {}; //!< an fd epoll can't watch (e.g. a regular file), which poll(2) calls always ready
+  };
+
   std::vector<RuleCategory> _rule_categories {};
   std::list<std::shared_ptr<FDRule>> _fd_rules {};
   std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
 
+  Backend _backend;
+  std::optional<FileDescriptor> _epoll_fd {};
+  std::unordered_map<int, EpollEntry> _epoll_entries {}; //!< by fd number
+  std::vector<epoll_event> _epoll_events {};
+
 public:
-  EventLoop() { _rule_categories.reserve( 64 ); }
+  explicit EventLoop( Backend backend = Backend::Epoll );
 
   //! Returned by each call to EventLoop::wait_next_event.
   enum class Result
@@ -85,7 +118,7 @@ public:
 
   RuleHandle add_rule(
     size_t category_id,
-    FileDescriptor& fd,
+    const FileDescriptor& fd,
     Direction direction,
     const CallbackT& callback,
     const InterestT& interest = [] { return true; },
@@ -97,7 +130,8 @@ public:
     const CallbackT& callback,
     const InterestT& interest = [] { return true; } );
 
-  //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+  //! Calls [poll(2)](\ref man2::poll) or [epoll_wait(2)](\ref man2::epoll_wait), as the Backend says, and then
+  //! executes the callback for each ready fd.
   Result wait_next_event( int timeout_ms );
 
   // convenience function to add category and rule at the same time
@@ -106,6 +140,15 @@ public:
   {
     return add_rule( add_category( name ), std::forward<Targs>( Fargs )... );
   }
+
+private:
+  bool serve_non_fd_rules();
+  void serve( FDRule& rule );
+  void report_error( const FDRule& rule ) const;
+  void epoll_forget( const std::shared_ptr<FDRule>& rule );
+  bool epoll_dispatch( int fd_num, uint32_t revents ); // returns whether any rule was served (or cancelled)
+  Result wait_poll( int timeout_ms );
+  Result wait_epoll( int timeout_ms );
 };
 
 using Direction = EventLoop::Direction;
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <limits>
 #include <memory>
+#include <span>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -65,8 +66,11 @@ public:
   void read( std::string& buffer );
   void read( std::vector<std::string>& buffers );
 
+  // Read into caller-provided storage; returns the number of bytes read
+  size_t read( std::span<char> buffer );
+
   // Attempt to write a buffer
-  // returns number of bytes written
+  // returns number of bytes written (0 if the fd is non-blocking and would block)
   size_t write( std::string_view buffer );
   size_t write( const std::vector<std::string_view>& buffers );
   size_t write( const std::vector<std::string>& buffers );
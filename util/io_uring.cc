@@ -0,0 +1,388 @@
+#include "io_uring.hh"
+#include "exception.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+// (there is no glibc wrapper for these)
+int io_uring_setup( unsigned entries, io_uring_params& params )
+{
+  return static_cast<int>( ::syscall( __NR_io_uring_setup, entries, &params ) );
+}
+
+// Completions are task work, which by default interrupts the process (and an epoll_wait() or poll() it is in,
+// with EINTR). Where the kernel allows (Linux 5.19), it waits for the process's next system call instead, and
+// IORING_SQ_TASKRUN says there is some.
+int io_uring_setup_cooperative( unsigned entries, io_uring_params& params )
+{
+  params = {};
+  params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+  const int ring_fd = io_uring_setup( entries, params );
+  if ( ring_fd >= 0 or errno != EINVAL ) {
+    return ring_fd;
+  }
+  params = {};
+  return io_uring_setup( entries, params );
+}
+
+int io_uring_enter( int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags )
+{
+  return static_cast<int>( ::syscall( __NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0 ) );
+}
+
+int io_uring_register( int ring_fd, unsigned opcode, const void* arg, unsigned nr_args )
+{
+  return static_cast<int>( ::syscall( __NR_io_uring_register, ring_fd, opcode, arg, nr_args ) );
+}
+
+// The memory the kernel shares with a ring
+class Mapping
+{
+  void* addr_;
+  size_t len_;
+
+public:
+  Mapping( int ring_fd, size_t len, off_t offset )
+    : addr_( ::mmap( nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset ) )
+    , len_( len )
+  {
+    if ( addr_ == MAP_FAILED ) {
+      throw unix_error( "mmap" );
+    }
+  }
+  ~Mapping() { ::munmap( addr_, len_ ); }
+
+  template<typename T>
+  T* at( size_t offset ) const
+  {
+    return reinterpret_cast<T*>( static_cast<char*>( addr_ ) + offset ); // NOLINT(*-reinterpret-cast)
+  }
+
+  Mapping( const Mapping& other ) = delete;
+  Mapping& operator=( const Mapping& other ) = delete;
+  Mapping( Mapping&& other ) = delete;
+  Mapping& operator=( Mapping&& other ) = delete;
+};
+
+constexpr uint64_t CANCEL_TAG = UINT64_MAX; // user_data of a cancellation (a read's or write's is its buffer)
+} // namespace
+
+struct IOUringFD::Ring
+{
+  io_uring_params params {};
+  FileDescriptor fd; // (closed after the destructor has waited for everything in flight)
+  FileDescriptor datagram_fd;
+  size_t depth;
+
+  Mapping rings; // the submission and completion queues (which share one mapping, IORING_FEAT_SINGLE_MMAP)
+  Mapping sqe_array;
+
+  // buffer i < depth is read i's, and buffer depth + i is write i's
+  vector<char> buffers;
+  bool registered {};
+
+  unsigned queued {};                  // SQEs not yet submitted
+  size_t in_flight {};                 // reads and writes queued or submitted, and not yet completed
+  vector<bool> busy;                   // by buffer
+  deque<pair<size_t, int>> arrived {}; // reads that have completed (the buffer, and the result)
+  vector<size_t> free_writes {};
+  uint64_t submits {};
+  uint64_t write_errors {};
+
+  Ring( FileDescriptor&& s_datagram_fd, size_t s_depth );
+  ~Ring();
+
+  Ring( const Ring& other ) = delete;
+  Ring& operator=( const Ring& other ) = delete;
+  Ring( Ring&& other ) = delete;
+  Ring& operator=( Ring&& other ) = delete;
+
+  char* buffer( size_t index ) { return buffers.data() + index * BUFFER_SIZE; }
+  io_uring_sqe& next_sqe();
+  void queue( uint8_t opcode, size_t index, size_t len );
+  void read( size_t index ) { queue( registered ? IORING_OP_READ_FIXED : IORING_OP_READ, index, BUFFER_SIZE ); }
+  void submit( unsigned min_complete = 0 );
+  void reap();
+};
+
+IOUringFD::Ring::Ring( FileDescriptor&& s_datagram_fd, size_t s_depth )
+  : fd( ::CheckSystemCall( "io_uring_setup", io_uring_setup_cooperative( 2 * s_depth, params ) ) )
+  , datagram_fd( std::move( s_datagram_fd ) )
+  , depth( s_depth )
+  , rings( fd.fd_num(),
+           max( params.sq_off.array + params.sq_entries * sizeof( unsigned ),
+                params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe ) ),
+           IORING_OFF_SQ_RING )
+  , sqe_array( fd.fd_num(), params.sq_entries * sizeof( io_uring_sqe ), IORING_OFF_SQES )
+  , buffers( 2 * depth * BUFFER_SIZE )
+  , busy( 2 * depth )
+{
+  if ( not( params.features & IORING_FEAT_SINGLE_MMAP ) ) {
+    throw runtime_error( "io_uring: the kernel is too old (no IORING_FEAT_SINGLE_MMAP)" );
+  }
+
+  // (pinning the buffers counts against RLIMIT_MEMLOCK; if there isn't room, the reads and writes copy)
+  vector<iovec> iovecs;
+  for ( size_t i = 0; i < 2 * depth; i++ ) {
+    iovecs.push_back( { buffer( i ), BUFFER_SIZE } );
+  }
+  registered = io_uring_register(
+                 fd.fd_num(), IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<unsigned>( iovecs.size() ) )
+               == 0;
+
+  datagram_fd.set_blocking( true );
+  for ( size_t i = 0; i < depth; i++ ) {
+    read( i );
+    free_writes.push_back( depth + i );
+  }
+  submit();
+}
+
+IOUringFD::Ring::~Ring()
+{
+  try {
+    submit();
+    for ( size_t i = 0; i < busy.size(); i++ ) {
+      if ( busy[i] ) {
+        io_uring_sqe& sqe = next_sqe();
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.addr = i;
+        sqe.user_data = CANCEL_TAG;
+      }
+    }
+    submit();
+    while ( in_flight > 0 ) {
+      submit( 1 );
+      reap();
+    }
+  } catch ( const exception& e ) {
+    // don't throw an exception from the destructor
+    cerr << "Exception destructing IOUringFD: " << e.what() << "\n";
+  }
+}
+
+io_uring_sqe& IOUringFD::Ring::next_sqe()
+{
+  if ( queued == params.sq_entries ) {
+    submit();
+  }
+  auto* const tail = rings.at<unsigned>( params.sq_off.tail );
+  const unsigned index = *tail & *rings.at<unsigned>( params.sq_off.ring_mask );
+  rings.at<unsigned>( params.sq_off.array )[index] = index;
+  io_uring_sqe& sqe = sqe_array.at<io_uring_sqe>( 0 )[index];
+  sqe = {};
+  atomic_ref { *tail }.store( *tail + 1, memory_order_release );
+  queued++;
+  return sqe;
+}
+
+void IOUringFD::Ring::queue( const uint8_t opcode, const size_t index, const size_t len )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = opcode;
+  sqe.fd = datagram_fd.fd_num();
+  sqe.addr = reinterpret_cast<uint64_t>( buffer( index ) ); // NOLINT(*-reinterpret-cast)
+  sqe.len = static_cast<uint32_t>( len );
+  sqe.buf_index = static_cast<uint16_t>( index );
+  sqe.user_data = index;
+  busy[index] = true;
+  in_flight++;
+}
+
+void IOUringFD::Ring::submit( const unsigned min_complete )
+{
+  while ( queued > 0 or min_complete > 0 ) {
+    const int ret = io_uring_enter( fd.fd_num(), queued, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0 );
+    if ( ret < 0 and errno == EINTR ) {
+      continue;
+    }
+    if ( ret < 0 and ( errno == EBUSY or errno == EAGAIN ) ) {
+      reap(); // (the completion queue is full, or the kernel is short of memory: make room, and try again)
+      continue;
+    }
+    ::CheckSystemCall( "io_uring_enter", ret );
+    submits++;
+    queued -= static_cast<unsigned>( ret );
+    if ( min_complete > 0 ) {
+      return;
+    }
+  }
+}
+
+void IOUringFD::Ring::reap()
+{
+  // (run the completions that are waiting as task work, so they are in the queue)
+  const unsigned sq_flags = atomic_ref { *rings.at<unsigned>( params.sq_off.flags ) }.load( memory_order_acquire );
+  if ( sq_flags & IORING_SQ_TASKRUN and io_uring_enter( fd.fd_num(), 0, 0, IORING_ENTER_GETEVENTS ) >= 0 ) {
+    submits++;
+  }
+
+  auto* const head = rings.at<unsigned>( params.cq_off.head );
+  const unsigned tail = atomic_ref { *rings.at<unsigned>( params.cq_off.tail ) }.load( memory_order_acquire );
+  const unsigned mask = *rings.at<unsigned>( params.cq_off.ring_mask );
+  const auto* const cqes = rings.at<io_uring_cqe>( params.cq_off.cqes );
+
+  unsigned next = *head;
+  for ( ; next != tail; next++ ) {
+    const io_uring_cqe& cqe = cqes[next & mask];
+    if ( cqe.user_data == CANCEL_TAG ) {
+      continue;
+    }
+    const size_t index = cqe.user_data;
+    busy[index] = false;
+    in_flight--;
+    if ( index < depth ) {
+      arrived.emplace_back( index, cqe.res );
+    } else {
+      free_writes.push_back( index );
+      write_errors += cqe.res < 0 ? 1 : 0;
+    }
+  }
+  atomic_ref { *head }.store( next, memory_order_release );
+}
+
+bool IOUringFD::available()
+{
+  static const bool ret = [] {
+    io_uring_params params {};
+    const int ring_fd = io_uring_setup( 2, params );
+    if ( ring_fd < 0 ) {
+      return false;
+    }
+    const FileDescriptor ring { ring_fd };
+
+    // the operations it uses, and a probe to ask about them (Linux 5.6)
+    constexpr size_t OPS = 256;
+    vector<char> storage( sizeof( io_uring_probe ) + OPS * sizeof( io_uring_probe_op ) );
+    auto* const probe = reinterpret_cast<io_uring_probe*>( storage.data() ); // NOLINT(*-reinterpret-cast)
+    if ( not( params.features & IORING_FEAT_SINGLE_MMAP )
+         or io_uring_register( ring.fd_num(), IORING_REGISTER_PROBE, probe, OPS ) < 0 ) {
+      return false;
+    }
+    constexpr array needed {
+      IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_ASYNC_CANCEL };
+    return ranges::all_of( needed, [&]( const auto op ) {
+      return op <= probe->last_op and ( probe->ops[op].flags & IO_URING_OP_SUPPORTED ); // NOLINT(*-array-index)
+    } );
+  }();
+  return ret;
+}
+
+IOUringFD::IOUringFD( FileDescriptor&& datagram_fd, const size_t depth )
+  : IOUringFD( make_unique<Ring>( std::move( datagram_fd ), depth ) )
+{}
+
+IOUringFD::IOUringFD( unique_ptr<Ring> ring ) : watch_fd_( ring->fd.duplicate() ), ring_( std::move( ring ) ) {}
+
+IOUringFD::~IOUringFD() = default;
+IOUringFD::IOUringFD( IOUringFD&& other ) noexcept = default;
+IOUringFD& IOUringFD::operator=( IOUringFD&& other ) noexcept = default;
+
+void IOUringFD::read( vector<string>& buffers )
+{
+  watch_fd_.register_read();
+  ring_->reap();
+  if ( ring_->arrived.empty() or buffers.empty() ) {
+    ring_->submit(); // (the reader has caught up: replace the reads it took, and send what it wrote meanwhile)
+    buffers.clear();
+    return;
+  }
+
+  const auto [index, result] = ring_->arrived.front();
+  ring_->arrived.pop_front();
+  ring_->read( index );
+  if ( result < 0 ) {
+    throw unix_error( "io_uring read", -result );
+  }
+
+  // as FileDescriptor::read(): the last buffer gets what doesn't fit in the others
+  buffers.back().resize( BUFFER_SIZE );
+  string_view datagram { ring_->buffer( index ), static_cast<size_t>( result ) };
+  for ( auto& buf : buffers ) {
+    buf.assign( datagram.substr( 0, min( buf.size(), datagram.size() ) ) );
+    datagram.remove_prefix( buf.size() );
+  }
+
+  if ( ring_->arrived.empty() ) {
+    ring_->submit();
+  }
+}
+
+size_t IOUringFD::write( string_view buffer )
+{
+  return write( vector<string_view> { buffer } );
+}
+
+size_t IOUringFD::write( const vector<string>& buffers )
+{
+  return write( vector<string_view> { buffers.begin(), buffers.end() } );
+}
+
+size_t IOUringFD::write( const vector<string_view>& buffers )
+{
+  size_t len = 0;
+  for ( const auto& buf : buffers ) {
+    len += buf.size();
+  }
+  if ( len > BUFFER_SIZE ) {
+    throw runtime_error( "IOUringFD: datagram of " + to_string( len ) + " bytes is longer than BUFFER_SIZE" );
+  }
+
+  Ring& ring = *ring_;
+  if ( ring.free_writes.empty() ) {
+    ring.reap();
+  }
+  if ( ring.free_writes.empty() ) {
+    return 0;
+  }
+
+  const size_t index = ring.free_writes.back();
+  ring.free_writes.pop_back();
+  char* out = ring.buffer( index );
+  for ( const auto& buf : buffers ) {
+    out = ranges::copy( buf, out ).out;
+  }
+  ring.queue( ring.registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, index, len );
+  watch_fd_.register_write();
+
+  // every write buffer is taken: send them
+  if ( ring.free_writes.empty() ) {
+    ring.submit();
+  }
+  return len;
+}
+
+void IOUringFD::submit()
+{
+  ring_->submit();
+}
+
+uint64_t IOUringFD::submits() const
+{
+  return ring_->submits;
+}
+
+uint64_t IOUringFD::write_errors() const
+{
+  return ring_->write_errors;
+}
+
+bool IOUringFD::registered_buffers() const
+{
+  return ring_->registered;
+}
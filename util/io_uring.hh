@@ -0,0 +1,87 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//! How a datagram fd's owner (a TCPStack, or a TCPOverIPv4OverTunFdAdapter) reads and writes it
+enum class DatagramIO : uint8_t
+{
+  Syscalls, //!< a read() per datagram, once poll says the fd is readable, and a writev() per datagram
+  IOUring   //!< in batches, through an IOUringFD (if IOUringFD::available(); if not, as Syscalls)
+};
+
+//! Datagram reads and writes on a file descriptor, batched through an [io_uring(7)](\ref man7::io_uring)
+//! \details Reads of the datagram fd are always in flight, each into a buffer of its own (registered with the
+//! kernel, if the memlock limit allows), so a datagram is read as it arrives, with no system call. Writes are
+//! copied into buffers of their own and queued. One io_uring_enter() submits the queued writes, and a new
+//! read for each datagram taken, when the reader has taken every datagram that has arrived, when every write
+//! buffer is taken, or on submit(). Where poll() + read() + writev() is three system calls per datagram,
+//! this is about one per batch. (Where the kernel allows, completions wait for the process's next system call,
+//! rather than interrupt it.)
+//!
+//! watch_fd() is the ring's own fd, which is readable while completions are waiting, so an EventLoop rule
+//! on it (that calls read() until it finds nothing) stands in for one on the datagram fd. (It is only to be
+//! watched: the datagrams go through the IOUringFD's own read() and write().)
+class IOUringFD
+{
+public:
+  static constexpr size_t DEFAULT_DEPTH = 32;  //!< reads kept in flight, and writes queued or in flight
+  static constexpr size_t BUFFER_SIZE = 16384; //!< longest datagram
+
+  //! Can this process set up a ring that does what IOUringFD needs? (The kernel may be too old, or have
+  //! io_uring disabled by a sysctl or a seccomp filter.) Checked once.
+  static bool available();
+
+  //! Take over a file descriptor that carries one datagram per read and write (it is made blocking: the reads
+  //! wait in the kernel, not in the caller), and start reading it
+  explicit IOUringFD( FileDescriptor&& datagram_fd, size_t depth = DEFAULT_DEPTH );
+
+  //! Take the next datagram that has arrived, splitting it over `buffers` as FileDescriptor::read() would;
+  //! or clear `buffers` if none has. (Each call counts as a read of the ring, for EventLoop.)
+  void read( std::vector<std::string>& buffers );
+
+  //! Queue a datagram to be written
+  //! \returns its length, or 0 if every write buffer is in flight (it is dropped, as by a full queue)
+  size_t write( std::string_view buffer );
+  size_t write( const std::vector<std::string_view>& buffers );
+  size_t write( const std::vector<std::string>& buffers );
+
+  //! Submit the queued writes and reads, if there are any
+  void submit();
+
+  uint64_t submits() const;      //!< io_uring_enter() calls
+  uint64_t write_errors() const; //!< writes that failed in the kernel (they are counted, not thrown)
+  bool registered_buffers() const;
+
+  //! The fd for an EventLoop rule to watch (reads and writes of the ring count as its own)
+  const FileDescriptor& watch_fd() const { return watch_fd_; }
+
+  //! Cancels the reads and writes in flight, and waits for them
+  ~IOUringFD();
+
+  IOUringFD( IOUringFD&& other ) noexcept;
+  IOUringFD& operator=( IOUringFD&& other ) noexcept;
+
+private:
+  // the ring's fd, with read() and write() counted on it, as EventLoop expects of the fd it watches
+  class WatchFD : public FileDescriptor
+  {
+  public:
+    explicit WatchFD( FileDescriptor&& fd ) : FileDescriptor( std::move( fd ) ) {}
+    using FileDescriptor::register_read;
+    using FileDescriptor::register_write;
+  };
+
+  struct Ring;
+  WatchFD watch_fd_;
+  std::unique_ptr<Ring> ring_;
+
+  explicit IOUringFD( std::unique_ptr<Ring> ring );
+};
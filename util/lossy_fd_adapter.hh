@@ -31,22 +31,23 @@ private:
   }
 
 public:
-  //! Conversion to a FileDescriptor by returning the underlying AdapterT
-  FileDescriptor& fd() { return _adapter.fd(); }
+  //! The file descriptor the underlying AdapterT has to be watched for datagrams
+  const FileDescriptor& watch_fd() const { return _adapter.watch_fd(); }
 
   //! Construct from a FileDescriptor appropriate to the AdapterT constructor
   explicit LossyFdAdapter( AdapterT&& adapter ) : _adapter( std::move( adapter ) ) {}
 
-  //! \brief Read from the underlying AdapterT instance, potentially dropping the read datagram
-  //! \returns std::optional<TCPSegment> that is empty if the segment was dropped or if
-  //!          the underlying AdapterT returned an empty value
+  //! \brief Read from the underlying AdapterT instance, potentially dropping the read datagrams
+  //! \returns std::optional<TCPSegment>, the first segment not dropped, or empty once the underlying AdapterT
+  //!          returns an empty value
   std::optional<TCPMessage> read()
   {
-    auto ret = _adapter.read();
-    if ( _should_drop( false ) ) {
-      return {};
+    while ( auto ret = _adapter.read() ) {
+      if ( not _should_drop( false ) ) {
+        return ret;
+      }
     }
-    return ret;
+    return {};
   }
 
   //! \brief Write to the underlying AdapterT instance, potentially dropping the datagram to be written
@@ -10,6 +10,7 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 class Parser
@@ -173,6 +174,7 @@ class Serializer
 {
   std::vector<std::string> output_ {};
   std::string buffer_ {};
+  std::vector<std::pair<size_t, std::string_view>> views_ {}; // bytes held elsewhere, each before output_[first]
 
 public:
   Serializer() = default;
@@ -204,6 +206,16 @@ public:
     }
   }
 
+  // Bytes held elsewhere (e.g. a payload's Slices), which must outlive the output: release() returns them in
+  // place, and output() copies them
+  void view( std::string_view buf )
+  {
+    flush();
+    if ( not buf.empty() ) {
+      views_.emplace_back( output_.size(), buf );
+    }
+  }
+
   void flush()
   {
     if ( not buffer_.empty() ) {
@@ -215,8 +227,46 @@ public:
   const std::vector<std::string>& output()
   {
     flush();
+    if ( not views_.empty() ) {
+      std::vector<std::string> merged;
+      size_t next = 0;
+      for ( const auto& [index, buf] : views_ ) {
+        for ( ; next < index; next++ ) {
+          merged.push_back( std::move( output_[next] ) );
+        }
+        merged.emplace_back( buf );
+      }
+      for ( ; next < output_.size(); next++ ) {
+        merged.push_back( std::move( output_[next] ) );
+      }
+      output_ = std::move( merged );
+      views_.clear();
+    }
     return output_;
   }
+
+  // Take the integers serialized so far as one string, in `storage`, and return it followed by the views, in
+  // place (for a Serializer that was given integers and then views, but no buffers)
+  std::vector<std::string_view> release( std::string& storage )
+  {
+    flush();
+    const auto after_integers = [&]( const auto& v ) { return v.first == output_.size(); };
+    if ( output_.size() > 1 or not std::ranges::all_of( views_, after_integers ) ) {
+      throw std::runtime_error( "Serializer::release() after buffer(), or with integers after a view" );
+    }
+    storage = output_.empty() ? std::string {} : std::move( output_.front() );
+    output_.clear();
+
+    std::vector<std::string_view> ret;
+    if ( not storage.empty() ) {
+      ret.emplace_back( storage );
+    }
+    for ( const auto& v : views_ ) {
+      ret.emplace_back( v.second );
+    }
+    views_.clear();
+    return ret;
+  }
 };
 
 // Helper to serialize any object (without constructing a Serializer of the caller's own)
@@ -0,0 +1,212 @@
+#include "ring_buffer.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+size_t page_size()
+{
+  static const size_t size = sysconf( _SC_PAGESIZE );
+  return size;
+}
+
+// Map a memfd of `size` bytes twice, back-to-back. Returns nullptr on failure.
+char* map_mirrored( const size_t size )
+{
+  const int fd = memfd_create( "ring_buffer", MFD_CLOEXEC );
+  if ( fd < 0 ) {
+    return nullptr;
+  }
+
+  char* base = nullptr;
+  if ( ftruncate( fd, static_cast<off_t>( size ) ) == 0 ) {
+    // reserve a region twice the size, then map the memfd over both halves
+    void* region = mmap( nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( region != MAP_FAILED ) {
+      base = static_cast<char*>( region );
+      void* first = mmap( base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 );
+      void* second = mmap( base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 );
+      if ( first == MAP_FAILED or second == MAP_FAILED ) {
+        munmap( base, 2 * size );
+        base = nullptr;
+      }
+    }
+  }
+
+  close( fd );
+  return base;
+}
+} // namespace
+
+RingBuffer::RingBuffer( const size_t capacity, const bool mirrored ) : capacity_( capacity ), mirrored_( mirrored )
+{}
+
+RingBuffer::~RingBuffer()
+{
+  release();
+}
+
+RingBuffer::RingBuffer( const RingBuffer& other ) : capacity_( other.capacity_ ), mirrored_( other.mirrored_ )
+{
+  *this = other;
+}
+
+RingBuffer& RingBuffer::operator=( const RingBuffer& other )
+{
+  if ( this == &other ) {
+    return *this;
+  }
+
+  if ( capacity_ != other.capacity_ ) {
+    release();
+    capacity_ = other.capacity_;
+    mirrored_ = other.mirrored_;
+  }
+
+  head_ = size_ = 0;
+  size_t offset = other.head_;
+  size_t remaining = other.size_;
+  while ( remaining ) {
+    const size_t chunk = min( remaining, other.storage_size_ - offset );
+    push( { other.storage_ + offset, chunk } );
+    offset = ( offset + chunk ) % other.storage_size_;
+    remaining -= chunk;
+  }
+
+  return *this;
+}
+
+RingBuffer::RingBuffer( RingBuffer&& other ) noexcept
+  : capacity_( other.capacity_ )
+  , storage_size_( exchange( other.storage_size_, 0 ) )
+  , storage_( exchange( other.storage_, nullptr ) )
+  , head_( exchange( other.head_, 0 ) )
+  , size_( exchange( other.size_, 0 ) )
+  , mirrored_( other.mirrored_ )
+{}
+
+RingBuffer& RingBuffer::operator=( RingBuffer&& other ) noexcept
+{
+  if ( this != &other ) {
+    release();
+    capacity_ = other.capacity_;
+    storage_size_ = exchange( other.storage_size_, 0 );
+    storage_ = exchange( other.storage_, nullptr );
+    head_ = exchange( other.head_, 0 );
+    size_ = exchange( other.size_, 0 );
+    mirrored_ = other.mirrored_;
+  }
+  return *this;
+}
+
+void RingBuffer::allocate()
+{
+  if ( mirrored_ ) {
+    const size_t rounded = ( capacity_ + page_size() - 1 ) / page_size() * page_size();
+    storage_ = map_mirrored( rounded );
+    if ( storage_ ) {
+      storage_size_ = rounded;
+      return;
+    }
+    mirrored_ = false; // fall back to ordinary storage
+  }
+
+  storage_ = new char[capacity_]; // NOLINT(*-owning-memory)
+  storage_size_ = capacity_;
+}
+
+void RingBuffer::release()
+{
+  if ( storage_ ) {
+    if ( mirrored_ ) {
+      munmap( storage_, 2 * storage_size_ );
+    } else {
+      delete[] storage_; // NOLINT(*-owning-memory)
+    }
+  }
+  storage_ = nullptr;
+  storage_size_ = head_ = size_ = 0;
+}
+
+size_t RingBuffer::push( string_view data )
+{
+  const size_t len = min( data.size(), available() );
+  if ( len == 0 ) {
+    return 0;
+  }
+  if ( not storage_ ) {
+    allocate();
+  }
+
+  const size_t tail = tail_offset();
+  if ( mirrored_ ) {
+    memcpy( storage_ + tail, data.data(), len );
+  } else {
+    const size_t first = min( len, storage_size_ - tail );
+    memcpy( storage_ + tail, data.data(), first );
+    memcpy( storage_, data.data() + first, len - first );
+  }
+
+  size_ += len;
+  return len;
+}
+
+span<char> RingBuffer::reserve( const size_t len )
+{
+  const size_t wanted = min( len, available() );
+  if ( wanted == 0 ) {
+    return {};
+  }
+  if ( not storage_ ) {
+    allocate();
+  }
+
+  const size_t tail = tail_offset();
+  return { storage_ + tail, mirrored_ ? wanted : min( wanted, storage_size_ - tail ) };
+}
+
+void RingBuffer::commit( const size_t len )
+{
+  if ( len > available() ) {
+    throw runtime_error( "RingBuffer::commit: committing more than is available" );
+  }
+  size_ += len;
+}
+
+string_view RingBuffer::peek() const
+{
+  if ( empty() ) {
+    return {};
+  }
+  return { storage_ + head_, mirrored_ ? size_ : min( size_, storage_size_ - head_ ) };
+}
+
+vector<string_view> RingBuffer::peek_iov( const size_t max_len ) const
+{
+  vector<string_view> ret;
+  size_t remaining = min( max_len, size_ );
+  size_t offset = head_;
+  while ( remaining ) {
+    const size_t chunk = mirrored_ ? remaining : min( remaining, storage_size_ - offset );
+    ret.emplace_back( storage_ + offset, chunk );
+    offset = ( offset + chunk ) % storage_size_;
+    remaining -= chunk;
+  }
+  return ret;
+}
+
+void RingBuffer::pop( const size_t len )
+{
+  if ( len > size_ ) {
+    throw runtime_error( "RingBuffer::pop: popping more than is buffered" );
+  }
+  size_ -= len;
+  // once empty, rewind to the start so that the next push lands contiguously
+  head_ = size_ ? ( head_ + len ) % storage_size_ : 0;
+}
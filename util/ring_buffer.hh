@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+//! A fixed-capacity circular byte buffer
+//! \details When constructed with `mirrored` set, the storage is a memfd mapped twice back-to-back in
+//! virtual memory, so the buffered bytes are always one contiguous region (even when they wrap around
+//! the end of the buffer). If the mirrored mapping can't be set up, the buffer falls back to ordinary
+//! heap storage, where the buffered bytes may be split in two at the wrap point.
+//! Storage is allocated lazily, on the first write.
+class RingBuffer
+{
+public:
+  explicit RingBuffer( size_t capacity, bool mirrored = true );
+  ~RingBuffer();
+
+  RingBuffer( const RingBuffer& other );
+  RingBuffer& operator=( const RingBuffer& other );
+  RingBuffer( RingBuffer&& other ) noexcept;
+  RingBuffer& operator=( RingBuffer&& other ) noexcept;
+
+  size_t capacity() const { return capacity_; }          // Maximum number of bytes that can be buffered
+  size_t size() const { return size_; }                  // Number of bytes currently buffered
+  size_t available() const { return capacity_ - size_; } // Number of bytes that can still be written
+  bool empty() const { return size_ == 0; }              // Is nothing buffered?
+  bool mirrored() const { return mirrored_; }            // Is the storage double-mapped (always contiguous)?
+
+  // Copy as much of `data` as fits into the buffer; returns the number of bytes written
+  size_t push( std::string_view data );
+
+  // A writable region of at most `len` bytes just past the buffered bytes. The region may be shorter than
+  // requested if the buffer is full or (when not mirrored) if the free space wraps around.
+  std::span<char> reserve( size_t len );
+
+  // Mark the first `len` bytes of the region returned by reserve() as buffered
+  void commit( size_t len );
+
+  // The longest contiguous run of buffered bytes, starting from the oldest.
+  // If the buffer is mirrored, this is every buffered byte.
+  std::string_view peek() const;
+
+  // Every buffered byte (at most `max_len` of them) as one or two contiguous runs, oldest first
+  std::vector<std::string_view> peek_iov( size_t max_len ) const;
+
+  // Discard `len` bytes (at most size()) from the front of the buffer
+  void pop( size_t len );
+
+private:
+  size_t capacity_;        // logical capacity requested by the user
+  size_t storage_size_ {}; // size of the storage region (>= capacity_ once allocated)
+  char* storage_ {};       // start of the storage region (the first of two mappings, if mirrored)
+  size_t head_ {};         // offset of the oldest buffered byte
+  size_t size_ {};         // number of bytes buffered
+  bool mirrored_;          // storage is (or will be) double-mapped
+
+  void allocate();
+  void release();
+  size_t tail_offset() const { return ( head_ + size_ ) % storage_size_; }
+};
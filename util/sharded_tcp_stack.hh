@@ -0,0 +1,108 @@
+#pragma once
+
+#include "address.hh"
+#include "eventfd.hh"
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "spsc_byte_ring.hh"
+#include "tcp_config.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_stack.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! TCP connections spread over worker threads ("shards"), each with a TCPStack, a datagram fd and connections
+//! of its own
+//! \details Give it one fd per queue of a multi-queue device (e.g. from TunFD::open_queues()), and each queue
+//! gets a thread. A connection belongs to the shard that FourTuple::FlowHash picks for it, and only that
+//! shard's thread ever touches it. The device steers datagrams by a hash of its own, so one may arrive on
+//! another shard's queue; that shard passes it on to the owner through a lock-free SPSCByteRing. (A TUN
+//! device notes the queue each flow last sent on and steers the flow's replies there, so once the owner has
+//! sent, the rest of the connection arrives where it belongs.)
+//!
+//! The shards share no locks and no connection state: the only lock is for post(), which is for setting
+//! things up (e.g. connect()), not for moving data.
+class ShardedTCPStack
+{
+public:
+  //! Run on a shard's thread, with its stack
+  using Task = std::function<void( TCPStack& stack )>;
+
+  //! Run on each shard's thread before it starts, e.g. to listen() and set handlers. The handlers run on that
+  //! thread too, and must not touch other shards' connections.
+  using Setup = std::function<void( TCPStack& stack, size_t shard )>;
+
+  //! Start a thread for each fd (which carry one IPv4 datagram per read and write, as a TunFD does), whose
+  //! stack reads and writes it as `io` says
+  ShardedTCPStack( std::vector<FileDescriptor>&& queues,
+                   const Setup& setup,
+                   DatagramIO io = DatagramIO::Syscalls );
+
+  //! Stop the threads and wait for them (the shards' connections are kept until the object is destroyed)
+  void stop();
+
+  ~ShardedTCPStack() { stop(); }
+
+  size_t shards() const { return shards_.size(); }
+
+  //! The shard a connection belongs to
+  size_t shard_of( const FourTuple& tuple ) const { return FourTuple::FlowHash {}( tuple ) % shards_.size(); }
+
+  //! Run `task` on a shard's thread, soon
+  void post( size_t shard, Task task );
+
+  //! Open a connection from `local` to `remote`, on the shard it belongs to
+  void connect( const TCPConfig& config, const Address& local, const Address& remote );
+
+  //! Datagrams that arrived on a shard's queue for a connection of another shard, and were passed on to it
+  uint64_t forwarded( size_t shard ) const { return shards_.at( shard )->forwarded.load(); }
+
+  //! Datagrams that a shard couldn't pass on, because the ring to the owner was full
+  uint64_t forward_drops( size_t shard ) const { return shards_.at( shard )->forward_drops.load(); }
+
+  // The threads use the object, so it can't be copied or moved
+  ShardedTCPStack( const ShardedTCPStack& other ) = delete;
+  ShardedTCPStack& operator=( const ShardedTCPStack& other ) = delete;
+  ShardedTCPStack( ShardedTCPStack&& other ) = delete;
+  ShardedTCPStack& operator=( ShardedTCPStack&& other ) = delete;
+
+private:
+  static constexpr size_t RING_CAPACITY = 256 * 1024; //!< of each ring between two shards
+  static constexpr uint64_t TICK_MS = 10;             //!< longest a shard sleeps without ticking its stack
+
+  struct Shard
+  {
+    TCPStack stack;
+    EventFD wakeup {};
+    std::vector<std::unique_ptr<SPSCByteRing>> inbound {}; //!< rings from the other shards, by their index
+
+    // a datagram on its way into a ring, and on its way out of one
+    std::string record {};
+    std::vector<std::string> delivery = std::vector<std::string>( 1 );
+
+    std::atomic<uint64_t> forwarded {};
+    std::atomic<uint64_t> forward_drops {};
+
+    std::mutex tasks_mutex {};
+    std::vector<Task> tasks {};
+    std::atomic<bool> has_tasks {};
+
+    std::thread thread {};
+
+    Shard( FileDescriptor&& fd, DatagramIO io ) : stack( std::move( fd ), io ) {}
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_ {};
+  std::atomic<bool> stop_ {};
+
+  void run( size_t index, const Setup& setup );
+  bool forward( size_t from, const std::vector<std::string>& datagram );
+  void drain( Shard& shard );
+};
@@ -0,0 +1,101 @@
+#include "spsc_byte_ring.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+// The cross-thread loads and stores below are sequentially consistent, which the wakeup protocol relies on.
+// A side about to sleep sets its "waiting" flag and then re-checks the other side's counter; the other side
+// updates its counter and then checks the flag. At least one of the two is guaranteed to see the other's
+// store, so either the sleeper doesn't sleep or it gets notified.
+
+SPSCByteRing::SPSCByteRing( const size_t capacity, EventFD& consumer_wakeup, EventFD& producer_wakeup )
+  : capacity_( capacity )
+  , storage_( make_unique<char[]>( capacity ) )
+  , consumer_wakeup_( consumer_wakeup )
+  , producer_wakeup_( producer_wakeup )
+{
+  if ( capacity == 0 ) {
+    throw runtime_error( "SPSCByteRing: capacity must be nonzero" );
+  }
+}
+
+size_t SPSCByteRing::available_capacity() const
+{
+  return capacity_ - ( pushed_.load() - popped_.load() );
+}
+
+size_t SPSCByteRing::push( string_view data )
+{
+  const uint64_t pushed = pushed_.load( memory_order_relaxed ); // only this thread writes it
+  const size_t len = min( data.size(), capacity_ - ( pushed - popped_.load() ) );
+  if ( len == 0 ) {
+    return 0;
+  }
+
+  // copy in up to two pieces, split at the end of the storage
+  const size_t offset = pushed % capacity_;
+  const size_t first = min( len, capacity_ - offset );
+  memcpy( storage_.get() + offset, data.data(), first );
+  memcpy( storage_.get(), data.data() + first, len - first );
+
+  pushed_.store( pushed + len );
+  if ( consumer_waiting_.load() and consumer_waiting_.exchange( false ) ) {
+    consumer_wakeup_.notify();
+  }
+  return len;
+}
+
+void SPSCByteRing::close()
+{
+  closed_.store( true );
+  consumer_waiting_.store( false );
+  consumer_wakeup_.notify();
+}
+
+bool SPSCByteRing::request_space_wakeup()
+{
+  producer_waiting_.store( true );
+  return available_capacity() < space_wakeup_threshold();
+}
+
+string_view SPSCByteRing::peek() const
+{
+  const uint64_t popped = popped_.load( memory_order_relaxed ); // only this thread writes it
+  const size_t offset = popped % capacity_;
+  const size_t len = min( static_cast<size_t>( pushed_.load() - popped ), capacity_ - offset );
+  return { storage_.get() + offset, len };
+}
+
+void SPSCByteRing::pop( const size_t len )
+{
+  const uint64_t popped = popped_.load( memory_order_relaxed );
+  if ( len > pushed_.load() - popped ) {
+    throw runtime_error( "SPSCByteRing: pop() of more bytes than are buffered" );
+  }
+  popped_.store( popped + len );
+
+  if ( producer_waiting_.load() and available_capacity() >= space_wakeup_threshold()
+       and producer_waiting_.exchange( false ) ) {
+    producer_wakeup_.notify();
+  }
+}
+
+size_t SPSCByteRing::size() const
+{
+  return pushed_.load() - popped_.load();
+}
+
+bool SPSCByteRing::is_finished() const
+{
+  // load closed_ first: every push() happened before close(), so if it's set, size() sees all of them
+  return closed_.load() and size() == 0;
+}
+
+bool SPSCByteRing::request_data_wakeup()
+{
+  consumer_waiting_.store( true );
+  return size() == 0 and not closed_.load();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "eventfd.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+//! A lock-free byte ring shared by exactly one producer thread and one consumer thread
+//! \details Neither side ever blocks or takes a lock. Before going to sleep, a side asks to be woken
+//! (request_data_wakeup() or request_space_wakeup()), and the other side then notifies its EventFD once:
+//! the consumer when the ring goes from empty to non-empty (or is closed), and the producer when at least
+//! half the ring is free again. A side that never sleeps never costs the other side a system call.
+class SPSCByteRing
+{
+public:
+  SPSCByteRing( size_t capacity, EventFD& consumer_wakeup, EventFD& producer_wakeup );
+
+  size_t capacity() const { return capacity_; }
+
+  //! \name Producer side
+  //!@{
+  size_t push( std::string_view data ); //!< Copy as much of `data` as fits; returns the number of bytes copied
+  void close();                         //!< Signal that nothing more will be pushed
+  bool is_closed() const { return closed_.load(); }
+  size_t available_capacity() const; //!< How many bytes can be pushed right now?
+
+  //! Ask to be woken once at least half the ring is free; returns false (don't sleep) if it already is
+  bool request_space_wakeup();
+  //!@}
+
+  //! \name Consumer side
+  //!@{
+  std::string_view peek() const; //!< The buffered bytes, up to the point where they wrap around the storage
+  void pop( size_t len );        //!< Discard `len` bytes (at most size()) from the front
+  size_t size() const;           //!< How many bytes are buffered?
+  bool is_finished() const;      //!< Closed, and every byte popped?
+
+  //! Ask to be woken once there are bytes to pop; returns false (don't sleep) if there are, or the ring is closed
+  bool request_data_wakeup();
+  //!@}
+
+  // A ring is shared by two threads, so it can't be copied or moved
+  SPSCByteRing( const SPSCByteRing& other ) = delete;
+  SPSCByteRing& operator=( const SPSCByteRing& other ) = delete;
+  SPSCByteRing( SPSCByteRing&& other ) = delete;
+  SPSCByteRing& operator=( SPSCByteRing&& other ) = delete;
+  ~SPSCByteRing() = default;
+
+private:
+  size_t capacity_;
+  std::unique_ptr<char[]> storage_;
+  EventFD& consumer_wakeup_;
+  EventFD& producer_wakeup_;
+
+  // Each side's state is written by that side only, and kept on its own cache line.
+  alignas( 64 ) std::atomic<uint64_t> pushed_ {}; // cumulative bytes pushed (written by the producer)
+  std::atomic<bool> producer_waiting_ {};
+  std::atomic<bool> closed_ {};
+  alignas( 64 ) std::atomic<uint64_t> popped_ {}; // cumulative bytes popped (written by the consumer)
+  std::atomic<bool> consumer_waiting_ {};
+
+  size_t space_wakeup_threshold() const { return ( capacity_ + 1 ) / 2; }
+};
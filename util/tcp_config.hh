@@ -7,6 +7,14 @@
 #include <cstdint>
 #include <optional>
 
+//! Congestion control algorithm used by the TCP sender
+enum class CongestionControl : uint8_t
+{
+  None,    //!< limit flight by the receiver's window only
+  NewReno, //!< RFC 5681 slow start and congestion avoidance, with RFC 6582 / RFC 6675 fast recovery
+  CUBIC,   //!< RFC 9438
+};
+
 //! Config for TCP sender and receiver
 class TCPConfig
 {
@@ -15,11 +23,45 @@ public:
   static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr size_t MAX_SACK_BLOCKS = 4;      //!< SACK blocks that fit in the TCP header's options
+  static constexpr unsigned DUP_THRESH = 3;         //!< Segments SACKed above a hole before it counts as lost
+  static constexpr uint8_t MAX_WINDOW_SHIFT = 14;   //!< Largest window scale allowed by RFC 7323
+  static constexpr uint32_t MAX_WINDOW = uint32_t { UINT16_MAX } << MAX_WINDOW_SHIFT; //!< Largest scaled window
+  static constexpr uint16_t DEFAULT_MTU = 1500;     //!< Ethernet
+  static constexpr uint16_t HEADERS_LEN = 40;       //!< IPv4 and TCP headers without options
+  static constexpr uint16_t DEFAULT_MSS = 536;      //!< MSS assumed if the peer's SYN has no MSS option (RFC 9293)
+  static constexpr uint16_t TIMESTAMPS_LEN = 12;    //!< Timestamps option, with padding
+  static constexpr size_t PMTU_SEARCH_DONE = 32;    //!< PLPMTUD stops probing once within this many bytes
+  static constexpr unsigned MAX_PROBES = 3;         //!< Lost probes of one size before PLPMTUD calls it too big
+  static constexpr unsigned ACK_EVERY = 2;          //!< A delayed ACK waits for at most this many full segments
+  static constexpr unsigned PACING_SS_GAIN = 200;   //!< Pacing rate in slow start, as a percentage of cwnd/SRTT
+  static constexpr unsigned PACING_CA_GAIN = 120;   //!< ... and in congestion avoidance
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
+  bool adaptive_rto = true;                //!< Compute the RTO from measured round-trip times (RFC 6298)
+  uint64_t rto_min = 200;                  //!< Lower bound on the adaptive RTO, in milliseconds
+  uint64_t rto_max = 60000;                //!< Upper bound on the RTO, in milliseconds
   size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
   size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
   Wrap32 isn { 137 };                      //!< Default initial sequence number
+  bool window_scaling = true;              //!< Offer the window scale option (RFC 7323) in the SYN
+  bool timestamps = true;                  //!< Send the timestamps option (RFC 7323) for RTT measurement and PAWS
+  bool sack = true;                        //!< Offer selective acknowledgments (RFC 2018) in the SYN
+  uint16_t mtu = DEFAULT_MTU;              //!< MTU of the interface, which bounds the MSS advertised and used
+                                           //!< (set it from TunTapFD::mtu() when running over a TUN device)
+  bool plpmtud = true;                     //!< Probe for a larger path MTU (RFC 4821) instead of assuming `mtu`
+  bool delayed_ack = true;                 //!< Hold back pure ACKs of in-order data (RFC 9293 section 3.8.6.3)
+  uint64_t ack_delay = 40;                 //!< Longest a delayed ACK waits, in milliseconds
+  unsigned stretch_ack = ACK_EVERY;        //!< Full segments per ACK while data streams in; above 2 stretches ACKs
+  bool fast_retransmit = true;             //!< Resend after DUP_THRESH duplicate ACKs (RFC 5681, RFC 6582)
+  bool rack_tlp = true;                    //!< Time-based loss detection and tail loss probes (RFC 8985)
+  bool pacing = false;                     //!< Spread segments over the round trip instead of sending bursts
+  uint64_t pacing_rate = 0;                //!< Pacing rate in bytes per second (0: from cwnd and SRTT)
+  bool nodelay = false;                    //!< Send small segments at once (TCP_NODELAY), not per Nagle
+  bool autocork = false;                   //!< Hold small segments until the socket's event loop iteration ends
+  bool zero_copy = false;                  //!< Deque-backed streams, so payloads reach the fd uncopied (opt-in:
+                                           //!< the default ring-backed streams copy each byte in, and out once)
+  CongestionControl congestion_control = CongestionControl::NewReno; //!< Congestion control algorithm
 };
 
 //! Config for classes derived from FdAdapter
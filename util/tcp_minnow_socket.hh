@@ -1,9 +1,11 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "eventfd.hh"
 #include "eventloop.hh"
 #include "file_descriptor.hh"
 #include "socket.hh"
+#include "spsc_byte_ring.hh"
 #include "tcp_config.hh"
 #include "tcp_peer.hh"
 #include "tuntap_adapter.hh"
@@ -14,13 +16,20 @@
 #include <thread>
 #include <vector>
 
+//! How a TCPMinnowSocket moves bytes between its owner thread and its TCPPeer thread
+enum class ThreadChannel : uint8_t
+{
+  SocketPair,   //!< an AF_UNIX stream socketpair (every byte crosses the kernel twice)
+  SharedMemory, //!< a pair of lock-free SPSCByteRings, with EventFD wakeups
+};
+
 //! Multithreaded wrapper around TCPPeer that approximates the Unix sockets API
 template<TCPDatagramAdapter AdaptT>
 class TCPMinnowSocket : public LocalStreamSocket
 {
 public:
   //! Construct from the interface that the TCPPeer thread will use to read and write datagrams
-  explicit TCPMinnowSocket( AdaptT&& datagram_interface );
+  explicit TCPMinnowSocket( AdaptT&& datagram_interface, ThreadChannel channel = ThreadChannel::SocketPair );
 
   //! Close socket, and wait for TCPPeer to finish
   //! \note Calling this function is only advisable if the socket has reached EOF,
@@ -31,6 +40,8 @@ public:
   void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
 
   //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
+  //! \details One-shot: the adapter stops listening at the first SYN. (For a port that accepts many
+  //! connections, with a backlog, use TCPStack::listen() and TCPStack::accept().)
   void listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
 
   //! When a connected socket is destructed, it will send a RST
@@ -58,13 +69,48 @@ public:
   // Return peer address from underlying datagram adapter
   const Address& peer_address() const { return _datagram_adapter.config().destination; }
 
+  //! \name
+  //! Reading and writing from the owner thread. With ThreadChannel::SocketPair these are the ordinary
+  //! (non-blocking) socket calls; with ThreadChannel::SharedMemory they copy to and from the shared rings.
+  //! (In that mode, the socket's file descriptor carries no data, so call these rather than the base class's.)
+
+  //!@{
+  using LocalStreamSocket::read;
+  using LocalStreamSocket::write;
+  void read( std::string& buffer );
+  size_t write( std::string_view buffer );
+  void shutdown( int how );
+
+  //! Block until read() or (if `want_write`) write() can make progress, or until `timeout_ms` passes
+  void wait_until_ready( bool want_write, int timeout_ms = -1 );
+  //!@}
+
 protected:
   //! Adapter to underlying datagram socket (e.g., UDP or IP)
   AdaptT _datagram_adapter;
 
 private:
-  //! Stream socket for reads and writes between owner and TCP thread
-  LocalStreamSocket _thread_data;
+  //! Stream socket for reads and writes between owner and TCP thread (ThreadChannel::SocketPair only)
+  std::optional<LocalStreamSocket> _thread_data {};
+
+  //! How bytes move between the owner and TCP thread
+  ThreadChannel _channel;
+
+  //! With ThreadChannel::SharedMemory: wakeups for each thread, and the rings in each direction
+  //!@{
+  EventFD _owner_wakeup {};
+  EventFD _tcp_wakeup {};
+  std::optional<SPSCByteRing> _outbound_ring {}; //!< owner thread -> TCP thread
+  std::optional<SPSCByteRing> _inbound_ring {};  //!< TCP thread -> owner thread
+  //!@}
+
+  bool _inbound_ring_full { false }; //!< Is the TCP thread waiting for the owner to make room in _inbound_ring?
+
+  //! With ThreadChannel::SharedMemory: move bytes between the rings and the TCPPeer (on the TCP thread)
+  //!@{
+  void _pull_from_outbound_ring();
+  void _push_to_inbound_ring();
+  //!@}
 
   //! Set up the TCPPeer and the event loop
   void _initialize_TCP( const TCPConfig& config );
@@ -72,6 +118,9 @@ private:
   //! TCP state machine
   std::optional<TCPPeer> _tcp {};
 
+  //! Hold small segments until the end of each event loop iteration (TCPConfig::autocork)
+  bool _autocork { false };
+
   //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
   EventLoop _eventloop {};
 
@@ -84,8 +133,10 @@ private:
   //! Handle to the TCPPeer thread; owner thread calls join() in the destructor
   std::thread _tcp_thread {};
 
-  //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
-  TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT&& datagram_interface );
+  //! Construct from the owner's and (with a socket pair) the TCP thread's ends of the data channel
+  TCPMinnowSocket( std::pair<FileDescriptor, std::optional<FileDescriptor>> data_sockets,
+                   AdaptT&& datagram_interface,
+                   ThreadChannel channel );
 
   std::atomic_bool _abort { false }; //!< Flag used by the owner to force the TCPPeer thread to shut down
 
@@ -113,21 +164,37 @@ using LossyTCPOverIPv4MinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4O
 //!
 //! There are a few notable differences between the TCPMinnowSocket and TCPSocket interfaces:
 //!
-//! - a TCPMinnowSocket can only accept a single connection
+//! - a TCPMinnowSocket can only accept a single connection (TCPStack::listen() and TCPStack::accept() serve
+//!   a listening port's many connections)
 //! - listen_and_accept() is a blocking function call that acts as both [listen(2)](\ref man2::listen)
 //!   and [accept(2)](\ref man2::accept)
 //! - if TCPMinnowSocket is destructed while a TCP connection is open, the connection is
 //!   immediately terminated with a RST (call `wait_until_closed` to avoid this)
+//!
+//! By default the two threads exchange bytes through a socketpair, so the owner can treat the
+//! TCPMinnowSocket as an ordinary file descriptor (e.g. poll it in an EventLoop). With
+//! ThreadChannel::SharedMemory, they instead share two lock-free rings, and the kernel is involved
+//! only to wake a thread that is waiting for the other one. (No socketpair is made then: the socket's own
+//! file descriptor is an AF_UNIX stream socket that is never connected.)
 
 //! Helper class that makes a TCPOverIPv4MinnowSocket behave more like a (kernel) TCPSocket
 class CS144TCPSocket : public TCPOverIPv4MinnowSocket
 {
+  uint16_t mtu_;
+
+  // (std::move only casts, so the MTU is read before the adapter takes the device)
+  explicit CS144TCPSocket( TunFD&& tun ) : CS144TCPSocket( tun.mtu(), std::move( tun ) ) {}
+  CS144TCPSocket( uint16_t mtu, TunFD&& tun )
+    : TCPOverIPv4MinnowSocket( TCPOverIPv4OverTunFdAdapter { std::move( tun ) } ), mtu_( mtu )
+  {}
+
 public:
-  CS144TCPSocket() : TCPOverIPv4MinnowSocket( TCPOverIPv4OverTunFdAdapter { TunFD { "tun144" } } ) {}
+  CS144TCPSocket() : CS144TCPSocket( TunFD { "tun144" } ) {}
   void connect( const Address& address )
   {
     TCPConfig tcp_config;
     tcp_config.rt_timeout = 100;
+    tcp_config.mtu = mtu_;
 
     FdAdapterConfig multiplexer_config;
     multiplexer_config.source = { "169.254.144.9", std::to_string( uint16_t( std::random_device()() ) ) };
@@ -4,9 +4,12 @@
 #include "parser.hh"
 #include "tun.hh"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <exception>
 #include <iostream>
+#include <poll.h>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
@@ -30,7 +33,16 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
 {
   auto base_time = timestamp_ms();
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    // wake for the next tick, or sooner if a paced segment or a timer is due
+    uint64_t timeout_ms = TCP_TICK_MS;
+    if ( _tcp.has_value() ) {
+      timeout_ms = std::min( timeout_ms, _tcp->next_deadline().value_or( TCP_TICK_MS ) );
+    }
+    // autocork: the segments a rule pushes gather small writes until the rule is done
+    if ( _autocork and _tcp.has_value() ) {
+      _tcp->set_corked( true );
+    }
+    auto ret = _eventloop.wait_next_event( static_cast<int>( timeout_ms ) );
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
@@ -38,6 +50,10 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
     if ( not _tcp.has_value() ) {
       throw std::runtime_error( "_tcp_loop entered before TCPPeer initialized" );
     }
+    if ( _autocork ) {
+      _tcp->set_corked( false );
+      _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+    }
 
     if ( _tcp.value().active() ) {
       const auto next_time = timestamp_ms();
@@ -48,16 +64,22 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
   }
 }
 
-//! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
+//! \param[in] data_sockets are the owner's and (for ThreadChannel::SocketPair) the TCP thread's AF_UNIX
+//! SOCK_STREAM sockets
 //! \param[in] datagram_interface is the interface for reading and writing datagrams
+//! \param[in] channel is how bytes move between the owner and TCP thread
 template<TCPDatagramAdapter AdaptT>
-TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair,
-                                          AdaptT&& datagram_interface )
-  : LocalStreamSocket( std::move( data_socket_pair.first ) )
+TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, std::optional<FileDescriptor>> data_sockets,
+                                          AdaptT&& datagram_interface,
+                                          const ThreadChannel channel )
+  : LocalStreamSocket( std::move( data_sockets.first ) )
   , _datagram_adapter( std::move( datagram_interface ) )
-  , _thread_data( std::move( data_socket_pair.second ) )
+  , _channel( channel )
 {
-  _thread_data.set_blocking( false );
+  if ( data_sockets.second.has_value() ) {
+    _thread_data.emplace( std::move( *data_sockets.second ) );
+    _thread_data->set_blocking( false );
+  }
   set_blocking( false );
 }
 
@@ -65,6 +87,7 @@ template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
+  _autocork = config.autocork;
 
   // Set up the event loop
 
@@ -83,15 +106,21 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
   // rule 1: read from filtered packet stream and dump into TCPConnection
   _eventloop.add_rule(
     "receive TCP segment from the network",
-    _datagram_adapter.fd(),
+    _datagram_adapter.watch_fd(),
     Direction::In,
     [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
+      // (every segment that has arrived: with DatagramIO::IOUring, the ring's fd isn't readable again for them)
+      while ( auto seg = _datagram_adapter.read() ) {
         _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
+      // an ack may have made room in the outbound stream for bytes waiting in the ring
+      if ( _channel == ThreadChannel::SharedMemory ) {
+        _pull_from_outbound_ring();
+      }
+
       // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
+      if ( _outbound_shutdown and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
         std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
                   << " has been fully acknowledged.\n";
         _fully_acked = true;
@@ -99,18 +128,48 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     },
     [&] { return _tcp->active(); } );
 
+  if ( _channel == ThreadChannel::SharedMemory ) {
+    _outbound_ring.emplace( config.send_capacity, _tcp_wakeup, _owner_wakeup );
+    _inbound_ring.emplace( config.recv_capacity, _owner_wakeup, _tcp_wakeup );
+
+    // rule 2 (shared memory): the owner woke us, because it wrote to an empty outbound ring or made
+    // room in a full inbound ring
+    _eventloop.add_rule(
+      "push bytes to TCPPeer",
+      _tcp_wakeup,
+      Direction::In,
+      [&] {
+        _tcp_wakeup.clear();
+        _inbound_ring_full = false;
+        _pull_from_outbound_ring();
+      },
+      [&] { return _tcp->active(); } );
+
+    // rule 3 (shared memory): move bytes from the inbound stream into the inbound ring.
+    // An eventfd is always writable, so (as with the socket in rule 3 below) this runs when no datagram
+    // is waiting, and bytes from a burst of segments reach the owner together.
+    _eventloop.add_rule(
+      "read bytes from inbound stream",
+      _tcp_wakeup,
+      Direction::Out,
+      [&] { _push_to_inbound_ring(); },
+      [&] {
+        return not _inbound_shutdown
+               and ( ( _tcp->inbound_reader().bytes_buffered() and not _inbound_ring_full )
+                     or _tcp->inbound_reader().is_finished() or _tcp->inbound_reader().has_error() );
+      } );
+    return;
+  }
+
   // rule 2: read from pipe into outbound buffer
   _eventloop.add_rule(
     "push bytes to TCPPeer",
-    _thread_data,
+    *_thread_data,
     Direction::In,
     [&] {
-      std::string data;
-      data.resize( _tcp->outbound_writer().available_capacity() );
-      _thread_data.read( data );
-      _tcp->outbound_writer().push( move( data ) );
+      read_into( *_thread_data, _tcp->outbound_writer() );
 
-      if ( _thread_data.eof() ) {
+      if ( _thread_data->eof() ) {
         _tcp->outbound_writer().close();
         _outbound_shutdown = true;
 
@@ -139,21 +198,17 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
   // rule 3: read from inbound buffer into pipe
   _eventloop.add_rule(
     "read bytes from inbound stream",
-    _thread_data,
+    *_thread_data,
     Direction::Out,
     [&] {
       Reader& inbound = _tcp->inbound_reader();
-      // Write from the inbound_stream into
-      // the pipe, handling the possibility of a partial
+      // Write everything buffered in the inbound_stream into
+      // the pipe with one writev, handling the possibility of a partial
       // write (i.e., only pop what was actually written).
-      if ( inbound.bytes_buffered() ) {
-        const std::string_view buffer = inbound.peek();
-        const auto bytes_written = _thread_data.write( buffer );
-        inbound.pop( bytes_written );
-      }
+      write_from( *_thread_data, inbound );
 
       if ( inbound.is_finished() or inbound.has_error() ) {
-        _thread_data.shutdown( SHUT_WR );
+        _thread_data->shutdown( SHUT_WR );
         _inbound_shutdown = true;
 
         // debugging output:
@@ -173,6 +228,64 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     } );
 }
 
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_pull_from_outbound_ring()
+{
+  if ( _outbound_shutdown ) {
+    return;
+  }
+
+  Writer& outbound = _tcp->outbound_writer();
+  while ( outbound.available_capacity() ) {
+    std::string_view bytes = _outbound_ring->peek();
+    if ( bytes.empty() and not _outbound_ring->request_data_wakeup() ) {
+      bytes = _outbound_ring->peek(); // more arrived while asking to be woken
+    }
+    if ( bytes.empty() ) {
+      break;
+    }
+    const auto region = outbound.reserve( bytes.size() );
+    memcpy( region.data(), bytes.data(), region.size() );
+    outbound.commit( region.size() );
+    _outbound_ring->pop( region.size() );
+  }
+
+  if ( _outbound_ring->is_finished() ) {
+    outbound.close();
+    _outbound_shutdown = true;
+
+    // debugging output:
+    std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
+              << " finished (" << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
+              << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" ) << " still in flight).\n";
+  }
+
+  _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_push_to_inbound_ring()
+{
+  Reader& inbound = _tcp->inbound_reader();
+  while ( inbound.bytes_buffered() ) {
+    const size_t written = _inbound_ring->push( inbound.peek() );
+    inbound.pop( written );
+    if ( written == 0 and _inbound_ring->request_space_wakeup() ) {
+      _inbound_ring_full = true; // rule 2 will hear when the owner has made room
+      break;
+    }
+  }
+
+  if ( inbound.is_finished() or inbound.has_error() ) {
+    _inbound_ring->close();
+    _inbound_shutdown = true;
+
+    // debugging output:
+    std::cerr << "DEBUG: minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
+              << " finished " << ( inbound.has_error() ? "uncleanly.\n" : "cleanly.\n" );
+  }
+}
+
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
 //! \param[in] type is the type of AF_UNIX sockets to create (e.g., SOCK_SEQPACKET)
 //! \returns a std::pair of connected sockets
@@ -184,11 +297,23 @@ inline std::pair<SocketType, SocketType> socket_pair_helper( int domain, int typ
   return { SocketType { FileDescriptor { fds[0] } }, SocketType { FileDescriptor { fds[1] } } };
 }
 
+//! \brief The owner's and the TCP thread's ends of the data channel between them
+//! \details With ThreadChannel::SharedMemory, the bytes go through the rings, so there is no socket pair: the
+//! owner's end is an AF_UNIX stream socket that is never connected (so that TCPMinnowSocket is still one).
+inline std::pair<FileDescriptor, std::optional<FileDescriptor>> thread_data_sockets( const ThreadChannel channel )
+{
+  if ( channel == ThreadChannel::SharedMemory ) {
+    return { FileDescriptor { ::CheckSystemCall( "socket", ::socket( AF_UNIX, SOCK_STREAM, 0 ) ) }, std::nullopt };
+  }
+  auto [owner, tcp] = socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM );
+  return { std::move( owner ), std::move( tcp ) };
+}
+
 //! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
+//! \param[in] channel is how bytes move between the owner and TCP thread
 template<TCPDatagramAdapter AdaptT>
-TCPMinnowSocket<AdaptT>::TCPMinnowSocket( AdaptT&& datagram_interface )
-  : TCPMinnowSocket( socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM ),
-                     std::move( datagram_interface ) )
+TCPMinnowSocket<AdaptT>::TCPMinnowSocket( AdaptT&& datagram_interface, const ThreadChannel channel )
+  : TCPMinnowSocket( thread_data_sockets( channel ), std::move( datagram_interface ), channel )
 {}
 
 template<TCPDatagramAdapter AdaptT>
@@ -206,6 +331,101 @@ TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
   }
 }
 
+//! \param[in] buffer is the string to be read into (as for FileDescriptor::read)
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::read( std::string& buffer )
+{
+  if ( _channel == ThreadChannel::SocketPair ) {
+    LocalStreamSocket::read( buffer );
+    return;
+  }
+
+  if ( not _inbound_ring ) {
+    throw std::runtime_error( "read() before TCPPeer initialized" );
+  }
+
+  const size_t max_len = buffer.empty() ? kReadBufferSize : buffer.size();
+  buffer.clear();
+  while ( buffer.size() < max_len ) {
+    const std::string_view bytes = _inbound_ring->peek();
+    if ( bytes.empty() ) {
+      break;
+    }
+    const size_t len = std::min( bytes.size(), max_len - buffer.size() );
+    buffer.append( bytes.substr( 0, len ) );
+    _inbound_ring->pop( len );
+  }
+
+  if ( buffer.empty() and _inbound_ring->is_finished() ) {
+    set_eof();
+  }
+}
+
+//! \param[in] buffer is the data to be written
+//! \returns the number of bytes written, which may be fewer than requested (as for a non-blocking socket)
+template<TCPDatagramAdapter AdaptT>
+size_t TCPMinnowSocket<AdaptT>::write( const std::string_view buffer )
+{
+  if ( _channel == ThreadChannel::SocketPair ) {
+    return LocalStreamSocket::write( buffer );
+  }
+
+  if ( not _outbound_ring ) {
+    throw std::runtime_error( "write() before TCPPeer initialized" );
+  }
+  if ( _outbound_ring->is_closed() ) {
+    throw std::runtime_error( "write() after shutdown" );
+  }
+  return _outbound_ring->push( buffer );
+}
+
+//! \param[in] how can be `SHUT_RD`, `SHUT_WR`, or `SHUT_RDWR`
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::shutdown( const int how )
+{
+  if ( _channel == ThreadChannel::SocketPair ) {
+    LocalStreamSocket::shutdown( how );
+    return;
+  }
+
+  if ( how != SHUT_RD and how != SHUT_WR and how != SHUT_RDWR ) {
+    throw std::runtime_error( "TCPMinnowSocket::shutdown() called with invalid `how`" );
+  }
+  if ( how != SHUT_RD and _outbound_ring and not _outbound_ring->is_closed() ) {
+    _outbound_ring->close();
+  }
+}
+
+//! \param[in] want_write is whether to also wake up when write() can accept more bytes
+//! \param[in] timeout_ms is the longest to wait (-1 to wait indefinitely)
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::wait_until_ready( const bool want_write, const int timeout_ms )
+{
+  pollfd pfd { fd_num(), static_cast<int16_t>( POLLIN | ( want_write ? POLLOUT : 0 ) ), 0 };
+
+  if ( _channel == ThreadChannel::SharedMemory ) {
+    if ( not _inbound_ring ) {
+      throw std::runtime_error( "wait_until_ready() before TCPPeer initialized" );
+    }
+
+    // no system calls unless there is nothing to do
+    if ( not _inbound_ring->request_data_wakeup() ) {
+      return;
+    }
+    if ( want_write and not _outbound_ring->is_closed() and not _outbound_ring->request_space_wakeup() ) {
+      return;
+    }
+
+    // (a wakeup left over from earlier just ends this poll early, and the caller will ask again)
+    pfd = { _owner_wakeup.fd_num(), POLLIN, 0 };
+    ::CheckSystemCall( "poll", ::poll( &pfd, 1, timeout_ms ) );
+    _owner_wakeup.clear();
+    return;
+  }
+
+  ::CheckSystemCall( "poll", ::poll( &pfd, 1, timeout_ms ) );
+}
+
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
@@ -281,10 +501,19 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
       throw std::runtime_error( "no TCP" );
     }
     _tcp_loop( [] { return true; } );
-    shutdown( SHUT_RDWR );
+    if ( _channel == ThreadChannel::SharedMemory ) {
+      if ( not _inbound_ring->is_closed() ) {
+        _inbound_ring->close();
+      }
+    } else {
+      LocalStreamSocket::shutdown( SHUT_RDWR );
+    }
     if ( not _tcp.value().active() ) {
+      const TCPPeerStats& stats = _tcp->stats();
       std::cerr << "DEBUG: minnow TCP connection finished "
-                << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
+                << ( _tcp->inbound_reader().has_error() ? "uncleanly" : "cleanly" ) << " ("
+                << stats.segments_received << " segments received, " << stats.segments_sent << " sent, "
+                << stats.pure_acks_sent << " of them pure ACKs).\n";
     }
     _tcp.reset();
   } catch ( const std::exception& e ) {
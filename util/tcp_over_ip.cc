@@ -52,7 +52,8 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
     return {};
   }
 
-  // should we target this source addr/port (and use its destination addr as our source) in reply?
+  // should we target this source addr/port (and use its destination addr as our source) in reply? (Only the
+  // first SYN: a listening adapter carries one connection. TCPStack is the multi-connection listener.)
   if ( listening() ) {
     if ( tcp_seg.message.sender.SYN and not tcp_seg.message.sender.RST ) {
       config_mutable().source = Address { inet_ntoa( { htobe32( ip_dgram.header.dst ) } ), config().source.port() };
@@ -72,25 +73,78 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
   return tcp_seg.message;
 }
 
+//! \details Unlike unwrap_tcp_in_ip(), this keeps no state and filters nothing but invalid segments, so one
+//! reader can demultiplex the segments of many connections by their 4-tuple.
+optional<pair<FourTuple, TCPMessage>> TCPOverIPv4Adapter::parse_tcp_in_ip( const InternetDatagram& ip_dgram )
+{
+  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+    return {};
+  }
+
+  TCPSegment tcp_seg;
+  if ( not parse( tcp_seg, ip_dgram.payload, ip_dgram.header.pseudo_checksum() ) ) {
+    return {};
+  }
+
+  const FourTuple tuple {
+    ip_dgram.header.dst, ip_dgram.header.src, tcp_seg.udinfo.dst_port, tcp_seg.udinfo.src_port };
+  return pair { tuple, std::move( tcp_seg.message ) };
+}
+
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
+{
+  return wrap_tcp_in_ip( msg,
+                         { config().source.ipv4_numeric(),
+                           config().destination.ipv4_numeric(),
+                           config().source.port(),
+                           config().destination.port() } );
+}
+
+//! \param[in] msg is the TCP segment to convert
+//! \param[in] tuple gives the addresses and ports to send it from and to
+pair<IPv4Header, TCPSegment> TCPOverIPv4Adapter::make_tcp_in_ip( const TCPMessage& msg, const FourTuple& tuple )
 {
   TCPSegment seg { .message = msg };
   // set the port numbers in the TCP segment
-  seg.udinfo.src_port = config().source.port();
-  seg.udinfo.dst_port = config().destination.port();
+  seg.udinfo.src_port = tuple.local_port;
+  seg.udinfo.dst_port = tuple.remote_port;
 
-  // create an Internet Datagram and set its addresses and length
-  InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + seg.message.sender.payload.size();
+  // create an IPv4 header and set its addresses and length
+  IPv4Header header;
+  header.src = tuple.local_address;
+  header.dst = tuple.remote_address;
+  header.len = header.hlen * 4 + seg.header_length() + seg.message.sender.payload.size();
 
-  // set payload, calculating TCP checksum using information from IP header
-  seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
-  ip_dgram.header.compute_checksum();
-  ip_dgram.payload = serialize( seg );
+  // calculate the TCP checksum using information from the IP header
+  seg.compute_checksum( header.pseudo_checksum() );
+  header.compute_checksum();
+  return { header, std::move( seg ) };
+}
 
+//! \param[in] msg is the TCP segment to convert
+//! \param[in] tuple gives the addresses and ports to send it from and to
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg, const FourTuple& tuple )
+{
+  auto [header, seg] = make_tcp_in_ip( msg, tuple );
+  InternetDatagram ip_dgram;
+  ip_dgram.header = header;
+  ip_dgram.payload = serialize( seg ); // (copies the payload's Slices into strings)
   return ip_dgram;
 }
+
+//! \param[in] msg is the TCP segment to convert
+//! \param[in] tuple gives the addresses and ports to send it from and to
+//! \param[out] headers receives the serialized IPv4 and TCP headers
+vector<string_view> TCPOverIPv4Adapter::serialize_tcp_in_ip( const TCPMessage& msg,
+                                                              const FourTuple& tuple,
+                                                              string& headers )
+{
+  const auto [header, seg] = make_tcp_in_ip( msg, tuple );
+  headers.clear();
+  Serializer serializer { std::move( headers ) };
+  header.serialize( serializer );
+  seg.serialize( serializer );
+  return serializer.release( headers );
+}
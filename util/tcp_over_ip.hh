@@ -4,7 +4,51 @@
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//! The addresses and ports (host byte order) that identify a TCP connection, as seen from this end
+struct FourTuple
+{
+  uint32_t local_address {};
+  uint32_t remote_address {};
+  uint16_t local_port {};
+  uint16_t remote_port {};
+
+  bool operator==( const FourTuple& other ) const = default;
+
+  //! Hash for unordered containers: the twelve bytes, mixed so that nearby ports spread out
+  struct Hash
+  {
+    size_t operator()( const FourTuple& t ) const
+    {
+      const uint64_t addresses = uint64_t { t.local_address } << 32 | t.remote_address;
+      const uint64_t ports = uint64_t { t.local_port } << 16 | t.remote_port;
+      const uint64_t h = ( addresses ^ ( ports * 0x9E3779B97F4A7C15 ) ) * 0xBF58476D1CE4E5B9;
+      return h ^ ( h >> 31 );
+    }
+  };
+
+  //! Flow hash for steering: the same from both ends of a connection, so that two stacks sharded alike (e.g.
+  //! over the queues of a link) send each connection's segments both ways through the same pair of shards
+  struct FlowHash
+  {
+    size_t operator()( const FourTuple& t ) const
+    {
+      const uint64_t local = uint64_t { t.local_address } << 16 | t.local_port;
+      const uint64_t remote = uint64_t { t.remote_address } << 16 | t.remote_port;
+      const uint64_t h = ( std::min( local, remote ) * 0x9E3779B97F4A7C15 ^ std::max( local, remote ) )
+                         * 0xBF58476D1CE4E5B9;
+      return h ^ ( h >> 31 );
+    }
+  };
+};
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase
@@ -13,4 +57,22 @@ public:
   std::optional<TCPMessage> unwrap_tcp_in_ip( const InternetDatagram& ip_dgram );
 
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+  //! Parse the TCP segment in a datagram, whatever connection it belongs to, along with the 4-tuple
+  //! of that connection (as seen from the receiving end)
+  static std::optional<std::pair<FourTuple, TCPMessage>> parse_tcp_in_ip( const InternetDatagram& ip_dgram );
+
+  //! Wrap a TCP segment of the connection `tuple` in an IPv4 datagram
+  static InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg, const FourTuple& tuple );
+
+  //! Serialize the same datagram without copying the payload: the IPv4 and TCP headers are written to
+  //! `headers`, and the pieces returned (for one writev) are `headers` followed by views of the payload's
+  //! Slices, valid as long as `msg` and `headers` are
+  static std::vector<std::string_view> serialize_tcp_in_ip( const TCPMessage& msg,
+                                                            const FourTuple& tuple,
+                                                            std::string& headers );
+
+private:
+  //! The TCP segment (with ports and checksum) and the IPv4 header that carries it
+  static std::pair<IPv4Header, TCPSegment> make_tcp_in_ip( const TCPMessage& msg, const FourTuple& tuple );
 };
@@ -7,9 +7,21 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <optional>
 
+// Counts of the segments a TCPPeer has exchanged
+struct TCPPeerStats
+{
+  uint64_t segments_received {};
+  uint64_t segments_sent {};
+  uint64_t pure_acks_sent {};      // segments sent that occupy no sequence numbers
+  uint64_t delayed_acks_sent {};   // pure ACKs sent because the delayed-ACK timer expired
+  uint64_t window_updates_sent {}; // pure ACKs sent because the application opened the window
+};
+
 class TCPPeer
 {
   auto make_send( const auto& transmit )
@@ -28,13 +40,35 @@ public:
 
   /* Passthrough methods */
   void push( const TransmitFunction& transmit ) { sender_.push( make_send( transmit ) ); }
+  void set_corked( bool corked ) { sender_.set_corked( corked ); }
   void tick( uint64_t t, const TransmitFunction& transmit )
   {
     cumulative_time_ += t;
     sender_.tick( t, make_send( transmit ) );
+
+    // Send a delayed ACK whose time is up, or tell the peer the application has opened the window
+    if ( ack_deadline_.has_value() and cumulative_time_ >= *ack_deadline_ ) {
+      stretching_ = false;
+      stats_.delayed_acks_sent++;
+      send( sender_.make_empty_message(), transmit );
+    } else if ( window_update_due() ) {
+      stats_.window_updates_sent++;
+      send( sender_.make_empty_message(), transmit );
+    }
   }
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
+  /* Milliseconds until tick() next has something to do (a paced segment, a timer, a delayed ACK), if ever */
+  std::optional<uint64_t> next_deadline() const
+  {
+    auto deadline = sender_.next_deadline();
+    if ( ack_deadline_.has_value() ) {
+      const uint64_t ack_in = *ack_deadline_ - std::min( *ack_deadline_, cumulative_time_ );
+      deadline = std::min( deadline.value_or( ack_in ), ack_in );
+    }
+    return deadline;
+  }
+
   /* Is the peer still active? */
   bool active() const
   {
@@ -55,15 +89,48 @@ public:
 
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
-
-    // If SenderMessage occupies a sequence number, make sure to reply.
-    need_send_ |= ( msg.sender.sequence_length() > 0 );
+    stats_.segments_received++;
 
     // If SenderMessage is a "keep-alive" (with intentionally invalid seqno), make sure to reply.
     // (N.B. orthodox TCP rules require a reply on any unacceptable segment.)
     const auto our_ackno = receiver_.send().ackno;
     need_send_ |= ( our_ackno.has_value() and msg.sender.seqno + 1 == our_ackno.value() );
 
+    // Note what the receiver had before this segment, to tell in-order data from the rest
+    const uint64_t sequence_length = msg.sender.sequence_length();
+    const bool in_order = our_ackno.has_value() and msg.sender.seqno == our_ackno.value();
+    const bool had_holes = not receiver_.send().sack_blocks.empty();
+    const uint64_t payload_size = msg.sender.payload.size();
+    const bool syn_or_fin = msg.sender.SYN or msg.sender.FIN;
+    const uint64_t bytes_pushed = receiver_.writer().bytes_pushed();
+
+    // Note whether the peer can scale windows and use timestamps (RFC 7323) and SACK (RFC 2018), and unscale
+    // the window it advertises. (The window in a SYN is never scaled.)
+    if ( msg.sender.SYN and not peer_syn_seen_ ) {
+      peer_syn_seen_ = true;
+      if ( msg.window_scale.has_value() ) {
+        peer_window_shift_ = std::min( *msg.window_scale, TCPConfig::MAX_WINDOW_SHIFT );
+      }
+      peer_timestamps_ = msg.sender.TSval.has_value();
+      peer_sack_permitted_ = msg.sack_permitted;
+
+      // Segments can be as big as both the peer's MSS and our MTU allow, less the room for timestamps
+      const uint64_t mss
+        = std::min<uint64_t>( msg.mss.value_or( TCPConfig::DEFAULT_MSS ), cfg_.mtu - TCPConfig::HEADERS_LEN );
+      max_payload_ = mss - ( timestamps() ? TCPConfig::TIMESTAMPS_LEN : 0 );
+      sender_.set_max_payload_size( max_payload_ );
+    }
+    if ( window_scaling() and not msg.sender.SYN ) {
+      msg.receiver.window_size <<= *peer_window_shift_;
+    }
+    if ( not timestamps() ) {
+      msg.sender.TSval.reset();
+      msg.receiver.TSecr.reset();
+    }
+    if ( not sack() ) {
+      msg.receiver.sack_blocks.clear();
+    }
+
     // Did the inbound stream finish before the outbound stream? If so, no need to linger after streams finish.
     if ( receiver_.writer().is_closed() and not sender_.reader().is_finished() ) {
       linger_after_streams_finish_ = false;
@@ -72,8 +139,19 @@ public:
     // Give incoming TCPSenderMessage to receiver.
     receiver_.receive( std::move( msg.sender ) );
 
+    // If SenderMessage occupies a sequence number, make sure to reply -- now, or soon (a delayed ACK).
+    if ( sequence_length > 0 ) {
+      const uint64_t accepted = receiver_.writer().bytes_pushed() - bytes_pushed;
+      schedule_ack( in_order, had_holes, syn_or_fin, payload_size, accepted );
+    }
+
     // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( msg.receiver );
+    sender_.receive( msg.receiver, sequence_length > 0 );
+
+    // ACK clocking: a new ackno, a larger window or a larger congestion window may let more data go out (and
+    // the ACK may have set up a fast retransmission). Send it now, rather than wait for the application to
+    // push() (which it won't, if the outbound stream is already full).
+    push( transmit );
 
     // Send reply if needed.
     if ( need_send_ ) {
@@ -84,19 +162,142 @@ public:
   // Testing interface
   const TCPReceiver& receiver() const { return receiver_; }
   const TCPSender& sender() const { return sender_; }
+  const TCPPeerStats& stats() const { return stats_; }
 
 private:
   TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
-  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
+  ByteStream::Backend backend_ { cfg_.zero_copy ? ByteStream::Backend::Deque : ByteStream::Backend::MirroredRing };
+  TCPSender sender_ { ByteStream { cfg_.send_capacity, backend_ }, cfg_ };
+  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity, backend_ } }, TCPConfig::MAX_WINDOW };
 
   bool need_send_ {};
+  TCPPeerStats stats_ {};
+
+  // Delayed ACKs: in-order data is acknowledged after every ACK_EVERY full segments (or, while data
+  // streams in, every `stretch_ack`), or once the oldest unacknowledged segment has waited `ack_delay`
+  std::optional<uint64_t> ack_deadline_ {};
+  uint64_t unacked_bytes_ {};
+  uint64_t rcv_mss_ {}; // largest payload received, the receiver's guess at the peer's segment size
+  bool stretching_ {};
+  uint64_t window_edge_ {}; // the stream index just past the window last advertised
+
+  void schedule_ack( bool in_order, bool had_holes, bool syn_or_fin, uint64_t payload_size, uint64_t accepted )
+  {
+    rcv_mss_ = std::max( rcv_mss_, payload_size );
+    unacked_bytes_ += accepted;
+
+    // Out-of-order data, filling a hole, or a segment that did not fit gets an immediate ACK (RFC 5681)
+    const bool has_holes = not receiver_.send().sack_blocks.empty();
+    if ( not cfg_.delayed_ack or syn_or_fin or not in_order or had_holes or has_holes or accepted < payload_size ) {
+      stretching_ = false;
+      need_send_ = true;
+      return;
+    }
+
+    const uint64_t segments
+      = stretching_ ? std::max( cfg_.stretch_ack, TCPConfig::ACK_EVERY ) : TCPConfig::ACK_EVERY;
+    if ( unacked_bytes_ >= segments * rcv_mss_ ) {
+      stretching_ = true;
+      need_send_ = true;
+    } else if ( not ack_deadline_.has_value() ) {
+      ack_deadline_ = cumulative_time_ + cfg_.ack_delay;
+    }
+  }
+
+  // The window the peer will see, after scaling and the 16-bit header field
+  uint64_t advertised_window() const
+  {
+    const uint8_t shift = window_scaling() ? window_shift_ : 0;
+    return uint64_t { std::min( receiver_.send().window_size >> shift, uint32_t { UINT16_MAX } ) } << shift;
+  }
+
+  // Has the application read enough to double a window that had shrunk below half the buffer?
+  bool window_update_due() const
+  {
+    if ( not has_ackno() or receiver_.writer().is_closed() ) {
+      return false;
+    }
+    const uint64_t bytes_pushed = receiver_.writer().bytes_pushed();
+    const uint64_t advertised = window_edge_ - std::min( window_edge_, bytes_pushed );
+    const uint64_t window = advertised_window();
+    return advertised <= cfg_.recv_capacity / 2 and window >= 2 * advertised
+           and window >= advertised + std::max<uint64_t>( rcv_mss_, 1 );
+  }
+
+  // Window scaling: our shift is the smallest that lets the header express the whole receive capacity
+  static uint8_t window_shift_for( size_t capacity )
+  {
+    uint8_t shift = 0;
+    while ( shift < TCPConfig::MAX_WINDOW_SHIFT and ( capacity >> shift ) > UINT16_MAX ) {
+      ++shift;
+    }
+    return shift;
+  }
+  uint8_t window_shift_ { window_shift_for( cfg_.recv_capacity ) };
+  bool sent_window_scale_ {};
+  bool peer_syn_seen_ {};
+  std::optional<uint8_t> peer_window_shift_ {};
+  bool window_scaling() const { return sent_window_scale_ and peer_window_shift_.has_value(); }
+  bool peer_timestamps_ {};
+  bool timestamps() const { return cfg_.timestamps and peer_timestamps_; }
+  bool sent_sack_permitted_ {};
+  bool peer_sack_permitted_ {};
+  bool sack() const { return sent_sack_permitted_ and peer_sack_permitted_; }
+  uint64_t max_payload_ { TCPConfig::DEFAULT_MSS };
 
   void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
   {
     TCPMessage msg { sender_message, receiver_.send() };
+
+    // Tell the peer how big a segment our interface can take
+    if ( sender_message.SYN ) {
+      msg.mss = cfg_.mtu - TCPConfig::HEADERS_LEN;
+    }
+
+    // Offer window scaling in our SYN, unless the peer's SYN already came without it
+    if ( sender_message.SYN and cfg_.window_scaling and ( not peer_syn_seen_ or peer_window_shift_.has_value() ) ) {
+      msg.window_scale = window_shift_;
+      sent_window_scale_ = true;
+    }
+    // Likewise SACK, and blocks go out only once both SYNs have said SACK-permitted
+    if ( sender_message.SYN and cfg_.sack and ( not peer_syn_seen_ or peer_sack_permitted_ ) ) {
+      msg.sack_permitted = true;
+      sent_sack_permitted_ = true;
+    }
+    if ( not sack() ) {
+      msg.receiver.sack_blocks.clear();
+    }
+    // Timestamps are offered in our SYN, and kept in later segments only if the peer's SYN had them too
+    if ( peer_syn_seen_ and not timestamps() ) {
+      msg.sender.TSval.reset();
+      msg.receiver.TSecr.reset();
+    }
+
+    // SACK blocks only go in the room a data segment's payload leaves below the MSS
+    if ( not msg.sender.payload.empty() ) {
+      size_t num_blocks = std::min( msg.receiver.sack_blocks.size(), TCPConfig::MAX_SACK_BLOCKS );
+      while ( num_blocks > 0 and msg.sender.payload.size() + 4 + 8 * num_blocks > max_payload_ ) {
+        --num_blocks;
+      }
+      msg.receiver.sack_blocks.erase( msg.receiver.sack_blocks.begin() + static_cast<ptrdiff_t>( num_blocks ),
+                                      msg.receiver.sack_blocks.end() );
+    }
+
+    const uint8_t shift = window_scaling() and not sender_message.SYN ? window_shift_ : 0;
+    msg.receiver.window_size = std::min( msg.receiver.window_size >> shift, uint32_t { UINT16_MAX } );
+
+    stats_.segments_sent++;
+    if ( sender_message.sequence_length() == 0 ) {
+      stats_.pure_acks_sent++;
+    }
+    if ( msg.receiver.ackno.has_value() ) {
+      window_edge_ = receiver_.writer().bytes_pushed() + advertised_window();
+    }
+
     transmit( std::move( msg ) );
     need_send_ = false;
+    ack_deadline_.reset();
+    unacked_bytes_ = 0;
   }
 
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
@@ -2,26 +2,38 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
 #include <optional>
+#include <utility>
+#include <vector>
 
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
  *
- * It contains three fields:
+ * It contains five fields:
  *
  * 1) The acknowledgment number (ackno): the *next* sequence number needed by the TCP Receiver.
  *    This is an optional field that is empty if the TCPReceiver hasn't yet received the Initial Sequence Number.
  *
  * 2) The window size. This is the number of sequence numbers that the TCP receiver is interested
  *    to receive, starting from the ackno if present. The maximum value is 65,535 (UINT16_MAX from
- *    the <cstdint> header).
+ *    the <cstdint> header), or 65,535 << 14 once the peers have negotiated window scaling (RFC 7323).
+ *    The window is always unscaled here; TCPPeer scales it to and from the header's 16-bit field.
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) SACK blocks (RFC 2018): ranges of sequence numbers [left edge, right edge) that the TCP receiver holds
+ *    beyond the ackno, the most recently received first, so the sender can retransmit only the holes.
+ *    TCPPeer puts them on the wire only once both SYNs have carried the SACK-permitted option.
+ *
+ * 5) TSecr (RFC 7323): the TSval most recently received from the sender, echoed so it can measure round trips.
  */
 
 struct TCPReceiverMessage
 {
   std::optional<Wrap32> ackno {};
-  uint16_t window_size {};
+  uint32_t window_size {};
   bool RST {};
+  std::vector<std::pair<Wrap32, Wrap32>> sack_blocks {};
+  std::optional<uint32_t> TSecr {};
 };
@@ -1,10 +1,22 @@
 #include "tcp_segment.hh"
 #include "checksum.hh"
+#include "tcp_config.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <cstddef>
 
-static constexpr uint32_t TCPHeaderMinLen = 5; // 32-bit words
+static constexpr uint32_t TCPHeaderMinLen = 5;     // 32-bit words
+static constexpr size_t TCPMaxOptionsWords = 10; // the data offset allows at most 40 bytes of options
+
+// TCP option kinds
+static constexpr uint8_t TCPOptionEnd = 0;
+static constexpr uint8_t TCPOptionNoOp = 1;
+static constexpr uint8_t TCPOptionMSS = 2;
+static constexpr uint8_t TCPOptionWindowScale = 3; // RFC 7323
+static constexpr uint8_t TCPOptionSACKPermitted = 4; // RFC 2018
+static constexpr uint8_t TCPOptionSACK = 5; // RFC 2018
+static constexpr uint8_t TCPOptionTimestamps = 8; // RFC 7323
 
 using namespace std;
 
@@ -43,17 +55,77 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   message.sender.SYN = octet & 0b0000'0010;
   message.sender.FIN = octet & 0b0000'0001;
 
-  parser.integer( message.receiver.window_size );
+  parser.integer( raw16 );
+  message.receiver.window_size = raw16;
   parser.integer( udinfo.cksum );
   parser.integer( raw16 ); // urgent pointer
 
-  // skip any options or anything extra in the header
   if ( data_offset < TCPHeaderMinLen ) {
     parser.set_error();
+    return;
   }
-  parser.remove_prefix( data_offset * 4 - TCPHeaderMinLen * 4 );
+  parse_options( parser, data_offset * 4 - TCPHeaderMinLen * 4 );
 
-  parser.all_remaining( message.sender.payload );
+  string payload;
+  parser.all_remaining( payload );
+  message.sender.payload = move( payload );
+}
+
+// read the MSS, SACK, window scale and timestamps options, and skip any other options or anything extra in the
+// header
+void TCPSegment::parse_options( Parser& parser, uint64_t options_len )
+{
+  while ( options_len > 0 and not parser.has_error() ) {
+    uint8_t kind {};
+    parser.integer( kind );
+    --options_len;
+    if ( kind == TCPOptionEnd ) {
+      break;
+    }
+    if ( kind == TCPOptionNoOp ) {
+      continue;
+    }
+
+    uint8_t len {}; // includes the kind and length octets
+    parser.integer( len );
+    if ( options_len == 0 or len < 2 or len - 1U > options_len ) {
+      parser.set_error();
+      return;
+    }
+    options_len -= len - 1U;
+
+    if ( kind == TCPOptionSACK and ( len - 2 ) % 8 == 0 ) {
+      for ( int i = 0; i < ( len - 2 ) / 8; ++i ) {
+        uint32_t left {};
+        uint32_t right {};
+        parser.integer( left );
+        parser.integer( right );
+        message.receiver.sack_blocks.emplace_back( Wrap32 { left }, Wrap32 { right } );
+      }
+    } else if ( kind == TCPOptionMSS and len == 4 ) {
+      uint16_t mss {};
+      parser.integer( mss );
+      message.mss = mss;
+    } else if ( kind == TCPOptionSACKPermitted and len == 2 ) {
+      message.sack_permitted = true;
+    } else if ( kind == TCPOptionWindowScale and len == 3 ) {
+      uint8_t shift {};
+      parser.integer( shift );
+      message.window_scale = shift;
+    } else if ( kind == TCPOptionTimestamps and len == 10 ) {
+      uint32_t tsval {};
+      uint32_t tsecr {};
+      parser.integer( tsval );
+      parser.integer( tsecr );
+      message.sender.TSval = tsval;
+      if ( message.receiver.ackno.has_value() ) {
+        message.receiver.TSecr = tsecr; // only meaningful with an ACK
+      }
+    } else {
+      parser.remove_prefix( len - 2 );
+    }
+  }
+  parser.remove_prefix( options_len );
 }
 
 class Wrap32Serializable : public Wrap32
@@ -63,29 +135,106 @@ public:
 };
 
 void TCPSegment::serialize( Serializer& serializer ) const
+{
+  serialize_header( serializer );
+  for ( const auto& slice : message.sender.payload.slices() ) {
+    serializer.view( slice.view() );
+  }
+}
+
+void TCPSegment::serialize_header( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender.seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver.ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { TCPHeaderMinLen << 4 } ); // data offset
+  serializer.integer( static_cast<uint8_t>( ( TCPHeaderMinLen + options_words() ) << 4 ) ); // data offset
   const bool reset = message.sender.RST or message.receiver.RST;
   const uint8_t flags = ( message.receiver.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender.SYN ? 0b0000'0010U : 0 ) | ( message.sender.FIN ? 0b0000'0001U : 0 );
   serializer.integer( flags );
-  serializer.integer( message.receiver.window_size );
+  serializer.integer( static_cast<uint16_t>( min( message.receiver.window_size, uint32_t { UINT16_MAX } ) ) );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
-  serializer.buffer( message.sender.payload );
+
+  if ( message.mss.has_value() ) {
+    serializer.integer( TCPOptionMSS );
+    serializer.integer( uint8_t { 4 } );
+    serializer.integer( *message.mss );
+  }
+
+  if ( message.sack_permitted ) {
+    serializer.integer( TCPOptionNoOp ); // pad to a 32-bit boundary
+    serializer.integer( TCPOptionNoOp );
+    serializer.integer( TCPOptionSACKPermitted );
+    serializer.integer( uint8_t { 2 } );
+  }
+
+  if ( message.window_scale.has_value() ) {
+    serializer.integer( TCPOptionNoOp ); // pad to a 32-bit boundary
+    serializer.integer( TCPOptionWindowScale );
+    serializer.integer( uint8_t { 3 } );
+    serializer.integer( *message.window_scale );
+  }
+
+  if ( message.sender.TSval.has_value() ) {
+    serializer.integer( TCPOptionNoOp ); // pad so the timestamps are 32-bit aligned
+    serializer.integer( TCPOptionNoOp );
+    serializer.integer( TCPOptionTimestamps );
+    serializer.integer( uint8_t { 10 } );
+    serializer.integer( *message.sender.TSval );
+    serializer.integer( message.receiver.TSecr.value_or( 0 ) );
+  }
+
+  const size_t num_blocks = num_sack_blocks();
+  if ( num_blocks ) {
+    serializer.integer( TCPOptionNoOp ); // pad so the blocks are 32-bit aligned
+    serializer.integer( TCPOptionNoOp );
+    serializer.integer( TCPOptionSACK );
+    serializer.integer( static_cast<uint8_t>( 2 + 8 * num_blocks ) );
+    for ( size_t i = 0; i < num_blocks; ++i ) {
+      const auto& [left, right] = message.receiver.sack_blocks[i];
+      serializer.integer( Wrap32Serializable { left }.raw_value() );
+      serializer.integer( Wrap32Serializable { right }.raw_value() );
+    }
+  }
+}
+
+// SACK blocks get whatever room the other options leave (three blocks alongside timestamps)
+size_t TCPSegment::num_sack_blocks() const
+{
+  const size_t room = TCPMaxOptionsWords - other_options_words();
+  return min( { message.receiver.sack_blocks.size(), TCPConfig::MAX_SACK_BLOCKS, ( room - 1 ) / 2 } );
+}
+
+size_t TCPSegment::other_options_words() const
+{
+  return ( message.mss.has_value() ? 1 : 0 ) + ( message.sack_permitted ? 1 : 0 )
+         + ( message.window_scale.has_value() ? 1 : 0 ) + ( message.sender.TSval.has_value() ? 3 : 0 );
+}
+
+size_t TCPSegment::options_words() const
+{
+  const size_t num_blocks = num_sack_blocks();
+  return other_options_words() + ( num_blocks ? 1 + 2 * num_blocks : 0 );
+}
+
+size_t TCPSegment::header_length() const
+{
+  return ( TCPHeaderMinLen + options_words() ) * 4;
 }
 
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
   udinfo.cksum = 0;
   Serializer s;
-  serialize( s );
+  serialize_header( s );
 
+  // checksum the payload where it lies, without flattening it
   InternetChecksum check { datagram_layer_pseudo_checksum };
   check.add( s.output() );
+  for ( const auto& slice : message.sender.payload.slices() ) {
+    check.add( slice.view() );
+  }
   udinfo.cksum = check.value();
 }
@@ -5,10 +5,17 @@
 #include "tcp_sender_message.hh"
 #include "udinfo.hh"
 
+#include <cstdint>
+#include <optional>
+
+// A TCP message as it appears in the header: receiver.window_size is scaled by the negotiated window scale
 struct TCPMessage
 {
   TCPSenderMessage sender {};
   TCPReceiverMessage receiver {};
+  std::optional<uint8_t> window_scale {}; // the window scale option (RFC 7323), only in a SYN
+  std::optional<uint16_t> mss {};         // the maximum segment size option (RFC 9293), only in a SYN
+  bool sack_permitted {};                 // the SACK-permitted option (RFC 2018), only in a SYN
 };
 
 struct TCPSegment
@@ -17,7 +24,20 @@ struct TCPSegment
   UserDatagramInfo udinfo {};
 
   void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
+  // The payload's Slices go to the Serializer as views (Serializer::view), to be written in place
   void serialize( Serializer& serializer ) const;
 
+  // Serialize only the header (with options), e.g. to checksum the payload's Slices after it where they lie
+  void serialize_header( Serializer& serializer ) const;
+
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // Length of the header, including options, in bytes
+  size_t header_length() const;
+
+private:
+  void parse_options( Parser& parser, uint64_t options_len );
+  size_t num_sack_blocks() const;
+  size_t other_options_words() const;
+  size_t options_words() const;
 };
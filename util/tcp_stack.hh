@@ -0,0 +1,181 @@
+#pragma once
+
+#include "address.hh"
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "tcp_config.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//! Counts of what a TCPStack has done with the datagrams it read and wrote
+struct TCPStackStats
+{
+  uint64_t datagrams_received {};
+  uint64_t datagrams_sent {};
+  uint64_t invalid {};       //!< datagrams that didn't hold a valid TCP segment
+  uint64_t unmatched {};     //!< segments for no connection (and not a SYN to a listening port)
+  uint64_t passive_opens {}; //!< connections opened by a SYN to a listening port (or an ACK of a SYN cookie)
+  uint64_t syn_drops {};     //!< SYNs dropped because a listener's half-open connections filled its backlog
+  uint64_t accept_drops {};  //!< handshakes left unfinished because a listener's accept queue was full
+  uint64_t cookies_sent {};  //!< SYN-ACKs sent with a SYN cookie instead of keeping a half-open connection
+  uint64_t bad_cookies {};   //!< ACKs to a listening port that carried no valid cookie
+  uint64_t send_drops {};    //!< datagrams the fd had no room for (as a full NIC queue would drop them)
+};
+
+//! Many TCP connections sharing one datagram file descriptor (e.g. a TunFD), all run by the calling thread
+//! \details Each datagram read from the fd is parsed once and given to the connection its 4-tuple names,
+//! found in a hash table, so the cost of a segment doesn't grow with the number of connections. (A
+//! TCPMinnowSocket per connection needs a thread and a reader of its own, and every reader sees, parses and
+//! discards every other connection's segments.)
+//!
+//! The owner drives the stack: it calls receive() when the fd is readable (e.g. from an EventLoop rule on
+//! watch_fd()), tick() as time passes, and push() after writing to a connection's outbound stream. The handler is
+//! called after each segment a connection receives, so the application can read what arrived and write more.
+//!
+//! A listener keeps up to `backlog` half-open connections (SYN received, handshake not finished) and up to
+//! `backlog` finished ones waiting for accept(). The handler only hears about a passive connection once the
+//! application has accepted it. Past the backlog, a SYN is dropped, as Linux does; or, with SYN cookies, it is
+//! answered by a SYN-ACK whose ISN encodes the connection, and nothing is kept until the ACK brings the cookie
+//! back. (A cookie can't carry the window scale, timestamps or SACK-permitted options, so those connections go
+//! without.)
+class TCPStack
+{
+public:
+  //! A connection: its 4-tuple and TCP state machine
+  struct Connection
+  {
+    FourTuple tuple;
+    TCPPeer peer;
+    //! Where a passive connection is on its way to the application (an active one starts out Accepted)
+    enum class Stage : uint8_t
+    {
+      HalfOpen,
+      AcceptQueue,
+      Accepted
+    } stage { Stage::Accepted };
+
+    Connection( const FourTuple& s_tuple, const TCPConfig& config ) : tuple( s_tuple ), peer( config ) {}
+  };
+
+  static constexpr size_t DEFAULT_BACKLOG = 128;
+  static constexpr unsigned MAX_SYNACK_RETX = 5;     //!< a half-open connection is dropped after this many
+  static constexpr uint64_t COOKIE_PERIOD_MS = 64000; //!< a SYN cookie is good for one to two of these
+
+  using ConnectionHandler = std::function<void( Connection& )>;
+  using AcceptHandler = std::function<void( uint16_t port )>;
+
+  //! Sees each datagram read from the fd before it is parsed. Returning true takes it away (e.g. to the
+  //! stack that owns its connection), and the stack does nothing more with it.
+  using DatagramFilter = std::function<bool( const std::vector<std::string>& datagram )>;
+
+  //! Construct from a file descriptor that carries one IPv4 datagram per read and write (it is made
+  //! non-blocking, or with DatagramIO::IOUring, handed to an IOUringFD)
+  explicit TCPStack( FileDescriptor&& datagram_fd, DatagramIO io = DatagramIO::Syscalls );
+
+  //! Open a connection from `local` to `remote` (sending the SYN)
+  //! \returns the connection, which stays valid until tick() removes it
+  Connection& connect( const TCPConfig& config, const Address& local, const Address& remote );
+
+  //! Accept connections to `local` (whose address may be 0.0.0.0, for any)
+  void listen( const TCPConfig& config,
+               const Address& local,
+               size_t backlog = DEFAULT_BACKLOG,
+               bool syn_cookies = false );
+
+  //! The oldest connection to `port` whose handshake has finished, if there is one
+  //! \returns the connection, which stays valid until tick() removes it
+  Connection* accept( uint16_t port );
+
+  //! Called after a connection the application has (from connect() or accept()) has received a segment
+  void set_handler( ConnectionHandler handler ) { handler_ = std::move( handler ); }
+
+  //! Called when connections to a listening port are waiting for accept() (after receive() or tick() is done
+  //! with them, so it may do anything the application could)
+  void set_accept_handler( AcceptHandler handler ) { accept_handler_ = std::move( handler ); }
+
+  void set_filter( DatagramFilter filter ) { filter_ = std::move( filter ); }
+
+  //! Read and dispatch every datagram waiting on the fd
+  //! \returns the number of datagrams read
+  size_t receive();
+
+  //! Dispatch a datagram that came some other way than the fd
+  void deliver( const std::vector<std::string>& datagram );
+
+  //! Send what the application has written to a connection's outbound stream
+  void push( Connection& connection );
+
+  //! Time has passed for every connection. Connections that are no longer active, once the application has
+  //! read their inbound stream to the end, are removed.
+  void tick( uint64_t ms_since_last_tick );
+
+  //! The connection with this 4-tuple, if there is one
+  Connection* find( const FourTuple& tuple );
+
+  size_t size() const { return connections_.size(); } //!< number of connections
+  const TCPStackStats& stats() const { return stats_; }
+
+  //! The fd to watch for datagrams: the datagram fd, or with DatagramIO::IOUring, the ring's
+  const FileDescriptor& watch_fd() const { return ring_ ? ring_->watch_fd() : fd_; }
+
+  //! How the stack reads and writes (DatagramIO::Syscalls if it was asked for io_uring but it isn't available)
+  DatagramIO io() const { return ring_ ? DatagramIO::IOUring : DatagramIO::Syscalls; }
+
+private:
+  struct Listener
+  {
+    uint32_t address; //!< 0 for any
+    TCPConfig config;
+    size_t backlog;
+    bool syn_cookies;
+    size_t half_open {};
+    std::deque<FourTuple> accept_queue {};
+  };
+
+  FileDescriptor fd_;
+  std::optional<IOUringFD> ring_ {};
+  unsigned batching_ {}; //!< receive(), deliver(), push() and tick() calls under way (the ring submits after)
+  std::string headers_ {}; //!< the headers of the datagram being sent (its payload is written in place)
+  std::unordered_map<FourTuple, Connection, FourTuple::Hash> connections_ {};
+  std::unordered_map<uint16_t, Listener> listeners_ {}; //!< by port
+  ConnectionHandler handler_ {};
+  AcceptHandler accept_handler_ {};
+  DatagramFilter filter_ {};
+  std::vector<uint16_t> acceptable_ {}; //!< ports whose accept queue got a connection, for the accept handler
+  TCPStackStats stats_ {};
+  std::vector<std::string> read_buffers_ {};
+  uint64_t now_ms_ {}; //!< sum of the tick() intervals
+
+  Listener* find_listener( const FourTuple& tuple );
+  void listener_holds( Connection& connection, Listener& listener ); // move to the accept queue, if finished
+  void listener_drops( const Connection& connection );
+  void notify_acceptable();
+  void end_batch();
+
+  // SYN cookies: the ISN is the time (in COOKIE_PERIOD_MS) in the top 5 bits, the MSS (as an index into
+  // COOKIE_MSS) in the next 3, and 24 bits of a keyed hash of the 4-tuple, the peer's ISN and the time
+  static constexpr std::array<uint16_t, 8> COOKIE_MSS { 536, 1200, 1360, 1400, 1440, 1460, 4312, 8960 };
+  std::array<uint64_t, 2> cookie_secret_ {};
+  uint32_t cookie_hash( const FourTuple& tuple, Wrap32 peer_isn, uint64_t period ) const;
+  Wrap32 make_cookie( const FourTuple& tuple, Wrap32 peer_isn, uint16_t mss ) const;
+  std::optional<uint16_t> check_cookie( const FourTuple& tuple, Wrap32 peer_isn, Wrap32 cookie ) const;
+  static TCPConfig cookie_config( const TCPConfig& config, Wrap32 cookie );
+  void send_cookie( const FourTuple& tuple, const TCPMessage& syn, const Listener& listener );
+  Connection* open_from_cookie( const FourTuple& tuple, const TCPMessage& ack, Listener& listener );
+
+  void dispatch( const std::vector<std::string>& datagram );
+  void send( const FourTuple& tuple, const TCPMessage& msg );
+  auto transmit( const Connection& connection )
+  {
+    return [this, &connection]( const TCPMessage& msg ) { send( connection.tuple, msg ); };
+  }
+};
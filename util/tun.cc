@@ -1,5 +1,8 @@
 #include "tun.hh"
 #include "exception.hh"
+#include "socket.hh"
+
+#include <algorithm>
 
 #include <cstring>
 #include <fcntl.h>
@@ -14,20 +17,22 @@ using namespace std;
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects
 //! Ethernet frames)
+//! \param[in] multi_queue is `true` to attach one more queue of a device created with `multi_queue`
 //!
 //! To create a TUN device, you should already have run
 //!
-//!     ip tuntap add mode tun user `username` name `devname`
+//!     ip tuntap add mode tun user `username` name `devname` [multi_queue]
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD( const string& devname, const bool is_tun )
+TunTapFD::TunTapFD( const string& devname, const bool is_tun, const bool multi_queue )
   : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) )
 {
   struct ifreq tun_req
   {};
 
-  tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI ); // no packetinfo
+  const int mode = ( is_tun ? IFF_TUN : IFF_TAP ) | ( multi_queue ? IFF_MULTI_QUEUE : 0 );
+  tun_req.ifr_flags = static_cast<int16_t>( mode | IFF_NO_PI ); // no packetinfo
 
   // copy devname to ifr_name, making sure to null terminate
 
@@ -36,3 +41,25 @@ TunTapFD::TunTapFD( const string& devname, const bool is_tun )
 
   CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) );
 }
+
+uint16_t TunTapFD::mtu() const
+{
+  struct ifreq req
+  {};
+
+  // the device's name, then its MTU, which only a socket's ioctl reports
+  CheckSystemCall( "ioctl", ioctl( fd_num(), TUNGETIFF, static_cast<void*>( &req ) ) );
+  const UDPSocket socket;
+  CheckSystemCall( "ioctl", ioctl( socket.fd_num(), SIOCGIFMTU, static_cast<void*>( &req ) ) );
+  return static_cast<uint16_t>( clamp( req.ifr_mtu, 0, int { UINT16_MAX } ) );
+}
+
+vector<TunFD> TunFD::open_queues( const string& devname, const size_t count )
+{
+  vector<TunFD> queues;
+  queues.reserve( count );
+  for ( size_t i = 0; i < count; i++ ) {
+    queues.emplace_back( devname, true );
+  }
+  return queues;
+}
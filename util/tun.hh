@@ -2,7 +2,9 @@
 
 #include "file_descriptor.hh"
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor
@@ -10,7 +12,13 @@ class TunTapFD : public FileDescriptor
 public:
   //! Open an existing persistent [TUN or TAP
   //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunTapFD( const std::string& devname, bool is_tun );
+  //! \details With `multi_queue`, this is one queue of the device (IFF_MULTI_QUEUE): each open attaches
+  //! another queue, and the kernel spreads the datagrams it sends across them by flow, so a queue can have a
+  //! thread of its own.
+  explicit TunTapFD( const std::string& devname, bool is_tun, bool multi_queue = false );
+
+  //! The device's MTU (as `ip link set dev <devname> mtu <mtu>` sets it), from the SIOCGIFMTU ioctl
+  uint16_t mtu() const;
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -18,7 +26,10 @@ class TunFD : public TunTapFD
 {
 public:
   //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunFD( const std::string& devname ) : TunTapFD( devname, true ) {}
+  explicit TunFD( const std::string& devname, bool multi_queue = false ) : TunTapFD( devname, true, multi_queue ) {}
+
+  //! Open `count` queues of a multi-queue TUN device
+  static std::vector<TunFD> open_queues( const std::string& devname, size_t count );
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -3,18 +3,56 @@
 
 using namespace std;
 
+TCPOverIPv4OverTunFdAdapter::TCPOverIPv4OverTunFdAdapter( FileDescriptor&& tun, const DatagramIO io )
+  : _tun( std::move( tun ) )
+{
+  if ( io == DatagramIO::IOUring and IOUringFD::available() ) {
+    _ring.emplace( _tun.duplicate() );
+  } else {
+    _tun.set_blocking( false );
+  }
+}
+
 optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
 {
-  vector<string> strs( 2 );
-  strs.front().resize( IPv4Header::LENGTH );
-  _tun.read( strs );
+  vector<string> strs;
+  while ( true ) {
+    strs.resize( 2 );
+    strs.front().resize( IPv4Header::LENGTH );
+    if ( _ring ) {
+      _ring->read( strs );
+    } else {
+      _tun.read( strs );
+    }
+    if ( strs.size() < 2 or ( strs.front().empty() and strs.back().empty() ) ) {
+      return {}; // nothing had arrived (or EOF)
+    }
 
-  InternetDatagram ip_dgram;
-  const vector<string> buffers = { strs.at( 0 ), strs.at( 1 ) };
-  if ( parse( ip_dgram, buffers ) ) {
-    return unwrap_tcp_in_ip( ip_dgram );
+    // (a datagram that isn't a segment of this connection is skipped)
+    InternetDatagram ip_dgram;
+    const vector<string> buffers = { strs.at( 0 ), strs.at( 1 ) };
+    if ( parse( ip_dgram, buffers ) ) {
+      if ( auto seg = unwrap_tcp_in_ip( ip_dgram ) ) {
+        return seg;
+      }
+    }
+  }
+}
+
+void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )
+{
+  const FourTuple tuple { config().source.ipv4_numeric(),
+                          config().destination.ipv4_numeric(),
+                          config().source.port(),
+                          config().destination.port() };
+  const auto datagram = serialize_tcp_in_ip( seg, tuple, _headers );
+  if ( _ring ) {
+    // (a segment is sent at once, with any reads the ring has to replace; it isn't known when the next will be)
+    _ring->write( datagram );
+    _ring->submit();
+  } else {
+    _tun.write( datagram );
   }
-  return {};
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "io_uring.hh"
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
 
 #include <optional>
+#include <string>
 #include <unordered_map>
 #include <utility>
 
@@ -20,29 +22,31 @@ concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
 };
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
+//! \details Any file descriptor that carries one IPv4 datagram per read and write will do in place
+//! of the TUN device (e.g. one end of an AF_UNIX SOCK_DGRAM socketpair, to connect two stacks in-process).
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 {
 private:
-  TunFD _tun;
+  FileDescriptor _tun;
+  std::optional<IOUringFD> _ring {};
+  std::string _headers {}; //!< the headers of the datagram being written (its payload is written in place)
 
 public:
-  //! Construct from a TunFD
-  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
+  //! Construct from a TunFD (or another datagram file descriptor), to be read and written as `io` says (with
+  //! DatagramIO::Syscalls, it is made non-blocking)
+  explicit TCPOverIPv4OverTunFdAdapter( FileDescriptor&& tun, DatagramIO io = DatagramIO::Syscalls );
 
-  //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
+  //! Reads IPv4 datagrams until one contains a TCP segment related to the current connection
+  //! \returns the segment, or nothing once no more datagrams have arrived. (With DatagramIO::IOUring, datagrams
+  //! that arrived together are read from the ring together: call this until it returns nothing.)
   std::optional<TCPMessage> read();
 
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-  void write( const TCPMessage& seg ) { _tun.write( serialize( wrap_tcp_in_ip( seg ) ) ); }
+  void write( const TCPMessage& seg );
 
-  //! Access the underlying TUN device
-  explicit operator TunFD&() { return _tun; }
-
-  //! Access the underlying TUN device
-  explicit operator const TunFD&() const { return _tun; }
-
-  //! Access underlying file descriptor
-  FileDescriptor& fd() { return _tun; }
+  //! The file descriptor to watch for datagrams: the underlying one, or with DatagramIO::IOUring, the ring's,
+  //! which is readable when datagrams have arrived
+  const FileDescriptor& watch_fd() const { return _ring ? _ring->watch_fd() : _tun; }
 };
 
 static_assert( TCPDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );